@@ -13,19 +13,23 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cinttypes>
+#include <condition_variable>
 #include <cstdint>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <fcntl.h>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -49,6 +53,11 @@
 #include "trace_collector_client.h"
 #include "trace_json_parser.h"
 #include "hitrace_dump.h"
+#include "raw_trace_decoder.h"
+#include "trace_marker.h"
+#include "trace_slice_stats.h"
+#include "trace_dump_strategy.h"
+#include "trace_source_factory.h"
 #include "cJSON.h"
 
 using namespace OHOS::HiviewDFX::Hitrace;
@@ -93,6 +102,12 @@ enum RunningState {
     SET_TRACE_LEVEL = 33,    // --trace_level level
     GET_TRACE_LEVEL = 34,    // --trace_level
     CONFIG_BOOT_TRACE = 35,  // --boot_trace
+
+    /* Dump pipeline statistics */
+    DUMP_STATS = 36,         // --dump_stats
+
+    /* Analyze a trace file */
+    SLICE_STATS = 37,        // --slice_stats file
 };
 }
 
@@ -113,6 +128,8 @@ static bool HandleCloseSnapshot();
 static bool SetTraceLevel();
 static bool GetTraceLevel();
 static bool HandleBootTraceConfig();
+static bool HandleDumpStats();
+static bool HandleSliceStats();
 static bool HandleOptBootTrace(const RunningState& setValue);
 static bool HandleOptRepeat(const RunningState& setValue);
 
@@ -122,6 +139,8 @@ static bool HandleOptTime(const RunningState& setValue);
 static bool HandleOptOutput(const RunningState& setValue);
 static bool HandleOptOverwrite(const RunningState& setValue);
 static bool HandleOptRecord(const RunningState& setValue);
+static bool HandleOptRawText(const RunningState& setValue);
+static bool HandleOptSliceStats(const RunningState& setValue);
 static bool HandleOptFilesize(const RunningState& setValue);
 static bool HandleOptTotalsize(const RunningState& setValue);
 static bool HandleOptTracelevel(const RunningState& setValue);
@@ -146,6 +165,8 @@ struct TraceArgs {
 
     int duration = 0;
     bool isCompress = false;
+    bool isRawText = false; // --raw_text: format the text in userspace from a raw capture
+    std::string sliceStatsFile; // --slice_stats: the raw or text trace file to analyze
     // --repeat for boot_trace, range [1, 100]
     int remainingCount = 1;
     std::string bootFilePrefix; // prefix for boot trace file name
@@ -187,6 +208,8 @@ enum CmdErrorCode {
     OPEN_ROOT_PATH_FAILURE = 2001,
     OPEN_FILE_PATH_FAILURE = 2002,
     TRACING_ON_CLOSED = 2003,
+    RAW_TRACE_CAPTURE_FAILURE = 2004,
+    COMPRESS_TRACE_FAILURE = 2005,
 };
 
 const std::map<RunningState, std::string> STATE_INFO = {
@@ -206,6 +229,8 @@ const std::map<RunningState, std::string> STATE_INFO = {
     { SET_TRACE_LEVEL, "SET_TRACE_LEVEL"},
     { GET_TRACE_LEVEL, "GET_TRACE_LEVEL"},
     { CONFIG_BOOT_TRACE, "CONFIG_BOOT_TRACE"},
+    { DUMP_STATS, "DUMP_STATS"},
+    { SLICE_STATS, "SLICE_STATS"},
 };
 
 constexpr struct option LONG_OPTIONS[] = {
@@ -234,6 +259,9 @@ constexpr struct option LONG_OPTIONS[] = {
     { "repeat",              required_argument, nullptr, 0 },
     { "file_prefix",         required_argument, nullptr, 0 },
     { "increment",           no_argument,       nullptr, 0 },
+    { "dump_stats",          no_argument,       nullptr, 0 },
+    { "raw_text",            no_argument,       nullptr, 0 },
+    { "slice_stats",         required_argument, nullptr, 0 },
     { nullptr,               0,                 nullptr, 0 },
 };
 
@@ -251,7 +279,9 @@ const std::unordered_map<RunningState, TaskFunc> TASK_TABLE = {
     {SNAPSHOT_STOP, HandleCloseSnapshot},
     {SET_TRACE_LEVEL, SetTraceLevel},
     {GET_TRACE_LEVEL, GetTraceLevel},
-    {CONFIG_BOOT_TRACE, HandleBootTraceConfig}
+    {CONFIG_BOOT_TRACE, HandleBootTraceConfig},
+    {DUMP_STATS, HandleDumpStats},
+    {SLICE_STATS, HandleSliceStats}
 };
 
 const std::unordered_map<std::string, CommandFunc> COMMAND_TABLE = {
@@ -279,7 +309,10 @@ const std::unordered_map<std::string, CommandFunc> COMMAND_TABLE = {
     {"boot_trace", HandleOptBootTrace},
     {"repeat", HandleOptRepeat},
     {"file_prefix", HandleOptBootFilePrefix},
-    {"increment", HandleOptBootIncrement}
+    {"increment", HandleOptBootIncrement},
+    {"dump_stats", SetRunningState},
+    {"raw_text", HandleOptRawText},
+    {"slice_stats", HandleOptSliceStats}
 };
 
 std::unordered_map<std::string, RunningState> OPT_MAP = {
@@ -307,7 +340,10 @@ std::unordered_map<std::string, RunningState> OPT_MAP = {
     {"boot_trace", CONFIG_BOOT_TRACE},
     {"repeat", CONFIG_BOOT_TRACE},
     {"file_prefix", CONFIG_BOOT_TRACE},
-    {"increment", CONFIG_BOOT_TRACE}
+    {"increment", CONFIG_BOOT_TRACE},
+    {"dump_stats", DUMP_STATS},
+    {"raw_text", STATE_NULL},
+    {"slice_stats", SLICE_STATS}
 };
 
 const std::set<std::string> CLOCK_TYPE = {
@@ -319,6 +355,13 @@ const std::set<std::string> CLOCK_TYPE = {
 };
 
 constexpr unsigned int CHUNK_SIZE = 65536;
+constexpr size_t COMPRESS_BLOCK_SIZE = 1024 * 1024; // 1 MB read and compressed per worker task
+constexpr size_t COMPRESS_DICT_SIZE = 32768; // deflate window, primes each block with the tail of the previous one
+constexpr unsigned int MAX_COMPRESS_WORKERS = 8;
+constexpr size_t COMPRESS_BLOCKS_PER_WORKER = 2;
+constexpr uint8_t ZLIB_HEADER[] = { 0x78, 0x9c }; // deflate, 32K window, default level
+constexpr int ZLIB_MEM_LEVEL = 8;
+constexpr char RAW_TEXT_TMP_PREFIX[] = "/data/local/tmp/hitrace_raw_text_";
 
 // support customization of some parameters
 constexpr int KB_PER_MB = 1024;
@@ -333,6 +376,7 @@ constexpr int MAX_FILE_SIZE = 512000; // 500 MB
 constexpr int MAX_FILE_SIZE_MULTIPLIER = 10;
 
 constexpr int BOOT_TRACE_DEFAULT_DURATION = 30; // 30 seconds
+constexpr int DUMP_STATS_DEFAULT_DURATION = 5; // 5 seconds
 constexpr int BOOT_TRACE_REPEAT_MIN = 1;
 constexpr int BOOT_TRACE_REPEAT_MAX = 100;
 constexpr int BOOT_TRACE_EXIT_OK = 0;
@@ -511,8 +555,16 @@ static bool SetProperty(const std::string& property, const std::string& value)
 
 static bool SetTraceTagsEnabled(uint64_t tags)
 {
+    if (tags != 0) {
+        SetProperty(TRACE_TAG_RATE_LIMIT, TraceJsonParser::Instance().GetTagRateLimitParam());
+    }
     std::string value = std::to_string(tags);
-    return SetProperty(TRACE_TAG_ENABLE_FLAGS, value);
+    bool ret = SetProperty(TRACE_TAG_ENABLE_FLAGS, value);
+    if (tags == 0) {
+        // the processes report the drops still pending and stop paying for the buckets
+        SetProperty(TRACE_TAG_RATE_LIMIT, "");
+    }
+    return ret;
 }
 
 static void ShowListCategory()
@@ -565,6 +617,9 @@ static void ShowHelp(const std::string& cmd)
            "  -z                     Compresses a captured trace.\n"
            "  --text                 Specify the output format of trace as text.\n"
            "  --raw                  Specify the output format of trace as raw trace, the default format is text.\n"
+           "  --raw_text             Read the raw per-cpu buffers and format the text in userspace, instead of\n"
+           "                         reading the kernel formatted trace. Works with --text, --trace_dump and\n"
+           "                         --trace_finish, the events read are consumed from the buffer.\n"
            "  --start_bgsrv          Enable trace_service in snapshot mode.\n"
            "  --dump_bgsrv           Trigger the dump trace task of the trace_service.\n"
            "  --stop_bgsrv           Disable trace_service in snapshot mode.\n"
@@ -577,6 +632,10 @@ static void ShowHelp(const std::string& cmd)
            "                         D or Debug, I or Info, C or Critical, M or Commercial.\n"
            "  --get_level            Query the system parameter \"persist.hitrace.level.threshold\",\n"
            "                         which can control the level threshold of tracing.\n"
+           "  --dump_stats           Capture a raw trace with the given categories and print the dump pipeline\n"
+           "                         statistics: bytes read per cpu, skipped pages, stage durations and latencies.\n"
+           "  --slice_stats file     Pair the B/E and S/F markers of a raw or text trace file and print count, total,\n"
+           "                         min, max and percentile durations per name and tag, to --output if set.\n"
     );
     if (ShouldShowBootTraceHelp()) {
         ShowBootTraceHelp();
@@ -604,7 +663,7 @@ static bool CheckTraceLevel(const std::string& arg)
 
 static bool SetTraceLevel()
 {
-    bool isSuccess = OHOS::system::SetParameter(TRACE_LEVEL_THRESHOLD, g_traceArgs.level);
+    bool isSuccess = SetPropertyInner(TRACE_LEVEL_THRESHOLD, g_traceArgs.level);
     if (!isSuccess) {
         ConsoleLog("error: failed to set trace level.");
     } else {
@@ -1319,6 +1378,91 @@ static bool HandleBootTraceConfig()
     return BuildAndWriteBootTraceConfig(kernelTags, userTags);
 }
 
+static void PrintDumpStats(const TraceDumpMetrics& metrics)
+{
+    std::cout << "dump stats:" << std::endl;
+    uint64_t totalBytes = 0;
+    uint32_t cpuCount = std::min(metrics.cpuCount, static_cast<uint32_t>(DUMP_METRICS_MAX_CPU));
+    for (uint32_t cpu = 0; cpu < cpuCount; cpu++) {
+        std::cout << "    cpu" << cpu << " bytes read: " << metrics.cpuBytesRead[cpu] << std::endl;
+        totalBytes += metrics.cpuBytesRead[cpu];
+    }
+    std::cout << "    total bytes read: " << totalBytes << std::endl;
+    std::cout << "    pages skipped: " << metrics.pagesSkipped << std::endl;
+    std::cout << "    pages check failed: " << metrics.pagesCheckFailed << std::endl;
+    std::cout << "    meta duration: " << metrics.metaDurationUs << "us" << std::endl;
+    std::cout << "    read duration: " << metrics.readDurationUs << "us" << std::endl;
+    std::cout << "    write duration: " << metrics.writeDurationUs << "us" << std::endl;
+    std::cout << "    fork latency: " << metrics.forkLatencyUs << "us" << std::endl;
+    std::cout << "    ipc latency: " << metrics.ipcLatencyUs << "us" << std::endl;
+    std::cout << "    buffer peak bytes: " << metrics.bufferPeakBytes << std::endl;
+}
+
+static bool HandleDumpStats()
+{
+    if (g_traceArgs.tagsVec.empty()) {
+        ConsoleLog("error: tag is empty, please add.");
+        return false;
+    }
+    ::OHOS::HiviewDFX::Hitrace::TraceArgs args;
+    args.tags = g_traceArgs.tagsVec;
+    args.bufferSize = static_cast<uint32_t>(g_traceArgs.bufferSize > 0 ? g_traceArgs.bufferSize : DEFAULT_BUFFER_SIZE);
+    if (!g_traceArgs.clockType.empty()) {
+        args.clockType = g_traceArgs.clockType;
+    }
+    args.isOverWrite = g_traceArgs.overwrite;
+    TraceErrorCode openRet = OpenTrace(args);
+    if (openRet != TraceErrorCode::SUCCESS) {
+        ConsoleLog("error: OpenTrace failed, errorCode(" + std::to_string(static_cast<int>(openRet)) + ")");
+        return false;
+    }
+
+    int duration = (g_traceArgs.duration > 0) ? g_traceArgs.duration : DUMP_STATS_DEFAULT_DURATION;
+    ConsoleLog("start capture, please wait " + std::to_string(duration) + "s ...");
+    sleep(static_cast<unsigned int>(duration));
+
+    TraceRetInfo dumpRet = DumpTrace(static_cast<uint32_t>(duration));
+    if (dumpRet.errorCode != TraceErrorCode::SUCCESS) {
+        ConsoleLog("error: DumpTrace failed, errorCode(" + std::to_string(static_cast<int>(dumpRet.errorCode)) + ")");
+        (void)CloseTrace();
+        return false;
+    }
+    ConsoleLog("capture done, output files:");
+    for (const auto& item : dumpRet.outputFiles) {
+        std::cout << "    " << item << std::endl;
+    }
+    PrintDumpStats(dumpRet.dumpMetrics);
+
+    TraceErrorCode closeRet = CloseTrace();
+    if (closeRet != TraceErrorCode::SUCCESS) {
+        ConsoleLog("error: CloseTrace failed, errorCode(" + std::to_string(static_cast<int>(closeRet)) + ")");
+    }
+    return true;
+}
+
+static bool HandleSliceStats()
+{
+    SliceAggregator aggregator;
+    if (!AggregateTraceSlices(g_traceArgs.sliceStatsFile, aggregator)) {
+        ConsoleLog("error: analyze " + g_traceArgs.sliceStatsFile + " failed.");
+        return false;
+    }
+    std::string text = FormatSliceStats(aggregator);
+    if (g_traceArgs.output.empty()) {
+        std::cout << text;
+        std::cout.flush();
+        return true;
+    }
+    std::ofstream outFile(g_traceArgs.output, std::ios::out | std::ios::trunc);
+    outFile << text;
+    if (!outFile.good()) {
+        ConsoleLog("error: write " + g_traceArgs.output + " failed.");
+        return false;
+    }
+    ConsoleLog("slice statistics written to " + g_traceArgs.output);
+    return true;
+}
+
 static bool CheckOutputFile(const char* path)
 {
     struct stat buf;
@@ -1421,6 +1565,36 @@ static bool HandleOptRecord(const RunningState& setValue)
     return isTrue;
 }
 
+static bool HandleOptRawText(const RunningState& setValue)
+{
+    // a modifier, it does not change the running state, which is checked in CheckRawTextState once all options
+    // are parsed because --raw_text may come before the command it modifies.
+    (void)setValue;
+    g_traceArgs.isRawText = true;
+    return true;
+}
+
+static bool CheckRawTextState()
+{
+    if (!g_traceArgs.isRawText || g_runningState == STATE_NULL || g_runningState == RECORDING_SHORT_TEXT ||
+        g_runningState == RECORDING_LONG_DUMP || g_runningState == RECORDING_LONG_FINISH) {
+        return true;
+    }
+    ConsoleLog("error: --raw_text only supports --text, --trace_dump and --trace_finish, not " +
+        GetStateInfo(g_runningState) + ".");
+    return false;
+}
+
+static bool HandleOptSliceStats(const RunningState& setValue)
+{
+    if (optarg == nullptr || strlen(optarg) == 0) {
+        ConsoleLog("error: slice_stats needs a trace file, eg: \"--slice_stats /data/log/hitrace/trace.sys\".");
+        return false;
+    }
+    g_traceArgs.sliceStatsFile = optarg;
+    return SetRunningState(setValue);
+}
+
 static bool HandleOptFilesize(const RunningState& setValue)
 {
     if (optarg == nullptr) {
@@ -1630,115 +1804,367 @@ static void StopTrace()
     SetFtraceEnabled(TRACING_ON_NODE, false);
 }
 
-static void DumpCompressedTrace(int traceFd, int outFd)
+struct CompressBlock {
+    std::vector<uint8_t> dict;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    uLong adler = 0;
+    bool done = false;
+    bool ok = false;
+};
+
+static bool DeflateBlock(CompressBlock& block)
 {
-    z_stream zs { nullptr };
-    int flush = Z_NO_FLUSH;
-    ssize_t bytesWritten;
-    ssize_t bytesRead;
-    if (memset_s(&zs, sizeof(zs), 0, sizeof(zs)) != EOK) {
-        ConsoleLog("error: zip stream buffer init failed.");
-        return;
-    }
-    int ret = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+    block.adler = adler32(adler32(0L, Z_NULL, 0), block.in.data(), block.in.size());
+    z_stream zs {};
+    int ret = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, ZLIB_MEM_LEVEL, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK) {
         ConsoleLog("error: initializing zlib failed ret " + std::to_string(ret));
-        return;
+        return false;
     }
-    std::unique_ptr<uint8_t[]>  in = std::make_unique<uint8_t[]>(CHUNK_SIZE);
-    std::unique_ptr<uint8_t[]>  out = std::make_unique<uint8_t[]>(CHUNK_SIZE);
-    if (!in || !out) {
-        ConsoleLog("error: couldn't allocate buffers.");
-        return;
+    if (!block.dict.empty()) {
+        deflateSetDictionary(&zs, block.dict.data(), block.dict.size());
+    }
+    // a sync flush ends the block on a byte boundary without the final bit, so blocks can be concatenated
+    constexpr size_t syncFlushMarkerSize = 16;
+    block.out.resize(deflateBound(&zs, block.in.size()) + syncFlushMarkerSize);
+    zs.next_in = block.in.data();
+    zs.avail_in = block.in.size();
+    zs.next_out = block.out.data();
+    zs.avail_out = block.out.size();
+    ret = deflate(&zs, Z_SYNC_FLUSH);
+    bool ok = ret == Z_OK && zs.avail_in == 0 && zs.avail_out > 0;
+    if (!ok) {
+        ConsoleLog("error: deflate failed return " + std::to_string(ret));
     }
-    zs.next_out = reinterpret_cast<Bytef*>(out.get());
-    zs.avail_out = CHUNK_SIZE;
+    block.out.resize(block.out.size() - zs.avail_out);
+    deflateEnd(&zs);
+    return ok;
+}
+
+static bool WriteCompressed(int outFd, const uint8_t* data, size_t size)
+{
+    ssize_t bytesWritten = TEMP_FAILURE_RETRY(write(outFd, data, size));
+    if (bytesWritten < static_cast<ssize_t>(size)) {
+        ConsoleLog("error: writing deflated trace, errno " + std::to_string(errno));
+        return false;
+    }
+    return true;
+}
 
-    do {
-        if (zs.avail_in == 0 && flush == Z_NO_FLUSH) {
-            bytesRead = TEMP_FAILURE_RETRY(read(traceFd, in.get(), CHUNK_SIZE));
+// Reads the text trace like read(2), with each counter batch line expanded into one line per counter.
+class TraceTextReader {
+public:
+    explicit TraceTextReader(int fd) : fd_(fd), chunk_(std::make_unique<char[]>(CHUNK_SIZE)) {}
+
+    ssize_t Read(char* buffer, size_t size)
+    {
+        while (outPos_ == out_.size() && !eof_) {
+            ssize_t bytesRead = TEMP_FAILURE_RETRY(read(fd_, chunk_.get(), CHUNK_SIZE));
+            if (bytesRead == -1) {
+                return -1;
+            }
+            out_.clear();
+            outPos_ = 0;
             if (bytesRead == 0) {
-                flush = Z_FINISH;
-            } else if (bytesRead == -1) {
-                ConsoleLog("error: reading trace, errno " + std::to_string(errno));
-                break;
+                expander_.Finish(out_);
+                eof_ = true;
             } else {
-                zs.next_in = reinterpret_cast<Bytef*>(in.get());
-                zs.avail_in = bytesRead;
+                expander_.Feed(std::string_view(chunk_.get(), static_cast<size_t>(bytesRead)), out_);
             }
         }
-        if (zs.avail_out == 0) {
-            bytesWritten = TEMP_FAILURE_RETRY(write(outFd, out.get(), CHUNK_SIZE));
-            if (bytesWritten < static_cast<ssize_t>(CHUNK_SIZE)) {
-                ConsoleLog("error: writing deflated trace, errno " + std::to_string(errno));
-                break;
+        size_t count = std::min(size, out_.size() - outPos_);
+        std::copy_n(out_.data() + outPos_, count, buffer);
+        outPos_ += count;
+        return static_cast<ssize_t>(count);
+    }
+
+private:
+    int fd_;
+    std::unique_ptr<char[]> chunk_;
+    CounterBatchTextExpander expander_;
+    std::string out_;
+    size_t outPos_ = 0;
+    bool eof_ = false;
+};
+
+/**
+ * Compress the trace node on several threads into one zlib stream, like pigz: the reader cuts 1 MB blocks,
+ * workers deflate them independently as raw deflate blocks primed with the previous 32 KB, and the blocks are
+ * written in order between a zlib header and the combined adler32, so consumers still see a single stream.
+ * The counter batch lines are expanded while reading, as in the plain text dump.
+ * On a read or write error the stream is left without its final block and trailer, so it never decodes as
+ * a complete trace, and false is returned.
+ */
+static bool DumpCompressedTrace(int traceFd, int outFd)
+{
+    unsigned int workerCount = std::max(1U, std::min(std::thread::hardware_concurrency(), MAX_COMPRESS_WORKERS));
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::shared_ptr<CompressBlock>> pending;
+    bool stop = false;
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.emplace_back([&mutex, &cond, &pending, &stop] {
+            while (true) {
+                std::shared_ptr<CompressBlock> block;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&pending, &stop] { return !pending.empty() || stop; });
+                    if (pending.empty()) {
+                        return;
+                    }
+                    block = pending.front();
+                    pending.pop_front();
+                }
+                bool ok = DeflateBlock(*block);
+                std::lock_guard<std::mutex> lock(mutex);
+                block->ok = ok;
+                block->done = true;
+                cond.notify_all();
             }
-            zs.next_out = reinterpret_cast<Bytef*>(out.get());
-            zs.avail_out = CHUNK_SIZE;
+        });
+    }
+
+    bool ok = WriteCompressed(outFd, ZLIB_HEADER, sizeof(ZLIB_HEADER));
+    uLong adler = adler32(0L, Z_NULL, 0);
+    std::deque<std::shared_ptr<CompressBlock>> inFlight;
+    auto writeFront = [&]() {
+        std::shared_ptr<CompressBlock> block = inFlight.front();
+        inFlight.pop_front();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&block] { return block->done; });
         }
-        ret = deflate(&zs, flush);
-        if (flush == Z_FINISH && ret == Z_STREAM_END) {
-            size_t have = CHUNK_SIZE - zs.avail_out;
-            bytesWritten = TEMP_FAILURE_RETRY(write(outFd, out.get(), have));
-            if (bytesWritten < static_cast<ssize_t>(have)) {
-                ConsoleLog("error: writing deflated trace, errno " + std::to_string(errno));
-            }
-            break;
-        } else if (ret != Z_OK) {
-            if (ret == Z_ERRNO) {
-                ConsoleLog("error: deflate failed with errno " + std::to_string(errno));
-            } else {
-                ConsoleLog("error: deflate failed return " + std::to_string(ret));
+        ok = ok && block->ok && WriteCompressed(outFd, block->out.data(), block->out.size());
+        adler = adler32_combine(adler, block->adler, block->in.size());
+    };
+    std::vector<uint8_t> dict;
+    TraceTextReader reader(traceFd);
+    while (ok) {
+        auto block = std::make_shared<CompressBlock>();
+        block->in.resize(COMPRESS_BLOCK_SIZE);
+        size_t filled = 0;
+        while (filled < COMPRESS_BLOCK_SIZE) {
+            ssize_t bytesRead = reader.Read(reinterpret_cast<char*>(block->in.data() + filled),
+                COMPRESS_BLOCK_SIZE - filled);
+            if (bytesRead <= 0) {
+                if (bytesRead == -1) {
+                    ConsoleLog("error: reading trace, errno " + std::to_string(errno));
+                    ok = false;
+                }
+                break;
             }
+            filled += static_cast<size_t>(bytesRead);
+        }
+        if (!ok || filled == 0) {
             break;
         }
-    } while (ret == Z_OK);
+        block->in.resize(filled);
+        block->dict = std::move(dict);
+        size_t dictSize = std::min(filled, COMPRESS_DICT_SIZE);
+        dict.assign(block->in.end() - dictSize, block->in.end());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(block);
+            cond.notify_all();
+        }
+        inFlight.push_back(block);
+        if (inFlight.size() >= workerCount * COMPRESS_BLOCKS_PER_WORKER) {
+            writeFront();
+        }
+    }
+    while (!inFlight.empty()) {
+        writeFront();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        pending.clear();
+        cond.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (!ok) {
+        return false;
+    }
 
-    ret = deflateEnd(&zs);
-    if (ret != Z_OK) {
-        ConsoleLog("error: cleaning up zlib return " + std::to_string(ret));
+    // an empty final block closes the deflate stream, the zlib trailer is the big-endian adler32
+    constexpr uint8_t finalBlock[] = { 0x03, 0x00 };
+    constexpr int byteShift = 8;
+    uint8_t trailer[] = {
+        static_cast<uint8_t>(adler >> (byteShift * 3)), static_cast<uint8_t>(adler >> (byteShift * 2)),
+        static_cast<uint8_t>(adler >> byteShift), static_cast<uint8_t>(adler)
+    };
+    return WriteCompressed(outFd, finalBlock, sizeof(finalBlock)) && WriteCompressed(outFd, trailer, sizeof(trailer));
+}
+
+static void HandleCompressFailure(int outFd)
+{
+    ConsoleLog("error: compressing trace failed, the output is incomplete.");
+    g_traceSysEventParams.errorCode = COMPRESS_TRACE_FAILURE;
+    g_traceSysEventParams.errorMessage = "error: compressing trace failed";
+    // a named output file is removed, a truncated stream on stdout has no trailer and fails to inflate
+    if (outFd != STDOUT_FILENO && unlink(CanonicalizeSpecPath(g_traceArgs.output.c_str()).c_str()) != 0) {
+        ConsoleLog("error: removing " + g_traceArgs.output + ", errno: " + std::to_string(errno));
     }
 }
 
-static void DumpKernelTraceToOutput()
+static bool OpenOutputFile(OHOS::HiviewDFX::SmartFd& outFileFd)
 {
-    std::string tracePath = GetTraceRootPath() + TRACE_NODE;
-    std::string traceSpecPath = CanonicalizeSpecPath(tracePath.c_str());
-    auto traceFd = OHOS::HiviewDFX::SmartFd(open(traceSpecPath.c_str(), O_RDONLY));
-    if (!traceFd) {
-        ConsoleLog("error: opening " + tracePath + ", errno: " + std::to_string(errno));
-        g_traceSysEventParams.errorCode = OPEN_ROOT_PATH_FAILURE;
-        g_traceSysEventParams.errorMessage = "error: opening " + tracePath + ", errno: " +
+    if (g_traceArgs.output.size() == 0) {
+        return true;
+    }
+    std::string outSpecPath = CanonicalizeSpecPath(g_traceArgs.output.c_str());
+    outFileFd = OHOS::HiviewDFX::SmartFd(
+        open(outSpecPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+    if (!outFileFd) {
+        ConsoleLog("error: opening " + g_traceArgs.output + ", errno: " + std::to_string(errno));
+        g_traceSysEventParams.errorCode = OPEN_FILE_PATH_FAILURE;
+        g_traceSysEventParams.errorMessage = "error: opening " + g_traceArgs.output + ", errno: " +
             std::to_string(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The kernel prints the buffer counters on top of the trace node, read them before the raw capture
+ * consumes the buffers: entries still in the buffer, and entries written including the overwritten ones.
+ */
+static void ReadRingBufferCounters(uint64_t& entries, uint64_t& written)
+{
+    int cpuCount = GetCpuProcessors();
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        std::ifstream statsFile(GetTraceRootPath() + "per_cpu/cpu" + std::to_string(cpu) + "/stats");
+        uint64_t cpuEntries = 0;
+        uint64_t cpuOverrun = 0;
+        std::string line;
+        while (std::getline(statsFile, line)) {
+            std::istringstream lineStream(line);
+            std::string key;
+            uint64_t value = 0;
+            if (!(lineStream >> key >> value)) {
+                continue;
+            }
+            if (key == "entries:") {
+                cpuEntries = value;
+            } else if (key == "overrun:") {
+                cpuOverrun = value;
+            }
+        }
+        entries += cpuEntries;
+        written += cpuEntries + cpuOverrun;
+    }
+}
+
+static bool CaptureRawTrace(const std::string& rawFile)
+{
+    std::shared_ptr<ITraceSourceFactory> traceSourceFactory = nullptr;
+    if (IsHmKernel()) {
+        traceSourceFactory = std::make_shared<TraceSourceHMFactory>(rawFile);
+    } else {
+        traceSourceFactory = std::make_shared<TraceSourceLinuxFactory>(rawFile);
+    }
+    TraceDumpRequest request; // snapshot of the whole buffer without a file size limit
+    SnapshotTraceDumpStrategy strategy;
+    TraceDumpRet ret = strategy.Execute(traceSourceFactory, request);
+    if (ret.code != TraceErrorCode::SUCCESS) {
+        ConsoleLog("error: capturing raw trace failed, errorCode(" + std::to_string(static_cast<int>(ret.code)) + ")");
+        g_traceSysEventParams.errorCode = RAW_TRACE_CAPTURE_FAILURE;
+        g_traceSysEventParams.errorMessage = "error: capturing raw trace failed, errorCode(" +
+            std::to_string(static_cast<int>(ret.code)) + ")";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read the per-cpu raw pages the way a raw dump does and format the text in userspace, which keeps the kernel
+ * out of the per-event formatting done under its locks when the trace node is read.
+ */
+static void DumpRawTraceToOutput(int outFd)
+{
+    uint64_t entries = 0;
+    uint64_t written = 0;
+    ReadRingBufferCounters(entries, written);
+    std::string rawFile = RAW_TEXT_TMP_PREFIX + std::to_string(getpid()) + ".sys";
+    RawTraceFile traceFile;
+    if (!CaptureRawTrace(rawFile)) {
+        unlink(rawFile.c_str());
         return;
     }
-    OHOS::HiviewDFX::SmartFd outFileFd;
-    if (g_traceArgs.output.size() > 0) {
-        std::string outSpecPath = CanonicalizeSpecPath(g_traceArgs.output.c_str());
-        outFileFd = OHOS::HiviewDFX::SmartFd(
-            open(outSpecPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
-        if (!outFileFd) {
-            ConsoleLog("error: opening " + g_traceArgs.output + ", errno: " + std::to_string(errno));
-            g_traceSysEventParams.errorCode = OPEN_FILE_PATH_FAILURE;
-            g_traceSysEventParams.errorMessage = "error: opening " + g_traceArgs.output + ", errno: " +
+    RawTraceError openRet = traceFile.Open(rawFile);
+    unlink(rawFile.c_str()); // the opened fd keeps the content readable
+    if (openRet != RawTraceError::NONE) {
+        ConsoleLog("error: reading the captured raw trace: " + std::string(GetRawTraceErrorMsg(openRet)) + ".");
+        return;
+    }
+    RawTraceDecoder decoder(traceFile);
+    decoder.SetTextHeader(FormatTraceTextHeader(entries, written, traceFile.GetCpuCount()));
+    DecodeStats stats;
+    if (!g_traceArgs.isCompress) {
+        if (!decoder.DecodeToSystrace(outFd, stats)) {
+            ConsoleLog("error: formatting raw trace failed.");
+        }
+        g_traceSysEventParams.fileSize += static_cast<int>(stats.outputBytes);
+        return;
+    }
+    std::string textFile = RAW_TEXT_TMP_PREFIX + std::to_string(getpid()) + ".txt";
+    auto textFd = OHOS::HiviewDFX::SmartFd(open(textFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR));
+    if (!textFd) {
+        ConsoleLog("error: opening " + textFile + ", errno: " + std::to_string(errno));
+        return;
+    }
+    unlink(textFile.c_str());
+    if (!decoder.DecodeToSystrace(textFd.GetFd(), stats) || lseek(textFd.GetFd(), 0, SEEK_SET) != 0) {
+        ConsoleLog("error: formatting raw trace failed.");
+        return;
+    }
+    if (!DumpCompressedTrace(textFd.GetFd(), outFd)) {
+        HandleCompressFailure(outFd);
+    }
+}
+
+static void DumpKernelTraceToOutput()
+{
+    OHOS::HiviewDFX::SmartFd traceFd;
+    if (!g_traceArgs.isRawText) {
+        std::string tracePath = GetTraceRootPath() + TRACE_NODE;
+        std::string traceSpecPath = CanonicalizeSpecPath(tracePath.c_str());
+        traceFd = OHOS::HiviewDFX::SmartFd(open(traceSpecPath.c_str(), O_RDONLY));
+        if (!traceFd) {
+            ConsoleLog("error: opening " + tracePath + ", errno: " + std::to_string(errno));
+            g_traceSysEventParams.errorCode = OPEN_ROOT_PATH_FAILURE;
+            g_traceSysEventParams.errorMessage = "error: opening " + tracePath + ", errno: " +
                 std::to_string(errno);
             return;
         }
     }
+    OHOS::HiviewDFX::SmartFd outFileFd;
+    if (!OpenOutputFile(outFileFd)) {
+        return;
+    }
     int outFd = outFileFd ? outFileFd.GetFd() : STDOUT_FILENO;
     ssize_t bytesWritten;
     ssize_t bytesRead;
-    if (g_traceArgs.isCompress) {
-        DumpCompressedTrace(traceFd.GetFd(), outFd);
+    if (g_traceArgs.isRawText) {
+        DumpRawTraceToOutput(outFd);
+    } else if (g_traceArgs.isCompress) {
+        if (!DumpCompressedTrace(traceFd.GetFd(), outFd)) {
+            HandleCompressFailure(outFd);
+            return;
+        }
     } else {
-        const int blockSize = 4096;
-        char buffer[blockSize];
+        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(CHUNK_SIZE);
+        TraceTextReader reader(traceFd.GetFd());
         do {
-            bytesRead = TEMP_FAILURE_RETRY(read(traceFd.GetFd(), buffer, blockSize));
+            bytesRead = reader.Read(buffer.get(), CHUNK_SIZE);
             if ((bytesRead == 0) || (bytesRead == -1)) {
                 break;
             }
-            bytesWritten = TEMP_FAILURE_RETRY(write(outFd, buffer, bytesRead));
+            bytesWritten = TEMP_FAILURE_RETRY(write(outFd, buffer.get(), bytesRead));
             if (bytesWritten > 0) {
                 g_traceSysEventParams.fileSize += bytesWritten;
             }
@@ -2139,6 +2565,9 @@ static bool InitAndCheckArgs(int argc, char**argv)
         ConsoleLog("error: can't set totalsize when output path is't /data/local/tmp, exit.");
         return false;
     }
+    if (!CheckRawTextState()) {
+        return false;
+    }
 
     if (g_runningState == STATE_NULL) {
         g_runningState = RECORDING_SHORT_TEXT;
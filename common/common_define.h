@@ -27,6 +27,7 @@ constexpr size_t PAGE_SIZE = 4096;
 #endif
 constexpr uint64_t S_TO_NS = 1000000000;
 constexpr uint64_t MS_TO_NS = 1000000;
+constexpr uint64_t US_TO_NS = 1000;
 constexpr uint64_t S_TO_MS = 1000;
 
 constexpr int DEFAULT_FILE_SIZE = 100 * 1024;
@@ -34,6 +35,8 @@ constexpr int DEFAULT_FILE_SIZE = 100 * 1024;
 static const char* const TRACE_TAG_ENABLE_FLAGS = "debug.hitrace.tags.enableflags";
 static const char* const TRACE_KEY_APP_PID = "debug.hitrace.app_pid";
 static const char* const TRACE_LEVEL_THRESHOLD = "persist.hitrace.level.threshold";
+// "<tag offset>:<events per second>[:<burst>],...", per process token buckets in hitrace_meter
+static const char* const TRACE_TAG_RATE_LIMIT = "debug.hitrace.tags.rate_limit";
 // 标记 boot-trace 是否正在进行的临时参数（非 persist）
 static const char* const TRACE_BOOT_ACTIVE_FLAG = "debug.hitrace.boot_trace.active";
 
@@ -50,5 +53,7 @@ static const char* const BOOT_TRACE_CONFIG_DIR = "/data/local/tmp/";
 static const char* const BOOT_TRACE_CONFIG_FILE = "boot_trace.cfg";
 static const char* const BOOT_TRACE_COUNT_PARAM = "persist.hitrace.boot_trace.count";
 static const char* const TRACE_SAVED_EVENTS_FORMAT = "saved_events_format";
+/** Content-addressed copy of saved_events_format referenced by CONTENT_TYPE_EVENTS_FORMAT_REF sections. */
+static const char* const TRACE_EVENTS_FORMAT_SIDECAR_PREFIX = "events_format_";
 static const char* const CACHE_FILE_PREFIX = "cache_";
 #endif // HITRACE_COMMON_DEFINE_H
\ No newline at end of file
@@ -16,7 +16,9 @@
 #ifndef HITRACE_DEFINE_H
 #define HITRACE_DEFINE_H
 
+#include <functional>
 #include <inttypes.h>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -24,12 +26,14 @@ namespace OHOS {
 namespace HiviewDFX {
 namespace Hitrace {
 constexpr int TRACE_FILE_LEN = 128;
+constexpr int DUMP_METRICS_MAX_CPU = 64;
 
 enum TraceMode : uint8_t {
     CLOSE = 0,
     OPEN = 1 << 0,
     RECORD = 1 << 1,
     CACHE = 1 << 2,
+    SUBSCRIBE = 1 << 3,
 };
 
 enum TraceDumpType : uint8_t {
@@ -59,6 +63,8 @@ enum TraceErrorCode : uint8_t {
     UNKNOWN_TRACE_DUMP_TYPE = 15,
     /** debug.hitrace.boot_trace.active is on and caller is not root (uid 0). */
     BOOT_TRACE_ACTIVE = 16,
+    /** SubscribeTraceEvents() without a callback, or with event names unknown to the kernel. */
+    INVALID_EVENT_FILTER = 17,
     UNSET = 255,
 };
 
@@ -72,6 +78,24 @@ struct TraceDumpRequest {
     uint64_t cacheSliceDuration = 0;
 };
 
+/**
+ * Throughput and latency of one dump, collected in the dump process and handed back through the dump pipe,
+ * so it must stay trivially copyable.
+ */
+struct TraceDumpMetrics {
+    uint64_t cpuBytesRead[DUMP_METRICS_MAX_CPU] = { 0 }; // raw bytes kept per cpu
+    uint32_t cpuCount = 0;
+    uint64_t pagesSkipped = 0; // pages outside the requested time range
+    uint64_t pagesCheckFailed = 0; // pages failing the page header check
+    uint64_t metaDurationUs = 0; // file header, formats, cmdlines, tgids and other metadata
+    uint64_t readDurationUs = 0; // raw pages read, including the file write in the synchronous modes
+    uint64_t writeDurationUs = 0; // buffered raw pages written to the file, async dump only
+    uint64_t forkLatencyUs = 0; // fork() until the dump process starts working
+    uint64_t ipcLatencyUs = 0; // dump process sending the result until the caller receives it
+    uint64_t bufferPeakBytes = 0; // peak async dump buffer usage
+    uint64_t sendTime = 0; // boot time in ns when the dump process sent the result
+};
+
 struct TraceRetInfo {
     TraceErrorCode errorCode;
     uint8_t mode = 0;
@@ -81,6 +105,8 @@ struct TraceRetInfo {
     int32_t coverRatio = 0;
     int32_t coverDuration = 0;
     std::vector<std::string> tags;
+    int32_t spillRatio = 0; // per mille of the async dump data that was spilled to disk while reading
+    TraceDumpMetrics dumpMetrics;
 };
 
 enum class TraceDumpStatus : uint8_t {
@@ -103,6 +129,49 @@ struct TraceDumpTask {
     TraceErrorCode code = TraceErrorCode::UNSET;
     bool isFileSizeOverLimit = false;
     TraceDumpStatus status = TraceDumpStatus::START;
+    uint64_t spilledBytes = 0;
+    TraceDumpMetrics metrics;
+};
+
+/**
+ * Selects the events of a live subscription, an empty list matches everything.
+ */
+struct TraceEventFilter {
+    std::vector<std::string> eventNames {}; // e.g. "tracing_mark_write", "sched_switch"
+    std::vector<int32_t> pids {};
+    uint32_t maxBatchSize = 512; // events per callback
+    uint32_t maxPendingBatches = 16; // batches queued for a slow callback before new ones are dropped
+    uint32_t flushIntervalMs = 100; // partially filled pages are drained at least this often
+};
+
+/**
+ * One event of a live subscription. The pointers refer to the batch buffer and are only valid in the callback.
+ */
+struct TraceEventView {
+    uint64_t timestamp = 0; // ns of the trace clock
+    uint32_t cpu = 0;
+    int32_t pid = 0;
+    uint16_t eventId = 0;
+    const uint8_t* data = nullptr; // the raw record, starting with the common fields
+    uint32_t size = 0;
+    const char* payload = nullptr; // text of tracing_mark_write and print events, not nul terminated
+    uint32_t payloadSize = 0;
+};
+
+/**
+ * droppedCount: events lost since the previous batch because the pending batches were full.
+ */
+using TraceEventCallback = std::function<void(const std::vector<TraceEventView>& events, uint64_t droppedCount)>;
+
+/**
+ * Post-filter of raw dumps: keeps the hitrace markers matching every criterion set, an empty filter keeps all.
+ */
+struct TraceMarkerFilter {
+    uint64_t tags = 0; // HITRACE_TAG_* bits, a marker matches if it carries any of them
+    uint32_t minLevel = 0; // HiTraceOutputLevel, markers below it are dropped
+    std::vector<int32_t> pids {}; // the pid written into the marker, i.e. the process
+    std::vector<std::string> names {}; // substrings of the marker name, E markers follow their B marker
+    bool keepKernelEvents = false; // keep the non-marker events too, those of the filtered pids if pids is set
 };
 
 struct AgeingParam {
@@ -22,6 +22,7 @@
 #endif
 
 typedef HiTraceOutputLevel HiTrace_Output_Level;
+typedef HiTraceCounter HiTrace_Counter;
 typedef void (*OH_HiTrace_TraceEventListener)(bool traceStatus);
 
 void OH_HiTrace_StartTrace(const char *name)
@@ -89,3 +90,8 @@ int32_t OH_HiTrace_UnregisterTraceListener(int32_t index)
 {
     return UnregisterTraceListenerCwrapper(index);
 }
+
+void OH_HiTrace_CountTraceBatch(HiTrace_Output_Level level, const HiTrace_Counter* counters, size_t count)
+{
+    CountTraceBatchExCwrapper(level, HITRACE_TAG_APP, counters, count);
+}
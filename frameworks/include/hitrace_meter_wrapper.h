@@ -36,9 +36,14 @@ void FinishAsyncTraceCwrapper(uint64_t tag, const char *name, int32_t taskId);
 
 void CountTraceCwrapper(uint64_t tag, const char *name, int64_t count);
 
+void CountTraceBatchExCwrapper(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count);
+
 struct HiTraceIdStruct;
 void StartTraceChainPoint(const struct HiTraceIdStruct* hiTraceId, const char* value);
 
+// Whether a StartTraceChainPoint would be written to the trace marker or the app trace.
+bool IsTraceChainPointEnabled(void);
+
 void StartTraceExCwrapper(HiTraceOutputLevel level, uint64_t tag, const char* name, const char* customArgs);
 
 void FinishTraceExCwrapper(HiTraceOutputLevel level, uint64_t tag);
@@ -112,5 +112,30 @@ void HiTraceChain::Restore(const HiTraceId& id)
 {
     ::HiTraceChainRestoreId(&(id.id_));
 }
+
+HiTraceSpanHandle HiTraceChain::Push(const HiTraceId& id)
+{
+    return ::HiTraceChainPushId(&(id.id_));
+}
+
+void HiTraceChain::Pop(HiTraceSpanHandle handle)
+{
+    ::HiTraceChainPopId(handle);
+}
+
+HiTraceTaskContext* HiTraceChain::CaptureContext()
+{
+    return ::HiTraceChainCaptureContext();
+}
+
+HiTraceSpanHandle HiTraceChain::ResumeContext(const HiTraceTaskContext* context)
+{
+    return ::HiTraceChainResumeContext(context);
+}
+
+void HiTraceChain::ReleaseContext(HiTraceTaskContext* context)
+{
+    ::HiTraceChainReleaseContext(context);
+}
 } // namespace HiviewDFX
 } // namespace OHOS
@@ -15,12 +15,16 @@
 
 #include "hitrace/hitracechainc.h"
 
+#include <pthread.h>
 #include <sched.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "hilog/log.h"
 #include "hilog_trace.h"
@@ -45,38 +49,6 @@ static const int BUFF_ONE_NUMBER = 1;
 static const int BUFF_TWO_NUMBER = 2;
 static const uint64_t HITRACE_TAG_OHOS = (1ULL << 30);
 
-typedef struct HiTraceChainIdStruct {
-    union {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        struct {
-            uint64_t reserved : 4;
-            uint64_t usecond : 20;
-            uint64_t second : 16;
-            uint64_t cpuId : 4;
-            uint64_t deviceId : 20;
-        };
-        struct {
-            uint64_t padding : 4;
-            uint64_t chainId : 60;
-        };
-#elif __BYTE_ORDER == __BIG_ENDIAN
-        struct {
-            uint64_t deviceId : 20;
-            uint64_t cpuId : 4;
-            uint64_t second : 16;
-            uint64_t usecond : 20;
-            uint64_t reserved : 4;
-        };
-        struct {
-            uint64_t chainId : 60;
-            uint64_t padding : 4;
-        };
-#else
-#error "ERROR: No BIG_LITTLE_ENDIAN defines."
-#endif
-    };
-} HiTraceChainIdStruct;
-
 typedef struct HiTraceIdStructExtra {
     uint32_t setTls : 1;
     uint32_t reserved : 31;
@@ -89,6 +61,51 @@ typedef struct HiTraceIdStructInner {
 
 static __thread HiTraceIdStructInner g_hiTraceId = {{0, 0, 0, 0, 0, 0}, {0, 0}};
 
+// xoshiro256** state of the thread, the chain and span ids are drawn from it without a syscall or a shared write
+typedef struct HiTraceIdGenerator {
+    uint64_t state[4];
+    unsigned int forkGeneration;
+    bool seeded;
+} HiTraceIdGenerator;
+
+static __thread HiTraceIdGenerator g_idGenerator = {{0, 0, 0, 0}, 0, false};
+// moves in the child of a fork, which would otherwise repeat the ids of the forking thread
+static atomic_uint g_forkGeneration = 0;
+static pthread_once_t g_atForkOnce = PTHREAD_ONCE_INIT;
+
+static const uint64_t SPLITMIX64_GAMMA = 0x9e3779b97f4a7c15ULL;
+static const uint64_t SPLITMIX64_MUL1 = 0xbf58476d1ce4e5b9ULL;
+static const uint64_t SPLITMIX64_MUL2 = 0x94d049bb133111ebULL;
+static const uint64_t TID_MIX = 0xd6e8feb86659fd93ULL;
+static const uint64_t NS_PER_SECOND = 1000000000ULL;
+static const uint64_t CHAIN_ID_MASK = (1ULL << 60) - 1;
+static const uint64_t SPAN_ID_MASK = (1ULL << 26) - 1;
+
+// the id a push replaced, restored when its handle is popped
+typedef struct HiTraceSpanFrame {
+    HiTraceIdStruct savedId;
+    uint64_t serial;
+} HiTraceSpanFrame;
+
+typedef struct HiTraceSpanStack {
+    HiTraceSpanFrame frames[HITRACE_SPAN_STACK_DEPTH];
+    uint32_t depth;
+    uint64_t serial;
+    bool registered;
+} HiTraceSpanStack;
+
+static __thread HiTraceSpanStack g_spanStack;
+static pthread_key_t g_spanStackKey;
+static pthread_once_t g_spanStackKeyOnce = PTHREAD_ONCE_INIT;
+
+struct HiTraceTaskContext {
+    HiTraceIdStruct id;
+};
+
+static const int SPAN_HANDLE_DEPTH_BITS = 8;
+static const uint64_t SPAN_HANDLE_DEPTH_MASK = (1ULL << SPAN_HANDLE_DEPTH_BITS) - 1;
+static atomic_uint g_liveContexts = 0;
+
 static inline HiTraceIdStructInner* GetThreadIdInner(void)
 {
     return &g_hiTraceId;
@@ -145,28 +162,70 @@ static inline int HiTraceChainGetDeviceId(void)
     return deviceId;
 }
 
-static inline unsigned int HiTraceChainGetCpuId(void)
+static void HiTraceChainOnFork(void)
+{
+    atomic_fetch_add_explicit(&g_forkGeneration, 1, memory_order_relaxed);
+}
+
+static void HiTraceChainRegisterAtFork(void)
+{
+    (void)pthread_atfork(NULL, NULL, HiTraceChainOnFork);
+}
+
+static inline uint64_t SplitMix64(uint64_t* x)
+{
+    uint64_t z = (*x += SPLITMIX64_GAMMA);
+    z = (z ^ (z >> 30)) * SPLITMIX64_MUL1; // 30 : splitmix64 shift
+    z = (z ^ (z >> 27)) * SPLITMIX64_MUL2; // 27 : splitmix64 shift
+    return z ^ (z >> 31); // 31 : splitmix64 shift
+}
+
+static inline uint64_t RotateLeft(uint64_t x, int k)
 {
-    // Using vdso call will make get_cpu_id faster: sched_getcpu()
-    static atomic_uint cpuId = 0;
-    unsigned int ret = atomic_fetch_add(&cpuId, 1);
-    return ret + 1;
+    return (x << k) | (x >> (64 - k)); // 64 : bits of x
+}
+
+// device id, tid and boot time tell the threads of all processes apart, splitmix64 spreads them over the state
+static void HiTraceChainSeedGenerator(HiTraceIdGenerator* gen, unsigned int forkGeneration)
+{
+    (void)pthread_once(&g_atForkOnce, HiTraceChainRegisterAtFork);
+    struct timespec ts = {0, 0};
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    uint64_t seed = ((uint64_t)(unsigned int)HiTraceChainGetDeviceId() << 32) ^ // 32 : upper half
+        ((uint64_t)syscall(SYS_gettid) * TID_MIX) ^ ((uint64_t)ts.tv_sec * NS_PER_SECOND + (uint64_t)ts.tv_nsec);
+    for (int i = 0; i < 4; i++) { // 4 : xoshiro256 state words
+        gen->state[i] = SplitMix64(&seed);
+    }
+    gen->forkGeneration = forkGeneration;
+    gen->seeded = true;
+}
+
+static uint64_t HiTraceChainNextRandom(void)
+{
+    HiTraceIdGenerator* gen = &g_idGenerator;
+    unsigned int forkGeneration = atomic_load_explicit(&g_forkGeneration, memory_order_relaxed);
+    if (!gen->seeded || gen->forkGeneration != forkGeneration) {
+        HiTraceChainSeedGenerator(gen, forkGeneration);
+    }
+    uint64_t* s = gen->state;
+    uint64_t result = RotateLeft(s[1] * 5, 7) * 9; // 5, 7, 9 : xoshiro256** scrambler
+    uint64_t t = s[1] << 17; // 17 : xoshiro256 shift
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RotateLeft(s[3], 45); // 45 : xoshiro256 rotation
+    return result;
 }
 
 static inline uint64_t HiTraceChainCreateChainId(void)
 {
-    // get timestamp. Using vdso call(no system call)
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    HiTraceChainIdStruct chainId = {
-        .padding = 0,
-        .chainId = 0
-    };
-    chainId.deviceId = (uint64_t)(HiTraceChainGetDeviceId());
-    chainId.cpuId = HiTraceChainGetCpuId();
-    chainId.second = (uint64_t)(tv.tv_sec);
-    chainId.usecond = (uint64_t)(tv.tv_usec);
-    return chainId.chainId;
+    uint64_t chainId = 0;
+    do {
+        chainId = HiTraceChainNextRandom() & CHAIN_ID_MASK;
+    } while (chainId == 0);
+    return chainId;
 }
 
 HiTraceIdStruct HiTraceChainBeginWithDomain(const char* name, int flags, unsigned int domain)
@@ -245,30 +304,8 @@ void HiTraceChainEnd(const HiTraceIdStruct* pId)
     HiTraceChainEndWithDomain(pId, 0);
 }
 
-// BKDRHash
-static uint32_t HashFunc(const void* pData, uint32_t dataLen)
-{
-    const uint32_t seed = 131;
-
-    if ((!pData) || dataLen == 0) {
-        return 0;
-    }
-
-    uint32_t hash = 0;
-    uint32_t len = dataLen;
-    char* p = (char*)pData;
-
-    for (; len > 0; --len) {
-        hash = (hash * seed) + (*p++);
-    }
-
-    return hash;
-}
-
 HiTraceIdStruct HiTraceChainCreateSpan(void)
 {
-    static const uint32_t hashDataNum = 5;
-
     HiTraceIdStruct id = HiTraceChainGetId();
     if (!HiTraceChainIsValid(&id)) {
         return id;
@@ -278,21 +315,14 @@ HiTraceIdStruct HiTraceChainCreateSpan(void)
         return id;
     }
 
-    // create child span id
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-
-    uint32_t hashData[hashDataNum];
-    hashData[0] = (uint32_t)(HiTraceChainGetDeviceId());  // 0: device id
-    hashData[1] = id.parentSpanId;                   // 1: parent span id
-    hashData[2] = id.spanId;                         // 2: span id
-    hashData[3] = (uint32_t)(tv.tv_sec);             // 3: second
-    hashData[4] = (uint32_t)(tv.tv_usec);            // 4: usecond
-
-    uint32_t hash = HashFunc(hashData, hashDataNum * sizeof(uint32_t));
+    // create child span id, 0 is the root span and never a child
+    uint64_t spanId = 0;
+    do {
+        spanId = HiTraceChainNextRandom() & SPAN_ID_MASK;
+    } while (spanId == 0 || spanId == id.spanId);
 
     id.parentSpanId = id.spanId;
-    id.spanId = hash;
+    id.spanId = spanId;
     return id;
 }
 
@@ -309,6 +339,20 @@ static bool TracepointParamsCheck(HiTraceCommunicationMode mode, HiTraceTracepoi
     return true;
 }
 
+static bool IsTracepointLogged(HiTraceCommunicationMode mode, const HiTraceIdStruct* pId, unsigned int domain)
+{
+    if (!HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_TP_INFO) &&
+        !HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_D2D_TP_INFO)) {
+        // Both tp and d2d-tp flags are disabled.
+        return false;
+    } else if (!HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_TP_INFO) && (mode != HITRACE_CM_DEVICE)) {
+        // Only d2d-tp flag is enabled. But the communication mode is not device-to-device.
+        return false;
+    }
+    return (domain == 0) ? HiLogIsLoggable(LOG_DOMAIN, LOG_TAG, LOG_DEBUG) :
+        HiLogIsLoggable(domain, LOG_TAG, LOG_INFO);
+}
+
 void HiTraceChainTracepointInner(HiTraceCommunicationMode mode, HiTraceTracepointType type,
     const HiTraceIdStruct* pId, unsigned int domain, const char* fmt, va_list args)
 {
@@ -321,14 +365,19 @@ void HiTraceChainTracepointInner(HiTraceCommunicationMode mode, HiTraceTracepoin
         return;
     }
 
-    char buff[tpBufferSize];
-    if (type == HITRACE_TP_CS || type == HITRACE_TP_CR) {
-        buff[BUFF_ZERO_NUMBER] = 'C';
+    if (type == HITRACE_TP_CR || type == HITRACE_TP_SS) {
+        HiTraceFinishTrace(HITRACE_TAG_OHOS);
     }
 
-    if (type == HITRACE_TP_SR || type == HITRACE_TP_SS) {
-        buff[BUFF_ZERO_NUMBER] = 'S';
+    // the message is only formatted for a sink that takes it: the trace marker of a CS/SR point or the log
+    bool isTraced = (type == HITRACE_TP_CS || type == HITRACE_TP_SR) && IsTraceChainPointEnabled();
+    bool isLogged = IsTracepointLogged(mode, pId, domain);
+    if (!isTraced && !isLogged) {
+        return;
     }
+
+    char buff[tpBufferSize];
+    buff[BUFF_ZERO_NUMBER] = (type == HITRACE_TP_CS || type == HITRACE_TP_CR) ? 'C' : 'S';
     buff[BUFF_ONE_NUMBER] = '#';
     buff[BUFF_TWO_NUMBER] = '#';
 
@@ -340,20 +389,11 @@ void HiTraceChainTracepointInner(HiTraceCommunicationMode mode, HiTraceTracepoin
     if (ret == -1) { // -1: vsnprintf_s copy string fail
         return;
     }
-    if (type == HITRACE_TP_CS || type == HITRACE_TP_SR) {
+    if (isTraced) {
         StartTraceChainPoint(pId, buff);
     }
 
-    if (type == HITRACE_TP_CR || type == HITRACE_TP_SS) {
-        HiTraceFinishTrace(HITRACE_TAG_OHOS);
-    }
-
-    if (!HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_TP_INFO) &&
-        !HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_D2D_TP_INFO)) {
-        // Both tp and d2d-tp flags are disabled.
-        return;
-    } else if (!HiTraceChainIsFlagEnabled(pId, HITRACE_FLAG_TP_INFO) && (mode != HITRACE_CM_DEVICE)) {
-        // Only d2d-tp flag is enabled. But the communication mode is not device-to-device.
+    if (!isLogged) {
         return;
     }
 
@@ -459,6 +499,98 @@ void HiTraceChainRestoreId(const HiTraceIdStruct* pId)
     }
 }
 
+// a thread leaving pushed spans behind lost a pop on some path, its handles can never be popped now
+static void HiTraceChainCheckSpanStack(void* arg)
+{
+    const HiTraceSpanStack* stack = (const HiTraceSpanStack*)arg;
+    if (stack->depth != 0) {
+        HILOG_WARN(LOG_CORE, "HiTraceChain: thread exits with %{public}u spans not popped.", stack->depth);
+    }
+}
+
+static void HiTraceChainCreateSpanStackKey(void)
+{
+    (void)pthread_key_create(&g_spanStackKey, HiTraceChainCheckSpanStack);
+}
+
+HiTraceSpanHandle HiTraceChainPushId(const HiTraceIdStruct* pId)
+{
+    HiTraceSpanStack* stack = &g_spanStack;
+    if (stack->depth >= HITRACE_SPAN_STACK_DEPTH) {
+        HILOG_WARN(LOG_CORE, "HiTraceChainPushId failed: more than %{public}d spans pushed.",
+            HITRACE_SPAN_STACK_DEPTH);
+        return HITRACE_SPAN_HANDLE_INVALID;
+    }
+    if (!stack->registered) {
+        (void)pthread_once(&g_spanStackKeyOnce, HiTraceChainCreateSpanStackKey);
+        (void)pthread_setspecific(g_spanStackKey, stack);
+        stack->registered = true;
+    }
+    HiTraceSpanFrame* frame = &stack->frames[stack->depth++];
+    frame->savedId = g_hiTraceId.id;
+    frame->serial = ++stack->serial;
+    if (HiTraceChainIsValid(pId)) {
+        g_hiTraceId.id = *pId;
+    } else {
+        HiTraceChainInitId(&g_hiTraceId.id);
+    }
+    return (frame->serial << SPAN_HANDLE_DEPTH_BITS) | stack->depth;
+}
+
+void HiTraceChainPopId(HiTraceSpanHandle handle)
+{
+    if (handle == HITRACE_SPAN_HANDLE_INVALID) {
+        return;
+    }
+    HiTraceSpanStack* stack = &g_spanStack;
+    uint32_t depth = (uint32_t)(handle & SPAN_HANDLE_DEPTH_MASK);
+    if (depth == 0 || depth > stack->depth ||
+        stack->frames[depth - 1].serial != (handle >> SPAN_HANDLE_DEPTH_BITS)) {
+        HILOG_WARN(LOG_CORE, "HiTraceChainPopId failed: handle(%{public}llx) is not on the thread stack.",
+            (unsigned long long)handle);
+        return;
+    }
+    if (depth != stack->depth) {
+        HILOG_WARN(LOG_CORE, "HiTraceChainPopId: %{public}u spans pushed above the handle were not popped.",
+            stack->depth - depth);
+    }
+    g_hiTraceId.id = stack->frames[depth - 1].savedId;
+    stack->depth = depth - 1;
+}
+
+HiTraceTaskContext* HiTraceChainCaptureContext(void)
+{
+    if (!HiTraceChainIsValid(&g_hiTraceId.id)) {
+        return NULL;
+    }
+    HiTraceTaskContext* context = (HiTraceTaskContext*)malloc(sizeof(HiTraceTaskContext));
+    if (context == NULL) {
+        return NULL;
+    }
+    context->id = g_hiTraceId.id;
+    atomic_fetch_add_explicit(&g_liveContexts, 1, memory_order_relaxed);
+    return context;
+}
+
+HiTraceSpanHandle HiTraceChainResumeContext(const HiTraceTaskContext* context)
+{
+    return HiTraceChainPushId(context != NULL ? &context->id : NULL);
+}
+
+void HiTraceChainReleaseContext(HiTraceTaskContext* context)
+{
+    if (context == NULL) {
+        return;
+    }
+    free(context);
+    atomic_fetch_sub_explicit(&g_liveContexts, 1, memory_order_relaxed);
+}
+
+unsigned int HiTraceChainGetLiveContextCount(void)
+{
+    return atomic_load_explicit(&g_liveContexts, memory_order_relaxed);
+}
+
 static void __attribute__((constructor)) HiTraceChainInit(void)
 {
     // Call HiLog Register Interface
@@ -467,5 +599,9 @@ static void __attribute__((constructor)) HiTraceChainInit(void)
 
 static void __attribute__((destructor)) HiTraceChainFini(void)
 {
+    unsigned int liveContexts = HiTraceChainGetLiveContextCount();
+    if (liveContexts != 0) {
+        HILOG_WARN(LOG_CORE, "HiTraceChain: %{public}u task contexts were never released.", liveContexts);
+    }
     HiLogUnregisterGetIdFun(HiTraceChainGetInfo);
 }
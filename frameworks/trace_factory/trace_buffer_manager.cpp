@@ -15,10 +15,19 @@
 
 #include "trace_buffer_manager.h"
 
+#include <cerrno>
 #include <cinttypes>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unistd.h>
 
+#include "common_define.h"
 #include "hilog/log.h"
 #include "securec.h"
 
@@ -34,6 +43,49 @@ namespace {
 #undef LOG_TAG
 #define LOG_TAG "HitraceBufferManager"
 #endif
+
+// the "." prefix keeps a named spill file out of the trace file ledger and the ageing scans
+constexpr const char* SPILL_FILE_PREFIX = ".spill_";
+
+// Removes the named spill files of dead processes, left when a process died between creating and unlinking one.
+void RemoveSpillLeftovers()
+{
+    DIR* dir = opendir(TRACE_FILE_DEFAULT_DIR);
+    if (dir == nullptr) {
+        return;
+    }
+    const size_t prefixLen = strlen(SPILL_FILE_PREFIX);
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncmp(entry->d_name, SPILL_FILE_PREFIX, prefixLen) != 0) {
+            continue;
+        }
+        // ".spill_<pid>_<task>"
+        pid_t pid = static_cast<pid_t>(strtol(entry->d_name + prefixLen, nullptr, 10)); // 10 : decimal
+        if (pid <= 0 || pid == getpid() || kill(pid, 0) == 0 || errno != ESRCH) {
+            continue;
+        }
+        std::string path = std::string(TRACE_FILE_DEFAULT_DIR) + entry->d_name;
+        if (unlink(path.c_str()) != 0) {
+            HILOG_WARN(LOG_CORE, "RemoveSpillLeftovers : unlink %{public}s failed, errno(%{public}d)",
+                path.c_str(), errno);
+        }
+    }
+    closedir(dir);
+}
+
+bool WriteFull(int fd, const uint8_t* buffer, size_t size, off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = TEMP_FAILURE_RETRY(pwrite(fd, buffer + done, size - done, offset + static_cast<off_t>(done)));
+        if (ret <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
 } // namespace
 
 size_t BufferBlock::FreeBytes() const
@@ -59,7 +111,10 @@ TraceBufferManager::TraceBufferManager()
 {
     maxTotalSz_ = DEFAULT_MAX_TOTAL_SZ;
     blockSz_ = DEFAULT_BLOCK_SZ;
+    maxSpillSz_ = DEFAULT_MAX_SPILL_SZ;
     curTotalSz_.store(0, std::memory_order_relaxed);
+    peakTotalSz_.store(0, std::memory_order_relaxed);
+    RemoveSpillLeftovers();
 }
 
 TraceBufferManager::~TraceBufferManager() {}
@@ -83,7 +138,9 @@ bool TraceBufferManager::TryAllocateMemorySpace(uint64_t taskId)
             return false;
         }
     }
-
+    size_t peak = peakTotalSz_.load(std::memory_order_relaxed);
+    while (desiredSz > peak &&
+        !peakTotalSz_.compare_exchange_weak(peak, desiredSz, std::memory_order_relaxed)) {}
     return true;
 }
 
@@ -104,11 +161,131 @@ BufferBlockPtr TraceBufferManager::AllocateBlock(const uint64_t taskId, const in
     return buffer;
 }
 
+BufferBlockPtr TraceBufferManager::AllocateBlockWithSpill(const uint64_t taskId, const int cpu)
+{
+    if (curTotalSz_.load(std::memory_order_relaxed) + blockSz_ <= maxTotalSz_) {
+        if (auto buffer = AllocateBlock(taskId, cpu); buffer != nullptr) {
+            return buffer;
+        }
+    }
+    auto victim = SpillOldestBlock(taskId);
+    if (victim == nullptr) {
+        return nullptr;
+    }
+    // the spilled block keeps its budget, hand its memory over to the new block.
+    auto buffer = std::make_shared<BufferBlock>(cpu, 0);
+    buffer->data.swap(victim->data);
+    {
+        std::unique_lock<std::shared_mutex> globalWriteLock(globalMutex_);
+        taskBuffers_[taskId].push_back(buffer);
+    }
+    return buffer;
+}
+
+bool TraceBufferManager::OpenSpillFile(const uint64_t taskId, TaskSpill& spill)
+{
+    // prefer an unnamed file, nothing is left behind if the dump process is killed.
+    spill.fd = SmartFd(open(TRACE_FILE_DEFAULT_DIR, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)); // 0600: -rw-------
+    if (spill.fd) {
+        return true;
+    }
+    std::string spillPath = std::string(TRACE_FILE_DEFAULT_DIR) + SPILL_FILE_PREFIX + std::to_string(getpid()) +
+        "_" + std::to_string(taskId);
+    spill.fd = SmartFd(open(spillPath.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600)); // 0600: -rw-------
+    if (!spill.fd) {
+        HILOG_ERROR(LOG_CORE, "OpenSpillFile : create %{public}s failed, errno(%{public}d)", spillPath.c_str(), errno);
+        return false;
+    }
+    unlink(spillPath.c_str());
+    return true;
+}
+
+BufferBlockPtr TraceBufferManager::SpillOldestBlock(const uint64_t taskId)
+{
+    BufferBlockPtr victim = nullptr;
+    int spillFd = -1;
+    off_t spillOffset = 0;
+    {
+        std::unique_lock<std::shared_mutex> globalWriteLock(globalMutex_);
+        auto it = taskBuffers_.find(taskId);
+        if (it == taskBuffers_.end()) {
+            return nullptr;
+        }
+        for (auto& block : it->second) {
+            if (!block->IsSpilled() && !block->data.empty()) {
+                victim = block;
+                break;
+            }
+        }
+        auto& spill = taskSpills_[taskId];
+        if (victim == nullptr || static_cast<size_t>(spill.size) + victim->usedBytes > maxSpillSz_) {
+            HILOG_ERROR(LOG_CORE, "SpillOldestBlock : taskid(%{public}" PRIu64 ") cannot spill more blocks", taskId);
+            return nullptr;
+        }
+        if (!spill.fd && !OpenSpillFile(taskId, spill)) {
+            return nullptr;
+        }
+        spillFd = spill.fd.GetFd();
+        spillOffset = spill.size;
+    }
+    // blocks of one task are only touched by the thread dumping it, the copy can run without the global lock.
+    if (!WriteFull(spillFd, victim->data.data(), victim->usedBytes, spillOffset)) {
+        HILOG_ERROR(LOG_CORE, "SpillOldestBlock : taskid(%{public}" PRIu64 ") write spill file failed, "
+            "errno(%{public}d)", taskId, errno);
+        return nullptr;
+    }
+    {
+        // only bytes that reached the file count, a failed write leaves the offset free for the next block.
+        std::unique_lock<std::shared_mutex> globalWriteLock(globalMutex_);
+        auto it = taskSpills_.find(taskId);
+        if (it == taskSpills_.end()) {
+            return nullptr; // the task was released during the copy
+        }
+        it->second.size = spillOffset + static_cast<off_t>(victim->usedBytes);
+    }
+    victim->spillOffset = spillOffset;
+    HILOG_INFO(LOG_CORE, "SpillOldestBlock : taskid(%{public}" PRIu64 ") spilled %{public}zu bytes of cpu%{public}d",
+        taskId, victim->usedBytes, victim->cpu);
+    return victim;
+}
+
+ssize_t TraceBufferManager::ReadSpilledBlock(const uint64_t taskId, const BufferBlock& block, size_t offset,
+    uint8_t* dst, size_t size)
+{
+    if (!block.IsSpilled() || offset >= block.usedBytes) {
+        return -1;
+    }
+    int spillFd = -1;
+    {
+        std::shared_lock<std::shared_mutex> globalReadLock(globalMutex_);
+        auto it = taskSpills_.find(taskId);
+        if (it == taskSpills_.end() || !it->second.fd) {
+            return -1;
+        }
+        spillFd = it->second.fd.GetFd();
+    }
+    size = std::min(size, block.usedBytes - offset);
+    return TEMP_FAILURE_RETRY(pread(spillFd, dst, size, block.spillOffset + static_cast<off_t>(offset)));
+}
+
+size_t TraceBufferManager::GetTaskSpilledBytes(const uint64_t taskId)
+{
+    std::shared_lock<std::shared_mutex> globalReadLock(globalMutex_);
+    if (auto it = taskSpills_.find(taskId); it != taskSpills_.end()) {
+        return static_cast<size_t>(it->second.size);
+    }
+    return 0;
+}
+
 void TraceBufferManager::ReleaseTaskBlocks(const uint64_t taskId)
 {
     std::unique_lock<std::shared_mutex> globalWriteLock(globalMutex_);
+    taskSpills_.erase(taskId);
     if (auto it = taskBuffers_.find(taskId); it != taskBuffers_.end()) {
-        size_t released = it->second.size() * blockSz_;
+        size_t released = 0;
+        for (auto& bufBlock : it->second) {
+            released += bufBlock->data.size();
+        }
         taskBuffers_.erase(it);
         globalWriteLock.unlock();
         curTotalSz_.fetch_sub(released, std::memory_order_relaxed);
@@ -143,6 +320,11 @@ size_t TraceBufferManager::GetCurrentTotalSize()
     return curTotalSz_.load(std::memory_order_relaxed);
 }
 
+size_t TraceBufferManager::GetPeakTotalSize() const
+{
+    return peakTotalSz_.load(std::memory_order_relaxed);
+}
+
 size_t TraceBufferManager::GetBlockSize() const
 {
     return blockSz_;
@@ -21,9 +21,11 @@
 #include <map>
 #include <memory>
 #include <shared_mutex>
+#include <sys/types.h>
 #include <vector>
 
 #include "singleton.h"
+#include "smart_fd.h"
 
 namespace OHOS {
 namespace HiviewDFX {
@@ -40,12 +42,16 @@ struct BufferBlock {
     std::vector<uint8_t> data;
     // used bytes
     size_t usedBytes = 0;
+    // offset of the data in the task spill file, -1 while the data is still in memory
+    off_t spillOffset = -1;
     // constructor
     BufferBlock(int cpuIdx, size_t size) : cpu(cpuIdx), data(size) {}
     // free bytes
     size_t FreeBytes() const;
     // append data
     bool Append(const uint8_t* src, size_t size);
+    // whether the data has been moved to the task spill file
+    bool IsSpilled() const { return spillOffset >= 0; }
 };
 
 using BufferBlockPtr = std::shared_ptr<BufferBlock>;
@@ -53,26 +59,47 @@ using BufferList = std::list<BufferBlockPtr>;
 
 constexpr size_t DEFAULT_BLOCK_SZ = 10 * 1024 * 1024; // 10 MB
 constexpr size_t DEFAULT_MAX_TOTAL_SZ = 300 * 1024 * 1024; // 300 MB
+constexpr size_t DEFAULT_MAX_SPILL_SZ = 300 * 1024 * 1024; // 300 MB
 
 class TraceBufferManager : public Singleton<TraceBufferManager> {
     DECLARE_SINGLETON(TraceBufferManager);
 public:
     BufferBlockPtr AllocateBlock(const uint64_t taskId, const int cpu);
+    /**
+     * @brief Same as AllocateBlock, but once the memory budget is exhausted the oldest in-memory block of the
+     *        task is written to a temp file and its memory is reused for the new block.
+     */
+    BufferBlockPtr AllocateBlockWithSpill(const uint64_t taskId, const int cpu);
     void ReleaseTaskBlocks(const uint64_t taskId);
     BufferList GetTaskBuffers(const uint64_t taskId);
     size_t GetTaskTotalUsedBytes(const uint64_t taskId);
+    size_t GetTaskSpilledBytes(const uint64_t taskId);
+    // read back part of a spilled block, returns the number of bytes read or -1 on failure.
+    ssize_t ReadSpilledBlock(const uint64_t taskId, const BufferBlock& block, size_t offset, uint8_t* dst,
+        size_t size);
     size_t GetCurrentTotalSize();
+    size_t GetPeakTotalSize() const;
     size_t GetBlockSize() const;
 
 private:
+    struct TaskSpill {
+        SmartFd fd;
+        off_t size = 0;
+    };
+
     bool TryAllocateMemorySpace(uint64_t taskId);
+    BufferBlockPtr SpillOldestBlock(const uint64_t taskId);
+    bool OpenSpillFile(const uint64_t taskId, TaskSpill& spill);
 
 private:
     size_t maxTotalSz_;
     size_t blockSz_;
+    size_t maxSpillSz_;
     std::atomic_size_t curTotalSz_;
+    std::atomic_size_t peakTotalSz_;
     mutable std::shared_mutex globalMutex_;
     std::map<uint64_t, BufferList> taskBuffers_;
+    std::map<uint64_t, TaskSpill> taskSpills_;
 };
 } // namespace Hitrace
 } // namespace HiviewDFX
@@ -21,7 +21,9 @@
 #include <fcntl.h>
 #include <fstream>
 #include <hilog/log.h>
+#include <mutex>
 #include <string>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "common_define.h"
@@ -49,6 +51,9 @@ constexpr int JUDGE_FILE_EXIST = 10;  // Check whether the trace file exists eve
 constexpr int BUFFER_SIZE = 256 * PAGE_SIZE; // 1M
 constexpr uint8_t HM_FILE_RAW_TRACE = 1;
 constexpr char BOOT_TRACE_INLINE_EVENT_FMT_ENV[] = "HITRACE_BOOT_INLINE_EVENT_FMT";
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+constexpr int HASH_HEX_LEN = 16;
 
 /**
  * @note async trace dump mode is performed in parallel with other modes,
@@ -57,6 +62,16 @@ constexpr char BOOT_TRACE_INLINE_EVENT_FMT_ENV[] = "HITRACE_BOOT_INLINE_EVENT_FM
 thread_local int g_writeFileLimit = 0;
 thread_local int g_outputFileSize = 0;
 thread_local uint8_t g_buffer[BUFFER_SIZE] = { 0 };
+thread_local TraceDumpMetrics g_dumpMetrics;
+
+void RecordCpuBytesRead(const int cpu, const ssize_t bytes)
+{
+    if (cpu < 0 || cpu >= DUMP_METRICS_MAX_CPU || bytes <= 0) {
+        return;
+    }
+    g_dumpMetrics.cpuBytesRead[cpu] += static_cast<uint64_t>(bytes);
+    g_dumpMetrics.cpuCount = std::max(g_dumpMetrics.cpuCount, static_cast<uint32_t>(cpu + 1));
+}
 
 static void PreWriteAllTraceEventsFormat(const int fd)
 {
@@ -76,6 +91,64 @@ static void PreWriteAllTraceEventsFormat(const int fd)
     }
 }
 
+/**
+ * @note saved_events_format only changes when it is deleted and regenerated, so the sidecar name is
+ *       cached by file identity and the hash is computed once per regeneration instead of once per slice.
+ */
+struct EventsFormatSidecarCache {
+    std::mutex mutex;
+    dev_t dev = 0;
+    ino_t ino = 0;
+    time_t mtime = 0;
+    off_t size = -1;
+    std::string name;
+};
+
+EventsFormatSidecarCache g_sidecarCache;
+
+static bool HashEventsFormat(const int fd, const off_t size, uint64_t& hash)
+{
+    hash = FNV_OFFSET_BASIS;
+    off_t offset = 0;
+    while (offset < size) {
+        ssize_t readBytes = TEMP_FAILURE_RETRY(pread(fd, g_buffer, BUFFER_SIZE, offset));
+        if (readBytes <= 0) {
+            return false;
+        }
+        for (ssize_t i = 0; i < readBytes; i++) {
+            hash = (hash ^ g_buffer[i]) * FNV_PRIME;
+        }
+        offset += readBytes;
+    }
+    return true;
+}
+
+static bool CopyEventsFormatToSidecar(const int fd, const off_t size, const std::string& sidecarPath)
+{
+    // write to a private temp file first, readers must never observe a partial sidecar.
+    const std::string tmpPath = sidecarPath + ".tmp" + std::to_string(getpid());
+    SmartFd outFd(open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)); // 0644: -rw-r--r--
+    if (!outFd) {
+        HILOG_ERROR(LOG_CORE, "CopyEventsFormatToSidecar: open %{public}s failed, errno(%{public}d)",
+            tmpPath.c_str(), errno);
+        return false;
+    }
+    off_t offset = 0;
+    bool ret = true;
+    while (ret && offset < size) {
+        ssize_t readBytes = TEMP_FAILURE_RETRY(pread(fd, g_buffer, BUFFER_SIZE, offset));
+        ret = readBytes > 0 && TEMP_FAILURE_RETRY(write(outFd.GetFd(), g_buffer, readBytes)) == readBytes;
+        offset += readBytes;
+    }
+    if (!ret || rename(tmpPath.c_str(), sidecarPath.c_str()) != 0) {
+        HILOG_ERROR(LOG_CORE, "CopyEventsFormatToSidecar: create %{public}s failed, errno(%{public}d)",
+            sidecarPath.c_str(), errno);
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
 static bool IsBootTraceInlineEventFmtEnabled()
 {
     const char* env = std::getenv(BOOT_TRACE_INLINE_EVENT_FMT_ENV);
@@ -291,6 +364,16 @@ void ITraceContent::ResetCurrentFileSize()
     g_outputFileSize = 0;
 }
 
+const TraceDumpMetrics& ITraceContent::GetDumpMetrics()
+{
+    return g_dumpMetrics;
+}
+
+void ITraceContent::ResetDumpMetrics()
+{
+    g_dumpMetrics = {};
+}
+
 void ITraceContent::WriteProcessLists(ssize_t& writeLen)
 {
     DIR* procDir = opendir("/proc");
@@ -506,6 +589,70 @@ bool TraceEventFmtContent::WriteTraceContent()
     return WriteTraceData(CONTENT_TYPE_EVENTS_FORMAT);
 }
 
+std::string TraceEventFmtContent::GetEventsFormatSidecar()
+{
+    struct stat fileStat {};
+    if (!traceSourceFd_ || fstat(traceSourceFd_.GetFd(), &fileStat) != 0 || fileStat.st_size == 0) {
+        return "";
+    }
+    std::lock_guard<std::mutex> lock(g_sidecarCache.mutex);
+    if (g_sidecarCache.dev != fileStat.st_dev || g_sidecarCache.ino != fileStat.st_ino ||
+        g_sidecarCache.mtime != fileStat.st_mtime || g_sidecarCache.size != fileStat.st_size) {
+        uint64_t hash = 0;
+        if (!HashEventsFormat(traceSourceFd_.GetFd(), fileStat.st_size, hash)) {
+            HILOG_ERROR(LOG_CORE, "GetEventsFormatSidecar: read saved_events_format failed, errno(%{public}d)", errno);
+            return "";
+        }
+        char hashHex[HASH_HEX_LEN + 1] = { 0 };
+        if (snprintf_s(hashHex, sizeof(hashHex), sizeof(hashHex) - 1, "%016" PRIx64, hash) < 0) {
+            return "";
+        }
+        g_sidecarCache.dev = fileStat.st_dev;
+        g_sidecarCache.ino = fileStat.st_ino;
+        g_sidecarCache.mtime = fileStat.st_mtime;
+        g_sidecarCache.size = fileStat.st_size;
+        g_sidecarCache.name = std::string(TRACE_EVENTS_FORMAT_SIDECAR_PREFIX) + hashHex;
+    }
+    const std::string sidecarPath = std::string(TRACE_FILE_DEFAULT_DIR) + g_sidecarCache.name;
+    if (access(sidecarPath.c_str(), F_OK) != 0 &&
+        !CopyEventsFormatToSidecar(traceSourceFd_.GetFd(), fileStat.st_size, sidecarPath)) {
+        return "";
+    }
+    return g_sidecarCache.name;
+}
+
+bool TraceEventFmtContent::WriteTraceContentRef()
+{
+    if (inlineEventFmt_) {
+        return WriteTraceContentInline();
+    }
+    const std::string sidecarName = GetEventsFormatSidecar();
+    if (sidecarName.empty()) {
+        HILOG_WARN(LOG_CORE, "WriteTraceContentRef: sidecar unavailable, write full events format.");
+        return WriteTraceContent();
+    }
+    if (!IsFileExist()) {
+        HILOG_ERROR(LOG_CORE, "WriteTraceContentRef: trace file (%{public}s) not found.", traceFilePath_.c_str());
+        return false;
+    }
+    TraceFileContentHeader contentHeader;
+    contentHeader.type = CONTENT_TYPE_EVENTS_FORMAT_REF;
+    contentHeader.length = static_cast<uint32_t>(sidecarName.size());
+    ssize_t writeRet = TEMP_FAILURE_RETRY(write(traceFileFd_, reinterpret_cast<char*>(&contentHeader),
+        sizeof(contentHeader)));
+    if (writeRet != static_cast<ssize_t>(sizeof(contentHeader))) {
+        HILOG_ERROR(LOG_CORE, "WriteTraceContentRef: write content header failed, errno(%{public}d)", errno);
+        return false;
+    }
+    writeRet = TEMP_FAILURE_RETRY(write(traceFileFd_, sidecarName.data(), sidecarName.size()));
+    if (writeRet != static_cast<ssize_t>(sidecarName.size())) {
+        HILOG_ERROR(LOG_CORE, "WriteTraceContentRef: write sidecar name failed, errno(%{public}d)", errno);
+        return false;
+    }
+    g_outputFileSize += static_cast<int>(sizeof(contentHeader) + sidecarName.size());
+    return true;
+}
+
 bool TraceEventFmtContent::WriteTraceContentInline()
 {
     if (!IsFileExist()) {
@@ -677,6 +824,7 @@ bool ITraceCpuRawContent::WriteTracePipeRawData(const std::string& srcPath, cons
         }
     }
     UpdateTraceContentHeader(rawtraceHdr, static_cast<uint32_t>(writeLen));
+    RecordCpuBytesRead(cpuIdx, readLen);
     if (readLen > 0) {
         dumpStatus_ = writeLen > 0 ? TraceErrorCode::SUCCESS : TraceErrorCode::WRITE_TRACE_INFO_ERROR;
     }
@@ -710,11 +858,13 @@ void ITraceCpuRawContent::ReadTracePipeRawLoop(const int srcFd,
             dumpStatus_ = TraceErrorCode::OUT_OF_TIME;
             break;
         } else if (pageValid == 0) {
+            g_dumpMetrics.pagesSkipped++;
             continue;
         }
         UpdateFirstLastPageTimeStamp(pageTraceTime, printFirstPageTime, firstPageTimeStamp_, lastPageTimeStamp_);
         if (!CheckPage(g_buffer + bytes)) {
             pageChkFailedTime++;
+            g_dumpMetrics.pagesCheckFailed++;
         }
         bytes += readBytes;
         if (pageChkFailedTime >= 2) { // 2 : check failed times threshold
@@ -782,7 +932,7 @@ bool ITraceCpuRawRead::CopyTracePipeRawLoop(const int srcFd, const int cpu, ssiz
     int& pageChkFailedTime, bool& printFirstPageTime)
 {
     const size_t bufferSz = TraceBufferManager::GetInstance().GetBlockSize();
-    auto buffer = TraceBufferManager::GetInstance().AllocateBlock(request_.taskId, cpu);
+    auto buffer = TraceBufferManager::GetInstance().AllocateBlockWithSpill(request_.taskId, cpu);
     if (buffer == nullptr) {
         HILOG_ERROR(LOG_CORE, "CopyTracePipeRawLoop: Failed to allocate memory block.");
         return true;
@@ -812,11 +962,13 @@ bool ITraceCpuRawRead::CopyTracePipeRawLoop(const int srcFd, const int cpu, ssiz
             dumpStatus_ = TraceErrorCode::OUT_OF_TIME;
             break;
         } else if (pageValid == 0) {
+            g_dumpMetrics.pagesSkipped++;
             continue;
         }
         UpdateFirstLastPageTimeStamp(pageTraceTime, printFirstPageTime, firstPageTimeStamp_, lastPageTimeStamp_);
         if (!CheckPage(pageBuffer)) {
             pageChkFailedTime++;
+            g_dumpMetrics.pagesCheckFailed++;
         }
         blockReadSz += readBytes;
         buffer->Append(pageBuffer, readBytes);
@@ -841,6 +993,7 @@ bool ITraceCpuRawRead::CacheTracePipeRawData(const std::string& srcPath, const i
     int pageChkFailedTime = 0;
     bool printFirstPageTime = false; // attention: update first page time in every WriteTracePipeRawData calling.
     while (!CopyTracePipeRawLoop(rawTraceFd.GetFd(), cpuIdx, writeLen, pageChkFailedTime, printFirstPageTime)) {}
+    RecordCpuBytesRead(cpuIdx, writeLen);
     if (writeLen > 0) {
         dumpStatus_ = TraceErrorCode::SUCCESS;
     }
@@ -879,6 +1032,26 @@ bool TraceCpuRawReadHM::WriteTraceContent()
     return true;
 }
 
+void ITraceCpuRawWrite::WriteBufferBlock(const BufferBlock& block, ssize_t& writeLen)
+{
+    if (!block.IsSpilled()) {
+        DoWriteTraceData(block.data.data(), block.usedBytes, writeLen); // attention: maybe write null data.
+        return;
+    }
+    size_t offset = 0;
+    while (offset < block.usedBytes) {
+        ssize_t readBytes = TraceBufferManager::GetInstance().ReadSpilledBlock(taskId_, block, offset,
+            g_buffer, BUFFER_SIZE);
+        if (readBytes <= 0) {
+            HILOG_ERROR(LOG_CORE, "WriteBufferBlock: read spilled block failed, cpu%{public}d errno(%{public}d)",
+                block.cpu, errno);
+            return;
+        }
+        DoWriteTraceData(g_buffer, static_cast<int>(readBytes), writeLen);
+        offset += static_cast<size_t>(readBytes);
+    }
+}
+
 bool TraceCpuRawWriteLinux::WriteTraceContent()
 {
     if (!IsFileExist()) {
@@ -902,7 +1075,7 @@ bool TraceCpuRawWriteLinux::WriteTraceContent()
                 return false;
             }
         }
-        DoWriteTraceData(bufItem->data.data(), bufItem->usedBytes, writeLen); // attention: maybe write null data.
+        WriteBufferBlock(*bufItem, writeLen);
         UpdateTraceContentHeader(rawHeader, static_cast<uint32_t>(writeLen));
     }
     TraceBufferManager::GetInstance().ReleaseTaskBlocks(taskId_);
@@ -927,7 +1100,7 @@ bool TraceCpuRawWriteHM::WriteTraceContent()
     ssize_t writeLen = 0;
     auto buffers = TraceBufferManager::GetInstance().GetTaskBuffers(taskId_);
     for (auto& bufItem : buffers) {
-        DoWriteTraceData(bufItem->data.data(), bufItem->usedBytes, writeLen); // attention: maybe write null data.
+        WriteBufferBlock(*bufItem, writeLen);
     }
     UpdateTraceContentHeader(rawHeader, static_cast<uint32_t>(writeLen));
     TraceBufferManager::GetInstance().ReleaseTaskBlocks(taskId_);
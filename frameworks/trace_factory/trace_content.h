@@ -46,7 +46,8 @@ enum ContentType : uint8_t {
     CONTENT_TYPE_HEADER_PAGE = 30,
     CONTENT_TYPE_PRINTK_FORMATS = 31,
     CONTENT_TYPE_KALLSYMS = 32,
-    CONTENT_TYPE_BASE_INFO = 33
+    CONTENT_TYPE_BASE_INFO = 33,
+    CONTENT_TYPE_EVENTS_FORMAT_REF = 34
 };
 
 struct alignas(ALIGNMENT_COEFFICIENT) TraceFileContentHeader {
@@ -76,6 +77,9 @@ public:
     const std::string& GetTraceFilePath() const { return traceFilePath_; }
     static int GetCurrentFileSize();
     static void ResetCurrentFileSize();
+    // raw page counters of the dump running on the calling thread
+    static const TraceDumpMetrics& GetDumpMetrics();
+    static void ResetDumpMetrics();
     void WriteProcessLists(ssize_t& writeLen);
 
 private:
@@ -129,8 +133,14 @@ public:
     TraceEventFmtContent(const int fd, const std::string& traceFilePath,
         const bool ishm);
     bool WriteTraceContent() override;
+    /**
+     * Write only the name of the events format sidecar instead of the full text,
+     * falls back to WriteTraceContent() if the sidecar is unavailable.
+     */
+    bool WriteTraceContentRef();
 private:
     bool WriteTraceContentInline();
+    std::string GetEventsFormatSidecar();
     bool inlineEventFmt_ = false;
 };
 
@@ -231,6 +241,8 @@ public:
     bool WriteTraceContent() override = 0;
 
 protected:
+    // write the block data, reading it back from the spill file if it was spilled.
+    void WriteBufferBlock(const BufferBlock& block, ssize_t& writeLen);
     uint64_t taskId_ = 0; // Task ID for the current write operation
 };
 
@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_file_merger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <fcntl.h>
+#include <set>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common_define.h"
+#include "hilog/log.h"
+#include "trace_file_utils.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+#ifdef LOG_DOMAIN
+#undef LOG_DOMAIN
+#define LOG_DOMAIN 0xD002D33
+#endif
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "HitraceMerger"
+#endif
+namespace {
+constexpr size_t COPY_BUFFER_SIZE = 1024 * 1024;
+constexpr size_t SIDECAR_HASH_LEN = 16;
+// metadata sections written before and after the raw data, in the order the dump strategies use.
+constexpr uint8_t PRE_META_TYPES[] = { CONTENT_TYPE_BASE_INFO };
+constexpr uint8_t POST_META_TYPES[] = { CONTENT_TYPE_HEADER_PAGE, CONTENT_TYPE_PRINTK_FORMATS, CONTENT_TYPE_KALLSYMS };
+
+bool IsCpuRawType(uint8_t type)
+{
+    return type >= CONTENT_TYPE_CPU_RAW && type < CONTENT_TYPE_HEADER_PAGE;
+}
+
+bool IsValidSidecarName(const std::string& name)
+{
+    const std::string prefix = TRACE_EVENTS_FORMAT_SIDECAR_PREFIX;
+    if (name.size() != prefix.size() + SIDECAR_HASH_LEN || name.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    return std::all_of(name.begin() + prefix.size(), name.end(), [](char c) { return isxdigit(c) != 0; });
+}
+
+bool ReadFull(int fd, off_t offset, uint8_t* buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = TEMP_FAILURE_RETRY(pread(fd, buffer + done, size - done, offset + static_cast<off_t>(done)));
+        if (ret <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool WriteFull(int fd, const uint8_t* buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = TEMP_FAILURE_RETRY(write(fd, buffer + done, size - done));
+        if (ret <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool WriteContentHeader(int fd, uint8_t type, uint64_t length)
+{
+    if (length > UINT32_MAX) {
+        HILOG_ERROR(LOG_CORE, "WriteContentHeader: section %{public}u too large, length: %{public}" PRIu64 ".",
+            type, length);
+        return false;
+    }
+    TraceFileContentHeader contentHeader;
+    contentHeader.type = type;
+    contentHeader.length = static_cast<uint32_t>(length);
+    return WriteFull(fd, reinterpret_cast<const uint8_t*>(&contentHeader), sizeof(contentHeader));
+}
+}
+
+bool TraceFileMerger::LoadSlice(const std::string& path, TraceSlice& slice)
+{
+    slice.path = path;
+    slice.fd = SmartFd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!slice.fd) {
+        HILOG_ERROR(LOG_CORE, "LoadSlice: open %{public}s failed, errno: %{public}d.", path.c_str(), errno);
+        return false;
+    }
+    // keep the slice from being aged out while it is merged, RemoveFile skips locked files. A slice locked
+    // exclusively is still being written or removed, merging it would copy a half file.
+    if (flock(slice.fd.GetFd(), LOCK_SH | LOCK_NB) < 0) {
+        HILOG_ERROR(LOG_CORE, "LoadSlice: lock %{public}s failed, errno: %{public}d.", path.c_str(), errno);
+        return false;
+    }
+    struct stat fileStat {};
+    if (fstat(slice.fd.GetFd(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+        HILOG_ERROR(LOG_CORE, "LoadSlice: %{public}s is not a regular file.", path.c_str());
+        return false;
+    }
+    const off_t fileSize = fileStat.st_size;
+    if (!ReadFull(slice.fd.GetFd(), 0, reinterpret_cast<uint8_t*>(&slice.header), sizeof(slice.header)) ||
+        slice.header.magicNumber != MAGIC_NUMBER) {
+        HILOG_ERROR(LOG_CORE, "LoadSlice: %{public}s is not a raw trace file.", path.c_str());
+        return false;
+    }
+    off_t offset = static_cast<off_t>(sizeof(TraceFileHeader));
+    while (offset + static_cast<off_t>(sizeof(TraceFileContentHeader)) <= fileSize) {
+        TraceFileContentHeader contentHeader;
+        if (!ReadFull(slice.fd.GetFd(), offset, reinterpret_cast<uint8_t*>(&contentHeader), sizeof(contentHeader))) {
+            return false;
+        }
+        offset += static_cast<off_t>(sizeof(contentHeader));
+        if (offset + static_cast<off_t>(contentHeader.length) > fileSize) {
+            HILOG_WARN(LOG_CORE, "LoadSlice: %{public}s truncated at section %{public}u, drop the tail.",
+                path.c_str(), contentHeader.type);
+            break;
+        }
+        slice.sections.push_back({ contentHeader.type, offset, contentHeader.length });
+        offset += static_cast<off_t>(contentHeader.length);
+    }
+    return true;
+}
+
+std::vector<TraceFileMerger::SectionPart> TraceFileMerger::CollectSections(uint8_t type, bool firstOnly) const
+{
+    std::vector<SectionPart> parts;
+    for (const auto& slice : slices_) {
+        for (const auto& section : slice.sections) {
+            if (section.type != type) {
+                continue;
+            }
+            parts.push_back({ slice.fd.GetFd(), section });
+            if (firstOnly) {
+                return parts;
+            }
+        }
+    }
+    return parts;
+}
+
+bool TraceFileMerger::WriteSection(int outFd, uint8_t type, const std::vector<SectionPart>& parts)
+{
+    if (parts.empty()) {
+        return true;
+    }
+    uint64_t totalLength = 0;
+    for (const auto& part : parts) {
+        totalLength += part.section.length;
+    }
+    if (!WriteContentHeader(outFd, type, totalLength)) {
+        return false;
+    }
+    std::vector<uint8_t> buffer(COPY_BUFFER_SIZE);
+    for (const auto& part : parts) {
+        off_t offset = part.section.offset;
+        size_t remain = part.section.length;
+        while (remain > 0) {
+            size_t chunk = std::min(remain, buffer.size());
+            if (!ReadFull(part.fd, offset, buffer.data(), chunk) || !WriteFull(outFd, buffer.data(), chunk)) {
+                HILOG_ERROR(LOG_CORE, "WriteSection: copy section %{public}u failed, errno: %{public}d.", type, errno);
+                return false;
+            }
+            offset += static_cast<off_t>(chunk);
+            remain -= chunk;
+        }
+    }
+    return true;
+}
+
+bool TraceFileMerger::WriteDedupedSection(int outFd, uint8_t type, const std::vector<SectionPart>& parts)
+{
+    if (parts.empty()) {
+        return true;
+    }
+    std::set<std::string> seen;
+    std::string content;
+    for (const auto& part : parts) {
+        std::string text(part.section.length, '\0');
+        if (!ReadFull(part.fd, part.section.offset, reinterpret_cast<uint8_t*>(text.data()), text.size())) {
+            HILOG_ERROR(LOG_CORE, "WriteDedupedSection: read section %{public}u failed.", type);
+            return false;
+        }
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            end = (end == std::string::npos) ? text.size() : end + 1;
+            std::string line = text.substr(start, end - start);
+            start = end;
+            if (line.back() != '\n') {
+                line.push_back('\n');
+            }
+            if (seen.insert(line).second) {
+                content += line;
+            }
+        }
+    }
+    return WriteContentHeader(outFd, type, content.size()) &&
+        WriteFull(outFd, reinterpret_cast<const uint8_t*>(content.data()), content.size());
+}
+
+bool TraceFileMerger::WriteSidecarSection(int outFd, const SectionPart& ref)
+{
+    std::string sidecarName;
+    if (!ReadSidecarName(ref, sidecarName)) {
+        HILOG_ERROR(LOG_CORE, "WriteSidecarSection: invalid events format reference.");
+        return false;
+    }
+    const std::string sidecarPath = std::string(TRACE_FILE_DEFAULT_DIR) + sidecarName;
+    SmartFd sidecarFd(open(sidecarPath.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat fileStat {};
+    if (!sidecarFd || fstat(sidecarFd.GetFd(), &fileStat) != 0 || fileStat.st_size > UINT32_MAX) {
+        HILOG_ERROR(LOG_CORE, "WriteSidecarSection: open %{public}s failed, errno: %{public}d.",
+            sidecarPath.c_str(), errno);
+        return false;
+    }
+    TraceSection section = { CONTENT_TYPE_EVENTS_FORMAT, 0, static_cast<uint32_t>(fileStat.st_size) };
+    return WriteSection(outFd, CONTENT_TYPE_EVENTS_FORMAT, { { sidecarFd.GetFd(), section } });
+}
+
+bool TraceFileMerger::ReadSidecarName(const SectionPart& ref, std::string& sidecarName)
+{
+    sidecarName.assign(ref.section.length, '\0');
+    return ReadFull(ref.fd, ref.section.offset, reinterpret_cast<uint8_t*>(sidecarName.data()), sidecarName.size()) &&
+        IsValidSidecarName(sidecarName);
+}
+
+bool TraceFileMerger::WriteEventsFormat(int outFd)
+{
+    auto parts = CollectSections(CONTENT_TYPE_EVENTS_FORMAT, true);
+    if (!parts.empty()) {
+        return WriteSection(outFd, CONTENT_TYPE_EVENTS_FORMAT, parts);
+    }
+    parts = CollectSections(CONTENT_TYPE_EVENTS_FORMAT_REF, true);
+    if (parts.empty()) {
+        return true;
+    }
+    return WriteSidecarSection(outFd, parts.front());
+}
+
+bool TraceFileMerger::DoMerge(int outFd)
+{
+    if (!WriteFull(outFd, reinterpret_cast<const uint8_t*>(&slices_.front().header), sizeof(TraceFileHeader))) {
+        return false;
+    }
+    for (auto type : PRE_META_TYPES) {
+        if (!WriteSection(outFd, type, CollectSections(type, true))) {
+            return false;
+        }
+    }
+    if (!WriteEventsFormat(outFd)) {
+        return false;
+    }
+    std::set<uint8_t> cpuTypes;
+    for (const auto& slice : slices_) {
+        for (const auto& section : slice.sections) {
+            if (IsCpuRawType(section.type)) {
+                cpuTypes.insert(section.type);
+            }
+        }
+    }
+    for (auto type : cpuTypes) {
+        if (!WriteSection(outFd, type, CollectSections(type, false))) {
+            return false;
+        }
+    }
+    if (!WriteDedupedSection(outFd, CONTENT_TYPE_CMDLINES, CollectSections(CONTENT_TYPE_CMDLINES, false)) ||
+        !WriteDedupedSection(outFd, CONTENT_TYPE_TGIDS, CollectSections(CONTENT_TYPE_TGIDS, false))) {
+        return false;
+    }
+    for (auto type : POST_META_TYPES) {
+        if (!WriteSection(outFd, type, CollectSections(type, true))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TraceFileMerger::MergeTo(const std::string& outputFile)
+{
+    if (inputFiles_.empty()) {
+        HILOG_ERROR(LOG_CORE, "MergeTo: no input trace file.");
+        return false;
+    }
+    slices_.clear();
+    slices_.resize(inputFiles_.size());
+    for (size_t i = 0; i < inputFiles_.size(); i++) {
+        if (inputFiles_[i] == outputFile || !LoadSlice(inputFiles_[i], slices_[i])) {
+            return false;
+        }
+        const auto& header = slices_[i].header;
+        const auto& first = slices_.front().header;
+        if (header.fileType != first.fileType || header.reserved != first.reserved) {
+            HILOG_ERROR(LOG_CORE, "MergeTo: %{public}s does not match the first slice, fileType: %{public}u, "
+                "reserved: %{public}u.", inputFiles_[i].c_str(), header.fileType, header.reserved);
+            return false;
+        }
+    }
+    SmartFd outFd(open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)); // 0644: -rw-r--r--
+    if (!outFd) {
+        HILOG_ERROR(LOG_CORE, "MergeTo: create %{public}s failed, errno: %{public}d.", outputFile.c_str(), errno);
+        return false;
+    }
+    if (!DoMerge(outFd.GetFd())) {
+        HILOG_ERROR(LOG_CORE, "MergeTo: merge into %{public}s failed.", outputFile.c_str());
+        if (remove(outputFile.c_str()) != 0) {
+            HILOG_WARN(LOG_CORE, "MergeTo: remove %{public}s failed, errno: %{public}d.", outputFile.c_str(), errno);
+        }
+        return false;
+    }
+    HILOG_INFO(LOG_CORE, "MergeTo: %{public}zu slices merged into %{public}s.", slices_.size(), outputFile.c_str());
+    return true;
+}
+
+bool TraceFileMerger::ExpandEventsFormatRef(const std::string& traceFile)
+{
+    TraceFileMerger merger({ traceFile });
+    TraceSlice slice;
+    if (!merger.LoadSlice(traceFile, slice)) {
+        return false;
+    }
+    bool hasRef = std::any_of(slice.sections.begin(), slice.sections.end(),
+        [](const TraceSection& section) { return section.type == CONTENT_TYPE_EVENTS_FORMAT_REF; });
+    if (!hasRef) {
+        return true;
+    }
+    // a dot file next to the trace file: the rename stays on one file system and the ledger does not index it.
+    const size_t nameStart = traceFile.rfind('/') + 1;
+    const std::string tmpFile = traceFile.substr(0, nameStart) + "." + traceFile.substr(nameStart) + ".expand";
+    SmartFd outFd(open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)); // 0644: -rw-r--r--
+    bool ret = outFd && WriteFull(outFd.GetFd(), reinterpret_cast<const uint8_t*>(&slice.header), sizeof(slice.header));
+    // only the reference is replaced, every other section is copied as it is and in its place.
+    for (auto it = slice.sections.begin(); ret && it != slice.sections.end(); it++) {
+        SectionPart part = { slice.fd.GetFd(), *it };
+        ret = (it->type == CONTENT_TYPE_EVENTS_FORMAT_REF) ? merger.WriteSidecarSection(outFd.GetFd(), part) :
+            merger.WriteSection(outFd.GetFd(), it->type, { part });
+    }
+    if (!ret || rename(tmpFile.c_str(), traceFile.c_str()) != 0) {
+        HILOG_ERROR(LOG_CORE, "ExpandEventsFormatRef: expand %{public}s failed, errno: %{public}d.",
+            traceFile.c_str(), errno);
+        remove(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void TraceFileMerger::RemoveUnusedSidecars(const std::vector<std::string>& traceFiles)
+{
+    TraceFileMerger merger(traceFiles);
+    std::set<std::string> usedSidecars;
+    for (const auto& traceFile : traceFiles) {
+        TraceSlice slice;
+        if (!merger.LoadSlice(traceFile, slice)) {
+            HILOG_WARN(LOG_CORE, "RemoveUnusedSidecars: %{public}s unreadable, keep all sidecars.", traceFile.c_str());
+            return;
+        }
+        for (const auto& section : slice.sections) {
+            std::string sidecarName;
+            if (section.type == CONTENT_TYPE_EVENTS_FORMAT_REF &&
+                ReadSidecarName({ slice.fd.GetFd(), section }, sidecarName)) {
+                usedSidecars.insert(sidecarName);
+            }
+        }
+    }
+    TraverseFiles(TRACE_FILE_DEFAULT_DIR, false, [&usedSidecars](const char* dirPath, const dirent* entry) {
+        const std::string name = entry->d_name;
+        if (!IsValidSidecarName(name) || usedSidecars.count(name) != 0) {
+            return;
+        }
+        const std::string path = std::string(dirPath) + "/" + name;
+        if (remove(path.c_str()) == 0) {
+            HILOG_INFO(LOG_CORE, "RemoveUnusedSidecars: %{public}s removed.", path.c_str());
+        } else {
+            HILOG_WARN(LOG_CORE, "RemoveUnusedSidecars: remove %{public}s failed, errno: %{public}d.",
+                path.c_str(), errno);
+        }
+    });
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_FILE_MERGER_H
+#define TRACE_FILE_MERGER_H
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "smart_fd.h"
+#include "trace_content.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+/**
+ * @brief Merge several raw trace slices, e.g. the cache_trace_* files of one caching session, into one file.
+ * @note The slices must come from the same device and be given in time order. Per-cpu raw sections are
+ *       concatenated slice by slice, metadata sections are taken once from the first slice that carries them,
+ *       and cmdlines/tgids lines are deduplicated. An events format reference is expanded to the full
+ *       events format text read from its sidecar file.
+ */
+class TraceFileMerger {
+public:
+    explicit TraceFileMerger(const std::vector<std::string>& inputFiles) : inputFiles_(inputFiles) {}
+    bool MergeTo(const std::string& outputFile);
+    /**
+     * @brief Rewrite traceFile in place with its events format reference replaced by the full text, the other
+     *        sections are kept as they are and in their order. Files without a reference are left untouched.
+     */
+    static bool ExpandEventsFormatRef(const std::string& traceFile);
+    /**
+     * @brief Remove the events format sidecars in the trace directory that none of traceFiles references,
+     *        nothing is removed if one of them cannot be read.
+     */
+    static void RemoveUnusedSidecars(const std::vector<std::string>& traceFiles);
+
+private:
+    struct TraceSection {
+        uint8_t type = CONTENT_TYPE_DEFAULT;
+        off_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct TraceSlice {
+        std::string path;
+        SmartFd fd;
+        TraceFileHeader header;
+        std::vector<TraceSection> sections;
+    };
+
+    struct SectionPart {
+        int fd;
+        TraceSection section;
+    };
+
+    bool LoadSlice(const std::string& path, TraceSlice& slice);
+    std::vector<SectionPart> CollectSections(uint8_t type, bool firstOnly) const;
+    bool WriteSection(int outFd, uint8_t type, const std::vector<SectionPart>& parts);
+    bool WriteDedupedSection(int outFd, uint8_t type, const std::vector<SectionPart>& parts);
+    bool WriteSidecarSection(int outFd, const SectionPart& ref);
+    static bool ReadSidecarName(const SectionPart& ref, std::string& sidecarName);
+    bool WriteEventsFormat(int outFd);
+    bool DoMerge(int outFd);
+
+    std::vector<std::string> inputFiles_;
+    std::vector<TraceSlice> slices_;
+};
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // TRACE_FILE_MERGER_H
@@ -15,8 +15,10 @@
 
 #include "trace_dump_executor.h"
 
+#include <fcntl.h>
 #include <securec.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "common_define.h"
@@ -24,6 +26,8 @@
 #include "file_ageing_utils.h"
 #include "hitrace_option_util.h"
 #include "hilog/log.h"
+#include "raw_trace_filter.h"
+#include "smart_fd.h"
 #include "trace_dump_state.h"
 #include "trace_file_utils.h"
 #include "trace_strategy_factory.h"
@@ -258,6 +262,11 @@ void TraceDumpExecutor::WriteTraceLoop()
     HILOG_INFO(LOG_CORE, "WriteTraceLoop end.");
 }
 
+void TraceDumpExecutor::SetForkLatency(const uint64_t forkLatencyUs)
+{
+    forkLatencyUs_.store(forkLatencyUs);
+}
+
 void TraceDumpExecutor::ProcessNewTask(std::shared_ptr<HitraceDumpPipe>& dumpPipe, int& sleepCnt)
 {
     TraceDumpTask newTask;
@@ -273,6 +282,7 @@ void TraceDumpExecutor::DoProcessTraceDumpTask(std::shared_ptr<HitraceDumpPipe>&
     std::vector<TraceDumpTask>& completedTasks)
 {
     uint64_t curBootTime = GetCurBootTime();
+    task.metrics.sendTime = curBootTime;
     if (task.status == TraceDumpStatus::WRITE_DONE) {
         if (task.hasSyncReturn && dumpPipe->WriteAsyncReturn(task)) { // Async return
             completedTasks.push_back(task);
@@ -460,6 +470,7 @@ bool TraceDumpExecutor::DoDumpTraceLoop(const TraceDumpParam& param, std::string
         return false;
     }
     traceFile = traceSourceFactory->GetTraceFilePath();
+    FilterTraceFile(traceFile);
     if (param.type == TraceDumpType::TRACE_CACHE) {
         TraceFileInfo traceFileInfo;
         TimestampRange range{dumpRet.traceStartTime, dumpRet.traceEndTime};
@@ -495,7 +506,11 @@ TraceDumpRet TraceDumpExecutor::DumpTraceInner(const TraceDumpParam& param, cons
         .traceStartTime = param.traceStartTime,
         .traceEndTime = param.traceEndTime
     };
-    return ExecuteDumpTrace(traceSourceFactory, request);
+    auto dumpRet = ExecuteDumpTrace(traceSourceFactory, request);
+    if (dumpRet.code == TraceErrorCode::SUCCESS) {
+        dumpRet.fileSize = static_cast<int64_t>(GetFileSize(std::string(dumpRet.outputFile)));
+    }
+    return dumpRet;
 }
 
 bool TraceDumpExecutor::DoReadRawTrace(TraceDumpTask& task)
@@ -521,6 +536,9 @@ bool TraceDumpExecutor::DoReadRawTrace(TraceDumpTask& task)
     auto ret = ExecuteDumpTrace(traceSourceFactory, request);
     task.code = ret.code;
     task.fileSize = ret.fileSize + ASYNC_DUMP_FILE_SIZE_ADDITION;
+    task.spilledBytes = ret.spilledBytes;
+    task.metrics = ret.metrics;
+    task.metrics.forkLatencyUs = forkLatencyUs_.exchange(0);
     if (strncpy_s(task.outputFile, TRACE_FILE_LEN, ret.outputFile, TRACE_FILE_LEN - 1) != 0) {
         HILOG_ERROR(LOG_CORE, "DoReadRawTrace: strncpy_s failed.");
     }
@@ -561,6 +579,8 @@ bool TraceDumpExecutor::DoWriteRawTrace(TraceDumpTask& task)
     auto ret = ExecuteDumpTrace(traceSourceFactory, request);
     task.code = ret.code;
     task.fileSize = static_cast<int64_t>(GetFileSize(std::string(task.outputFile)));
+    task.metrics.metaDurationUs += ret.metrics.metaDurationUs;
+    task.metrics.writeDurationUs = ret.metrics.writeDurationUs;
     task.status = TraceDumpStatus::WRITE_DONE;
     if (task.code == TraceErrorCode::SUCCESS && task.fileSize > task.fileSizeLimit) {
         task.isFileSizeOverLimit = true;
@@ -574,6 +594,60 @@ bool TraceDumpExecutor::DoWriteRawTrace(TraceDumpTask& task)
     }
     return task.code == TraceErrorCode::SUCCESS;
 }
+
+void TraceDumpExecutor::SetMarkerFilter(const TraceMarkerFilter& filter)
+{
+    std::lock_guard<std::mutex> lck(markerFilterMutex_);
+    markerFilter_ = filter;
+}
+
+bool TraceDumpExecutor::FilterTraceFile(const std::string& traceFile)
+{
+    TraceMarkerFilter filter;
+    {
+        std::lock_guard<std::mutex> lck(markerFilterMutex_);
+        filter = markerFilter_;
+    }
+    if (!IsMarkerFilterSet(filter) || traceFile.empty()) {
+        return false;
+    }
+    return ApplyMarkerFilter(traceFile, filter);
+}
+
+bool TraceDumpExecutor::ApplyMarkerFilter(const std::string& traceFile, const TraceMarkerFilter& filter)
+{
+    // the "." prefix keeps the temporary file out of the trace file ledger and the ageing scans
+    size_t dirPos = traceFile.rfind('/');
+    std::string dir = (dirPos == std::string::npos) ? "" : traceFile.substr(0, dirPos + 1);
+    std::string filteredFile = dir + "." + traceFile.substr(dir.size()) + ".filtering";
+    SmartFd traceFd(open(traceFile.c_str(), O_RDONLY | O_CLOEXEC));
+    FilterStats stats;
+    RawTraceError ret = traceFd ? FilterRawTraceFile(traceFile, filteredFile, filter, stats) :
+        RawTraceError::OPEN_FAILED;
+    if (ret != RawTraceError::NONE) {
+        HILOG_ERROR(LOG_CORE, "ApplyMarkerFilter: filter %{public}s failed: %{public}s, errno: %{public}d, "
+            "keep it unfiltered.", traceFile.c_str(), GetRawTraceErrorMsg(ret), errno);
+        RemoveFile(filteredFile);
+        return false;
+    }
+    // the ageing may have removed the file meanwhile, the rename would bring it back outside the ledger
+    struct stat traceStat;
+    if (fstat(traceFd.GetFd(), &traceStat) != 0 || traceStat.st_nlink == 0) {
+        HILOG_WARN(LOG_CORE, "ApplyMarkerFilter: %{public}s was removed while filtering.", traceFile.c_str());
+        RemoveFile(filteredFile);
+        return false;
+    }
+    if (rename(filteredFile.c_str(), traceFile.c_str()) != 0) {
+        HILOG_ERROR(LOG_CORE, "ApplyMarkerFilter: rename to %{public}s failed, errno: %{public}d.",
+            traceFile.c_str(), errno);
+        RemoveFile(filteredFile);
+        return false;
+    }
+    HILOG_INFO(LOG_CORE, "ApplyMarkerFilter: %{public}s kept %{public}" PRIu64 " of %{public}" PRIu64
+        " events, %{public}" PRIu64 " of %{public}" PRIu64 " pages.", traceFile.c_str(), stats.eventsKept,
+        stats.eventsIn, stats.pagesOut, stats.pagesIn);
+    return true;
+}
 } // namespace Hitrace
 } // namespace HiviewDFX
 } // namespace OHOS
\ No newline at end of file
@@ -16,6 +16,7 @@
 #ifndef TRACE_DUMP_EXECUTOR_H
 #define TRACE_DUMP_EXECUTOR_H
 
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -63,6 +64,12 @@ public:
     void ClearTraceDumpTask();
     bool IsTraceDumpTaskEmpty();
     size_t GetTraceDumpTaskCount();
+    // called in a freshly forked dump process, reported with the first task it reads.
+    void SetForkLatency(const uint64_t forkLatencyUs);
+    // applied to every finished raw trace file, an empty filter leaves the files untouched.
+    void SetMarkerFilter(const TraceMarkerFilter& filter);
+    // filters the finished file in place before its size is reported, returns false if the file was left as is.
+    bool FilterTraceFile(const std::string& traceFile);
 
 #ifdef HITRACE_UNITTEST
     void ClearCacheTraceFiles();
@@ -78,6 +85,7 @@ private:
     void DoProcessTraceDumpTask(std::shared_ptr<HitraceDumpPipe>& dumpPipe, TraceDumpTask& task,
         std::vector<TraceDumpTask>& completedTasks);
     void ProcessNewTask(std::shared_ptr<HitraceDumpPipe>& dumpPipe, int& sleepCnt);
+    bool ApplyMarkerFilter(const std::string& traceFile, const TraceMarkerFilter& filter);
 
     std::vector<TraceFileInfo> loopTraceFiles_ = {};
     std::vector<TraceFileInfo> cacheTraceFiles_ = {};
@@ -86,6 +94,9 @@ private:
     std::mutex taskQueueMutex_;
     std::condition_variable readCondVar_;
     std::condition_variable writeCondVar_;
+    std::atomic<uint64_t> forkLatencyUs_{0};
+    std::mutex markerFilterMutex_;
+    TraceMarkerFilter markerFilter_ {};
 };
 } // namespace Hitrace
 } // namespace HiviewDFX
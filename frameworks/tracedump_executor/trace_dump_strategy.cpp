@@ -25,6 +25,7 @@
 #include "hilog/log.h"
 #include "trace_dump_state.h"
 #include "trace_file_utils.h"
+#include "trace_json_parser.h"
 #include "trace_strategy_factory.h"
 
 namespace OHOS {
@@ -59,6 +60,22 @@ bool IsGenerateNewFile(std::shared_ptr<ITraceSourceFactory> traceSourceFactory,
     return true;
 }
 
+uint64_t GetElapsedUs(const uint64_t startTime)
+{
+    return (GetCurBootTime() - startTime) / US_TO_NS;
+}
+
+void CollectContentMetrics(TraceDumpMetrics& metrics)
+{
+    const TraceDumpMetrics& contentMetrics = ITraceContent::GetDumpMetrics();
+    for (uint32_t cpu = 0; cpu < contentMetrics.cpuCount; cpu++) {
+        metrics.cpuBytesRead[cpu] = contentMetrics.cpuBytesRead[cpu];
+    }
+    metrics.cpuCount = contentMetrics.cpuCount;
+    metrics.pagesSkipped = contentMetrics.pagesSkipped;
+    metrics.pagesCheckFailed = contentMetrics.pagesCheckFailed;
+}
+
 template<typename T>
 void SafeWriteTraceContent(const std::unique_ptr<T>& component, const std::string& componentName)
 {
@@ -88,11 +105,13 @@ TraceDumpRet ITraceDumpStrategy::Execute(std::shared_ptr<ITraceSourceFactory> tr
     }
     int newFileCount = 1;
     TraceDumpRet ret;
+    ITraceContent::ResetDumpMetrics();
     do {
         if (!ProcessTraceDumpIteration(traceSourceFactory, request, ret, newFileCount)) {
             break;
         }
     } while (ShouldContinueWithNewFile(traceSourceFactory, request, newFileCount));
+    CollectContentMetrics(ret.metrics);
 
     return ret;
 }
@@ -109,12 +128,23 @@ bool ITraceDumpStrategy::ProcessTraceDumpIteration(std::shared_ptr<ITraceSourceF
         return false;
     }
 
+    uint64_t stageStart = GetCurBootTime();
     ExecutePreProcessing(traceContentPtr);
-    if (!DoCore(traceSourceFactory, request, traceContentPtr, ret)) {
+    ret.metrics.metaDurationUs += GetElapsedUs(stageStart);
+    stageStart = GetCurBootTime();
+    bool coreRet = DoCore(traceSourceFactory, request, traceContentPtr, ret);
+    if (request.type == TraceDumpType::TRACE_ASYNC_WRITE) {
+        ret.metrics.writeDurationUs += GetElapsedUs(stageStart);
+    } else {
+        ret.metrics.readDurationUs += GetElapsedUs(stageStart);
+    }
+    if (!coreRet) {
         return HandleCoreFailure(traceSourceFactory, request, ret, newFileCount);
     }
 
+    stageStart = GetCurBootTime();
     ExecutePostProcessing(traceContentPtr);
+    ret.metrics.metaDurationUs += GetElapsedUs(stageStart);
     return true;
 }
 
@@ -269,6 +299,20 @@ bool RecordTraceDumpStrategy::DoCore(std::shared_ptr<ITraceSourceFactory> traceS
     return true;
 }
 
+void CacheTraceDumpStrategy::OnPre(const TraceContentPtr& traceContentPtr)
+{
+    if (!TraceJsonParser::Instance().IsCacheEventFormatRefEnabled()) {
+        ITraceDumpStrategy::OnPre(traceContentPtr);
+        return;
+    }
+    traceContentPtr.fileHdr->ResetCurrentFileSize();
+    SafeWriteTraceContent(traceContentPtr.fileHdr, "fileHdr");
+    SafeWriteTraceContent(traceContentPtr.baseInfo, "baseInfo");
+    if (!traceContentPtr.eventFmt->WriteTraceContentRef()) {
+        HILOG_INFO(LOG_CORE, "eventFmt WriteTraceContentRef failed.");
+    }
+}
+
 bool CacheTraceDumpStrategy::DoCore(std::shared_ptr<ITraceSourceFactory> traceSourceFactory,
     const TraceDumpRequest& request, const TraceContentPtr& traceContentPtr, TraceDumpRet& ret)
 {
@@ -311,6 +355,8 @@ bool AsyncTraceReadStrategy::DoCore(std::shared_ptr<ITraceSourceFactory> traceSo
     }
     ret.code = cpuRawRead->GetDumpStatus();
     ret.fileSize = static_cast<int64_t>(TraceBufferManager::GetInstance().GetTaskTotalUsedBytes(request.taskId));
+    ret.spilledBytes = TraceBufferManager::GetInstance().GetTaskSpilledBytes(request.taskId);
+    ret.metrics.bufferPeakBytes = TraceBufferManager::GetInstance().GetPeakTotalSize();
     ret.traceStartTime = cpuRawRead->GetFirstPageTimeStamp();
     ret.traceEndTime = cpuRawRead->GetLastPageTimeStamp();
     auto tracefile = GenerateTraceFileNameByTraceTime(request.type, ret.traceStartTime, ret.traceEndTime);
@@ -318,8 +364,8 @@ bool AsyncTraceReadStrategy::DoCore(std::shared_ptr<ITraceSourceFactory> traceSo
         HILOG_ERROR(LOG_CORE, "AsyncTraceReadStrategy: strncpy_s failed.");
         return false;
     }
-    HILOG_INFO(LOG_CORE, "AsyncTraceReadStrategy: trace file : %{public}s, file size : %{public}" PRId64,
-        ret.outputFile, ret.fileSize);
+    HILOG_INFO(LOG_CORE, "AsyncTraceReadStrategy: trace file : %{public}s, file size : %{public}" PRId64
+        ", spilled : %{public}" PRIu64, ret.outputFile, ret.fileSize, ret.spilledBytes);
     return true;
 }
 
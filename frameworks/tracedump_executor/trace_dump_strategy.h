@@ -30,6 +30,8 @@ struct TraceDumpRet {
     int64_t fileSize = 0;
     uint64_t traceStartTime = 0;
     uint64_t traceEndTime = 0;
+    uint64_t spilledBytes = 0;
+    TraceDumpMetrics metrics;
 };
 
 struct TraceContentPtr {
@@ -94,6 +96,10 @@ public:
     bool DoCore(std::shared_ptr<ITraceSourceFactory> traceSourceFactory, const TraceDumpRequest& request,
         const TraceContentPtr& contentPtr, TraceDumpRet& ret) override;
     bool NeedCheckFileExist() const override { return true; }
+
+protected:
+    // Cache slices may reference a shared events format sidecar, it is expanded again on export.
+    void OnPre(const TraceContentPtr& traceContentPtr) override;
 };
 
 
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_event_subscriber.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include "common_utils.h"
+#include "hilog/log.h"
+#include "hitrace_option_util.h"
+#include "raw_trace_decoder.h"
+#include "trace_json_parser.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+#ifdef LOG_DOMAIN
+#undef LOG_DOMAIN
+#define LOG_DOMAIN 0xD002D33
+#endif
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "HitraceEventSubscriber"
+#endif
+namespace {
+constexpr uint32_t COMMON_PID_OFFSET = 4; // common_type u16, common_flags u8, common_preempt_count u8
+constexpr uint32_t DATA_LOC_OFFSET_MASK = 0xffff;
+constexpr uint32_t DATA_LOC_SIZE_SHIFT = 16;
+constexpr int MAX_PAGES_PER_PIPE = 64; // pages drained from one fd per wakeup, so a busy cpu cannot starve others
+const std::vector<std::string> MARKER_EVENT_NAMES = { "tracing_mark_write", "print" };
+
+// "events/ftrace/print/format" -> "print"
+std::string GetEventNameOfFormatPath(const std::string& formatPath)
+{
+    size_t end = formatPath.rfind('/');
+    if (end == std::string::npos || end == 0) {
+        return "";
+    }
+    size_t begin = formatPath.rfind('/', end - 1);
+    begin = (begin == std::string::npos) ? 0 : begin + 1;
+    return formatPath.substr(begin, end - begin);
+}
+
+bool IsMarkerEvent(const std::string& name)
+{
+    return std::find(MARKER_EVENT_NAMES.begin(), MARKER_EVENT_NAMES.end(), name) != MARKER_EVENT_NAMES.end();
+}
+} // namespace
+
+TraceEventSubscriber::TraceEventSubscriber() {}
+
+TraceEventSubscriber::~TraceEventSubscriber()
+{
+    Stop();
+}
+
+TraceErrorCode TraceEventSubscriber::Start(const TraceEventFilter& filter, TraceEventCallback callback)
+{
+    std::lock_guard<std::mutex> startLock(mutex_);
+    if (running_ || stopping_ || reader_.joinable()) {
+        HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: already subscribed.");
+        return WRONG_TRACE_MODE;
+    }
+    if (!callback || filter.maxBatchSize == 0 || filter.maxPendingBatches == 0) {
+        HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: invalid callback or batch limits.");
+        return INVALID_EVENT_FILTER;
+    }
+    if (!ResolveEventFormats(filter)) {
+        return INVALID_EVENT_FILTER;
+    }
+    isHmKernel_ = IsHmKernel();
+    if (!isHmKernel_ && !ResolvePageLayout()) {
+        return FILE_ERROR;
+    }
+    if (!OpenTracePipes()) {
+        pipes_.clear();
+        return FILE_ERROR;
+    }
+    filter_ = filter;
+    callback_ = std::move(callback);
+    pids_ = std::unordered_set<int32_t>(filter.pids.begin(), filter.pids.end());
+    pending_.clear();
+    current_ = std::make_unique<TraceEventBatch>();
+    droppedCount_ = 0;
+    readerDone_ = false;
+    running_ = true;
+    reader_ = std::thread(&TraceEventSubscriber::ReadLoop, this);
+    deliverer_ = std::thread(&TraceEventSubscriber::DeliverLoop, this);
+    HILOG_INFO(LOG_CORE, "TraceEventSubscriber: subscribed to %{public}zu pipes, %{public}zu event ids.",
+        pipes_.size(), eventIds_.size());
+    return SUCCESS;
+}
+
+void TraceEventSubscriber::Stop()
+{
+    RequestStop();
+    Join();
+}
+
+void TraceEventSubscriber::RequestStop()
+{
+    std::lock_guard<std::mutex> stopLock(mutex_);
+    if (!reader_.joinable() || stopping_) {
+        return;
+    }
+    running_ = false;
+    stopping_ = true;
+    uint64_t wakeup = 1;
+    if (write(stopFd_.GetFd(), &wakeup, sizeof(wakeup)) < 0) {
+        HILOG_WARN(LOG_CORE, "TraceEventSubscriber: wake up reader failed, errno(%{public}d).", errno);
+    }
+}
+
+void TraceEventSubscriber::Join()
+{
+    std::thread reader;
+    std::thread deliverer;
+    {
+        std::lock_guard<std::mutex> joinLock(mutex_);
+        if (!stopping_ || !reader_.joinable()) {
+            return;
+        }
+        if (deliverer_.get_id() == std::this_thread::get_id()) {
+            HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: the callback cannot end its own subscription.");
+            return;
+        }
+        reader = std::move(reader_);
+        deliverer = std::move(deliverer_);
+    }
+    reader.join();
+    if (deliverer.joinable()) {
+        deliverer.join();
+    }
+    std::lock_guard<std::mutex> joinLock(mutex_);
+    pipes_.clear();
+    epollFd_.Reset();
+    stopFd_.Reset();
+    callback_ = nullptr;
+    stopping_ = false;
+    HILOG_INFO(LOG_CORE, "TraceEventSubscriber: unsubscribed, %{public}" PRIu64 " events dropped.", droppedCount_);
+}
+
+bool TraceEventSubscriber::IsRunning()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_;
+}
+
+bool TraceEventSubscriber::ResolveEventFormats(const TraceEventFilter& filter)
+{
+    std::unordered_set<std::string> wanted(filter.eventNames.begin(), filter.eventNames.end());
+    std::vector<std::string> formatPaths = TraceJsonParser::Instance().GetBaseFmtPath();
+    for (const auto& [tagName, tag] : TraceJsonParser::Instance().GetAllTagInfos()) {
+        formatPaths.insert(formatPaths.end(), tag.formatPath.begin(), tag.formatPath.end());
+    }
+    std::unordered_map<uint16_t, EventFormat> formats;
+    for (const auto& formatPath : formatPaths) {
+        std::string name = GetEventNameOfFormatPath(formatPath);
+        if (wanted.count(name) == 0 && !IsMarkerEvent(name)) {
+            continue;
+        }
+        std::ifstream formatFile(GetTraceRootPath() + formatPath);
+        if (!formatFile.is_open()) {
+            continue;
+        }
+        std::stringstream text;
+        text << formatFile.rdbuf();
+        ParseEventFormats(text.str(), formats);
+    }
+
+    eventIds_.clear();
+    markerFields_.clear();
+    std::unordered_set<std::string> resolved;
+    for (const auto& [id, format] : formats) {
+        if (wanted.count(format.name) != 0) {
+            eventIds_.insert(id);
+            resolved.insert(format.name);
+        }
+        if (!IsMarkerEvent(format.name)) {
+            continue;
+        }
+        const EventField* field = format.FindField("buffer");
+        if (field == nullptr) {
+            field = format.FindField("buf");
+        }
+        if (field != nullptr) {
+            markerFields_[id] = { field->offset, field->size, field->isDataLoc };
+        }
+    }
+    for (const auto& name : wanted) {
+        if (resolved.count(name) == 0) {
+            HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: event %{public}s has no format.", name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TraceEventSubscriber::ResolvePageLayout()
+{
+    // the page header follows the kernel, not this process: a 32-bit process may read a 64-bit kernel's pages
+    const std::string headerPagePath = GetTraceRootPath() + "events/header_page";
+    std::ifstream headerPageFile(headerPagePath);
+    if (!headerPageFile.is_open()) {
+        HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: open %{public}s failed.", headerPagePath.c_str());
+        return false;
+    }
+    std::stringstream text;
+    text << headerPageFile.rdbuf();
+    if (!ParseHeaderPageArch(text.str(), is32BitArch_)) {
+        HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: no commit field in %{public}s.", headerPagePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TraceEventSubscriber::OpenTracePipes()
+{
+    pipes_.clear();
+    std::vector<std::pair<std::string, uint32_t>> paths;
+    if (IsHmKernel()) {
+        paths.emplace_back(GetTraceRootPath() + "trace_pipe_raw", 0); // the cpu is carried by every page
+    } else {
+        int cpuNums = GetCpuProcessors();
+        for (int cpuIdx = 0; cpuIdx < cpuNums; cpuIdx++) {
+            paths.emplace_back(GetTraceRootPath() + "per_cpu/cpu" + std::to_string(cpuIdx) + "/trace_pipe_raw",
+                static_cast<uint32_t>(cpuIdx));
+        }
+    }
+    epollFd_ = SmartFd(epoll_create1(EPOLL_CLOEXEC));
+    stopFd_ = SmartFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!epollFd_ || !stopFd_) {
+        HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: create epoll or eventfd failed, errno(%{public}d).", errno);
+        return false;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = UINT64_MAX;
+    if (epoll_ctl(epollFd_.GetFd(), EPOLL_CTL_ADD, stopFd_.GetFd(), &event) < 0) {
+        return false;
+    }
+    for (const auto& [path, cpu] : paths) {
+        SmartFd fd(open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+        if (!fd) {
+            HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: open %{public}s failed, errno(%{public}d).",
+                path.c_str(), errno);
+            return false;
+        }
+        event.data.u64 = pipes_.size();
+        if (epoll_ctl(epollFd_.GetFd(), EPOLL_CTL_ADD, fd.GetFd(), &event) < 0) {
+            HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: epoll_ctl %{public}s failed, errno(%{public}d).",
+                path.c_str(), errno);
+            return false;
+        }
+        pipes_.emplace_back(std::move(fd), cpu);
+    }
+    return !pipes_.empty();
+}
+
+void TraceEventSubscriber::ReadLoop()
+{
+    prctl(PR_SET_NAME, "TraceSubReader");
+    std::vector<uint8_t> page(RAW_TRACE_PAGE_SIZE);
+    std::vector<struct epoll_event> events(pipes_.size() + 1);
+    bool stop = false;
+    while (!stop) {
+        int nfds = epoll_wait(epollFd_.GetFd(), events.data(), static_cast<int>(events.size()),
+            static_cast<int>(filter_.flushIntervalMs));
+        if (nfds < 0 && errno != EINTR) {
+            HILOG_ERROR(LOG_CORE, "TraceEventSubscriber: epoll_wait failed, errno(%{public}d).", errno);
+            break;
+        }
+        for (int i = 0; i < nfds; i++) {
+            if (events[i].data.u64 == UINT64_MAX) {
+                stop = true;
+            }
+        }
+        // the ring buffer only wakes up readers on full pages, drain every cpu so partial pages still come
+        // through within the flush interval.
+        for (const auto& [fd, cpu] : pipes_) {
+            DrainPipe(fd.GetFd(), cpu, page);
+        }
+        PushBatch();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    readerDone_ = true;
+    running_ = false;
+    cond_.notify_all();
+}
+
+bool TraceEventSubscriber::DrainPipe(const int fd, const uint32_t cpu, std::vector<uint8_t>& page)
+{
+    auto onEvent = [this](const RawEvent& event) {
+        OnEvent(event.data, event.size, event.cpu, event.timestamp);
+    };
+    for (int i = 0; i < MAX_PAGES_PER_PIPE; i++) {
+        ssize_t ret = TEMP_FAILURE_RETRY(read(fd, page.data(), page.size()));
+        if (ret <= 0) {
+            return ret == 0 || errno == EAGAIN;
+        }
+        if (static_cast<size_t>(ret) < page.size()) {
+            std::fill(page.begin() + ret, page.end(), 0);
+        }
+        if (isHmKernel_) {
+            DecodePage(page.data(), onEvent);
+        } else {
+            DecodeLinuxPage(page.data(), cpu, is32BitArch_, onEvent);
+        }
+    }
+    return true;
+}
+
+void TraceEventSubscriber::OnEvent(const uint8_t* data, const size_t size, const uint32_t cpu,
+    const uint64_t timestamp)
+{
+    if (size < COMMON_PID_OFFSET + sizeof(int32_t)) {
+        return;
+    }
+    uint16_t eventId = 0;
+    int32_t pid = 0;
+    (void)memcpy(&eventId, data, sizeof(eventId));
+    (void)memcpy(&pid, data + COMMON_PID_OFFSET, sizeof(pid));
+    if ((!eventIds_.empty() && eventIds_.count(eventId) == 0) || (!pids_.empty() && pids_.count(pid) == 0)) {
+        return;
+    }
+
+    TraceEventBatch& batch = *current_;
+    TraceEventView view;
+    view.timestamp = timestamp;
+    view.cpu = cpu;
+    view.pid = pid;
+    view.eventId = eventId;
+    view.size = static_cast<uint32_t>(size);
+    size_t payloadOffset = 0;
+    auto marker = markerFields_.find(eventId);
+    if (marker != markerFields_.end()) {
+        uint32_t begin = marker->second.offset;
+        uint32_t end = begin + marker->second.size;
+        if (marker->second.isDataLoc && end <= size) {
+            uint32_t dataLoc = 0;
+            (void)memcpy(&dataLoc, data + begin, sizeof(dataLoc));
+            begin = dataLoc & DATA_LOC_OFFSET_MASK;
+            end = begin + (dataLoc >> DATA_LOC_SIZE_SHIFT);
+        } else if (!marker->second.isDataLoc) {
+            end = static_cast<uint32_t>(size); // char buf[] takes up the rest of the record
+        }
+        if (begin < end && end <= size) {
+            const void* nul = memchr(data + begin, '\0', end - begin);
+            payloadOffset = begin;
+            view.payloadSize = (nul == nullptr) ? end - begin :
+                static_cast<uint32_t>(static_cast<const uint8_t*>(nul) - (data + begin));
+        }
+    }
+    batch.recordOffsets.push_back(batch.records.size());
+    batch.payloadOffsets.push_back(payloadOffset);
+    batch.records.insert(batch.records.end(), data, data + size);
+    batch.events.push_back(view);
+    if (batch.events.size() >= filter_.maxBatchSize) {
+        PushBatch();
+    }
+}
+
+void TraceEventSubscriber::SealBatch(TraceEventBatch& batch)
+{
+    for (size_t i = 0; i < batch.events.size(); i++) {
+        TraceEventView& view = batch.events[i];
+        view.data = batch.records.data() + batch.recordOffsets[i];
+        if (view.payloadSize > 0) {
+            view.payload = reinterpret_cast<const char*>(view.data + batch.payloadOffsets[i]);
+        }
+    }
+}
+
+void TraceEventSubscriber::PushBatch()
+{
+    if (current_->events.empty()) {
+        return;
+    }
+    SealBatch(*current_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() >= filter_.maxPendingBatches) {
+        droppedCount_ += current_->events.size();
+        current_->events.clear();
+        current_->records.clear();
+        current_->recordOffsets.clear();
+        current_->payloadOffsets.clear();
+        return;
+    }
+    pending_.push_back(std::move(current_));
+    current_ = std::make_unique<TraceEventBatch>();
+    cond_.notify_one();
+}
+
+void TraceEventSubscriber::DeliverLoop()
+{
+    prctl(PR_SET_NAME, "TraceSubDeliver");
+    uint64_t reportedDrops = 0;
+    while (true) {
+        std::unique_ptr<TraceEventBatch> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return !pending_.empty() || readerDone_; });
+            if (pending_.empty()) {
+                break;
+            }
+            batch = std::move(pending_.front());
+            pending_.pop_front();
+            batch->droppedCount = droppedCount_ - reportedDrops;
+            reportedDrops = droppedCount_;
+        }
+        callback_(batch->events, batch->droppedCount);
+    }
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_EVENT_SUBSCRIBER_H
+#define TRACE_EVENT_SUBSCRIBER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "hitrace_define.h"
+#include "singleton.h"
+#include "smart_fd.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct TraceEventBatch {
+    std::vector<TraceEventView> events;
+    std::vector<uint8_t> records; // the views point into this buffer once the batch is sealed
+    std::vector<size_t> recordOffsets;
+    std::vector<size_t> payloadOffsets;
+    uint64_t droppedCount = 0;
+};
+
+/**
+ * @brief Streams the ring buffer to an in-process callback while tracing runs.
+ * @note A reader thread epolls the trace_pipe_raw fds and decodes the pages into batches, a delivery thread
+ *       hands the batches to the callback, so a slow callback costs dropped batches instead of kernel overruns.
+ *       Reading trace_pipe_raw consumes the buffer, only one subscription can exist at a time.
+ *       RequestStop only signals the threads so it can run under the caller's lock, Join waits for them outside of
+ *       it: a callback may call the other dump APIs, but must not end its own subscription.
+ */
+class TraceEventSubscriber : public DelayedRefSingleton<TraceEventSubscriber> {
+    DECLARE_DELAYED_REF_SINGLETON(TraceEventSubscriber);
+
+public:
+    TraceErrorCode Start(const TraceEventFilter& filter, TraceEventCallback callback);
+    void Stop();
+    void RequestStop();
+    void Join();
+    bool IsRunning();
+
+private:
+    struct MarkerField {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        bool isDataLoc = false;
+    };
+
+    bool ResolveEventFormats(const TraceEventFilter& filter);
+    bool ResolvePageLayout();
+    bool OpenTracePipes();
+    void ReadLoop();
+    void DeliverLoop();
+    bool DrainPipe(const int fd, const uint32_t cpu, std::vector<uint8_t>& page);
+    void OnEvent(const uint8_t* data, const size_t size, const uint32_t cpu, const uint64_t timestamp);
+    void SealBatch(TraceEventBatch& batch);
+    void PushBatch();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::unique_ptr<TraceEventBatch>> pending_;
+    bool running_ = false;
+    bool readerDone_ = false; // the reader has pushed its last batch
+    bool stopping_ = false; // stop requested, the threads are not joined yet
+    bool isHmKernel_ = false;
+    bool is32BitArch_ = false;
+    std::thread reader_;
+    std::thread deliverer_;
+    SmartFd epollFd_;
+    SmartFd stopFd_;
+    std::vector<std::pair<SmartFd, uint32_t>> pipes_; // fd, cpu
+    TraceEventFilter filter_;
+    TraceEventCallback callback_;
+    std::unordered_set<uint16_t> eventIds_;
+    std::unordered_set<int32_t> pids_;
+    std::unordered_map<uint16_t, MarkerField> markerFields_;
+    std::unique_ptr<TraceEventBatch> current_;
+    uint64_t droppedCount_ = 0;
+};
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // TRACE_EVENT_SUBSCRIBER_H
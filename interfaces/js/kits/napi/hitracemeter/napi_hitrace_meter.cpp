@@ -18,6 +18,7 @@
 #include <hilog/log.h>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "hitrace_meter.h"
 #include "hitrace_meter_c.h"
@@ -245,6 +246,58 @@ static napi_value JSTraceCount(napi_env env, napi_callback_info info)
     return nullptr;
 }
 
+static bool ParseCounterParam(napi_env env, napi_value value, std::string& name, int64_t& count)
+{
+    napi_value nameValue = nullptr;
+    napi_value countValue = nullptr;
+    if (!TypeCheck(env, value, napi_object) ||
+        napi_get_named_property(env, value, "name", &nameValue) != napi_ok ||
+        napi_get_named_property(env, value, "value", &countValue) != napi_ok) {
+        HILOG_DEBUG(LOG_CORE, "Counter should be an object with name and value.");
+        return false;
+    }
+    return ParseStringParam(env, nameValue, name) && ParseInt64Param(env, countValue, count);
+}
+
+static napi_value JSCountTraceBatch(napi_env env, napi_callback_info info)
+{
+    size_t argc = ARGC_TWO;
+    napi_value argv[ARGC_TWO];
+    napi_status status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+    if (status != napi_ok) {
+        HILOG_ERROR(LOG_CORE, "napi_get_cb_info failed.");
+        return nullptr;
+    }
+    if (argc != ARGC_TWO) {
+        HILOG_ERROR(LOG_CORE, "Wrong number of parameters.");
+        return nullptr;
+    }
+    int32_t level;
+    if (!ParseInt32Param(env, argv[ARG_FIRST], level)) {
+        return nullptr;
+    }
+    bool isArray = false;
+    uint32_t length = 0;
+    if (napi_is_array(env, argv[ARG_SECOND], &isArray) != napi_ok || !isArray ||
+        napi_get_array_length(env, argv[ARG_SECOND], &length) != napi_ok || length == 0) {
+        HILOG_DEBUG(LOG_CORE, "Counters should be a non-empty array.");
+        return nullptr;
+    }
+    // the names stay alive until the batch is written
+    std::vector<std::string> names(length);
+    std::vector<HiTraceCounter> counters(length);
+    for (uint32_t i = 0; i < length; i++) {
+        napi_value element = nullptr;
+        if (napi_get_element(env, argv[ARG_SECOND], i, &element) != napi_ok ||
+            !ParseCounterParam(env, element, names[i], counters[i].value)) {
+            return nullptr;
+        }
+        counters[i].name = names[i].c_str();
+    }
+    CountTraceBatchEx(static_cast<HiTraceOutputLevel>(level), HITRACE_TAG_APP, counters.data(), counters.size());
+    return nullptr;
+}
+
 static napi_value JSStartSyncTrace(napi_env env, napi_callback_info info)
 {
     size_t argc = ARGC_THREE;
@@ -503,6 +556,7 @@ static napi_value HiTraceMeterInit(napi_env env, napi_value exports)
         DECLARE_NAPI_FUNCTION("startTrace", JSTraceStart),
         DECLARE_NAPI_FUNCTION("finishTrace", JSTraceFinish),
         DECLARE_NAPI_FUNCTION("traceByValue", JSTraceCount),
+        DECLARE_NAPI_FUNCTION("traceByValueBatch", JSCountTraceBatch),
         DECLARE_NAPI_FUNCTION("startSyncTrace", JSStartSyncTrace),
         DECLARE_NAPI_FUNCTION("finishSyncTrace", JSFinishSyncTrace),
         DECLARE_NAPI_FUNCTION("startAsyncTrace", JSStartAsyncTrace),
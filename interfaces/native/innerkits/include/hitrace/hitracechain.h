@@ -117,6 +117,32 @@ public:
      * @brief restore the current thread id.
      */
     static void Restore(const HiTraceId& id);
+
+    /**
+     * @brief set the target id and keep the old id on the thread stack.
+     * @param id the trace id of target id, an invalid id clears the thread id.
+     * @return handle to pop on the same thread, HITRACE_SPAN_HANDLE_INVALID if the stack is full.
+     */
+    static HiTraceSpanHandle Push(const HiTraceId& id);
+
+    /**
+     * @brief restore the id replaced by the push of the handle.
+     */
+    static void Pop(HiTraceSpanHandle handle);
+
+    /**
+     * @brief capture the current thread id for a task resumed on another thread.
+     * @return nullptr if the thread has no trace id, otherwise released once with ReleaseContext.
+     * Resuming or releasing a context again after it was released is undefined.
+     */
+    static HiTraceTaskContext* CaptureContext();
+
+    /**
+     * @brief push the captured id on the current thread.
+     */
+    static HiTraceSpanHandle ResumeContext(const HiTraceTaskContext* context);
+
+    static void ReleaseContext(HiTraceTaskContext* context);
 private:
     HiTraceChain() = default;
     ~HiTraceChain() = default;
@@ -103,6 +103,16 @@ typedef struct HiTraceIdStruct {
 
 #define HITRACE_ID_LEN sizeof(HiTraceIdStruct)
 
+// Spans one thread can have pushed at the same time.
+#define HITRACE_SPAN_STACK_DEPTH 32
+#define HITRACE_SPAN_HANDLE_INVALID 0
+
+// Handle of a span pushed on the stack of the current thread, popped on the same thread.
+typedef uint64_t HiTraceSpanHandle;
+
+// Trace id captured from one thread to resume a task on another, opaque to the caller.
+typedef struct HiTraceTaskContext HiTraceTaskContext;
+
 HiTraceIdStruct HiTraceChainBegin(const char* name, int flags);
 HiTraceIdStruct HiTraceChainBeginWithDomain(const char* name, int flags, unsigned int domain);
 void HiTraceChainEnd(const HiTraceIdStruct* pId);
@@ -114,6 +124,19 @@ void HiTraceChainClearId(void);
 HiTraceIdStruct HiTraceChainCreateSpan(void);
 HiTraceIdStruct HiTraceChainSaveAndSetId(const HiTraceIdStruct* pId);
 void HiTraceChainRestoreId(const HiTraceIdStruct* oldId);
+/**
+ * Push sets pId as the trace id of the current thread, or clears it if pId is invalid, and keeps the replaced id
+ * on the thread stack. Pop restores it, spans pushed above the handle and never popped are dropped with a warning.
+ */
+HiTraceSpanHandle HiTraceChainPushId(const HiTraceIdStruct* pId);
+void HiTraceChainPopId(HiTraceSpanHandle handle);
+// Returns NULL if the thread has no trace id, every context returned is released once and not used after release.
+HiTraceTaskContext* HiTraceChainCaptureContext(void);
+// Pushes the captured id on the current thread, the handle is popped when the task yields or finishes.
+HiTraceSpanHandle HiTraceChainResumeContext(const HiTraceTaskContext* context);
+void HiTraceChainReleaseContext(HiTraceTaskContext* context);
+// Contexts captured and not released yet, a count that keeps growing is a leak.
+unsigned int HiTraceChainGetLiveContextCount(void);
 void HiTraceChainTracepoint(HiTraceTracepointType type, const HiTraceIdStruct* pId, const char* fmt, ...)
     __attribute__((__format__(os_log, 3, 4)));
 void HiTraceChainTracepointWithArgs(HiTraceTracepointType type, const HiTraceIdStruct* pId, const char* fmt,
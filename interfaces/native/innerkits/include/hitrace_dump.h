@@ -37,6 +37,9 @@ struct TraceArgs {
     int32_t appPid = 0;
     int64_t totalSize = 0;
     std::vector<int32_t> filterPids {};
+    // applied to the raw files of every dump until the trace is closed, on a background thread: a file is first
+    // returned unfiltered and then atomically replaced by its filtered copy.
+    TraceMarkerFilter markerFilter {};
 };
 
 #ifdef HITRACE_UNITTEST
@@ -96,6 +99,16 @@ TraceRetInfo DumpTrace(uint32_t maxDuration = 0, uint64_t utTraceEndTime = 0, co
 TraceRetInfo DumpTraceAsync(uint32_t maxDuration = 0, uint64_t utTraceEndTime = 0, int64_t fileSizeLimit = 0,
     std::function<void(TraceRetInfo)> asyncCallback = nullptr);
 
+/**
+ * Merge trace slices, e.g. the cache files returned by DumpTrace() during caching, into one trace file.
+ * inputFiles: raw trace files under /data/log/hitrace/ captured on this device, in time order.
+ * outputPath: where to write the merged file.
+ * ----If outputPath is empty, the file is generated under /data/log/hitrace/ and aged like a snapshot.
+ * return TraceErrorCode::SUCCESS with the merged file in outputFiles
+ * return TraceErrorCode::FILE_ERROR if any input is illegal or the merge fails.
+*/
+TraceRetInfo MergeTraceFiles(const std::vector<std::string>& inputFiles, const std::string& outputPath = "");
+
 /**
  * Enable sub threads to periodically drop disk trace data.
  * End the periodic disk drop task until the next call to RecordTraceOff().
@@ -120,6 +133,20 @@ TraceErrorCode CacheTraceOn(uint64_t totalFileSize = DEFAULT_TOTAL_CACHE_FILE_SI
 */
 TraceErrorCode CacheTraceOff();
 
+/**
+ * Stream the events of the opened trace to callback in batches on a sub thread, until UnsubscribeTraceEvents().
+ * The subscription consumes the ring buffer, so it excludes record, cache and dump while it runs.
+ * filter: the event names and pids to deliver, bounded by maxBatchSize and maxPendingBatches.
+ * return TraceErrorCode::INVALID_EVENT_FILTER if callback is empty or an event name is unknown.
+*/
+TraceErrorCode SubscribeTraceEvents(const TraceEventFilter& filter, TraceEventCallback callback);
+
+/**
+ * End the subscription, the pending batches are delivered before it returns.
+ * It waits for the callback, so it must not be called from the callback itself.
+*/
+TraceErrorCode UnsubscribeTraceEvents();
+
 /**
  * Turn off trace mode.
 */
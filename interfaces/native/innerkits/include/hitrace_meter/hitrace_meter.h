@@ -20,6 +20,8 @@
 #include <string>
 #include <unistd.h>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "hitrace_meter_c.h"
 #ifdef HITRACE_UNITTEST
@@ -194,7 +196,51 @@ void CountTraceEx(HiTraceOutputLevel level, uint64_t tag, const char* name, int6
 void CountTraceDebug(bool isDebug, uint64_t tag, const std::string& name, int64_t count);
 void CountTraceWrapper(uint64_t tag, const char* name, int64_t count);
 
+/**
+ * Track several 64-bit integer counters with one marker write, e.g. the counters of a frame.
+ * The dump and the converters expand the batch back into one counter event per item.
+ */
+void CountTraceBatch(uint64_t tag, const HiTraceCounter* counters, size_t count);
+void CountTraceBatchEx(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count);
+
+/**
+ * Drop the counter updates of this process that repeat the last value of the same tag and name, off by default;
+ * an unchanged value is still written once a second. With a minIntervalUs other than 0 a counter is written at most
+ * once per interval, a value held back and not replaced by a later update is written by the next update of any
+ * counter after the interval, by FlushCounterTrace, when the coalescing is turned off or at process exit.
+ */
+void SetCounterCoalescing(bool enable, uint64_t minIntervalUs);
+void FlushCounterTrace();
+
 bool IsTagEnabled(uint64_t tag);
+
+/**
+ * Latency statistics of the HitraceScoped spans of this process, kept whether or not the tag is being traced.
+ */
+struct HitraceSpanStat {
+    uint64_t tag = 0;
+    std::string name;
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> histogram; // lower bound in ns and count of the non-empty buckets
+};
+
+/**
+ * Start or stop aggregating the HitraceScoped spans per tag and name, off by default.
+ */
+void SetTraceStatsEnabled(bool enable);
+
+/**
+ * Merge the statistics of all threads, including the threads that already exited.
+ */
+void GetTraceStats(std::vector<HitraceSpanStat>& stats);
+
+/**
+ * Used by HitraceScoped, returns nullptr when the statistics are off.
+ */
+void* TraceStatsBegin(uint64_t tag, const std::string& name, uint64_t& beginNs);
+void TraceStatsEnd(void* slot, uint64_t beginNs);
 void ParseTagBits(const uint64_t tag, char* bitStr, const int bitStrSize);
 
 int32_t RegisterTraceListener(TraceEventListener callback);
@@ -255,14 +301,27 @@ public:
     inline HitraceScoped(uint64_t tag, const std::string& name) : mTag(tag)
     {
         StartTrace(mTag, name);
+        mStatsSlot = TraceStatsBegin(mTag, name, mStatsBeginNs);
     }
 
     inline ~HitraceScoped()
     {
+        if (mStatsSlot != nullptr) {
+            TraceStatsEnd(mStatsSlot, mStatsBeginNs);
+        }
         FinishTrace(mTag);
     }
 private:
     uint64_t mTag;
+    void* mStatsSlot = nullptr;
+    uint64_t mStatsBeginNs = 0;
+};
+
+enum HitracePerfCounter : uint32_t {
+    HITRACE_PERF_INSTRUCTIONS = 1U << 0,
+    HITRACE_PERF_CPU_CYCLES = 1U << 1,
+    HITRACE_PERF_CACHE_MISSES = 1U << 2,
+    HITRACE_PERF_BRANCH_MISSES = 1U << 3,
 };
 
 class HitracePerfScoped {
@@ -298,6 +357,29 @@ private:
     int err_ = 0;
 };
 
+/**
+ * Count any of the HitracePerfCounter events of a scope and trace them as counters at the end of it.
+ * The counters of a thread are opened once and read in user space where the pmu allows it,
+ * so a scope must be created, read and destroyed on the same thread.
+ */
+class HitracePerfCountersScoped {
+public:
+    HitracePerfCountersScoped(bool isDebug, uint64_t tag, const std::string& name, uint32_t counters);
+
+    ~HitracePerfCountersScoped();
+
+    // the events counted since the scope began, or the errno of the failed open
+    long long GetCount(HitracePerfCounter counter);
+private:
+    static constexpr int COUNTER_NUM = 4; // one sample per HitracePerfCounter
+
+    uint64_t mTag_;
+    std::string mName_;
+    long long begin_[COUNTER_NUM] = {};
+    int err_ = 0;
+    uint32_t counters_ = 0;
+};
+
 class HitraceMeterFmtScoped {
 public:
     HitraceMeterFmtScoped(uint64_t tag, const char* fmt, ...);
@@ -16,6 +16,7 @@
 #ifndef HITRACE_METER_H
 #define HITRACE_METER_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -33,6 +34,12 @@ typedef enum HiTraceOutputLevel {
 
 typedef void (*TraceEventListener)(bool traceStatus);
 
+// One counter of a batch, all counters of the batch share one marker write and one timestamp.
+typedef struct HiTraceCounter {
+    const char* name;
+    int64_t value;
+} HiTraceCounter;
+
 void HiTraceStartTrace(uint64_t tag, const char* name);
 void HiTraceFinishTrace(uint64_t tag);
 void HiTraceStartAsyncTrace(uint64_t tag, const char* name, int32_t taskId);
@@ -45,6 +52,8 @@ void HiTraceStartAsyncTraceEx(HiTraceOutputLevel level, uint64_t tag, const char
     const char* customCategory, const char* customArgs);
 void HiTraceFinishAsyncTraceEx(HiTraceOutputLevel level, uint64_t tag, const char* name, int32_t taskId);
 void HiTraceCountTraceEx(HiTraceOutputLevel level, uint64_t tag, const char* name, int64_t count);
+void HiTraceCountTraceBatch(uint64_t tag, const HiTraceCounter* counters, size_t count);
+void HiTraceCountTraceBatchEx(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count);
 bool HiTraceIsTagEnabled(uint64_t tag);
 
 int32_t HiTraceRegisterTraceListener(TraceEventListener callback);
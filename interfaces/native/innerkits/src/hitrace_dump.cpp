@@ -50,8 +50,11 @@
 #include "parameters.h"
 #include "securec.h"
 #include "trace_context.h"
+#include "trace_control_page.h"
 #include "trace_dump_executor.h"
 #include "trace_dump_pipe.h"
+#include "trace_event_subscriber.h"
+#include "trace_file_merger.h"
 #include "trace_file_utils.h"
 #include "trace_json_parser.h"
 
@@ -104,6 +107,7 @@ uint64_t g_lastPageTimestamp = 0;
 uint64_t g_utDestTraceStartTime = 0;
 uint64_t g_utDestTraceEndTime = 0;
 uint8_t g_dumpStatus(TraceErrorCode::UNSET);
+TraceDumpMetrics g_dumpMetrics = {};
 std::vector<TraceFileInfo> g_traceFileVec{};
 
 TraceParams g_currentTraceParams = {};
@@ -127,6 +131,11 @@ bool IsCacheOn()
     return (g_traceMode & TraceMode::CACHE) != 0;
 }
 
+bool IsSubscribeOn()
+{
+    return (g_traceMode & TraceMode::SUBSCRIBE) != 0;
+}
+
 std::vector<std::string> Split(const std::string& str, char delimiter)
 {
     std::vector<std::string> res;
@@ -215,6 +224,9 @@ bool SetProperty(const std::string& property, const std::string& value)
         HILOG_ERROR(LOG_CORE, "SetProperty: set %{public}s failed.", value.c_str());
     } else {
         HILOG_INFO(LOG_CORE, "SetProperty: set %{public}s success.", value.c_str());
+        if (IsTraceControlProperty(property)) {
+            PublishTraceControl();
+        }
     }
     return result;
 }
@@ -226,6 +238,7 @@ void ClearFilterParam()
         HILOG_ERROR(LOG_CORE, "ClearFilterParam: clear param fail");
     }
     TraceContextManager::GetInstance().ReleaseContext();
+    TraceDumpExecutor::GetInstance().SetMarkerFilter({});
 }
 
 // close all trace node
@@ -244,6 +257,7 @@ void TraceInit(const std::map<std::string, TraceTag>& allTags)
     }
     // close all user tags
     SetProperty(TRACE_TAG_ENABLE_FLAGS, std::to_string(0));
+    SetProperty(TRACE_TAG_RATE_LIMIT, "");
 
     // close tracing_on
     SetTraceNodeStatus(TRACING_ON_NODE, false);
@@ -311,6 +325,8 @@ void SetAllTags(const TraceParams& traceParams, const std::map<std::string, Trac
             }
         }
     }
+    // the limits are in place before the tags turn on, so a storming tag never floods the fresh buffer
+    SetProperty(TRACE_TAG_RATE_LIMIT, TraceJsonParser::Instance().GetTagRateLimitParam());
     SetProperty(TRACE_TAG_ENABLE_FLAGS, std::to_string(enabledUserTags));
 }
 
@@ -474,6 +490,12 @@ void SearchTraceFiles(const uint64_t& inputTraceStartTime, const uint64_t& input
     for (auto& file : targetFiles) {
         if (file.filename.find(CACHE_FILE_PREFIX) != std::string::npos) {
             file.filename = RenameCacheFile(file.filename);
+            // exported files must be self-contained, the events format sidecar may not travel with them.
+            if (TraceFileMerger::ExpandEventsFormatRef(file.filename)) {
+                file.fileSize = GetFileSize(file.filename);
+            } else {
+                HILOG_WARN(LOG_CORE, "expand events format of %{public}s failed.", file.filename.c_str());
+            }
             g_traceFileVec.push_back(file);
         }
         traceRetInfo.outputFiles.push_back(file.filename);
@@ -482,6 +504,38 @@ void SearchTraceFiles(const uint64_t& inputTraceStartTime, const uint64_t& input
     traceRetInfo.coverDuration += coverDuration;
 }
 
+std::string GenerateMergedTraceFileName(const std::vector<TraceFileInfo>& inputFiles, const std::string& outputPath)
+{
+    if (!outputPath.empty()) {
+        return GenerateTraceFileName(TraceDumpType::TRACE_SNAPSHOT, outputPath);
+    }
+    uint64_t utStartTimeMs = std::numeric_limits<uint64_t>::max();
+    uint64_t utEndTimeMs = 0;
+    for (const auto& file : inputFiles) {
+        utStartTimeMs = std::min(utStartTimeMs, file.traceStartTime);
+        utEndTimeMs = std::max(utEndTimeMs, file.traceEndTime);
+    }
+    // name the merged file by its trace time like a snapshot, so RefreshTraceVec can restore its time range.
+    uint64_t utNowMs = GetCurUnixTimeMs();
+    uint64_t bootNowMs = GetCurBootTime() / MS_TO_NS;
+    if (utStartTimeMs >= utEndTimeMs || utNowMs < bootNowMs || utStartTimeMs < utNowMs - bootNowMs) {
+        return GenerateTraceFileName(TraceDumpType::TRACE_SNAPSHOT);
+    }
+    uint64_t bootOffsetMs = utNowMs - bootNowMs;
+    return GenerateTraceFileNameByTraceTime(TraceDumpType::TRACE_SNAPSHOT,
+        (utStartTimeMs - bootOffsetMs) * MS_TO_NS, (utEndTimeMs - bootOffsetMs) * MS_TO_NS);
+}
+
+// only cache slices reference a sidecar, exported and merged files carry the full events format.
+void RemoveUnusedSidecars(const std::vector<TraceFileInfo>& cacheFileVec)
+{
+    std::vector<std::string> cacheFiles;
+    for (const auto& file : cacheFileVec) {
+        cacheFiles.push_back(file.filename);
+    }
+    TraceFileMerger::RemoveUnusedSidecars(cacheFiles);
+}
+
 void ProcessCacheTask()
 {
     const std::string threadName = "CacheTraceTask";
@@ -586,6 +640,15 @@ void WaitForChildProcess(const pid_t pid)
     }
 }
 
+void UpdateIpcLatency(TraceDumpMetrics& metrics)
+{
+    uint64_t curTime = GetCurBootTime();
+    if (metrics.sendTime == 0 || curTime < metrics.sendTime) {
+        return;
+    }
+    metrics.ipcLatencyUs = (curTime - metrics.sendTime) / US_TO_NS;
+}
+
 bool EpollWaitforChildProcess(pid_t& pid, int pipefd, std::string& reOutPath)
 {
     SmartFd epollfd = SmartFd(epoll_create1(0));
@@ -627,6 +690,8 @@ bool EpollWaitforChildProcess(pid_t& pid, int pipefd, std::string& reOutPath)
     reOutPath = retVal.outputFile;
     g_firstPageTimestamp = retVal.traceStartTime;
     g_lastPageTimestamp = retVal.traceEndTime;
+    g_dumpMetrics = retVal.metrics;
+    UpdateIpcLatency(g_dumpMetrics);
     WaitForChildProcess(pid);
     return true;
 }
@@ -634,6 +699,7 @@ bool EpollWaitforChildProcess(pid_t& pid, int pipefd, std::string& reOutPath)
 TraceErrorCode HandleDumpResult(std::string& reOutPath, TraceRetInfo& traceRetInfo, const std::string& outputPath)
 {
     SearchTraceFiles(g_utDestTraceStartTime, g_utDestTraceEndTime, traceRetInfo);
+    traceRetInfo.dumpMetrics = g_dumpMetrics;
     if (g_dumpStatus) {
         if (remove(reOutPath.c_str()) == 0) {
             HILOG_INFO(LOG_CORE, "Delete outpath:%{public}s success.", reOutPath.c_str());
@@ -644,6 +710,7 @@ TraceErrorCode HandleDumpResult(std::string& reOutPath, TraceRetInfo& traceRetIn
         HILOG_ERROR(LOG_CORE, "ProcessDump: write %{public}s failed.", reOutPath.c_str());
     } else {
         HILOG_INFO(LOG_CORE, "Output: %{public}s.", reOutPath.c_str());
+        TraceDumpExecutor::GetInstance().FilterTraceFile(reOutPath);
         TraceFileInfo traceFileInfo;
         TimestampRange range{g_firstPageTimestamp, g_lastPageTimestamp};
         if (!SetFileInfo(true, reOutPath, range, traceFileInfo, outputPath)) {
@@ -665,6 +732,15 @@ TraceErrorCode HandleDumpResult(std::string& reOutPath, TraceRetInfo& traceRetIn
     return TraceErrorCode::SUCCESS;
 }
 
+void UpdateSpillRatio(const TraceDumpTask& task, TraceRetInfo& traceRetInfo)
+{
+    if (task.spilledBytes == 0 || task.fileSize <= 0) {
+        return;
+    }
+    uint64_t ratio = task.spilledBytes * MAX_RATIO_UNIT / static_cast<uint64_t>(task.fileSize);
+    traceRetInfo.spillRatio = static_cast<int32_t>(std::min(ratio, static_cast<uint64_t>(MAX_RATIO_UNIT)));
+}
+
 void HandleAsyncDumpResult(TraceDumpTask& task, TraceRetInfo& traceRetInfo)
 {
     SearchTraceFiles(g_utDestTraceStartTime, g_utDestTraceEndTime, traceRetInfo);
@@ -675,7 +751,10 @@ void HandleAsyncDumpResult(TraceDumpTask& task, TraceRetInfo& traceRetInfo)
             // trace rename error
             HILOG_ERROR(LOG_CORE, "SetFileInfo: set %{public}s info failed.", task.outputFile);
         } else { // success
-            traceFileInfo.fileSize = task.fileSize;
+            // a task still writing is filtered by WaitAsyncDumpRetLoop before its callback
+            bool isFiltered = task.status == TraceDumpStatus::FINISH &&
+                TraceDumpExecutor::GetInstance().FilterTraceFile(traceFileInfo.filename);
+            traceFileInfo.fileSize = isFiltered ? GetFileSize(traceFileInfo.filename) : task.fileSize;
             g_traceFileVec.push_back(traceFileInfo);
             traceRetInfo.outputFiles.push_back(traceFileInfo.filename);
             traceRetInfo.coverDuration +=
@@ -689,6 +768,8 @@ void HandleAsyncDumpResult(TraceDumpTask& task, TraceRetInfo& traceRetInfo)
     if (task.isFileSizeOverLimit || traceRetInfo.fileSize > task.fileSizeLimit) {
         traceRetInfo.isOverflowControl = true;
     }
+    UpdateSpillRatio(task, traceRetInfo);
+    traceRetInfo.dumpMetrics = task.metrics;
 }
 
 TraceErrorCode ProcessDumpSync(TraceRetInfo& traceRetInfo, const std::string& outputPath)
@@ -707,6 +788,8 @@ TraceErrorCode ProcessDumpSync(TraceRetInfo& traceRetInfo, const std::string& ou
         return TraceErrorCode::PIPE_CREATE_ERROR;
     }
     g_dumpStatus = TraceErrorCode::UNSET;
+    g_dumpMetrics = {};
+    uint64_t forkTime = GetCurBootTime();
     /*Child process handles task, Father process wait.*/
     pid_t pid = fork();
     if (pid < 0) {
@@ -715,6 +798,7 @@ TraceErrorCode ProcessDumpSync(TraceRetInfo& traceRetInfo, const std::string& ou
         HILOG_ERROR(LOG_CORE, "fork error.");
         return TraceErrorCode::FORK_ERROR;
     } else if (pid == 0) {
+        uint64_t forkLatencyUs = (GetCurBootTime() - forkTime) / US_TO_NS;
         signal(SIGUSR1, TimeoutSignalHandler);
         {
             SmartFd readFd(pipefd[0]);
@@ -727,6 +811,8 @@ TraceErrorCode ProcessDumpSync(TraceRetInfo& traceRetInfo, const std::string& ou
         HILOG_INFO(LOG_CORE,
             "TraceDumpRet : %{public}d, outputFile: %{public}s, [%{public}" PRIu64 ", %{public}" PRIu64 "].",
             ret.code, ret.outputFile, ret.traceStartTime, ret.traceEndTime);
+        ret.metrics.forkLatencyUs = forkLatencyUs;
+        ret.metrics.sendTime = GetCurBootTime();
         write(writeFd.GetFd(), &ret, sizeof(ret));
         _exit(EXIT_SUCCESS);
     } else {
@@ -765,6 +851,7 @@ TraceDumpTask WaitSyncDumpRetLoop(const pid_t pid, const std::shared_ptr<Hitrace
         g_firstPageTimestamp = task.traceStartTime;
         g_lastPageTimestamp = task.traceEndTime;
         g_dumpStatus = task.code;
+        UpdateIpcLatency(task.metrics);
         if (task.status == TraceDumpStatus::WRITE_DONE) {
             task.status = TraceDumpStatus::FINISH;
             TraceDumpExecutor::GetInstance().RemoveTraceDumpTask(task.time);
@@ -812,6 +899,7 @@ void WaitAsyncDumpRetLoop(const std::shared_ptr<HitraceDumpPipe> pipe)
             HILOG_INFO(LOG_CORE, "WaitAsyncDumpRetLoop: task finished.");
             std::lock_guard<std::mutex> lock(g_traceRetAndCallbackMutex);
             auto traceRetInfo = g_traceRetInfos[task.time];
+            TraceDumpExecutor::GetInstance().FilterTraceFile(task.outputFile);
             traceRetInfo.fileSize = 0;
             for (auto& file : traceRetInfo.outputFiles) {
                 traceRetInfo.fileSize += GetFileSize(file);
@@ -819,6 +907,9 @@ void WaitAsyncDumpRetLoop(const std::shared_ptr<HitraceDumpPipe> pipe)
             if (traceRetInfo.fileSize > task.fileSizeLimit) {
                 traceRetInfo.isOverflowControl = true;
             }
+            UpdateSpillRatio(task, traceRetInfo);
+            UpdateIpcLatency(task.metrics);
+            traceRetInfo.dumpMetrics = task.metrics;
             if (g_callbacks[task.time] != nullptr) {
                 g_callbacks[task.time](traceRetInfo);
                 HILOG_INFO(LOG_CORE, "WaitAsyncDumpRetLoop: call callback func done, taskid[%{public}" PRIu64 "]",
@@ -920,12 +1011,14 @@ TraceErrorCode ProcessDumpAsync(const uint64_t taskid, const int64_t fileSizeLim
         HILOG_ERROR(LOG_CORE, "ProcessDumpAsync: create fifo failed.");
         return TraceErrorCode::PIPE_CREATE_ERROR;
     }
+    uint64_t forkTime = GetCurBootTime();
     pid_t pid = fork();
     if (pid < 0) {
         HILOG_ERROR(LOG_CORE, "ProcessDumpAsync: fork failed.");
         return TraceErrorCode::FORK_ERROR;
     }
     if (pid == 0) {
+        TraceDumpExecutor::GetInstance().SetForkLatency((GetCurBootTime() - forkTime) / US_TO_NS);
         signal(SIGUSR1, TimeoutSignalHandler);
         std::string processName = "HitraceDumpAsync";
         SetProcessName(processName);
@@ -1157,7 +1250,7 @@ bool ParseArgs(std::string args, TraceParams& traceParams, const std::map<std::s
                     pidStr.c_str());
                 return false;
             }
-            OHOS::system::SetParameter(TRACE_KEY_APP_PID, pidStr);
+            SetPropertyInner(TRACE_KEY_APP_PID, pidStr);
         } else if (itemName == "filterPids") {
             traceParams.filterPids = Split(item.substr(pos + 1), ',');
         } else {
@@ -1209,7 +1302,7 @@ void GetFileInCache(TraceRetInfo& traceRetInfo)
 
 bool CheckTraceDumpStatus(const uint32_t maxDuration, const uint64_t utTraceEndTime, TraceRetInfo& ret)
 {
-    if (!IsTraceOpen() || IsRecordOn()) {
+    if (!IsTraceOpen() || IsRecordOn() || IsSubscribeOn()) {
         HILOG_ERROR(LOG_CORE, "CheckTraceDumpStatus: WRONG_TRACE_MODE, current trace mode: %{public}u.",
             static_cast<uint32_t>(g_traceMode));
         ret.errorCode = WRONG_TRACE_MODE;
@@ -1235,10 +1328,13 @@ static TraceErrorCode ResetTracePipelineLocked()
     if (IsRecordOn() || IsCacheOn()) {
         TraceDumpExecutor::GetInstance().StopDumpTraceLoop();
     }
+    if (IsSubscribeOn()) {
+        TraceEventSubscriber::GetInstance().RequestStop(); // joined by CloseTrace once g_traceMutex is released
+    }
     ClearFilterParam();
     g_traceMode = TraceMode::CLOSE;
     g_cpuBufferBalanceService = nullptr;
-    OHOS::system::SetParameter(TRACE_KEY_APP_PID, "-1");
+    SetPropertyInner(TRACE_KEY_APP_PID, "-1");
     const std::map<std::string, TraceTag>& allTags = TraceJsonParser::Instance().GetAllTagInfos();
     if (allTags.empty()) {
         HILOG_ERROR(LOG_CORE, "ResetTracePipelineLocked: ParseTagInfo TAG_ERROR.");
@@ -1331,6 +1427,7 @@ TraceErrorCode OpenTrace(const std::vector<std::string>& tagGroups)
     std::vector<TraceFileInfo> cacheFileVec;
     RefreshTraceVec(cacheFileVec, TRACE_CACHE);
     ClearCacheTraceFileByDuration(cacheFileVec);
+    RemoveUnusedSidecars(cacheFileVec);
     g_sysInitParamTags = GetSysParamTags();
     g_traceMode = TraceMode::OPEN;
     HILOG_INFO(LOG_CORE, "OpenTrace: open by tag group success.");
@@ -1424,6 +1521,7 @@ static void FinalizeOpenTraceByArgs(const TraceParams& traceParams)
     std::vector<TraceFileInfo> cacheFileVec;
     RefreshTraceVec(cacheFileVec, TRACE_CACHE);
     ClearCacheTraceFileByDuration(cacheFileVec);
+    RemoveUnusedSidecars(cacheFileVec);
     g_sysInitParamTags = GetSysParamTags();
     g_traceMode = TraceMode::OPEN;
     OpenTraceLog(traceParams);
@@ -1478,7 +1576,7 @@ TraceErrorCode OpenTrace(const TraceArgs& traceArgs)
         return prepRet;
     }
     if (traceArgs.appPid > 0) {
-        OHOS::system::SetParameter(TRACE_KEY_APP_PID, std::to_string(traceArgs.appPid));
+        SetPropertyInner(TRACE_KEY_APP_PID, std::to_string(traceArgs.appPid));
     }
 
     TraceParams traceParams = BuildTraceParamsFromArgs(traceArgs, defaultBufferSize);
@@ -1488,6 +1586,7 @@ TraceErrorCode OpenTrace(const TraceArgs& traceArgs)
         return ret;
     }
     FinalizeOpenTraceByArgs(traceParams);
+    TraceDumpExecutor::GetInstance().SetMarkerFilter(traceArgs.markerFilter);
     return ret;
 }
 
@@ -1687,6 +1786,66 @@ TraceRetInfo DumpTraceAsync(uint32_t maxDuration, uint64_t utTraceEndTime, int64
     return ret;
 }
 
+TraceRetInfo MergeTraceFiles(const std::vector<std::string>& inputFiles, const std::string& outputPath)
+{
+    TraceRetInfo ret;
+    if (inputFiles.empty() || (!outputPath.empty() && !IsWritable(outputPath))) {
+        ret.errorCode = FILE_ERROR;
+        return ret;
+    }
+    std::vector<TraceFileInfo> inputFileInfos;
+    {
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        ret.mode = g_traceMode;
+        for (const auto& inputFile : inputFiles) {
+            char realFilePath[PATH_MAX];
+            if (!IsTraceFilePathLegal(inputFile, realFilePath, sizeof(realFilePath))) {
+                HILOG_ERROR(LOG_CORE, "MergeTraceFiles: illegal input file %{public}s.", inputFile.c_str());
+                ret.errorCode = FILE_ERROR;
+                return ret;
+            }
+            auto it = std::find_if(g_traceFileVec.begin(), g_traceFileVec.end(),
+                [&inputFile](const TraceFileInfo& file) { return file.filename == inputFile; });
+            if (it != g_traceFileVec.end()) {
+                inputFileInfos.push_back(*it);
+            }
+        }
+    }
+    std::string outputFile = GenerateMergedTraceFileName(inputFileInfos, outputPath);
+    if (outputFile.empty() || !TraceFileMerger(inputFiles).MergeTo(outputFile)) {
+        ret.errorCode = FILE_ERROR;
+        return ret;
+    }
+    struct stat fileStat {};
+    if (stat(outputFile.c_str(), &fileStat) != 0) {
+        HILOG_ERROR(LOG_CORE, "MergeTraceFiles: stat %{public}s failed, errno: %{public}d.", outputFile.c_str(), errno);
+        ret.errorCode = FILE_ERROR;
+        return ret;
+    }
+    // ageing orders the tracked files by ctime, a merged file without one would be removed first.
+    TraceFileInfo mergedFile(outputFile, fileStat.st_ctime, static_cast<int64_t>(fileStat.st_size), true);
+    if (!inputFileInfos.empty()) {
+        mergedFile.traceStartTime = inputFileInfos.front().traceStartTime;
+        mergedFile.traceEndTime = inputFileInfos.front().traceEndTime;
+        for (const auto& file : inputFileInfos) {
+            mergedFile.traceStartTime = std::min(mergedFile.traceStartTime, file.traceStartTime);
+            mergedFile.traceEndTime = std::max(mergedFile.traceEndTime, file.traceEndTime);
+        }
+        ret.coverDuration = static_cast<int32_t>(mergedFile.traceEndTime - mergedFile.traceStartTime);
+    }
+    if (outputPath.empty()) {
+        // files in the hitrace directory that are not tracked in g_traceFileVec are removed by ageing.
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        g_traceFileVec.push_back(mergedFile);
+    }
+    ret.errorCode = SUCCESS;
+    ret.outputFiles.push_back(outputFile);
+    ret.fileSize = mergedFile.fileSize;
+    HILOG_INFO(LOG_CORE, "MergeTraceFiles: %{public}zu files merged into %{public}s, size: %{public}" PRId64 ".",
+        inputFiles.size(), outputFile.c_str(), mergedFile.fileSize);
+    return ret;
+}
+
 TraceErrorCode RecordTraceOn(const std::string& outputPath)
 {
     std::lock_guard<std::mutex> lock(g_traceMutex);
@@ -1742,19 +1901,68 @@ TraceRetInfo RecordTraceOff()
     return ret;
 }
 
-TraceErrorCode CloseTrace()
+TraceErrorCode SubscribeTraceEvents(const TraceEventFilter& filter, TraceEventCallback callback)
 {
     std::lock_guard<std::mutex> lock(g_traceMutex);
     TraceErrorCode bootGate = SUCCESS;
-    if (BootTraceArbShouldReturnLocked(true, &bootGate)) {
+    if (BootTraceArbShouldReturnLocked(false, &bootGate)) {
         return bootGate;
     }
-    HILOG_INFO(LOG_CORE, "CloseTrace start.");
-    if (g_traceMode == TraceMode::CLOSE) {
-        HILOG_INFO(LOG_CORE, "Trace has already been closed.");
-        return SUCCESS;
+    // trace_pipe_raw is consumed by the subscription, it cannot share the ring buffer with other readers
+    if (g_traceMode != TraceMode::OPEN) {
+        HILOG_ERROR(LOG_CORE, "SubscribeTraceEvents: WRONG_TRACE_MODE, current trace mode: %{public}u.",
+            static_cast<uint32_t>(g_traceMode));
+        return WRONG_TRACE_MODE;
+    }
+    TraceErrorCode ret = TraceEventSubscriber::GetInstance().Start(filter, std::move(callback));
+    if (ret != SUCCESS) {
+        HILOG_ERROR(LOG_CORE, "SubscribeTraceEvents: start subscriber failed, ret: %{public}d.", ret);
+        return ret;
+    }
+    HILOG_INFO(LOG_CORE, "Subscribing trace events on.");
+    g_traceMode |= TraceMode::SUBSCRIBE;
+    return SUCCESS;
+}
+
+TraceErrorCode UnsubscribeTraceEvents()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        TraceErrorCode bootGate = SUCCESS;
+        if (BootTraceArbShouldReturnLocked(false, &bootGate)) {
+            return bootGate;
+        }
+        if (!IsSubscribeOn()) {
+            HILOG_ERROR(LOG_CORE, "UnsubscribeTraceEvents: The current state is %{public}u, data exception.",
+                static_cast<uint32_t>(g_traceMode));
+            return WRONG_TRACE_MODE;
+        }
+        TraceEventSubscriber::GetInstance().RequestStop();
+        g_traceMode &= ~TraceMode::SUBSCRIBE;
+    }
+    // the callback may be inside another dump API, joining under g_traceMutex would deadlock with it
+    TraceEventSubscriber::GetInstance().Join();
+    HILOG_INFO(LOG_CORE, "Subscribing trace events off.");
+    return SUCCESS;
+}
+
+TraceErrorCode CloseTrace()
+{
+    TraceErrorCode pipeRet = SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        TraceErrorCode bootGate = SUCCESS;
+        if (BootTraceArbShouldReturnLocked(true, &bootGate)) {
+            return bootGate;
+        }
+        HILOG_INFO(LOG_CORE, "CloseTrace start.");
+        if (g_traceMode == TraceMode::CLOSE) {
+            HILOG_INFO(LOG_CORE, "Trace has already been closed.");
+            return SUCCESS;
+        }
+        pipeRet = ResetTracePipelineLocked();
     }
-    TraceErrorCode pipeRet = ResetTracePipelineLocked();
+    TraceEventSubscriber::GetInstance().Join();
     HILOG_INFO(LOG_CORE, "CloseTrace done.");
     return pipeRet;
 }
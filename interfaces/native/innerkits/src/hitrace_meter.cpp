@@ -22,16 +22,19 @@
 #include <climits>
 #include <ctime>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
 #include <functional>
 #include <linux/perf_event.h>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <sched.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <thread>
 #include <vector>
@@ -43,6 +46,9 @@
 #include "param/sys_param.h"
 #include "parameters.h"
 #include "smart_fd.h"
+#include "trace_control_page.h"
+#include "trace_counter_coalescer.h"
+#include "trace_rate_limiter.h"
 #include "hitrace/tracechain.h"
 
 #ifdef LOG_DOMAIN
@@ -64,6 +70,10 @@ std::once_flag g_onceWriteMarkerFailedFlag;
 std::atomic<CachedHandle> g_cachedHandle;
 std::atomic<CachedHandle> g_appPidCachedHandle;
 std::atomic<CachedHandle> g_levelThresholdCachedHandle;
+std::atomic<CachedHandle> g_rateLimitCachedHandle;
+std::atomic<const Hitrace::TraceControlPage*> g_controlPage(nullptr);
+std::atomic<uint64_t> g_controlGeneration(0);
+std::atomic<uint64_t> g_controlCheckNs(0);
 
 std::atomic<bool> g_isHitraceMeterDisabled(false);
 std::atomic<bool> g_isHitraceMeterInit(false);
@@ -72,6 +82,8 @@ std::atomic<uint64_t> g_tagsProperty(HITRACE_TAG_NOT_READY);
 std::atomic<uint64_t> g_appTag(HITRACE_TAG_NOT_READY);
 std::atomic<int64_t> g_appTagMatchPid(-1);
 std::atomic<HiTraceOutputLevel> g_levelThreshold(HITRACE_LEVEL_MAX);
+Hitrace::TraceRateLimiter g_rateLimiter;
+Hitrace::TraceCounterCoalescer g_counterCoalescer;
 
 constexpr char SANDBOX_PATH[] = "/data/storage/el2/log/";
 constexpr char PHYSICAL_PATH[] = "/data/app/el2/100/log/";
@@ -90,6 +102,13 @@ constexpr int CPU_CORE_NUM = 16;
 constexpr int DEFAULT_CACHE_SIZE = 32 * 1024;
 constexpr int MAX_FILE_SIZE = 500 * 1024 * 1024;
 constexpr int NS_TO_MS = 1000;
+constexpr int SUPPRESSED_NAME_SIZE = 32;
+constexpr size_t COALESCED_BATCH_SIZE = 32;
+constexpr uint64_t NS_PER_US = 1000;
+// an unchanged counter is still written once a second, a trace that wrapped its ring buffer gets it back
+constexpr uint64_t COUNTER_MAX_SUPPRESS_NS = 1000000000;
+// a parameter set without a publish to the control page is seen about 100 ms later at most
+constexpr uint64_t CONTROL_RECHECK_NS = 100 * MS_TO_NS;
 int g_tgid = -1;
 uint64_t g_traceEventNum = 0;
 int g_writeOffset = 0;
@@ -108,8 +127,8 @@ constexpr int32_t INVALID_INDEX = -2;
 constexpr int32_t INDEX_NOT_REGISTERED = -1;
 constexpr int32_t SUCCESS_UNREGISTER = 0;
 
-constexpr char MARK_TYPES[] = {'B', 'E', 'S', 'F', 'C'};
-enum MarkerType { MARKER_BEGIN, MARKER_END, MARKER_ASYNC_BEGIN, MARKER_ASYNC_END, MARKER_INT };
+constexpr char MARK_TYPES[] = {'B', 'E', 'S', 'F', 'C', 'M'};
+enum MarkerType { MARKER_BEGIN, MARKER_END, MARKER_ASYNC_BEGIN, MARKER_ASYNC_END, MARKER_INT, MARKER_INT_BATCH };
 constexpr char TRACE_LEVEL[] = {'D', 'I', 'C', 'M'};
 
 constexpr uint64_t VALID_TAGS = HITRACE_TAG_FFRT | HITRACE_TAG_COMMONLIBRARY | HITRACE_TAG_HDF | HITRACE_TAG_NET |
@@ -144,6 +163,7 @@ struct TraceMarker {
     const char* customArgs;
     const HiTraceIdStruct* hiTraceIdStruct = nullptr;
     int pid = -1;
+    const HiTraceCounter* counters = nullptr; // MARKER_INT_BATCH only, value is the number of counters
 };
 
 enum class HiTraceCallbackType {
@@ -267,23 +287,37 @@ inline void AddCharToBuffer(char*& dst, const char* end, char value)
     }
 }
 
+// "00" to "ff", one lookup formats a byte
+struct HexBytePairs {
+    char pairs[512]; // 512 : 256 bytes of two digits
+    constexpr HexBytePairs() : pairs()
+    {
+        constexpr int byteCount = 256;
+        constexpr int hexDigitBitWidth = 4;
+        constexpr int hexDigitMask = 0xf;
+        for (int i = 0; i < byteCount; i++) {
+            pairs[i * 2] = NUM_TO_CHAR_MAPS[i >> hexDigitBitWidth]; // 2 : digits per byte
+            pairs[i * 2 + 1] = NUM_TO_CHAR_MAPS[i & hexDigitMask]; // 2 : digits per byte
+        }
+    }
+};
+constexpr HexBytePairs HEX_BYTE_PAIRS;
+
 inline void AddUInt64HexValueToBuffer(char*& dst, const char* end, uint64_t value)
 {
-    if (value == 0) {
-        AddCharToBuffer(dst, end, '0');
-        return;
-    }
-    constexpr auto maxLength = 16;
+    // all 16 digits are formatted with a fixed trip count, the leading zeros are cut by the bit length
+    constexpr int maxLength = 16;
+    constexpr int byteBitWidth = 8;
+    constexpr uint64_t byteMask = 0xff;
     char buff[maxLength];
-    const auto endPointer = buff + maxLength;
-    auto startPointer = buff + maxLength - 1;
-    while (value > 0) {
-        constexpr uint32_t kHexDigitMask = 0xf;
-        *startPointer-- = NUM_TO_CHAR_MAPS[value & kHexDigitMask];
-        constexpr uint32_t kHexDigitBitWidth = 4;
-        value >>= kHexDigitBitWidth;
+    for (int i = 0; i < maxLength / 2; i++) { // 2 : digits per byte
+        const char* pair = HEX_BYTE_PAIRS.pairs + ((value >> ((maxLength / 2 - 1 - i) * byteBitWidth)) & byteMask) * 2;
+        buff[i * 2] = pair[0]; // 2 : digits per byte
+        buff[i * 2 + 1] = pair[1]; // 2 : digits per byte
     }
-    AddStringToBuffer(dst, end, startPointer + 1, endPointer - startPointer - 1);
+    // value | 1 keeps a single '0' for zero
+    int digits = (64 - __builtin_clzll(value | 1) + 3) / 4; // 64 : bits of value, 3, 4 : round up to hex digits
+    AddStringToBuffer(dst, end, buff + maxLength - digits, static_cast<size_t>(digits));
 }
 
 inline void AddUInt32DecValueToBuffer(char*& dst, const char* end, uint32_t value)
@@ -355,15 +389,21 @@ inline void CreateCacheHandle()
     if (g_levelThresholdCachedHandle == nullptr) {
         g_levelThresholdCachedHandle = CachedParameterCreate(TRACE_LEVEL_THRESHOLD, devValue);
     }
+    if (g_rateLimitCachedHandle == nullptr) {
+        g_rateLimitCachedHandle = CachedParameterCreate(TRACE_TAG_RATE_LIMIT, "");
+    }
 }
 
-static void UpdateSysParamTags()
+void WritePendingSuppressedReport(const Hitrace::SuppressedReport& report);
+
+// Returns true if any of the parameters changed.
+static bool RefreshSysParamTags()
 {
     // Get the system parameters of TRACE_TAG_ENABLE_FLAGS.
     if (UNEXPECTANTLY(g_cachedHandle == nullptr || g_appPidCachedHandle == nullptr ||
-        g_levelThresholdCachedHandle == nullptr)) {
+        g_levelThresholdCachedHandle == nullptr || g_rateLimitCachedHandle == nullptr)) {
         CreateCacheHandle();
-        return;
+        return false;
     }
 
     int changed = 0;
@@ -371,7 +411,7 @@ static void UpdateSysParamTags()
     if (UNEXPECTANTLY(changed == 1) && paramValue != nullptr) {
         uint64_t tags = 0;
         if (!OHOS::HiviewDFX::Hitrace::StringToUint64(paramValue, tags)) {
-            return;
+            return true;
         }
         uint64_t targetTags = (tags | HITRACE_TAG_ALWAYS) & HITRACE_TAG_VALID_MASK;
         uint64_t currentTags = g_tagsProperty.load();
@@ -379,6 +419,8 @@ static void UpdateSysParamTags()
             uint64_t oldTags = g_tagsProperty.load() | g_appTag.load();
             bool exchanged = g_tagsProperty.compare_exchange_strong(currentTags, targetTags);
             if (exchanged) {
+                // a trace starting now has not seen the last values of the coalesced counters
+                g_counterCoalescer.Invalidate();
                 uint64_t newTags = g_tagsProperty.load() | g_appTag.load();
                 HandleAppTagChange(oldTags, newTags);
             }
@@ -389,7 +431,7 @@ static void UpdateSysParamTags()
     if (UNEXPECTANTLY(appPidChanged == 1) && paramPid != nullptr) {
         int64_t appTagMatchPid = -1;
         if (!OHOS::HiviewDFX::Hitrace::StringToInt64(paramPid, appTagMatchPid)) {
-            return;
+            return true;
         }
         g_appTagMatchPid = appTagMatchPid;
     }
@@ -398,10 +440,68 @@ static void UpdateSysParamTags()
     if (UNEXPECTANTLY(levelThresholdChanged == 1) && paramLevel != nullptr) {
         int64_t levelThreshold = 0;
         if (!OHOS::HiviewDFX::Hitrace::StringToInt64(paramLevel, levelThreshold)) {
-            return;
+            return true;
         }
         g_levelThreshold = static_cast<HiTraceOutputLevel>(levelThreshold);
     }
+    int rateLimitChanged = 0;
+    const char* paramRateLimit = CachedParameterGetChanged(g_rateLimitCachedHandle, &rateLimitChanged);
+    if (UNEXPECTANTLY(rateLimitChanged == 1) && paramRateLimit != nullptr) {
+        g_rateLimiter.Configure(paramRateLimit, Hitrace::GetCurBootTime(), WritePendingSuppressedReport);
+    }
+    return changed == 1 || appPidChanged == 1 || levelThresholdChanged == 1 || rateLimitChanged == 1;
+}
+
+// The generation is snapshotted here, so the parameters must be read after a successful map: a publish landing
+// between an earlier read and the map would otherwise look already seen.
+static bool MapControlPage()
+{
+    const Hitrace::TraceControlPage* page = Hitrace::MapTraceControlPage();
+    if (page == nullptr) {
+        return false;
+    }
+    g_controlGeneration.store(page->generation.load(std::memory_order_acquire), std::memory_order_relaxed);
+    const Hitrace::TraceControlPage* expected = nullptr;
+    if (!g_controlPage.compare_exchange_strong(expected, page)) {
+        munmap(const_cast<Hitrace::TraceControlPage*>(page), PAGE_SIZE);
+    }
+    return true;
+}
+
+// the coarse clock is read from the vdso without touching the pmu or the tsc
+static inline uint64_t GetCoarseTimeNs()
+{
+    struct timespec ts = { 0, 0 };
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * S_TO_NS + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+static void UpdateSysParamTags()
+{
+    // Publishers bump the control page generation after setting a parameter, so the common case is one relaxed
+    // load and compare plus a coarse clock read; without the page every call checks the parameters.
+    const Hitrace::TraceControlPage* page = g_controlPage.load(std::memory_order_relaxed);
+    if (EXPECTANTLY(page != nullptr)) {
+        uint64_t generation = page->generation.load(std::memory_order_relaxed);
+        if (EXPECTANTLY(generation == g_controlGeneration.load(std::memory_order_relaxed))) {
+            // a bare "param set" does not publish, the parameters are still checked now and then
+            uint64_t now = GetCoarseTimeNs();
+            if (EXPECTANTLY(now - g_controlCheckNs.load(std::memory_order_relaxed) < CONTROL_RECHECK_NS)) {
+                return;
+            }
+            g_controlCheckNs.store(now, std::memory_order_relaxed);
+            RefreshSysParamTags();
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        g_controlGeneration.store(generation, std::memory_order_relaxed);
+        RefreshSysParamTags();
+        return;
+    }
+    // the page is created at boot but sized by the first publisher, retry only when something was published
+    if (RefreshSysParamTags() && g_isHitraceMeterInit && MapControlPage()) {
+        RefreshSysParamTags();
+    }
 }
 
 // open file "trace_marker".
@@ -422,10 +522,14 @@ void OpenTraceMarkerFile()
             return;
         }
     }
+    // snapshot the generation first, a publish racing the reads below is then seen by the next trace call
+    MapControlPage();
     // get tags, level threshold and pid
     g_tagsProperty = OHOS::system::GetUintParameter<uint64_t>(TRACE_TAG_ENABLE_FLAGS, 0);
     g_levelThreshold = static_cast<HiTraceOutputLevel>(OHOS::system::GetIntParameter<int>(TRACE_LEVEL_THRESHOLD,
         HITRACE_LEVEL_MAX, HITRACE_LEVEL_DEBUG, HITRACE_LEVEL_COMMERCIAL));
+    g_rateLimiter.Configure(OHOS::system::GetParameter(TRACE_TAG_RATE_LIMIT, "").c_str(),
+        Hitrace::GetCurBootTime());
     CreateCacheHandle();
 
     g_isHitraceMeterInit = true;
@@ -443,6 +547,14 @@ __attribute__((destructor)) static void LibraryUnload()
 
     CachedParameterDestroy(g_levelThresholdCachedHandle);
     g_levelThresholdCachedHandle = nullptr;
+
+    CachedParameterDestroy(g_rateLimitCachedHandle);
+    g_rateLimitCachedHandle = nullptr;
+
+    const Hitrace::TraceControlPage* page = g_controlPage.exchange(nullptr);
+    if (page != nullptr) {
+        munmap(const_cast<Hitrace::TraceControlPage*>(page), PAGE_SIZE);
+    }
 }
 
 __attribute__((always_inline)) bool PrepareTraceMarker()
@@ -785,6 +897,16 @@ bool CheckFileSize(int len)
 
 void WriteAppTrace(const TraceMarker& traceMarker)
 {
+    if (traceMarker.type == MARKER_INT_BATCH) {
+        // the app trace file is written in user space, it takes the counters one by one
+        for (int64_t i = 0; i < traceMarker.value; i++) {
+            const HiTraceCounter& item = traceMarker.counters[i];
+            TraceMarker counter = {MARKER_INT, traceMarker.level, traceMarker.tag, item.value,
+                (item.name != nullptr) ? item.name : EMPTY, EMPTY, EMPTY, nullptr, traceMarker.pid};
+            WriteAppTrace(counter);
+        }
+        return;
+    }
     int tid = getproctid();
     int len = PREFIX_MAX_SIZE + strlen(traceMarker.name) + strlen(traceMarker.customArgs) +
               strlen(traceMarker.customCategory);
@@ -820,18 +942,19 @@ void WriteAppTrace(const TraceMarker& traceMarker)
 
 inline void WriteHitraceId(TraceMarker& traceMarker, char*& dst, const char* end)
 {
-    HiTraceId hiTraceId = (traceMarker.hiTraceIdStruct == nullptr) ?
-                  HiTraceChain::GetId() :
-                  HiTraceId(*traceMarker.hiTraceIdStruct);
-    if (hiTraceId.IsValid()) {
-        StringUtil::AddCharToBuffer(dst, end, '[');
-        StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId.GetChainId());
-        StringUtil::AddCharToBuffer(dst, end, ',');
-        StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId.GetSpanId());
-        StringUtil::AddCharToBuffer(dst, end, ',');
-        StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId.GetParentSpanId());
-        StringUtil::AddStringToBuffer(dst, end, "]#");
+    // the thread id is read in place, most markers carry no chain and stop at the valid bit
+    const HiTraceIdStruct* hiTraceId = (traceMarker.hiTraceIdStruct == nullptr) ?
+        HiTraceChainGetIdAddress() : traceMarker.hiTraceIdStruct;
+    if (EXPECTANTLY(!HiTraceChainIsValid(hiTraceId))) {
+        return;
     }
+    StringUtil::AddCharToBuffer(dst, end, '[');
+    StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId->chainId);
+    StringUtil::AddCharToBuffer(dst, end, ',');
+    StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId->spanId);
+    StringUtil::AddCharToBuffer(dst, end, ',');
+    StringUtil::AddUInt64HexValueToBuffer(dst, end, hiTraceId->parentSpanId);
+    StringUtil::AddStringToBuffer(dst, end, "]#");
 }
 
 int WriteSyncBeginRecord(TraceMarker& traceMarker, const char* bitStr,
@@ -913,6 +1036,44 @@ int WriteOtherTypeRecord(TraceMarker& traceMarker, const char* bitStr,
     return static_cast<int>(dataOffset - dstBufferStart);
 }
 
+// "M|pid|level tags|name|value|name|value...", the counters that overflow one record go on in the next
+void WriteCounterBatchRecords(TraceMarker& traceMarker, const char* bitStr)
+{
+    char record[RECORD_SIZE_MAX];
+    const char* const bufferEnd = record + RECORD_SIZE_MAX;
+    const auto count = static_cast<size_t>(traceMarker.value);
+    size_t index = 0;
+    while (index < count) {
+        auto dataOffset = record;
+        StringUtil::AddStringToBuffer(dataOffset, bufferEnd, "M|");
+        StringUtil::AddUInt32DecValueToBuffer(dataOffset, bufferEnd, static_cast<uint32_t>(traceMarker.pid));
+        StringUtil::AddCharToBuffer(dataOffset, bufferEnd, '|');
+        StringUtil::AddCharToBuffer(dataOffset, bufferEnd, TRACE_LEVEL[traceMarker.level]);
+        StringUtil::AddStringToBuffer(dataOffset, bufferEnd, bitStr);
+        const char* const headerEnd = dataOffset;
+        for (; index < count; index++) {
+            const HiTraceCounter& counter = traceMarker.counters[index];
+            auto itemStart = dataOffset;
+            StringUtil::AddCharToBuffer(dataOffset, bufferEnd, '|');
+            StringUtil::AddStringToBuffer(dataOffset, bufferEnd, (counter.name != nullptr) ? counter.name : EMPTY);
+            StringUtil::AddCharToBuffer(dataOffset, bufferEnd, '|');
+            StringUtil::AddInt64DecValue(dataOffset, bufferEnd, counter.value);
+            if (dataOffset < bufferEnd) {
+                continue;
+            }
+            if (itemStart == headerEnd) {
+                // a counter longer than a record is written truncated, like a single counter record
+                HILOG_DEBUG(LOG_CORE, "Trace record buffer may be truncated");
+                index++;
+            } else {
+                dataOffset = itemStart;
+            }
+            break;
+        }
+        WriteToTraceMarker(record, static_cast<int>(dataOffset - record));
+    }
+}
+
 void SetNullptrToEmpty(TraceMarker& traceMarker)
 {
     if (traceMarker.name == nullptr) {
@@ -926,7 +1087,101 @@ void SetNullptrToEmpty(TraceMarker& traceMarker)
     }
 }
 
-void AddHitraceMeterMarker(TraceMarker& traceMarker)
+void WriteTraceMarkerRecord(TraceMarker& traceMarker)
+{
+    char record[RECORD_SIZE_MAX];
+    const char* const bufferEnd = record + RECORD_SIZE_MAX;
+    constexpr int bitStrSize = 7;
+    char bitStr[bitStrSize] = {0};
+    ParseTagBits(traceMarker.tag, bitStr, bitStrSize);
+    if (traceMarker.type == MARKER_INT_BATCH) {
+        WriteCounterBatchRecords(traceMarker, bitStr);
+        return;
+    }
+    int dataSize = 0;
+    if (traceMarker.type == MARKER_BEGIN) {
+        dataSize = WriteSyncBeginRecord(traceMarker, bitStr, record, bufferEnd);
+    } else if (traceMarker.type == MARKER_END) {
+        dataSize = WriteSyncEndRecord(traceMarker, bitStr, record, bufferEnd);
+    } else if (traceMarker.type == MARKER_ASYNC_BEGIN) {
+        dataSize = WriteAsyncBeginRecord(traceMarker, bitStr, record, bufferEnd);
+    } else {
+        dataSize = WriteOtherTypeRecord(traceMarker, bitStr, record, bufferEnd);
+    }
+    if (dataSize == RECORD_SIZE_MAX) {
+        HILOG_DEBUG(LOG_CORE, "Trace record buffer may be truncated");
+    }
+    WriteToTraceMarker(record, dataSize);
+}
+
+// the cumulative drop count of the tag, at most once a second and never limited itself
+void WriteSuppressedReport(const Hitrace::SuppressedReport& report, const HiTraceOutputLevel level, const int pid)
+{
+    char name[SUPPRESSED_NAME_SIZE] = {0};
+    if (snprintf_s(name, sizeof(name), sizeof(name) - 1, "hitrace_suppressed_%d", __builtin_ctzll(report.tag)) > 0) {
+        TraceMarker counter = {MARKER_INT, level, report.tag, static_cast<int64_t>(report.suppressed), name, EMPTY,
+            EMPTY, nullptr, pid};
+        WriteTraceMarkerRecord(counter);
+    }
+}
+
+// the drops of the limits being replaced, reported from the parameter refresh
+void WritePendingSuppressedReport(const Hitrace::SuppressedReport& report)
+{
+    WriteSuppressedReport(report, HITRACE_LEVEL_INFO, getprocpid());
+}
+
+// The limiter only guards the trace_marker write, a dropped marker still reaches the app trace.
+bool AdmitRateLimitedMarker(const TraceMarker& traceMarker)
+{
+    Hitrace::SuppressedReport report;
+    bool admit = g_rateLimiter.Admit(MARK_TYPES[traceMarker.type], traceMarker.tag, traceMarker.name,
+        traceMarker.value, Hitrace::GetCurBootTime(), report);
+    if (UNEXPECTANTLY(report.tag != 0)) {
+        WriteSuppressedReport(report, traceMarker.level, traceMarker.pid);
+    }
+    return admit;
+}
+
+void WriteMarkerToKernel(TraceMarker& traceMarker)
+{
+    if (EXPECTANTLY((traceMarker.tag & g_rateLimiter.GetLimitedTags()) == 0) ||
+        AdmitRateLimitedMarker(traceMarker)) {
+        WriteTraceMarkerRecord(traceMarker);
+    }
+}
+
+void WriteHeldCounter(const Hitrace::HeldCounter& counter);
+
+// Drops the counters repeating their last value, a batch writes its changed counters in chunks.
+void WriteCoalescedCounters(TraceMarker& traceMarker)
+{
+    uint64_t now = g_counterCoalescer.NeedsTime() ? Hitrace::GetCurBootTime() : 0;
+    if (traceMarker.type == MARKER_INT) {
+        if (g_counterCoalescer.Admit(traceMarker.tag, traceMarker.name, traceMarker.value, traceMarker.level, now)) {
+            WriteMarkerToKernel(traceMarker);
+        }
+        g_counterCoalescer.ReleaseDue(now, WriteHeldCounter);
+        return;
+    }
+    HiTraceCounter kept[COALESCED_BATCH_SIZE];
+    size_t keptCount = 0;
+    for (int64_t i = 0; i < traceMarker.value; i++) {
+        const HiTraceCounter& item = traceMarker.counters[i];
+        if (g_counterCoalescer.Admit(traceMarker.tag, item.name, item.value, traceMarker.level, now)) {
+            kept[keptCount++] = item;
+        }
+        if (keptCount == COALESCED_BATCH_SIZE || (i == traceMarker.value - 1 && keptCount > 0)) {
+            TraceMarker batch = {MARKER_INT_BATCH, traceMarker.level, traceMarker.tag, static_cast<int64_t>(keptCount),
+                EMPTY, EMPTY, EMPTY, nullptr, traceMarker.pid, kept};
+            WriteMarkerToKernel(batch);
+            keptCount = 0;
+        }
+    }
+    g_counterCoalescer.ReleaseDue(now, WriteHeldCounter);
+}
+
+void AddHitraceMeterMarker(TraceMarker& traceMarker, bool coalesce = true)
 {
     if (traceMarker.level < HITRACE_LEVEL_DEBUG || traceMarker.level > HITRACE_LEVEL_MAX || !PrepareTraceMarker()) {
         return;
@@ -941,25 +1196,13 @@ void AddHitraceMeterMarker(TraceMarker& traceMarker)
             (traceMarker.tag == HITRACE_TAG_APP && g_appTagMatchPid > 0 && g_appTagMatchPid != traceMarker.pid)) {
             return;
         }
-        char record[RECORD_SIZE_MAX];
-        const char* const bufferEnd = record + RECORD_SIZE_MAX;
-        constexpr int bitStrSize = 7;
-        char bitStr[bitStrSize] = {0};
-        ParseTagBits(traceMarker.tag, bitStr, bitStrSize);
-        int dataSize = 0;
-        if (traceMarker.type == MARKER_BEGIN) {
-            dataSize = WriteSyncBeginRecord(traceMarker, bitStr, record, bufferEnd);
-        } else if (traceMarker.type == MARKER_END) {
-            dataSize = WriteSyncEndRecord(traceMarker, bitStr, record, bufferEnd);
-        } else if (traceMarker.type == MARKER_ASYNC_BEGIN) {
-            dataSize = WriteAsyncBeginRecord(traceMarker, bitStr, record, bufferEnd);
+        // like the limiter, the coalescing only spares the ring buffer, the app trace keeps every counter
+        if (UNEXPECTANTLY(g_counterCoalescer.IsEnabled()) && coalesce &&
+            (traceMarker.type == MARKER_INT || traceMarker.type == MARKER_INT_BATCH)) {
+            WriteCoalescedCounters(traceMarker);
         } else {
-            dataSize = WriteOtherTypeRecord(traceMarker, bitStr, record, bufferEnd);
+            WriteMarkerToKernel(traceMarker);
         }
-        if (dataSize == RECORD_SIZE_MAX) {
-            HILOG_DEBUG(LOG_CORE, "Trace record buffer may be truncated");
-        }
-        WriteToTraceMarker(record, dataSize);
     }
     auto appTagload = g_appTag.load();
 #ifdef HITRACE_UNITTEST
@@ -972,6 +1215,13 @@ void AddHitraceMeterMarker(TraceMarker& traceMarker)
         WriteAppTrace(traceMarker);
     }
 }
+
+void WriteHeldCounter(const Hitrace::HeldCounter& counter)
+{
+    TraceMarker traceMarker = {MARKER_INT, static_cast<HiTraceOutputLevel>(counter.level), counter.tag, counter.value,
+        counter.name, EMPTY, EMPTY};
+    AddHitraceMeterMarker(traceMarker, false);
+}
 }; // namespace
 
 #ifdef HITRACE_UNITTEST
@@ -986,8 +1236,11 @@ void SetCachedHandle(const char* name, CachedHandle cachedHandle)
     } else if (strcmp(name, "g_levelThresholdCachedHandle") == 0) {
         CachedParameterDestroy(g_levelThresholdCachedHandle);
         g_levelThresholdCachedHandle = cachedHandle;
+    } else if (strcmp(name, "g_rateLimitCachedHandle") == 0) {
+        CachedParameterDestroy(g_rateLimitCachedHandle);
+        g_rateLimitCachedHandle = cachedHandle;
     }
-    UpdateSysParamTags();
+    RefreshSysParamTags();
 }
 
 void SetMarkerFd(int markerFd)
@@ -1410,6 +1663,40 @@ void CountTraceEx(HiTraceOutputLevel level, uint64_t tag, const char* name, int6
     AddHitraceMeterMarker(traceMarker);
 }
 
+void CountTraceBatch(uint64_t tag, const HiTraceCounter* counters, size_t count)
+{
+    CountTraceBatchEx(HITRACE_LEVEL_INFO, tag, counters, count);
+}
+
+void CountTraceBatchEx(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count)
+{
+    if (counters == nullptr || count == 0 || count > static_cast<size_t>(INT64_MAX)) {
+        return;
+    }
+    TraceMarker traceMarker = {MARKER_INT_BATCH, level, tag, static_cast<int64_t>(count), EMPTY, EMPTY, EMPTY};
+    traceMarker.counters = counters;
+    AddHitraceMeterMarker(traceMarker);
+}
+
+void SetCounterCoalescing(bool enable, uint64_t minIntervalUs)
+{
+    if (enable) {
+        // Registered after the globals of the library were constructed, so it runs before their destructors at
+        // exit and the marker fd is still open; a library destructor runs after them on musl.
+        static std::once_flag flushAtExitOnce;
+        std::call_once(flushAtExitOnce, [] { (void)atexit(FlushCounterTrace); });
+    }
+    g_counterCoalescer.Configure(enable, minIntervalUs * NS_PER_US, COUNTER_MAX_SUPPRESS_NS);
+    if (!enable) {
+        FlushCounterTrace();
+    }
+}
+
+void FlushCounterTrace()
+{
+    g_counterCoalescer.Flush(WriteHeldCounter);
+}
+
 void CountTraceDebug(bool isDebug, uint64_t tag, const std::string& name, int64_t count)
 {
     if (!isDebug) {
@@ -1476,6 +1763,19 @@ bool IsTagEnabled(uint64_t tag)
     return ((tag & g_tagsProperty) == tag);
 }
 
+// Declared in hitrace_meter_wrapper.h, lets the chain tracepoints skip formatting a marker nobody takes.
+extern "C" bool IsTraceChainPointEnabled(void)
+{
+    if (!PrepareTraceMarker()) {
+        return false;
+    }
+    if ((g_tagsProperty & HITRACE_TAG_OHOS) != 0) {
+        return true;
+    }
+    uint64_t appTag = g_appTag.load();
+    return appTag != HITRACE_TAG_NOT_READY && g_appFd && (appTag & HITRACE_TAG_OHOS) != 0;
+}
+
 static void ResetGlobalStatus()
 {
     g_appFd.Reset();
@@ -1600,6 +1900,195 @@ int StopCaptureAppTrace()
     return RET_SUCC;
 }
 
+namespace {
+constexpr int PERF_COUNTER_NUM = 4;
+constexpr int PERF_SUFFIX_MAX_LEN = 16;
+
+struct PerfCounterDesc {
+    uint32_t flag;
+    uint64_t config;
+    const char* suffix;
+};
+
+constexpr PerfCounterDesc PERF_COUNTERS[PERF_COUNTER_NUM] = {
+    {HITRACE_PERF_INSTRUCTIONS, PERF_COUNT_HW_INSTRUCTIONS, "-Ins"},
+    {HITRACE_PERF_CPU_CYCLES, PERF_COUNT_HW_CPU_CYCLES, "-Cycle"},
+    {HITRACE_PERF_CACHE_MISSES, PERF_COUNT_HW_CACHE_MISSES, "-CacheMiss"},
+    {HITRACE_PERF_BRANCH_MISSES, PERF_COUNT_HW_BRANCH_MISSES, "-BranchMiss"},
+};
+
+#if defined(__aarch64__)
+constexpr uint64_t ARMV8_RDPMC_CONFIG1 = 1ULL << 1; // the "rdpmc" format bit of the armv8 pmu
+constexpr uint32_t ARMV8_CYCLE_COUNTER = 31;
+
+// the event counters past the first six fall back to read(), cores rarely have more
+inline bool ReadPmc(uint32_t counter, uint64_t& value)
+{
+    switch (counter) {
+        case 0: __asm__ volatile("mrs %0, pmevcntr0_el0" : "=r"(value)); return true;
+        case 1: __asm__ volatile("mrs %0, pmevcntr1_el0" : "=r"(value)); return true;
+        case 2: __asm__ volatile("mrs %0, pmevcntr2_el0" : "=r"(value)); return true;
+        case 3: __asm__ volatile("mrs %0, pmevcntr3_el0" : "=r"(value)); return true;
+        case 4: __asm__ volatile("mrs %0, pmevcntr4_el0" : "=r"(value)); return true;
+        case 5: __asm__ volatile("mrs %0, pmevcntr5_el0" : "=r"(value)); return true;
+        case ARMV8_CYCLE_COUNTER: __asm__ volatile("mrs %0, pmccntr_el0" : "=r"(value)); return true;
+        default: return false;
+    }
+}
+#elif defined(__x86_64__)
+inline bool ReadPmc(uint32_t counter, uint64_t& value)
+{
+    uint32_t low = 0;
+    uint32_t high = 0;
+    __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    value = (static_cast<uint64_t>(high) << 32) | low; // 32 : high half
+    return true;
+}
+#else
+inline bool ReadPmc(uint32_t, uint64_t&)
+{
+    return false;
+}
+#endif
+
+// The self-monitoring protocol of perf_event_mmap_page: the kernel offset plus the live pmc value, retried while
+// the kernel moves the counter. False if the counter is not on the pmu or user reads are not permitted.
+bool ReadMmapCounter(const perf_event_mmap_page* page, long long& value)
+{
+    if (page == nullptr) {
+        return false;
+    }
+    uint32_t seq = 0;
+    int64_t count = 0;
+    do {
+        seq = __atomic_load_n(&page->lock, __ATOMIC_ACQUIRE);
+        uint32_t index = page->index;
+        if (!page->cap_user_rdpmc || index == 0 || page->pmc_width == 0) {
+            return false;
+        }
+        uint64_t pmc = 0;
+        if (!ReadPmc(index - 1, pmc)) {
+            return false;
+        }
+        uint32_t shift = 64 - page->pmc_width; // 64 : sign extend the pmc_width bits
+        count = page->offset + (static_cast<int64_t>(pmc << shift) >> shift);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    } while (__atomic_load_n(&page->lock, __ATOMIC_ACQUIRE) != seq);
+    value = count;
+    return true;
+}
+
+// The counters of one thread, opened by its first scope and counting until the thread exits: a scope only reads
+// them twice instead of opening, resetting and closing its own events.
+class PerfThreadGroup {
+public:
+    ~PerfThreadGroup()
+    {
+        for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+            if (pages_[i] != nullptr) {
+                munmap(pages_[i], PAGE_SIZE);
+            }
+            if (fds_[i] != -1) {
+                close(fds_[i]);
+            }
+        }
+    }
+
+    // returns the requested counters that count, err is the errno of the first one that could not be opened
+    uint32_t Open(uint32_t counters, int& err)
+    {
+        for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+            if ((counters & PERF_COUNTERS[i].flag) != 0 && fds_[i] == -1 && errs_[i] == 0) {
+                OpenCounter(i);
+            }
+        }
+        for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+            if ((counters & PERF_COUNTERS[i].flag) != 0 && fds_[i] == -1) {
+                err = errs_[i];
+                break;
+            }
+        }
+        return counters & opened_;
+    }
+
+    bool Read(uint32_t counters, long long (&values)[PERF_COUNTER_NUM])
+    {
+        bool readAll = true;
+        for (int i = 0; i < PERF_COUNTER_NUM && readAll; i++) {
+            if ((counters & PERF_COUNTERS[i].flag) != 0) {
+                readAll = ReadMmapCounter(pages_[i], values[i]);
+            }
+        }
+        return readAll || ReadGroup(counters, values);
+    }
+
+private:
+    void OpenCounter(int index)
+    {
+        struct perf_event_attr attr;
+        if (memset_s(&attr, sizeof(attr), 0, sizeof(attr)) != EOK) {
+            errs_[index] = EINVAL;
+            return;
+        }
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNTERS[index].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 0;
+        attr.exclude_hv = 0;
+#if defined(__aarch64__)
+        attr.config1 = ARMV8_RDPMC_CONFIG1;
+#endif
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leaderFd_, 0);
+#if defined(__aarch64__)
+        if (fd == -1) {
+            attr.config1 = 0; // kernels without user access reject the bit
+            fd = syscall(__NR_perf_event_open, &attr, 0, -1, leaderFd_, 0);
+        }
+#endif
+        if (fd == -1) {
+            errs_[index] = errno;
+            return;
+        }
+        if (leaderFd_ == -1) {
+            leaderFd_ = fd;
+        }
+        fds_[index] = fd;
+        groupIndex_[index] = groupSize_++;
+        opened_ |= PERF_COUNTERS[index].flag;
+        void* page = mmap(nullptr, PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        pages_[index] = (page == MAP_FAILED) ? nullptr : static_cast<perf_event_mmap_page*>(page);
+    }
+
+    // one read of the whole group, the values come in the order the counters joined it
+    bool ReadGroup(uint32_t counters, long long (&values)[PERF_COUNTER_NUM])
+    {
+        uint64_t buffer[PERF_COUNTER_NUM + 1] = {0};
+        ssize_t size = read(leaderFd_, buffer, sizeof(buffer));
+        if (size < static_cast<ssize_t>(sizeof(uint64_t) * (groupSize_ + 1))) {
+            return false;
+        }
+        for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+            if ((counters & PERF_COUNTERS[i].flag) != 0) {
+                values[i] = static_cast<long long>(buffer[groupIndex_[i] + 1]);
+            }
+        }
+        return true;
+    }
+
+    int leaderFd_ = -1;
+    int groupSize_ = 0;
+    uint32_t opened_ = 0;
+    int fds_[PERF_COUNTER_NUM] = {-1, -1, -1, -1};
+    int errs_[PERF_COUNTER_NUM] = {0};
+    int groupIndex_[PERF_COUNTER_NUM] = {0};
+    perf_event_mmap_page* pages_[PERF_COUNTER_NUM] = {nullptr};
+};
+
+thread_local PerfThreadGroup t_perfGroup;
+
+} // namespace
+
 HitracePerfScoped::HitracePerfScoped(bool isDebug, uint64_t tag, const std::string& name) : mTag_(tag), mName_(name)
 {
     if (!isDebug) {
@@ -1659,6 +2148,258 @@ HitracePerfScoped::~HitracePerfScoped()
     }
 }
 
+HitracePerfCountersScoped::HitracePerfCountersScoped(bool isDebug, uint64_t tag, const std::string& name,
+    uint32_t counters) : mTag_(tag)
+{
+    static_assert(COUNTER_NUM == PERF_COUNTER_NUM, "one sample per counter");
+    if (!isDebug) {
+        return;
+    }
+    counters_ = t_perfGroup.Open(counters, err_);
+    if (counters_ == 0) {
+        return;
+    }
+    if (!t_perfGroup.Read(counters_, begin_)) {
+        err_ = errno;
+        counters_ = 0;
+        return;
+    }
+    mName_ = name;
+}
+
+HitracePerfCountersScoped::~HitracePerfCountersScoped()
+{
+    long long end[PERF_COUNTER_NUM] = {0};
+    if (counters_ == 0 || !t_perfGroup.Read(counters_, end)) {
+        return;
+    }
+    char name[NAME_NORMAL_LEN + PERF_SUFFIX_MAX_LEN] = {0};
+    for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+        if ((counters_ & PERF_COUNTERS[i].flag) == 0 ||
+            snprintf_s(name, sizeof(name), sizeof(name) - 1, "%s%s", mName_.c_str(), PERF_COUNTERS[i].suffix) < 0) {
+            continue;
+        }
+        TraceMarker traceMarker = {MARKER_INT, HITRACE_LEVEL_INFO, mTag_, end[i] - begin_[i], name, EMPTY, EMPTY};
+        AddHitraceMeterMarker(traceMarker);
+    }
+}
+
+long long HitracePerfCountersScoped::GetCount(HitracePerfCounter counter)
+{
+    long long values[PERF_COUNTER_NUM] = {0};
+    if ((counters_ & counter) == 0 || !t_perfGroup.Read(counter, values)) {
+        return err_;
+    }
+    for (int i = 0; i < PERF_COUNTER_NUM; i++) {
+        if (PERF_COUNTERS[i].flag == counter) {
+            return values[i] - begin_[i];
+        }
+    }
+    return err_;
+}
+
+namespace {
+constexpr size_t STATS_SLOTS = 64; // spans per thread, a power of 2
+constexpr size_t STATS_MAX_PROBES = 8;
+constexpr int STATS_MIN_SHIFT = 10; // the first bucket holds the spans below 1024 ns
+constexpr int STATS_SUB_BUCKET_BITS = 2; // 4 linear buckets per power of 2, about 25% precision
+constexpr int STATS_OCTAVES = 24; // up to 2^34 ns, the last bucket also takes the longer spans
+constexpr size_t STATS_BUCKETS = (STATS_OCTAVES << STATS_SUB_BUCKET_BITS) + 1;
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+std::atomic<bool> g_statsEnabled(false);
+
+// Written by the owner thread only, so the counters are plain load-store pairs; the atomics let a reader merge
+// them at any time. A slot is published by "used" after its key is set and the key never changes afterwards.
+struct alignas(CACHE_LINE_SIZE) TraceStatsSlot {
+    std::atomic<bool> used {false};
+    uint64_t tag = 0;
+    size_t hash = 0;
+    std::string name;
+    std::atomic<uint64_t> count {0};
+    std::atomic<uint64_t> totalNs {0};
+    std::atomic<uint64_t> maxNs {0};
+    std::atomic<uint32_t> buckets[STATS_BUCKETS] = {};
+};
+
+struct TraceStatsSum {
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t buckets[STATS_BUCKETS] = {};
+
+    void Add(const TraceStatsSlot& slot)
+    {
+        count += slot.count.load(std::memory_order_relaxed);
+        totalNs += slot.totalNs.load(std::memory_order_relaxed);
+        maxNs = std::max(maxNs, slot.maxNs.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < STATS_BUCKETS; i++) {
+            buckets[i] += slot.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+using TraceStatsKey = std::pair<uint64_t, std::string>;
+
+class TraceStatsTable;
+
+// live tables and the sums of the exited threads
+struct TraceStatsRegistry {
+    std::mutex mutex;
+    std::vector<TraceStatsTable*> tables;
+    std::map<TraceStatsKey, TraceStatsSum> retired;
+};
+
+// never destroyed, a thread may exit after the static destructors ran
+TraceStatsRegistry& GetStatsRegistry()
+{
+    static TraceStatsRegistry* registry = new TraceStatsRegistry();
+    return *registry;
+}
+
+class TraceStatsTable {
+public:
+    TraceStatsTable()
+    {
+        TraceStatsRegistry& registry = GetStatsRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.tables.push_back(this);
+    }
+
+    ~TraceStatsTable()
+    {
+        TraceStatsRegistry& registry = GetStatsRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        MergeTo(registry.retired);
+        registry.tables.erase(std::remove(registry.tables.begin(), registry.tables.end(), this),
+            registry.tables.end());
+    }
+
+    // nullptr once the probes run out, the span is then not counted
+    TraceStatsSlot* Find(uint64_t tag, const std::string& name)
+    {
+        size_t hash = std::hash<std::string>()(name);
+        for (size_t probe = 0; probe < STATS_MAX_PROBES; probe++) {
+            TraceStatsSlot& slot = slots_[(hash + probe) & (STATS_SLOTS - 1)];
+            if (!slot.used.load(std::memory_order_relaxed)) {
+                slot.tag = tag;
+                slot.hash = hash;
+                slot.name = name;
+                slot.used.store(true, std::memory_order_release);
+                return &slot;
+            }
+            if (slot.hash == hash && slot.tag == tag && slot.name == name) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    void MergeTo(std::map<TraceStatsKey, TraceStatsSum>& sums) const
+    {
+        for (const auto& slot : slots_) {
+            if (slot.used.load(std::memory_order_acquire)) {
+                sums[TraceStatsKey(slot.tag, slot.name)].Add(slot);
+            }
+        }
+    }
+
+private:
+    TraceStatsSlot slots_[STATS_SLOTS];
+};
+
+thread_local std::unique_ptr<TraceStatsTable> t_statsTable;
+
+size_t GetStatsBucket(uint64_t ns)
+{
+    if (ns < (1ULL << STATS_MIN_SHIFT)) {
+        return 0;
+    }
+    int octave = 63 - __builtin_clzll(ns); // 63 : index of the highest bit
+    size_t sub = (ns >> (octave - STATS_SUB_BUCKET_BITS)) & ((1U << STATS_SUB_BUCKET_BITS) - 1);
+    size_t bucket = 1 + (static_cast<size_t>(octave - STATS_MIN_SHIFT) << STATS_SUB_BUCKET_BITS) + sub;
+    return std::min(bucket, STATS_BUCKETS - 1);
+}
+
+uint64_t GetStatsBucketLowerBound(size_t bucket)
+{
+    if (bucket == 0) {
+        return 0;
+    }
+    int octave = STATS_MIN_SHIFT + static_cast<int>((bucket - 1) >> STATS_SUB_BUCKET_BITS);
+    uint64_t sub = (bucket - 1) & ((1U << STATS_SUB_BUCKET_BITS) - 1);
+    return (1ULL << octave) + (sub << (octave - STATS_SUB_BUCKET_BITS));
+}
+
+inline void StatsIncrease(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+} // namespace
+
+void SetTraceStatsEnabled(bool enable)
+{
+    g_statsEnabled.store(enable, std::memory_order_relaxed);
+}
+
+void* TraceStatsBegin(uint64_t tag, const std::string& name, uint64_t& beginNs)
+{
+    if (EXPECTANTLY(!g_statsEnabled.load(std::memory_order_relaxed))) {
+        return nullptr;
+    }
+    if (UNEXPECTANTLY(t_statsTable == nullptr)) {
+        t_statsTable = std::make_unique<TraceStatsTable>();
+    }
+    TraceStatsSlot* slot = t_statsTable->Find(tag, name);
+    if (slot != nullptr) {
+        beginNs = Hitrace::GetCurBootTime();
+    }
+    return slot;
+}
+
+void TraceStatsEnd(void* slot, uint64_t beginNs)
+{
+    uint64_t endNs = Hitrace::GetCurBootTime();
+    uint64_t duration = endNs > beginNs ? endNs - beginNs : 0;
+    auto statsSlot = static_cast<TraceStatsSlot*>(slot);
+    StatsIncrease(statsSlot->count, 1);
+    StatsIncrease(statsSlot->totalNs, duration);
+    if (duration > statsSlot->maxNs.load(std::memory_order_relaxed)) {
+        statsSlot->maxNs.store(duration, std::memory_order_relaxed);
+    }
+    auto& bucket = statsSlot->buckets[GetStatsBucket(duration)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void GetTraceStats(std::vector<HitraceSpanStat>& stats)
+{
+    std::map<TraceStatsKey, TraceStatsSum> sums;
+    {
+        TraceStatsRegistry& registry = GetStatsRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        sums = registry.retired;
+        for (const auto table : registry.tables) {
+            table->MergeTo(sums);
+        }
+    }
+    stats.clear();
+    stats.reserve(sums.size());
+    for (const auto& [key, sum] : sums) {
+        HitraceSpanStat stat;
+        stat.tag = key.first;
+        stat.name = key.second;
+        stat.count = sum.count;
+        stat.totalNs = sum.totalNs;
+        stat.maxNs = sum.maxNs;
+        for (size_t i = 0; i < STATS_BUCKETS; i++) {
+            if (sum.buckets[i] != 0) {
+                stat.histogram.emplace_back(GetStatsBucketLowerBound(i), sum.buckets[i]);
+            }
+        }
+        stats.push_back(std::move(stat));
+    }
+}
+
 int32_t HiTraceCallbackRegistry::Register(void* callback, HiTraceCallbackType type)
 {
     if (!callback) {
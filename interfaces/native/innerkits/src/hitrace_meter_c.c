@@ -67,6 +67,16 @@ void HiTraceCountTraceEx(HiTraceOutputLevel level, uint64_t tag, const char* nam
     CountTraceExCwrapper(level, tag, name, count);
 }
 
+void HiTraceCountTraceBatch(uint64_t tag, const HiTraceCounter* counters, size_t count)
+{
+    CountTraceBatchExCwrapper(HITRACE_LEVEL_INFO, tag, counters, count);
+}
+
+void HiTraceCountTraceBatchEx(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count)
+{
+    CountTraceBatchExCwrapper(level, tag, counters, count);
+}
+
 bool HiTraceIsTagEnabled(uint64_t tag)
 {
     return IsTagEnabledCwrapper(tag);
@@ -76,6 +76,11 @@ void CountTraceExCwrapper(HiTraceOutputLevel level, uint64_t tag, const char* na
     CountTraceEx(level, tag, name, count);
 }
 
+void CountTraceBatchExCwrapper(HiTraceOutputLevel level, uint64_t tag, const HiTraceCounter* counters, size_t count)
+{
+    CountTraceBatchEx(level, tag, counters, count);
+}
+
 bool IsTagEnabledCwrapper(uint64_t tag)
 {
     return IsTagEnabled(tag);
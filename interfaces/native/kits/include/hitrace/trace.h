@@ -46,6 +46,7 @@
 #ifndef HIVIEWDFX_HITRACE_H
 #define HIVIEWDFX_HITRACE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -374,6 +375,22 @@ typedef struct HiTraceId {
  */
 typedef void (*OH_HiTrace_TraceEventListener)(bool traceStatus);
 
+/**
+ * @brief Defines one integer variable traced by <b>OH_HiTrace_CountTraceBatch</b>.
+ *
+ * @struct HiTrace_Counter
+ *
+ * @syscap SystemCapability.HiviewDFX.HiTrace
+ *
+ * @since 22
+ */
+typedef struct HiTrace_Counter {
+    /** Name of the integer variable. */
+    const char* name;
+    /** Integer value. */
+    int64_t value;
+} HiTrace_Counter;
+
 /**
  * @brief Starts tracing of a process.
  *
@@ -849,6 +866,20 @@ int32_t OH_HiTrace_RegisterTraceListener(OH_HiTrace_TraceEventListener callback)
  */
 int32_t OH_HiTrace_UnregisterTraceListener(int32_t index);
 
+/**
+ * @brief Traces the value changes of several integer variables at the same time point with output level control.
+ *
+ * All variables are written with one trace record, which costs about as much as one <b>OH_HiTrace_CountTraceEx</b>
+ * call. The trace shows one counter change per variable, as if <b>OH_HiTrace_CountTraceEx</b> was called for each.
+ *
+ * @param level Trace output priority level.
+ * @param counters Names and values of the integer variables.
+ * @param count Number of elements in counters.
+ * @atomicservice
+ * @since 22
+ */
+void OH_HiTrace_CountTraceBatch(HiTrace_Output_Level level, const HiTrace_Counter* counters, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -60,6 +60,27 @@ pub fn count_trace(label: u64, name: &str, count: i64) {
     }
 }
 
+/// Track several 64-bit integer counter values with one trace record
+pub fn count_trace_batch(label: u64, counters: &[(&str, i64)]) {
+    let names: Vec<CString> = counters.iter().map(|(name, _)| CString::new(*name).unwrap()).collect();
+    let items: Vec<HiTraceCounter> = names
+        .iter()
+        .zip(counters.iter())
+        .map(|(name, (_, count))| HiTraceCounter { name: name.as_ptr(), value: *count })
+        .collect();
+    // Safty: call C ffi border function, the names outlive the call.
+    unsafe {
+        CountTraceBatch(label, items.as_ptr(), items.len());
+    }
+}
+
+/// ffi border struct -> one counter of a batch
+#[repr(C)]
+pub(crate) struct HiTraceCounter {
+    name: *const c_char,
+    value: c_longlong,
+}
+
 extern "C" {
     /// ffi border function -> start trace
     pub(crate) fn StartTraceWrapper(label: c_ulonglong, value: *const c_char);
@@ -75,4 +96,7 @@ extern "C" {
 
     /// ffi border function -> count trace
     pub(crate) fn CountTraceWrapper(label: c_ulonglong, name: *const c_char, count: c_longlong);
+
+    /// ffi border function -> count trace batch
+    pub(crate) fn CountTraceBatch(label: c_ulonglong, counters: *const HiTraceCounter, count: usize);
 }
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# Copyright (C) 2025 Huawei Device Co., Ltd.
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os
+import sys
+import pytest
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "../../../tools/hitrace_converter"))
+from hitrace_converter import PerfettoTraceWriter
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def decode_message(data):
+    # 返回 {字段号: [值]}, 长度限定字段为bytes, varint字段为int
+    fields = {}
+    pos = 0
+    while pos < len(data):
+        key, pos = read_varint(data, pos)
+        field_id, wire_type = key >> 3, key & 0x7
+        if wire_type == PerfettoTraceWriter.WIRE_VARINT:
+            value, pos = read_varint(data, pos)
+        else:
+            assert wire_type == PerfettoTraceWriter.WIRE_LENGTH_DELIMITED
+            length, pos = read_varint(data, pos)
+            value = bytes(data[pos:pos + length])
+            pos += length
+        fields.setdefault(field_id, []).append(value)
+    return fields
+
+
+def read_packets(out_file):
+    with open(out_file, "rb") as infile:
+        trace = decode_message(infile.read())
+    return [decode_message(packet) for packet in trace.get(PerfettoTraceWriter.TRACE_PACKET, [])]
+
+
+def read_ftrace_events(packets):
+    events = []
+    for packet in packets:
+        for bundle in packet.get(PerfettoTraceWriter.PACKET_FTRACE_EVENTS, []):
+            bundle = decode_message(bundle)
+            cpu = bundle[PerfettoTraceWriter.BUNDLE_CPU][0]
+            for event in bundle.get(PerfettoTraceWriter.BUNDLE_EVENT, []):
+                events.append((cpu, decode_message(event)))
+    return events
+
+
+class TestHitraceConverter:
+    @pytest.mark.L0
+    def test_perfetto_round_trip(self, tmp_path):
+        out_file = str(tmp_path / "trace.perfetto")
+        writer = PerfettoTraceWriter(out_file)
+        writer.write_process_tree({100: "render", 101: "ui"}, {101: 100})
+        writer.append_event(0, 1000, 101, 1, "sched_switch",
+            "prev_comm=ui prev_pid=101 prev_prio=120 prev_state=S ==> next_comm=swapper next_pid=0 next_prio=120")
+        writer.append_event(1, 2000, 100, 0, "tracing_mark_write", "B|100|H:draw")
+        writer.append_event(1, 3000, 100, 0, "tracing_mark_write", "M|100|I|fps|60|jank|2")
+        writer.append_event(0, 4000, 0, 0, "cpu_frequency", "state=1800000 cpu_id=0")
+        writer.append_event(0, 5000, 0, 0, "workqueue_execute_start", "work struct 0x0")
+        writer.close()
+
+        packets = read_packets(out_file)
+        assert all(packet[PerfettoTraceWriter.PACKET_SEQUENCE_ID] == [PerfettoTraceWriter.SEQUENCE_ID]
+            for packet in packets)
+        threads = [decode_message(thread) for thread in decode_message(
+            packets[0][PerfettoTraceWriter.PACKET_PROCESS_TREE][0])[PerfettoTraceWriter.PROCESS_TREE_THREADS]]
+        assert threads[0] == {PerfettoTraceWriter.THREAD_TID: [100], PerfettoTraceWriter.THREAD_NAME: [b"render"]}
+        assert threads[1] == {PerfettoTraceWriter.THREAD_TID: [101], PerfettoTraceWriter.THREAD_NAME: [b"ui"],
+            PerfettoTraceWriter.THREAD_TGID: [100]}
+
+        events = read_ftrace_events(packets)
+        assert [(cpu, event[PerfettoTraceWriter.EVENT_TIMESTAMP][0]) for cpu, event in events] == \
+            [(0, 1000), (0, 4000), (1, 2000), (1, 3000), (1, 3000)]
+        sched_switch = events[0][1]
+        assert sched_switch[PerfettoTraceWriter.EVENT_PID] == [101]
+        assert sched_switch[PerfettoTraceWriter.EVENT_COMMON_FLAGS] == [1]
+        assert decode_message(sched_switch[4][0]) == {1: [b"ui"], 2: [101], 3: [120], 4: [0x1],
+            5: [b"swapper"], 6: [0], 7: [120]}
+        assert decode_message(events[1][1][11][0]) == {1: [1800000], 2: [0]}
+        prints = [decode_message(event[3][0])[2][0] for _, event in events[2:]]
+        assert prints == [b"B|100|H:draw", b"C|100|H:fps|60|I", b"C|100|H:jank|2|I"]
+        assert writer.event_count == 5
+        assert writer.unsupported_events == {"workqueue_execute_start": 1}
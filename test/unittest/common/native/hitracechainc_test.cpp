@@ -15,10 +15,15 @@
 
 #include "hitrace/hitracechainc.h"
 
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <gtest/gtest.h>
+#include <mutex>
 #include <sys/time.h>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include "gtest/gtest-message.h"
 #include "gtest/gtest-test-part.h"
@@ -1225,5 +1230,171 @@ HWTEST_F(HiTraceChainCTest, TracepointParamsTest_003, TestSize.Level1)
     id = HiTraceChainGetId();
     EXPECT_FALSE(HiTraceChainIsValid(&id));
 }
+
+/**
+ * @tc.name: Dfx_HiTraceChainCTest_IdGeneratorTest_001
+ * @tc.desc: Test the span ids of one parent rarely collide and never repeat the parent or the root.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HiTraceChainCTest, IdGeneratorTest_001, TestSize.Level1)
+{
+    constexpr int spanNum = 4096;
+    constexpr int collisionLimit = 4; // 26-bit span ids expect 0.125 collisions among 4096
+    HiTraceIdStruct id = HiTraceChainBegin("IdGeneratorTest_001", HITRACE_FLAG_NO_BE_INFO);
+    ASSERT_TRUE(HiTraceChainIsValid(&id));
+    std::unordered_set<uint64_t> spanIds;
+    int collisions = 0;
+    for (int i = 0; i < spanNum; i++) {
+        HiTraceIdStruct childId = HiTraceChainCreateSpan();
+        EXPECT_NE(childId.spanId, 0);
+        EXPECT_NE(childId.spanId, id.spanId);
+        EXPECT_EQ(childId.parentSpanId, id.spanId);
+        if (!spanIds.insert(childId.spanId).second) {
+            collisions++;
+        }
+    }
+    printf("IdGeneratorTest_001: %d collisions among %d span ids.\n", collisions, spanNum);
+    EXPECT_LE(collisions, collisionLimit);
+    HiTraceChainEnd(&id);
+}
+
+/**
+ * @tc.name: Dfx_HiTraceChainCTest_IdGeneratorTest_002
+ * @tc.desc: Test the chain ids begun at the same time on several threads do not collide.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HiTraceChainCTest, IdGeneratorTest_002, TestSize.Level1)
+{
+    constexpr int threadNum = 4;
+    constexpr int chainNum = 10000;
+    std::mutex mutex;
+    std::unordered_set<uint64_t> chainIds;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadNum; i++) {
+        threads.emplace_back([&mutex, &chainIds] {
+            std::vector<uint64_t> ids;
+            for (int j = 0; j < chainNum; j++) {
+                HiTraceIdStruct id = HiTraceChainBegin("IdGeneratorTest_002", HITRACE_FLAG_NO_BE_INFO);
+                ids.push_back(id.chainId);
+                HiTraceChainEnd(&id);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            chainIds.insert(ids.begin(), ids.end());
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(chainIds.size(), static_cast<size_t>(threadNum * chainNum));
+    EXPECT_EQ(chainIds.count(0), 0);
+}
+
+/**
+ * @tc.name: Dfx_HiTraceChainCTest_IdGeneratorTest_003
+ * @tc.desc: Test HiTraceChainCreateSpan performance, the cost is logged since it depends on the device load.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HiTraceChainCTest, IdGeneratorTest_003, TestSize.Level1)
+{
+    constexpr int spanNum = 1000000;
+    HiTraceIdStruct id = HiTraceChainBegin("IdGeneratorTest_003", HITRACE_FLAG_NO_BE_INFO);
+    ASSERT_TRUE(HiTraceChainIsValid(&id));
+    uint64_t spanSum = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < spanNum; i++) {
+        spanSum += HiTraceChainCreateSpan().spanId;
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    HiTraceChainEnd(&id);
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+    printf("IdGeneratorTest_003: %lld ns per span, sum %llu.\n", static_cast<long long>(duration / spanNum),
+        static_cast<unsigned long long>(spanSum));
+    HiTraceIdStruct spanId = HiTraceChainCreateSpan();
+    EXPECT_FALSE(HiTraceChainIsValid(&spanId)); // the chain has ended
+}
+
+/**
+ * @tc.name: Dfx_HiTraceChainCTest_SpanStackTest_001
+ * @tc.desc: Test nested push and pop of trace ids, including a pop that skips a span and a stale handle.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HiTraceChainCTest, SpanStackTest_001, TestSize.Level1)
+{
+    HiTraceIdStruct rootId = HiTraceChainBegin("SpanStackTest_001", HITRACE_FLAG_NO_BE_INFO);
+    ASSERT_TRUE(HiTraceChainIsValid(&rootId));
+    HiTraceIdStruct childId = HiTraceChainCreateSpan();
+    HiTraceSpanHandle childHandle = HiTraceChainPushId(&childId);
+    ASSERT_NE(childHandle, HITRACE_SPAN_HANDLE_INVALID);
+    HiTraceIdStruct currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.spanId, childId.spanId);
+
+    HiTraceIdStruct grandchildId = HiTraceChainCreateSpan();
+    HiTraceSpanHandle grandchildHandle = HiTraceChainPushId(&grandchildId);
+    ASSERT_NE(grandchildHandle, HITRACE_SPAN_HANDLE_INVALID);
+    HiTraceChainPopId(grandchildHandle);
+    currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.spanId, childId.spanId);
+    // the handle was popped, popping it again changes nothing
+    HiTraceChainPopId(grandchildHandle);
+    currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.spanId, childId.spanId);
+
+    // a span left pushed above is dropped with the one below it
+    (void)HiTraceChainPushId(&grandchildId);
+    HiTraceChainPopId(childHandle);
+    currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.chainId, rootId.chainId);
+    EXPECT_EQ(currentId.spanId, rootId.spanId);
+
+    HiTraceSpanHandle clearHandle = HiTraceChainPushId(nullptr);
+    currentId = HiTraceChainGetId();
+    EXPECT_FALSE(HiTraceChainIsValid(&currentId));
+    HiTraceChainPopId(clearHandle);
+    currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.chainId, rootId.chainId);
+
+    std::vector<HiTraceSpanHandle> handles;
+    for (int i = 0; i < HITRACE_SPAN_STACK_DEPTH; i++) {
+        handles.push_back(HiTraceChainPushId(&childId));
+    }
+    EXPECT_EQ(HiTraceChainPushId(&childId), HITRACE_SPAN_HANDLE_INVALID);
+    HiTraceChainPopId(handles.front());
+    currentId = HiTraceChainGetId();
+    EXPECT_EQ(currentId.spanId, rootId.spanId);
+    HiTraceChainEnd(&rootId);
+}
+
+/**
+ * @tc.name: Dfx_HiTraceChainCTest_TaskContextTest_001
+ * @tc.desc: Test a task context captured on one thread is resumed on another and released once.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HiTraceChainCTest, TaskContextTest_001, TestSize.Level1)
+{
+    unsigned int liveContexts = HiTraceChainGetLiveContextCount();
+    EXPECT_EQ(HiTraceChainCaptureContext(), nullptr);
+    HiTraceIdStruct id = HiTraceChainBegin("TaskContextTest_001", HITRACE_FLAG_NO_BE_INFO);
+    ASSERT_TRUE(HiTraceChainIsValid(&id));
+    HiTraceTaskContext* context = HiTraceChainCaptureContext();
+    ASSERT_NE(context, nullptr);
+    EXPECT_EQ(HiTraceChainGetLiveContextCount(), liveContexts + 1);
+
+    HiTraceIdStruct taskId;
+    HiTraceIdStruct afterTaskId;
+    std::thread worker([context, &taskId, &afterTaskId] {
+        HiTraceSpanHandle handle = HiTraceChainResumeContext(context);
+        taskId = HiTraceChainGetId();
+        HiTraceChainPopId(handle);
+        afterTaskId = HiTraceChainGetId();
+    });
+    worker.join();
+    EXPECT_EQ(taskId.chainId, id.chainId);
+    EXPECT_EQ(taskId.spanId, id.spanId);
+    EXPECT_FALSE(HiTraceChainIsValid(&afterTaskId));
+
+    HiTraceChainReleaseContext(context);
+    EXPECT_EQ(HiTraceChainGetLiveContextCount(), liveContexts);
+    HiTraceChainEnd(&id);
+}
 }  // namespace HiviewDFX
 }  // namespace OHOS
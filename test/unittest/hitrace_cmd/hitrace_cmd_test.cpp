@@ -1856,6 +1856,47 @@ HWTEST_F(HitraceCMDTest, HitraceCMDTest056, TestSize.Level1)
     GTEST_LOG_(INFO) << "HitraceCMDTest056: end.";
 }
 
+/**
+ * @tc.name: HitraceCMDTest057
+ * @tc.desc: test the text trace formatted in userspace from a raw capture with --raw_text
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceCMDTest, HitraceCMDTest057, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceCMDTest057: start.";
+
+    std::vector<std::string> keywordsReject = { "--raw_text only supports" };
+    ASSERT_TRUE(CheckTraceCommandOutput("hitrace --raw_text --trace_begin app", keywordsReject));
+
+    std::string cmdStart = "hitrace --trace_begin app ace -b 102400";
+    std::vector<std::string> keywordsStart = {
+        "RECORDING_LONG_BEGIN",
+        "OpenRecording done",
+    };
+    ASSERT_TRUE(CheckTraceCommandOutput(cmdStart, keywordsStart));
+
+    const std::string outFile = "/data/local/tmp/test_raw_text.txt";
+    std::string cmdFinish = "hitrace --trace_finish --raw_text -o " + outFile;
+    std::vector<std::string> keywordsFinish = {
+        "RECORDING_LONG_FINISH",
+        "trace read done",
+    };
+    ASSERT_TRUE(CheckTraceCommandOutput(cmdFinish, keywordsFinish));
+
+    std::ifstream textFile(outFile);
+    std::string firstLine;
+    ASSERT_TRUE(std::getline(textFile, firstLine));
+    EXPECT_EQ(firstLine, "# tracer: nop");
+    std::string entriesLine;
+    ASSERT_TRUE(std::getline(textFile, entriesLine) && std::getline(textFile, entriesLine));
+    EXPECT_EQ(entriesLine.find("# entries-in-buffer/entries-written: "), 0) << entriesLine;
+    EXPECT_EQ(entriesLine.find("%lu"), std::string::npos) << entriesLine;
+    textFile.close();
+    unlink(outFile.c_str());
+
+    GTEST_LOG_(INFO) << "HitraceCMDTest057: end.";
+}
+
 }
 }
 }
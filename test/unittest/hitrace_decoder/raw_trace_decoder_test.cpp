@@ -0,0 +1,662 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "raw_trace_decoder.h"
+#include "raw_trace_filter.h"
+#include "trace_slice_stats.h"
+#include "trace_text_parser.h"
+
+using namespace testing::ext;
+using namespace std;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+const char* const TEST_RAW_FILE = "/data/local/tmp/test_decoder_raw.sys";
+const char* const TEST_OUT_FILE = "/data/local/tmp/test_decoder_out.ftrace";
+const char* const TEST_FILTERED_FILE = "/data/local/tmp/test_decoder_filtered.sys";
+constexpr uint16_t MARK_EVENT_ID = 7;
+constexpr uint16_t UNKNOWN_EVENT_ID = 99;
+constexpr size_t PAGE_HEADER_SIZE = 17;
+constexpr size_t EVENT_HEADER_SIZE = 6;
+constexpr size_t MARK_BUFFER_OFFSET = 12;
+
+const char* const EVENTS_FORMAT =
+    "name: tracing_mark_write\n"
+    "ID: 7\n"
+    "format:\n"
+    "\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+    "\tfield:unsigned char common_flags;\toffset:2;\tsize:1;\tsigned:0;\n"
+    "\tfield:unsigned char common_preempt_count;\toffset:3;\tsize:1;\tsigned:0;\n"
+    "\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+    "\tfield:__data_loc char[] buffer;\toffset:8;\tsize:4;\tsigned:0;\n"
+    "\n"
+    "print fmt: \"%s\", __get_str(buffer)\n"
+    "name: test_plain\n"
+    "ID: 8\n"
+    "format:\n"
+    "\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+    "\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+    "\tfield:__data_loc char[] name;\toffset:8;\tsize:4;\tsigned:0;\n"
+    "\tfield:unsigned int loc;\toffset:8;\tsize:4;\tsigned:0;\n"
+    "\n"
+    "print fmt: \"name=%s pid=%d loc=%04hx %c\\t100%%\", __get_str(name), REC->common_pid, "
+    "(unsigned int)REC->loc, (REC->loc)\n"
+    "name: test_flags\n"
+    "ID: 9\n"
+    "format:\n"
+    "\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+    "\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+    "\tfield:__data_loc char[] name;\toffset:8;\tsize:4;\tsigned:0;\n"
+    "\n"
+    "print fmt: \"%s %s\", __get_str(name), __print_flags(REC->common_pid, \"|\", { 1, \"A\" })\n";
+
+void AppendBytes(vector<uint8_t>& out, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void AppendSection(vector<uint8_t>& out, uint8_t type, const vector<uint8_t>& payload)
+{
+    RawTraceSectionHeader header;
+    header.type = type;
+    header.length = static_cast<uint32_t>(payload.size());
+    AppendBytes(out, &header, sizeof(header));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+void AppendMarkEvent(vector<uint8_t>& page, size_t& pos, uint32_t delta, int32_t pid, const string& text,
+    uint16_t eventId = MARK_EVENT_ID)
+{
+    vector<uint8_t> content(MARK_BUFFER_OFFSET, 0);
+    memcpy(content.data(), &eventId, sizeof(eventId));
+    memcpy(content.data() + 4, &pid, sizeof(pid)); // 4 : common_pid offset
+    uint32_t loc = (static_cast<uint32_t>(text.size() + 1) << 16) | MARK_BUFFER_OFFSET; // 16 : data_loc length
+    memcpy(content.data() + 8, &loc, sizeof(loc)); // 8 : buffer offset
+    content.insert(content.end(), text.begin(), text.end());
+    content.push_back('\0');
+
+    uint16_t size = static_cast<uint16_t>(content.size());
+    memcpy(page.data() + pos, &delta, sizeof(delta));
+    memcpy(page.data() + pos + sizeof(delta), &size, sizeof(size));
+    pos += EVENT_HEADER_SIZE;
+    memcpy(page.data() + pos, content.data(), content.size());
+    pos += (content.size() + 3) & ~static_cast<size_t>(3); // 3 : align to 4 bytes
+}
+
+vector<uint8_t> MakePage(uint64_t timestamp, uint8_t cpu)
+{
+    vector<uint8_t> page(RAW_TRACE_PAGE_SIZE, 0);
+    memcpy(page.data(), &timestamp, sizeof(timestamp));
+    page[16] = cpu; // 16 : cpu offset in the page header
+    return page;
+}
+
+bool WriteTestFile(const vector<uint8_t>& data)
+{
+    ofstream file(TEST_RAW_FILE, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return file.good();
+}
+
+vector<uint8_t> MakeRawFile(const vector<vector<uint8_t>>& cpuPages, uint8_t fileType = RAW_FILE_TYPE_HM)
+{
+    vector<uint8_t> out;
+    RawTraceFileHeader header;
+    header.magicNumber = RAW_TRACE_MAGIC_NUMBER;
+    header.fileType = fileType;
+    header.reserved = static_cast<uint32_t>(cpuPages.size()) << 1;
+    AppendBytes(out, &header, sizeof(header));
+    AppendSection(out, RAW_SECTION_EVENTS_FORMAT,
+        vector<uint8_t>(EVENTS_FORMAT, EVENTS_FORMAT + strlen(EVENTS_FORMAT)));
+    string cmdlines = "100 render\n";
+    AppendSection(out, RAW_SECTION_CMDLINES, vector<uint8_t>(cmdlines.begin(), cmdlines.end()));
+    string tgids = "100 90\n";
+    AppendSection(out, RAW_SECTION_TGIDS, vector<uint8_t>(tgids.begin(), tgids.end()));
+    for (size_t cpu = 0; cpu < cpuPages.size(); cpu++) {
+        AppendSection(out, RAW_SECTION_CPU_RAW + cpu, cpuPages[cpu]);
+    }
+    return out;
+}
+
+void AppendLinuxRecord(vector<uint8_t>& page, size_t& pos, uint32_t header, const vector<uint32_t>& words)
+{
+    memcpy(page.data() + pos, &header, sizeof(header));
+    pos += sizeof(header);
+    for (uint32_t word : words) {
+        memcpy(page.data() + pos, &word, sizeof(word));
+        pos += sizeof(word);
+    }
+}
+
+vector<uint32_t> MakeLinuxMarkPayload(int32_t pid, const string& text)
+{
+    vector<uint8_t> content(MARK_BUFFER_OFFSET, 0);
+    memcpy(content.data(), &MARK_EVENT_ID, sizeof(MARK_EVENT_ID));
+    memcpy(content.data() + 4, &pid, sizeof(pid)); // 4 : common_pid offset
+    uint32_t loc = (static_cast<uint32_t>(text.size() + 1) << 16) | MARK_BUFFER_OFFSET; // 16 : data_loc length
+    memcpy(content.data() + 8, &loc, sizeof(loc)); // 8 : buffer offset
+    content.insert(content.end(), text.begin(), text.end());
+    content.resize((content.size() + 4) & ~static_cast<size_t>(3), 0); // 4 : nul terminated, aligned to 4 bytes
+    vector<uint32_t> words(content.size() / sizeof(uint32_t));
+    memcpy(words.data(), content.data(), content.size());
+    return words;
+}
+
+vector<string> DecodeTestFile(DecodeStats& stats, const char* rawFile = TEST_RAW_FILE, size_t threadCount = 0)
+{
+    vector<string> lines;
+    RawTraceFile traceFile;
+    if (traceFile.Open(rawFile) != RawTraceError::NONE) {
+        return lines;
+    }
+    int outFd = open(TEST_OUT_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0600); // 0600 : -rw-------
+    if (outFd < 0) {
+        return lines;
+    }
+    RawTraceDecoder decoder(traceFile);
+    decoder.SetThreadCount(threadCount);
+    bool ret = decoder.DecodeToSystrace(outFd, stats);
+    close(outFd);
+    if (!ret) {
+        return lines;
+    }
+    ifstream in(TEST_OUT_FILE);
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line[0] != '#') {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+} // namespace
+
+class HitraceDecoderTest : public testing::Test {
+public:
+    static void SetUpTestCase(void) {}
+    static void TearDownTestCase(void) {}
+    void SetUp() {}
+    void TearDown()
+    {
+        unlink(TEST_RAW_FILE);
+        unlink(TEST_OUT_FILE);
+        unlink(TEST_FILTERED_FILE);
+    }
+};
+
+/**
+ * @tc.name: RawTraceDecoderTest001
+ * @tc.desc: Test the systrace line layout of a tracing_mark_write event.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest001, TestSize.Level1)
+{
+    vector<uint8_t> page = MakePage(1234567890000, 2); // 2 : cpu id
+    size_t pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page, pos, 499, 100, "B|90|H:draw"); // 499 : rounds down to the microsecond
+    AppendMarkEvent(page, pos, 1500, 100, "E|90|"); // 1500 : rounds up to the microsecond
+    AppendMarkEvent(page, pos, 2000, 200, "C|200|count|3"); // 2000 : pid 200 is not in the cmdlines
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page})));
+
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats);
+    ASSERT_EQ(lines.size(), 3);
+    EXPECT_EQ(lines[0], "          render-100   (   90) [002] ....  1234.567890: tracing_mark_write: B|90|H:draw");
+    EXPECT_EQ(lines[1], "          render-100   (   90) [002] ....  1234.567892: tracing_mark_write: E|90");
+    EXPECT_EQ(lines[2], "           <...>-200   (-----) [002] ....  1234.567892: tracing_mark_write: C|200|count|3");
+    EXPECT_EQ(stats.eventCount[MARK_EVENT_ID], 3);
+    EXPECT_EQ(stats.formatMissCount, 0);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest002
+ * @tc.desc: Test the per-cpu streams are merged in timestamp order and unknown events are counted as misses.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest002, TestSize.Level1)
+{
+    constexpr int eventsPerCpu = 100;
+    constexpr uint64_t baseTime = 1000000000;
+    constexpr uint32_t step = 2000;
+    vector<vector<uint8_t>> cpuPages;
+    for (uint8_t cpu = 0; cpu < 2; cpu++) { // 2 : cpu count
+        vector<uint8_t> page = MakePage(baseTime, cpu);
+        size_t pos = PAGE_HEADER_SIZE;
+        for (int i = 0; i < eventsPerCpu; i++) {
+            // cpu 1 sits half a step after cpu 0, so the merged output must alternate
+            AppendMarkEvent(page, pos, i * step + cpu * (step / 2), 100, "C|90|n|" + to_string(i)); // 2 : half
+        }
+        AppendMarkEvent(page, pos, eventsPerCpu * step, 100, "", UNKNOWN_EVENT_ID);
+        cpuPages.push_back(page);
+    }
+    ASSERT_TRUE(WriteTestFile(MakeRawFile(cpuPages)));
+
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats);
+    ASSERT_EQ(lines.size(), eventsPerCpu * 2); // 2 : cpu count
+    for (size_t i = 0; i < lines.size(); i++) {
+        char expectCpu[8] = {0}; // 8 : enough for " [00x] "
+        (void)snprintf(expectCpu, sizeof(expectCpu), "[%03zu]", i % 2); // 2 : cpu count
+        EXPECT_NE(lines[i].find(expectCpu), string::npos) << lines[i];
+    }
+    EXPECT_EQ(stats.formatMissCount, 2); // 2 : one unknown event per cpu
+    EXPECT_EQ(stats.formatMissIds.count(UNKNOWN_EVENT_ID), 1);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest003
+ * @tc.desc: Test an invalid file is rejected.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest003, TestSize.Level1)
+{
+    ASSERT_TRUE(WriteTestFile(vector<uint8_t>(RAW_TRACE_PAGE_SIZE, 0)));
+    RawTraceFile traceFile;
+    EXPECT_EQ(traceFile.Open(TEST_RAW_FILE), RawTraceError::NOT_RAW_TRACE);
+    EXPECT_EQ(traceFile.Open("/data/local/tmp/not_exist_raw_trace"), RawTraceError::OPEN_FAILED);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest004
+ * @tc.desc: Test linux ring buffer pages, the cpu comes from the section and time extends are applied.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest004, TestSize.Level1)
+{
+    constexpr uint32_t typeLenShift = 5;
+    constexpr uint32_t typeTimeExtend = 30;
+    constexpr size_t linuxPageHeaderSize = 16;
+    vector<uint8_t> page(RAW_TRACE_PAGE_SIZE, 0);
+    uint64_t timestamp = 1234567890000;
+    memcpy(page.data(), &timestamp, sizeof(timestamp));
+    size_t pos = linuxPageHeaderSize;
+    vector<uint32_t> small = MakeLinuxMarkPayload(100, "B|90|H:draw");
+    AppendLinuxRecord(page, pos, (1000 << typeLenShift) | static_cast<uint32_t>(small.size()), small); // 1000 : ns
+    // a 2^27 + 3000 ns gap does not fit the 27 bit delta and needs a time extend record
+    AppendLinuxRecord(page, pos, (3000 << typeLenShift) | typeTimeExtend, {1});
+    vector<uint32_t> large = MakeLinuxMarkPayload(100, "E|90|");
+    large.insert(large.begin(), static_cast<uint32_t>((large.size() + 1) * sizeof(uint32_t)));
+    AppendLinuxRecord(page, pos, 0, large);
+    uint64_t commit = pos - linuxPageHeaderSize;
+    memcpy(page.data() + sizeof(timestamp), &commit, sizeof(commit));
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({vector<uint8_t>(), page}, RAW_FILE_TYPE_LINUX)));
+
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats);
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_EQ(lines[0], "          render-100   (   90) [001] ....  1234.567891: tracing_mark_write: B|90|H:draw");
+    EXPECT_EQ(lines[1], "          render-100   (   90) [001] ....  1234.702112: tracing_mark_write: E|90");
+    EXPECT_EQ(FormatTraceTextHeader(2, 5, 8).find("# entries-in-buffer/entries-written: 2/5   #P:8\n"), // 8 : cpus
+        strlen("# tracer: nop\n#\n"));
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest005
+ * @tc.desc: Test the post-filter by pid and name, E markers follow their B marker across cpus.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest005, TestSize.Level1)
+{
+    vector<uint8_t> page0 = MakePage(1000000000, 0);
+    size_t pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page0, pos, 1000, 100, "B|90|H:draw|I13"); // 1000 : ns after the page timestamp
+    AppendMarkEvent(page0, pos, 2000, 100, "B|90|H:other|I13"); // 2000 : nested in draw
+    AppendMarkEvent(page0, pos, 3000, 100, "E|90|I13"); // 3000 : ends other
+    AppendMarkEvent(page0, pos, 3500, 200, "C|200|H:draw|3|I13"); // 3500 : another process
+    AppendMarkEvent(page0, pos, 3600, 100, "", UNKNOWN_EVENT_ID); // 3600 : a kernel event
+    vector<uint8_t> page1 = MakePage(1000000000, 1);
+    pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page1, pos, 4000, 100, "E|90|I13"); // 4000 : ends draw after a migration to cpu 1
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page0, page1})));
+
+    TraceMarkerFilter filter;
+    filter.pids = {90}; // 90 : the tgid of thread 100
+    filter.names = {"dra"};
+    FilterStats filterStats;
+    ASSERT_EQ(FilterRawTraceFile(TEST_RAW_FILE, TEST_FILTERED_FILE, filter, filterStats), RawTraceError::NONE);
+    EXPECT_EQ(filterStats.eventsIn, 6);
+    EXPECT_EQ(filterStats.eventsKept, 2);
+    EXPECT_EQ(filterStats.pagesOut, 2);
+
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats, TEST_FILTERED_FILE);
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_EQ(lines[0], "          render-100   (   90) [000] ....     1.000001: tracing_mark_write: B|90|H:draw|I13");
+    EXPECT_EQ(lines[1], "          render-100   (   90) [001] ....     1.000004: tracing_mark_write: E|90|I13");
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest006
+ * @tc.desc: Test the post-filter by tag and level on linux pages, with kernel events of the pid kept.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest006, TestSize.Level1)
+{
+    TraceMarkerInfo info;
+    ASSERT_TRUE(ParseTraceMarker("S|90|H:[a1,b2,c3]#load|7|I0513|cat|args\n", info));
+    EXPECT_EQ(info.type, 'S');
+    EXPECT_EQ(info.pid, 90);
+    EXPECT_EQ(info.name, "load");
+    EXPECT_EQ(info.level, 1);
+    EXPECT_EQ(info.tags, (1ULL << 5) | (1ULL << 13)); // 5 : commercial, 13 : tag bit
+    EXPECT_FALSE(ParseTraceMarker("no marker", info));
+
+    constexpr uint32_t typeLenShift = 5;
+    constexpr size_t linuxPageHeaderSize = 16;
+    vector<uint8_t> page(RAW_TRACE_PAGE_SIZE, 0);
+    uint64_t timestamp = 1000000000;
+    memcpy(page.data(), &timestamp, sizeof(timestamp));
+    size_t pos = linuxPageHeaderSize;
+    const vector<string> markers = {"C|90|H:a|1|D13", "C|90|H:b|2|I0513", "C|90|H:c|3|I14"};
+    for (const auto& marker : markers) {
+        vector<uint32_t> payload = MakeLinuxMarkPayload(100, marker);
+        AppendLinuxRecord(page, pos, (1000 << typeLenShift) | static_cast<uint32_t>(payload.size()), payload);
+    }
+    vector<uint32_t> kernelEvent = MakeLinuxMarkPayload(100, "");
+    kernelEvent[0] = UNKNOWN_EVENT_ID;
+    AppendLinuxRecord(page, pos, (1000 << typeLenShift) | static_cast<uint32_t>(kernelEvent.size()), kernelEvent);
+    uint64_t commit = pos - linuxPageHeaderSize;
+    memcpy(page.data() + sizeof(timestamp), &commit, sizeof(commit));
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page}, RAW_FILE_TYPE_LINUX)));
+
+    TraceMarkerFilter filter;
+    filter.tags = 1ULL << 13; // 13 : tag bit
+    filter.minLevel = 1; // 1 : info
+    filter.pids = {90}; // 90 : the tgid of thread 100
+    filter.keepKernelEvents = true;
+    FilterStats filterStats;
+    ASSERT_EQ(FilterRawTraceFile(TEST_RAW_FILE, TEST_FILTERED_FILE, filter, filterStats), RawTraceError::NONE);
+    EXPECT_EQ(filterStats.eventsIn, 4);
+    EXPECT_EQ(filterStats.eventsKept, 2);
+
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats, TEST_FILTERED_FILE);
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_EQ(lines[0], "          render-100   (   90) [000] ....     1.000002: tracing_mark_write: C|90|H:b|2|I0513");
+    EXPECT_EQ(stats.formatMissIds.count(UNKNOWN_EVENT_ID), 1);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest007
+ * @tc.desc: Test the slice aggregation of a raw and a text trace, B/E per thread and S/F by task id.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest007, TestSize.Level1)
+{
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; value++) { // 1000 : values 1us to 1ms
+        histogram.Record(value * 1000); // 1000 : ns per us
+    }
+    EXPECT_NEAR(histogram.GetPercentile(50), 500000, 500000 / 32); // 50 : p50, 32 : buckets per power of two
+    EXPECT_NEAR(histogram.GetPercentile(99), 990000, 990000 / 32); // 99 : p99, 32 : buckets per power of two
+    EXPECT_EQ(histogram.GetPercentile(100), 1000000); // 100 : the max is exact
+
+    vector<uint8_t> page0 = MakePage(1000000000, 0);
+    size_t pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page0, pos, 1000, 100, "B|90|H:draw|I13"); // 1000 : ns after the page timestamp
+    AppendMarkEvent(page0, pos, 2000, 100, "S|90|H:load|7|I13"); // 2000 : task 7 starts
+    AppendMarkEvent(page0, pos, 3000, 100, "B|90|H:draw|I13"); // 3000 : nested draw
+    AppendMarkEvent(page0, pos, 4000, 100, "E|90|I13"); // 4000 : ends the nested draw
+    vector<uint8_t> page1 = MakePage(1000000000, 1);
+    pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page1, pos, 6000, 100, "E|90|I13"); // 6000 : ends the outer draw after a migration
+    AppendMarkEvent(page1, pos, 9000, 101, "F|90|H:load|7|I13"); // 9000 : task 7 ends on another thread
+    AppendMarkEvent(page1, pos, 9500, 101, "E|90|I13"); // 9500 : its B marker is before the trace
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page0, page1})));
+
+    SliceAggregator rawAggregator;
+    ASSERT_TRUE(AggregateTraceSlices(TEST_RAW_FILE, rawAggregator));
+    vector<const SliceStats*> slices = rawAggregator.GetSortedSlices();
+    ASSERT_EQ(slices.size(), 2);
+    EXPECT_EQ(slices[0]->name, "load");
+    EXPECT_TRUE(slices[0]->isAsync);
+    EXPECT_EQ(slices[0]->sum, 7000); // 7000 : from 2000 to 9000
+    EXPECT_EQ(slices[1]->name, "draw");
+    EXPECT_FALSE(slices[1]->isAsync);
+    EXPECT_EQ(slices[1]->count, 2);
+    EXPECT_EQ(slices[1]->min, 1000); // 1000 : nested draw
+    EXPECT_EQ(slices[1]->max, 5000); // 5000 : outer draw
+    EXPECT_EQ(slices[1]->tags, 1ULL << 13); // 13 : tag bit
+    EXPECT_EQ(rawAggregator.GetStats().unmatchedEnds, 1);
+    EXPECT_EQ(rawAggregator.GetStats().openSlices, 0);
+
+    ofstream text(TEST_OUT_FILE, ios::trunc);
+    text << "# tracer: nop\n"
+         << "          render-100   (   90) [000] ....     1.000001: tracing_mark_write: B|90|H:draw|I13\n"
+         << "          <...>-101    [001] ....     1.000002: tracing_mark_write: S|90|H:load|7|I13\n"
+         << "          render-100   (   90) [001] ....     1.000006: tracing_mark_write: E|90|I13\n"
+         << "          <...>-101    [001] ....     1.000009: tracing_mark_write: F|90|H:load|7|I13\n"
+         << "          render-100   (   90) [001] ....     1.000010: tracing_mark_write: B|90|H:draw|I13";
+    text.close();
+    SliceAggregator textAggregator;
+    ASSERT_TRUE(AggregateTraceSlices(TEST_OUT_FILE, textAggregator));
+    slices = textAggregator.GetSortedSlices();
+    ASSERT_EQ(slices.size(), 2);
+    EXPECT_EQ(slices[0]->name, "load");
+    EXPECT_EQ(slices[0]->sum, 7000); // 7000 : from 1.000002 to 1.000009
+    EXPECT_EQ(slices[1]->name, "draw");
+    EXPECT_EQ(slices[1]->sum, 5000); // 5000 : from 1.000001 to 1.000006
+    EXPECT_EQ(textAggregator.GetStats().openSlices, 1);
+    EXPECT_NE(FormatSliceStats(textAggregator).find("  load\n"), string::npos);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest008
+ * @tc.desc: systrace text lines are split with and without the tgid column, comment and malformed lines are skipped.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest008, TestSize.Level1)
+{
+    TraceTextLine line;
+    ASSERT_TRUE(ParseTraceTextLine("  Thread-[7]-1234  (  100) [003] d..1 12.5: sched_wakeup: comm=a pid=1", line));
+    EXPECT_EQ(line.task, "Thread-[7]");
+    EXPECT_EQ(line.pid, 1234);
+    EXPECT_EQ(line.tgid, 100);
+    EXPECT_EQ(line.cpu, 3);
+    EXPECT_EQ(line.flags, "d..1");
+    EXPECT_EQ(line.timestamp, 12500000000); // 12500000000 : 12.5 s
+    EXPECT_EQ(line.event, "sched_wakeup");
+    EXPECT_EQ(line.args, "comm=a pid=1");
+    ASSERT_TRUE(ParseTraceTextLine("<idle>-0 (-----) [000] .... 1.000000001: cpu_idle: state=1", line));
+    EXPECT_EQ(line.tgid, -1);
+    EXPECT_EQ(line.timestamp, 1000000001); // 1000000001 : 1 s and 1 ns
+    ASSERT_TRUE(ParseTraceTextLine("render-100 [001] .... 2.000001: tracing_mark_write: B|90|H:draw|I13", line));
+    EXPECT_EQ(line.tgid, -1);
+    EXPECT_EQ(line.args, "B|90|H:draw|I13");
+    EXPECT_FALSE(ParseTraceTextLine("render-100 [001] .... 2.000001", line));
+
+    string text = "# tracer: nop\n"
+                  "\n"
+                  "  render-100  [001] ....  2.000001: tracing_mark_write: B|90|H:draw|I13\n"
+                  "  broken line\n"
+                  "  render-100  [001] ....  2.000002: tracing_mark_write: E|90|I13";
+    TraceTextParser parser(text);
+    ASSERT_TRUE(parser.Next(line));
+    EXPECT_EQ(line.timestamp, 2000001000); // 2000001000 : 2.000001 s
+    ASSERT_TRUE(parser.Next(line));
+    EXPECT_EQ(line.args, "E|90|I13");
+    EXPECT_FALSE(parser.Next(line));
+    EXPECT_EQ(parser.GetSkippedLines(), 1);
+
+    ofstream out(TEST_OUT_FILE, ios::trunc);
+    out << text;
+    out.close();
+    void* handle = HiTraceTextParserOpen(TEST_OUT_FILE);
+    ASSERT_NE(handle, nullptr);
+    HiTraceTextLine lines[4]; // 4 : more than the lines in the file
+    ASSERT_EQ(HiTraceTextParserNext(handle, lines, 4), 2); // 4 : capacity
+    EXPECT_EQ(text.substr(lines[1].lineOffset + lines[1].argsOffset, lines[1].argsSize), "E|90|I13");
+    EXPECT_EQ(text.substr(lines[0].lineOffset + lines[0].taskOffset, lines[0].taskSize), "render");
+    EXPECT_EQ(lines[0].pid, 100);
+    EXPECT_EQ(HiTraceTextParserNext(handle, lines, 4), 0); // 4 : capacity
+    EXPECT_EQ(HiTraceTextParserSkippedLines(handle), 1);
+    HiTraceTextParserClose(handle);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest009
+ * @tc.desc: Test the counter batch marker is parsed for the filter, matched by its counter names only and
+ *           expanded to one counter per value in the raw and the text dumps.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest009, TestSize.Level1)
+{
+    TraceMarkerInfo info;
+    ASSERT_TRUE(ParseTraceMarker("M|90|I13|fps|60|mem|1024\n", info));
+    EXPECT_EQ(info.type, 'M');
+    EXPECT_EQ(info.pid, 90);
+    EXPECT_EQ(info.level, 1);
+    EXPECT_EQ(info.tags, 1ULL << 13); // 13 : tag bit
+    EXPECT_TRUE(MatchCounterBatchName(info.name, "mem"));
+    EXPECT_TRUE(MatchCounterBatchName(info.name, "fp"));
+    EXPECT_FALSE(MatchCounterBatchName(info.name, "1024"));
+    EXPECT_FALSE(MatchCounterBatchName(info.name, "fps|60"));
+
+    vector<string> counters;
+    ASSERT_TRUE(ExpandCounterBatch("M|90|I13|fps|60|mem|1024\n", counters));
+    ASSERT_EQ(counters.size(), 2);
+    EXPECT_EQ(counters[0], "C|90|H:fps|60|I13");
+    EXPECT_EQ(counters[1], "C|90|H:mem|1024|I13");
+    EXPECT_FALSE(ExpandCounterBatch("C|90|H:fps|60|I13", counters));
+    EXPECT_FALSE(ExpandCounterBatch("M|90|I13", counters));
+
+    vector<uint8_t> page = MakePage(1000000000, 0);
+    size_t pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page, pos, 1000, 100, "M|90|I13|fps|60|mem|1024"); // 1000 : 1 us after the page
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page})));
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats, TEST_RAW_FILE);
+    ASSERT_EQ(lines.size(), 2);
+    const string prefix = "          render-100   (   90) [000] ....     1.000001: tracing_mark_write: ";
+    EXPECT_EQ(lines[0], prefix + "C|90|H:fps|60|I13");
+    EXPECT_EQ(lines[1], prefix + "C|90|H:mem|1024|I13");
+
+    const string text = "# tracer: nop\n" + prefix + "M|90|I13|fps|60|mem|1024\n" + prefix + "B|90|H:draw|I13";
+    for (size_t chunkSize : {text.size(), size_t(7)}) { // 7 : cuts the lines at odd places
+        CounterBatchTextExpander expander;
+        string out;
+        for (size_t pos = 0; pos < text.size(); pos += chunkSize) {
+            expander.Feed(string_view(text).substr(pos, chunkSize), out);
+        }
+        expander.Finish(out);
+        EXPECT_EQ(out, "# tracer: nop\n" + prefix + "C|90|H:fps|60|I13\n" + prefix + "C|90|H:mem|1024|I13\n" +
+            prefix + "B|90|H:draw|I13");
+    }
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest010
+ * @tc.desc: Test events without a dedicated printer are rendered through their print fmt, and fall back to
+ *           field=value pairs when the print fmt uses kernel helpers.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest010, TestSize.Level1)
+{
+    constexpr uint16_t plainEventId = 8;
+    constexpr uint16_t flagsEventId = 9;
+    vector<uint8_t> page = MakePage(1000000000, 0);
+    size_t pos = PAGE_HEADER_SIZE;
+    AppendMarkEvent(page, pos, 1000, -7, "abc", plainEventId); // 1000 : 1 us after the page, -7 : signed pid
+    AppendMarkEvent(page, pos, 2000, 100, "abc", flagsEventId); // 2000 : 2 us after the page
+    ASSERT_TRUE(WriteTestFile(MakeRawFile({page})));
+    DecodeStats stats;
+    vector<string> lines = DecodeTestFile(stats);
+    ASSERT_EQ(lines.size(), 2);
+    // the data_loc word is 0x0004000c: "%04hx" keeps the low 16 bits, "%c" the low byte, a form feed
+    EXPECT_EQ(lines[0].substr(lines[0].find("test_plain: ")), "test_plain: name=abc pid=-7 loc=000c \f\t100%");
+    EXPECT_EQ(lines[1].substr(lines[1].find("test_flags: ")), "test_flags: name=abc");
+    EXPECT_EQ(stats.formatMissCount, 0);
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest011
+ * @tc.desc: Test the page layout is taken from the commit field of header_page.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest011, TestSize.Level1)
+{
+    const string header64 = "\tfield: u64 timestamp;\toffset:0;\tsize:8;\tsigned:0;\n"
+        "\tfield: local_t commit;\toffset:8;\tsize:8;\tsigned:1;\n"
+        "\tfield: int overwrite;\toffset:8;\tsize:1;\tsigned:1;\n"
+        "\tfield: char data;\toffset:16;\tsize:4080;\tsigned:1;\n";
+    const string header32 = "\tfield: u64 timestamp;\toffset:0;\tsize:8;\tsigned:0;\n"
+        "\tfield: local_t commit;\toffset:8;\tsize:4;\tsigned:1;\n"
+        "\tfield: char data;\toffset:12;\tsize:4084;\tsigned:1;\n";
+    bool is32BitArch = true;
+    ASSERT_TRUE(ParseHeaderPageArch(header64, is32BitArch));
+    EXPECT_FALSE(is32BitArch);
+    ASSERT_TRUE(ParseHeaderPageArch(header32, is32BitArch));
+    EXPECT_TRUE(is32BitArch);
+    EXPECT_FALSE(ParseHeaderPageArch("\tfield: u64 timestamp;\toffset:0;\tsize:8;\tsigned:0;\n", is32BitArch));
+}
+
+/**
+ * @tc.name: RawTraceDecoderTest012
+ * @tc.desc: Test cpus cut into several shards merge in timestamp order across the shard seams, with fewer pool
+ *           threads than shards and with more.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDecoderTest, RawTraceDecoderTest012, TestSize.Level1)
+{
+    constexpr uint64_t baseTime = 1000000000;
+    constexpr size_t busyPages = 600; // 3 shards of 256 pages, the last one partial
+    constexpr size_t quietPages = 300; // 2 shards
+    vector<pair<uint64_t, string>> expected;
+    vector<vector<uint8_t>> cpuPages(2); // 2 : a busy and a quiet cpu
+    auto appendPage = [&expected, &cpuPages](size_t cpu, size_t page, uint64_t timestamp) {
+        vector<uint8_t> data = MakePage(timestamp, static_cast<uint8_t>(cpu));
+        size_t pos = PAGE_HEADER_SIZE;
+        string name = "c" + to_string(cpu) + "_" + to_string(page);
+        AppendMarkEvent(data, pos, 1000, 100, "B|90|H:" + name + "|I13"); // 1000 : 1 us after the page
+        cpuPages[cpu].insert(cpuPages[cpu].end(), data.begin(), data.end());
+        expected.emplace_back(timestamp, name);
+    };
+    for (size_t page = 0; page < busyPages; page++) {
+        appendPage(0, page, baseTime + page * 2000); // 2000 : ns between the busy cpu's pages
+    }
+    for (size_t page = 0; page < quietPages; page++) {
+        appendPage(1, page, baseTime + page * 4000 + 1000); // 4000 : ns between pages, 1000 : between the cpus
+    }
+    sort(expected.begin(), expected.end());
+    ASSERT_TRUE(WriteTestFile(MakeRawFile(cpuPages)));
+
+    for (size_t threadCount : {1, 2, 8}) { // 1 : the merger decodes too, 2 : fewer than shards, 8 : more
+        DecodeStats stats;
+        vector<string> lines = DecodeTestFile(stats, TEST_RAW_FILE, threadCount);
+        ASSERT_EQ(lines.size(), expected.size()) << "threads: " << threadCount;
+        for (size_t i = 0; i < lines.size(); i++) {
+            size_t begin = lines[i].find("H:");
+            ASSERT_NE(begin, string::npos);
+            ASSERT_EQ(lines[i].substr(begin + 2, lines[i].find('|', begin) - begin - 2), expected[i].second) <<
+                "threads: " << threadCount << ", line: " << i;
+        }
+        EXPECT_EQ(stats.eventCount[MARK_EVENT_ID], busyPages + quietPages);
+    }
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -16,6 +16,7 @@
 #include "hitrace_dump.h"
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstdio>
 #include <dirent.h>
 #include <fcntl.h>
@@ -24,6 +25,7 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -411,6 +413,66 @@ HWTEST_F(HitraceDumpTest, GetTraceModeTest_003, TestSize.Level0)
     ASSERT_EQ(traceMode, TraceMode::CLOSE);
 }
 
+/**
+ * @tc.name: GetTraceModeTest_004
+ * @tc.desc: test trace state and delivered markers for SubscribeTraceEvents and UnsubscribeTraceEvents
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDumpTest, GetTraceModeTest_004, TestSize.Level0)
+{
+    const std::vector<std::string> tagGroups = {"scene_performance"};
+    ASSERT_EQ(static_cast<int>(OpenTrace(tagGroups)), static_cast<int>(TraceErrorCode::SUCCESS));
+    TraceEventFilter filter;
+    filter.eventNames = {"unknown_event_for_subscribe"};
+    auto callback = [](const std::vector<TraceEventView>& events, uint64_t droppedCount) {};
+    ASSERT_EQ(static_cast<int>(SubscribeTraceEvents(filter, callback)),
+        static_cast<int>(TraceErrorCode::INVALID_EVENT_FILTER));
+    filter.eventNames = {};
+    ASSERT_EQ(static_cast<int>(SubscribeTraceEvents(filter, nullptr)),
+        static_cast<int>(TraceErrorCode::INVALID_EVENT_FILTER));
+
+    // the state outlives the test body, the callback may still run if an assertion below returns early
+    struct SubscribeState {
+        std::string marker;
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool found = false;
+        uint8_t modeInCallback = TraceMode::CLOSE;
+    };
+    auto state = std::make_shared<SubscribeState>();
+    state->marker = "B|" + std::to_string(getpid()) + "|GetTraceModeTest_004";
+    filter.pids = {getpid()};
+    ASSERT_EQ(static_cast<int>(SubscribeTraceEvents(filter, [state](const std::vector<TraceEventView>& events,
+        uint64_t droppedCount) {
+        for (const auto& event : events) {
+            if (event.payload == nullptr || std::string(event.payload, event.payloadSize).find(state->marker) != 0) {
+                continue;
+            }
+            uint8_t mode = GetTraceMode(); // the dump APIs stay usable from the callback
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->modeInCallback = mode;
+            state->found = true;
+            state->cond.notify_all();
+        }
+    })), static_cast<int>(TraceErrorCode::SUCCESS));
+    EXPECT_EQ(GetTraceMode(), TraceMode::OPEN | TraceMode::SUBSCRIBE);
+    EXPECT_EQ(static_cast<int>(RecordTraceOn()), static_cast<int>(TraceErrorCode::WRONG_TRACE_MODE));
+    EXPECT_EQ(DumpTrace().errorCode, TraceErrorCode::WRONG_TRACE_MODE);
+
+    std::ofstream traceMarker(GetTraceRootPath() + "trace_marker");
+    traceMarker << state->marker << std::flush;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cond.wait_for(lock, std::chrono::seconds(3), [&state] { return state->found; }); // 3 : flush intervals
+        EXPECT_TRUE(state->found);
+        EXPECT_EQ(state->modeInCallback, TraceMode::OPEN | TraceMode::SUBSCRIBE);
+    }
+
+    EXPECT_EQ(static_cast<int>(UnsubscribeTraceEvents()), static_cast<int>(TraceErrorCode::SUCCESS));
+    EXPECT_EQ(GetTraceMode(), TraceMode::OPEN);
+    ASSERT_EQ(static_cast<int>(CloseTrace()), static_cast<int>(TraceErrorCode::SUCCESS));
+}
+
 /**
  * @tc.name: DumpTraceTest_001
  * @tc.desc: Test DumpTrace(int maxDuration) for valid input.
@@ -769,6 +831,28 @@ HWTEST_F(HitraceDumpTest, DumpTraceTest_014, TestSize.Level0)
     ASSERT_TRUE(CheckBaseInfo(outputFiles[0])) << outputFiles[0];
 }
 
+/**
+ * @tc.name: DumpTraceTest_015
+ * @tc.desc: Test the dump pipeline metrics returned by DumpTrace.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDumpTest, DumpTraceTest_015, TestSize.Level0)
+{
+    const std::vector<std::string> tagGroups = {"default"};
+    ASSERT_EQ(static_cast<int>(OpenTrace(tagGroups)), static_cast<int>(TraceErrorCode::SUCCESS));
+    sleep(1); // wait 1s
+    TraceRetInfo ret = DumpTrace();
+    ASSERT_EQ(static_cast<int>(ret.errorCode), static_cast<int>(TraceErrorCode::SUCCESS));
+    ASSERT_GT(ret.dumpMetrics.cpuCount, 0);
+    uint64_t totalBytes = 0;
+    for (uint32_t cpu = 0; cpu < ret.dumpMetrics.cpuCount && cpu < DUMP_METRICS_MAX_CPU; cpu++) {
+        totalBytes += ret.dumpMetrics.cpuBytesRead[cpu];
+    }
+    ASSERT_GT(totalBytes, 0);
+    ASSERT_GT(ret.dumpMetrics.metaDurationUs + ret.dumpMetrics.readDurationUs, 0);
+    ASSERT_EQ(static_cast<int>(CloseTrace()), static_cast<int>(TraceErrorCode::SUCCESS));
+}
+
 /**
  * @tc.name: DumpForServiceMode_001
  * @tc.desc: Correct capturing trace using default OpenTrace.
@@ -1659,4 +1743,36 @@ HWTEST_F(HitraceDumpTest, DynamicBufferTest001, TestSize.Level2)
         ASSERT_EQ(dynamicBuffer.CalculateBufferSize().size(), 0lu);
     }
 }
+
+/**
+ * @tc.name: MergeTraceFilesTest001
+ * @tc.desc: Test MergeTraceFiles with cache slices and illegal inputs
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceDumpTest, MergeTraceFilesTest001, TestSize.Level2)
+{
+    ASSERT_EQ(MergeTraceFiles({}).errorCode, TraceErrorCode::FILE_ERROR);
+    ASSERT_EQ(MergeTraceFiles({"/data/local/tmp/trace_not_in_dir.sys"}).errorCode, TraceErrorCode::FILE_ERROR);
+
+    std::vector<std::string> slices = GetCacheTrace();
+    ASSERT_FALSE(slices.empty());
+    int64_t slicesSize = 0;
+    for (const auto& slice : slices) {
+        slicesSize += static_cast<int64_t>(GetFileStatInfo(slice).st_size);
+    }
+    TraceRetInfo ret = MergeTraceFiles(slices);
+    ASSERT_EQ(ret.errorCode, TraceErrorCode::SUCCESS);
+    ASSERT_EQ(ret.outputFiles.size(), 1u);
+    struct stat mergedStat = GetFileStatInfo(ret.outputFiles[0]);
+    ASSERT_EQ(ret.fileSize, static_cast<int64_t>(mergedStat.st_size));
+    ASSERT_GT(ret.fileSize, 0);
+    ASSERT_LE(ret.fileSize, slicesSize);
+    ASSERT_GT(mergedStat.st_ctime, 0);
+
+    std::vector<std::string> withIllegal = slices;
+    withIllegal.push_back("/data/local/tmp/trace_not_in_dir.sys");
+    ASSERT_EQ(MergeTraceFiles(withIllegal).errorCode, TraceErrorCode::FILE_ERROR);
+    DeleteTraceFileInDir(GetTraceFilesInDir(TraceDumpType::TRACE_CACHE));
+    DeleteTraceFileInDir(GetTraceFilesInDir(TraceDumpType::TRACE_SNAPSHOT));
+}
 } // namespace
@@ -13,16 +13,24 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <linux/perf_event.h>
 #include <vector>
 #include <string>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
 
 #include "common_define.h"
 #include "common_utils.h"
 #include "hitrace_meter.h"
 #include "hitrace_meter_test_utils.h"
 #include "hitrace/tracechain.h"
+#include "parameters.h"
 
 using namespace testing::ext;
 using namespace OHOS::HiviewDFX::Hitrace;
@@ -119,6 +127,34 @@ void HitraceMeterTest::TearDown(void)
     ASSERT_TRUE(CleanTrace()) << "TearDown: Cleaning trace failed.";
 }
 
+// errno of opening the hardware counter on this thread, 0 if the pmu counts it
+static int ProbePerfCounter(uint64_t config)
+{
+    struct perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd == -1) {
+        return errno;
+    }
+    close(fd);
+    return 0;
+}
+
+// the value after prefix in the first matching counter record
+static bool GetCounterValue(const std::vector<std::string>& list, const std::string& prefix, long long& value)
+{
+    for (const auto& line : list) {
+        size_t pos = line.find(prefix);
+        if (pos != std::string::npos) {
+            value = std::strtoll(line.c_str() + pos + prefix.size(), nullptr, 10); // 10 : decimal
+            return true;
+        }
+    }
+    return false;
+}
+
 static void GetLibPathsBySystemBits(std::vector<std::string> &filePaths)
 {
     std::vector<std::string> lib64FilePaths = {
@@ -2998,6 +3034,195 @@ HWTEST_F(HitraceMeterTest, HitraceMeterTest013, TestSize.Level1)
     ASSERT_LE(duration, 2 * printCostLimit * printRepeat / msToUs) <<
         "HitraceMeterTest013: StartTrace and FinishTrace took too long.";
 }
+
+/**
+ * @tc.name: HitraceMeterTest014
+ * @tc.desc: Testing the HitraceScoped span statistics of the current and an exited thread.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceMeterTest, HitraceMeterTest014, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceMeterTest014: start.";
+    constexpr int spanRepeat = 100;
+    const std::string name = "HitraceMeterTest014";
+    SetTraceStatsEnabled(true);
+    for (int i = 0; i < spanRepeat; ++i) {
+        HITRACE_METER_NAME(TAG, name);
+    }
+    std::thread worker([&name] {
+        HITRACE_METER_NAME(TAG, name);
+    });
+    worker.join();
+    SetTraceStatsEnabled(false);
+    {
+        HITRACE_METER_NAME(TAG, name);
+    }
+    std::vector<HitraceSpanStat> stats;
+    GetTraceStats(stats);
+    auto stat = std::find_if(stats.begin(), stats.end(), [&name](const HitraceSpanStat& item) {
+        return item.tag == TAG && item.name == name;
+    });
+    ASSERT_NE(stat, stats.end());
+    EXPECT_EQ(stat->count, spanRepeat + 1);
+    EXPECT_LE(stat->maxNs, stat->totalNs);
+    uint64_t histogramCount = 0;
+    for (const auto& bucket : stat->histogram) {
+        histogramCount += bucket.second;
+    }
+    EXPECT_EQ(histogramCount, stat->count);
+    GTEST_LOG_(INFO) << "HitraceMeterTest014: end.";
+}
+
+/**
+ * @tc.name: HitraceMeterTest015
+ * @tc.desc: Testing HitracePerfCountersScoped counts and traces the chosen counters, on the counters the thread keeps.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceMeterTest, HitraceMeterTest015, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceMeterTest015: start.";
+    std::string name = "HitraceMeterTest015";
+    ASSERT_TRUE(CleanTrace());
+    int openErr = ProbePerfCounter(PERF_COUNT_HW_BRANCH_MISSES);
+    long long lastCount[2] = {0}; // 2 : the second scope reuses the counters of the first
+    for (int i = 0; i < 2; ++i) { // 2 : the second scope reuses the counters of the first
+        HitracePerfCountersScoped perfScoped(true, TAG, name + std::to_string(i), HITRACE_PERF_BRANCH_MISSES);
+        long long firstCount = perfScoped.GetCount(HITRACE_PERF_BRANCH_MISSES);
+        volatile int sum = 0;
+        for (int j = 0; j < 1000; ++j) { // 1000 : a few branches to count
+            sum = sum + ((j % 3 == 0) ? j : 1); // 3 : mixes the branch outcomes
+        }
+        lastCount[i] = perfScoped.GetCount(HITRACE_PERF_BRANCH_MISSES);
+        GTEST_LOG_(INFO) << "branch misses " << firstCount << " -> " << lastCount[i] << ", open errno " << openErr;
+        if (openErr != 0) {
+            EXPECT_EQ(lastCount[i], openErr);
+            EXPECT_EQ(perfScoped.GetCount(HITRACE_PERF_INSTRUCTIONS), openErr);
+            continue;
+        }
+        EXPECT_GE(firstCount, 0);
+        EXPECT_GE(lastCount[i], firstCount);
+        EXPECT_EQ(perfScoped.GetCount(HITRACE_PERF_INSTRUCTIONS), 0); // not counted by the scope
+    }
+    std::vector<std::string> list = ReadTrace();
+    EXPECT_FALSE(FindResult("HitraceMeterTest0150-Ins", list));
+    EXPECT_FALSE(FindResult("HitraceMeterTest0150-Cycle", list));
+    for (int i = 0; i < 2; ++i) { // 2 : one marker per scope
+        long long value = -1;
+        bool found = GetCounterValue(list, "H:" + name + std::to_string(i) + "-BranchMiss|", value);
+        if (openErr != 0) {
+            EXPECT_FALSE(found);
+            continue;
+        }
+        ASSERT_TRUE(found);
+        EXPECT_GE(value, lastCount[i]); // the marker is read when the scope ends
+    }
+
+    // more counters than the two of HitracePerfScoped, every one that opens gets its marker
+    ASSERT_TRUE(CleanTrace());
+    {
+        HitracePerfCountersScoped perfScoped(true, TAG, name, HITRACE_PERF_INSTRUCTIONS | HITRACE_PERF_CPU_CYCLES |
+            HITRACE_PERF_CACHE_MISSES | HITRACE_PERF_BRANCH_MISSES);
+    }
+    list = ReadTrace();
+    const std::pair<uint64_t, std::string> events[] = {
+        {PERF_COUNT_HW_INSTRUCTIONS, "-Ins"}, {PERF_COUNT_HW_CPU_CYCLES, "-Cycle"},
+        {PERF_COUNT_HW_CACHE_MISSES, "-CacheMiss"}, {PERF_COUNT_HW_BRANCH_MISSES, "-BranchMiss"},
+    };
+    for (const auto& [config, suffix] : events) {
+        long long value = -1;
+        EXPECT_EQ(GetCounterValue(list, "H:" + name + suffix + "|", value), ProbePerfCounter(config) == 0) << suffix;
+    }
+    GTEST_LOG_(INFO) << "HitraceMeterTest015: end.";
+}
+
+/**
+ * @tc.name: HitraceMeterTest016
+ * @tc.desc: Testing CountTraceBatch writes all the counters in one marker.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceMeterTest, HitraceMeterTest016, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceMeterTest016: start.";
+    ASSERT_TRUE(CleanTrace());
+    const HiTraceCounter counters[] = {
+        {"HitraceMeterTest016-fps", 60}, // 60 : counter value
+        {"HitraceMeterTest016-mem", 1024}, // 1024 : counter value
+    };
+    CountTraceBatch(TAG, counters, sizeof(counters) / sizeof(counters[0]));
+    CountTraceBatch(TAG, nullptr, 1);
+    CountTraceBatch(TAG, counters, 0);
+    std::vector<std::string> list = ReadTrace();
+    ASSERT_TRUE(FindResult("|HitraceMeterTest016-fps|60|HitraceMeterTest016-mem|1024", list));
+    GTEST_LOG_(INFO) << "HitraceMeterTest016: end.";
+}
+
+/**
+ * @tc.name: HitraceMeterTest017
+ * @tc.desc: Testing a published tag change reaches the next trace call without UpdateTraceLabel, and a change
+ *           set without a publish is seen after the periodic re-check.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceMeterTest, HitraceMeterTest017, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceMeterTest017: start.";
+    ASSERT_TRUE(CleanTrace());
+    ASSERT_TRUE(SetPropertyInner(TRACE_TAG_ENABLE_FLAGS, "0"));
+    StartTrace(TAG, "HitraceMeterTest017-off");
+    FinishTrace(TAG);
+    ASSERT_TRUE(SetPropertyInner(TRACE_TAG_ENABLE_FLAGS, std::to_string(TAG)));
+    StartTrace(TAG, "HitraceMeterTest017-on");
+    FinishTrace(TAG);
+    std::vector<std::string> list = ReadTrace();
+    EXPECT_FALSE(FindResult("HitraceMeterTest017-off", list));
+    EXPECT_TRUE(FindResult("HitraceMeterTest017-on", list));
+
+    // like a bare "param set", the control page generation does not move
+    ASSERT_TRUE(CleanTrace());
+    ASSERT_TRUE(OHOS::system::SetParameter(TRACE_TAG_ENABLE_FLAGS, "0"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 200 : past the 100 ms re-check
+    StartTrace(TAG, "HitraceMeterTest017-unpublished");
+    FinishTrace(TAG);
+    ASSERT_TRUE(SetPropertyInner(TRACE_TAG_ENABLE_FLAGS, std::to_string(TAG)));
+    list = ReadTrace();
+    EXPECT_FALSE(FindResult("HitraceMeterTest017-unpublished", list));
+    GTEST_LOG_(INFO) << "HitraceMeterTest017: end.";
+}
+
+/**
+ * @tc.name: HitraceMeterTest018
+ * @tc.desc: Testing SetCounterCoalescing drops repeated CountTrace values and writes the held ones later.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceMeterTest, HitraceMeterTest018, TestSize.Level1)
+{
+    GTEST_LOG_(INFO) << "HitraceMeterTest018: start.";
+    ASSERT_TRUE(CleanTrace());
+    const std::string name = "HitraceMeterTest018";
+    SetCounterCoalescing(true, 0);
+    CountTrace(TAG, name, 1);
+    CountTrace(TAG, name, 1); // dropped, the value repeats
+    CountTrace(TAG, name, 2);
+    constexpr uint64_t intervalUs = 10000; // 10 ms
+    SetCounterCoalescing(true, intervalUs);
+    CountTrace(TAG, name, 3); // the first value after the enable
+    CountTrace(TAG, name, 4); // held back, no update of it follows
+    std::this_thread::sleep_for(std::chrono::microseconds(intervalUs * 2)); // 2 : past the interval
+    CountTrace(TAG, name + "-other", 1); // releases the held value of the quiet counter
+    CountTrace(TAG, name, 5); // held back until the coalescing is turned off
+    SetCounterCoalescing(false, 0);
+
+    std::vector<std::string> list = ReadTrace();
+    auto countRecords = [&list, &name](int64_t value) {
+        std::string record = "|H:" + name + "|" + std::to_string(value) + "|";
+        return std::count_if(list.begin(), list.end(), [&record](const std::string& line) {
+            return line.find(record) != std::string::npos;
+        });
+    };
+    for (int64_t value = 1; value <= 5; value++) { // 5 : every value is written once
+        EXPECT_EQ(countRecords(value), 1) << "value " << value;
+    }
+    GTEST_LOG_(INFO) << "HitraceMeterTest018: end.";
+}
 }
 }
 }
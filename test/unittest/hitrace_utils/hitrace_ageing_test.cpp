@@ -41,6 +41,13 @@ void CreateFile(const std::string& filename)
     std::ofstream file(filename);
 }
 
+// the ageing reads the sizes from the ledger, so the files really hold the bytes the test lists
+void CreateFile(const std::string& filename, int64_t fileSize)
+{
+    std::ofstream file(filename);
+    file << std::string(fileSize, 'a');
+}
+
 void ClearFile()
 {
     OHOS::HiviewDFX::Hitrace::TraverseFiles(HitTraceDir(), true, [](const char* dirPath, const dirent* entry) {
@@ -198,8 +205,8 @@ HWTEST_F(HitraceAgeingTest, HandleAgeing_002, TestSize.Level1)
     for (uint32_t i = 0; i < 7; i++) {
         TraceFileInfo info;
         info.filename = HitTraceDir() + "record_trace_" + std::to_string(i) + ".a";
-        CreateFile(info.filename);
         info.fileSize = 100 * 1024;
+        CreateFile(info.filename, info.fileSize);
         vec.push_back(info);
 
         std::string otherFile = HitTraceDir() + "record_trace_" + std::to_string(i) + ".b";
@@ -356,8 +363,8 @@ HWTEST_F(HitraceAgeingTest, HandleAgeing_006, TestSize.Level1)
     for (uint32_t i = 0; i < 7; i++) {
         TraceFileInfo info;
         info.filename = HitTraceDir() + "trace_" + std::to_string(i) + ".a";
-        CreateFile(info.filename);
         info.fileSize = 100 * 1024;
+        CreateFile(info.filename, info.fileSize);
         vec.push_back(info);
 
         std::string otherFile = HitTraceDir() + "trace_" + std::to_string(i) + ".b";
@@ -395,8 +402,8 @@ HWTEST_F(HitraceAgeingTest, HandleAgeing_007, TestSize.Level1)
     for (uint32_t i = 0; i < 8; i++) {
         TraceFileInfo info;
         info.filename = HitTraceDir() + "trace_" + std::to_string(i) + ".a";
-        CreateFile(info.filename);
         info.fileSize = 100 * 1024;
+        CreateFile(info.filename, info.fileSize);
         vec.push_back(info);
 
         std::string otherFile = HitTraceDir() + "trace_" + std::to_string(i) + ".b";
@@ -439,8 +446,8 @@ HWTEST_F(HitraceAgeingTest, HandleAgeing_008, TestSize.Level1)
     for (uint32_t i = 0; i < 22; i++) {
         TraceFileInfo& info = vec.emplace_back();
         info.filename = HitTraceDir() + "trace_" + std::to_string(i) + ".a";
-        CreateFile(info.filename);
         info.fileSize = 100 * 1024;
+        CreateFile(info.filename, info.fileSize);
         if (i <= DEFAULT_LINK_NUM) {
             std::string value = "1";
             int ret = TEMP_FAILURE_RETRY(
@@ -464,6 +471,77 @@ HWTEST_F(HitraceAgeingTest, HandleAgeing_008, TestSize.Level1)
     }
 }
 
+/**
+ * @tc.name: TraceFileLedger_001
+ * @tc.desc: test the ledger keeps file count, sizes and totals in step with creations, writes and deletions
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceAgeingTest, TraceFileLedger_001, TestSize.Level1)
+{
+    ClearFile();
+    auto& ledger = TraceFileLedger::GetInstance();
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_RECORDING), 0);
+
+    constexpr int64_t fileSize = 1024;
+    for (uint32_t i = 0; i < 3; i++) {
+        std::ofstream file(HitTraceDir() + "record_trace_" + std::to_string(i) + ".a");
+        file << std::string(fileSize, 'a');
+    }
+    CreateFile(HitTraceDir() + "trace_0.a");
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_RECORDING), 3);
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_SNAPSHOT), 1);
+    {
+        // still open: the size comes from the IN_MODIFY of the write, not from a close
+        std::ofstream file(HitTraceDir() + "record_trace_0.a", std::ios::app);
+        file << std::string(fileSize, 'a');
+        file.flush();
+        std::vector<TraceFileInfo> fileList;
+        GetTraceFilesInDir(fileList, TraceDumpType::TRACE_RECORDING);
+        int64_t totalSize = 0;
+        for (const auto& info : fileList) {
+            totalSize += info.fileSize;
+        }
+        EXPECT_EQ(totalSize, 4 * fileSize); // 4 : three files, one written twice
+        EXPECT_EQ(ledger.GetTotalSize(TraceDumpType::TRACE_RECORDING), totalSize);
+    }
+    EXPECT_EQ(ledger.GetTotalSize(TraceDumpType::TRACE_SNAPSHOT), 0);
+    std::vector<TraceFileInfo> listed;
+    GetTraceFilesInDir(listed, TraceDumpType::TRACE_RECORDING);
+    EXPECT_FALSE(ledger.HasFilesBesides(listed, TraceDumpType::TRACE_RECORDING));
+    listed.pop_back();
+    EXPECT_TRUE(ledger.HasFilesBesides(listed, TraceDumpType::TRACE_RECORDING));
+
+    EXPECT_TRUE(RemoveFile(HitTraceDir() + "record_trace_1.a"));
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_RECORDING), 2);
+    EXPECT_EQ(ledger.GetTotalSize(TraceDumpType::TRACE_RECORDING), 3 * fileSize); // 3 : the file written twice left
+    std::set<std::string> fileSet;
+    GetTraceFileNamesInDir(fileSet, TraceDumpType::TRACE_RECORDING);
+    EXPECT_EQ(fileSet.count(HitTraceDir() + "record_trace_1.a"), 0);
+    EXPECT_EQ(fileSet.count(HitTraceDir() + "record_trace_2.a"), 1);
+}
+
+/**
+ * @tc.name: TraceFileLedger_002
+ * @tc.desc: test the ledger follows a cache file renamed into a snapshot file
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceAgeingTest, TraceFileLedger_002, TestSize.Level1)
+{
+    ClearFile();
+    auto& ledger = TraceFileLedger::GetInstance();
+    std::string cacheFile = HitTraceDir() + "cache_trace_0.sys";
+    CreateFile(cacheFile);
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_CACHE), 1);
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_SNAPSHOT), 0);
+
+    std::string newFile = RenameCacheFile(cacheFile);
+    EXPECT_EQ(newFile, HitTraceDir() + "trace_0.sys");
+    EXPECT_EQ(ledger.GetFileCount(TraceDumpType::TRACE_CACHE), 0);
+    std::vector<TraceFileInfo> fileList;
+    GetTraceFilesInDir(fileList, TraceDumpType::TRACE_SNAPSHOT);
+    ASSERT_EQ(fileList.size(), 1);
+    EXPECT_EQ(fileList[0].filename, newFile);
+}
 } // namespace Hitrace
 } // namespace HiviewDFX
 } // namespace OHOS
\ No newline at end of file
@@ -19,15 +19,20 @@
 #include <gtest/gtest.h>
 #include <climits>
 #include <string>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <vector>
 
 #include "common_define.h"
 #include "common_utils.h"
 #include "hitrace_option_util.h"
 #include "smart_fd.h"
+#include "trace_control_page.h"
+#include "trace_counter_coalescer.h"
 #include "trace_file_utils.h"
 #include "trace_json_parser.h"
+#include "trace_rate_limiter.h"
 
 using namespace testing::ext;
 using namespace std;
@@ -672,6 +677,171 @@ HWTEST_F(HitraceUtilsTest, IsTraceFilePathLegal001, TestSize.Level2)
     remove(errpathFile.c_str());
     GTEST_LOG_(INFO) << "IsTraceFilePathLegal001: end.";
 }
+
+std::vector<SuppressedReport> g_suppressedReports;
+
+void CollectSuppressedReport(const SuppressedReport& report)
+{
+    g_suppressedReports.push_back(report);
+}
+
+/**
+ * @tc.name: TraceRateLimiterTest001
+ * @tc.desc: test TraceRateLimiter drops whole B/E and S/F pairs once the burst is spent and reports the drops.
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceUtilsTest, TraceRateLimiterTest001, TestSize.Level2)
+{
+    GTEST_LOG_(INFO) << "TraceRateLimiterTest001: start.";
+    constexpr uint64_t limitedTag = 1ULL << 3;
+    constexpr uint64_t second = 1000000000;
+    static TraceRateLimiter limiter;
+    limiter.Configure("3:1:20,bad,64:10", 0);
+    EXPECT_EQ(limiter.GetLimitedTags(), limitedTag);
+    SuppressedReport report;
+    EXPECT_TRUE(limiter.Admit('B', 1ULL << 4, "other", 0, 0, report));
+    int kept = 0;
+    for (int i = 0; i < 20; i++) { // 20 : twice the burst in pairs
+        bool begin = limiter.Admit('B', limitedTag, "slice", 0, 0, report);
+        EXPECT_EQ(limiter.Admit('E', limitedTag, "slice", 0, 0, report), begin);
+        kept += begin ? 1 : 0;
+    }
+    EXPECT_EQ(kept, 10); // 10 : a pair costs two of the 20 tokens
+    EXPECT_EQ(report.tag, 0);
+
+    EXPECT_FALSE(limiter.Admit('S', limitedTag, "async", 1, second, report));
+    EXPECT_EQ(report.tag, limitedTag);
+    EXPECT_EQ(report.suppressed, 21); // 21 : 20 of the B/E markers and the S
+    EXPECT_FALSE(limiter.Admit('F', limitedTag, "async", 1, second, report));
+    EXPECT_TRUE(limiter.Admit('F', limitedTag, "async", 2, second, report));
+
+    report = SuppressedReport();
+    EXPECT_TRUE(limiter.Admit('C', limitedTag, "counter", 0, second * 2, report)); // 2 : one token a second
+    EXPECT_EQ(report.tag, limitedTag); // the drop of the F is reported by the next admitted marker
+    EXPECT_EQ(report.suppressed, 22); // 22 : the F joined the 21 reported drops
+    EXPECT_TRUE(limiter.Admit('C', limitedTag, "counter", 0, second * 2, report)); // 2 : the second token
+    EXPECT_FALSE(limiter.Admit('C', limitedTag, "counter", 0, second * 2, report)); // 2 : no token left
+    limiter.Configure("", 0, CollectSuppressedReport);
+    EXPECT_EQ(limiter.GetLimitedTags(), 0);
+    ASSERT_EQ(g_suppressedReports.size(), 1);
+    EXPECT_EQ(g_suppressedReports[0].tag, limitedTag);
+    EXPECT_EQ(g_suppressedReports[0].suppressed, 23); // 23 : the last drop is reported on the reconfigure
+    limiter.Configure("", 0, CollectSuppressedReport);
+    EXPECT_EQ(g_suppressedReports.size(), 1);
+    GTEST_LOG_(INFO) << "TraceRateLimiterTest001: end.";
+}
+std::vector<HeldCounter> g_heldCounters;
+std::vector<std::string> g_heldNames;
+
+void CollectHeldCounter(const HeldCounter& counter)
+{
+    g_heldCounters.push_back(counter);
+    g_heldNames.emplace_back(counter.name);
+}
+
+/**
+ * @tc.name: TraceCounterCoalescerTest001
+ * @tc.desc: test TraceCounterCoalescer drops repeated values, holds back early changes and flushes the last one.
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceUtilsTest, TraceCounterCoalescerTest001, TestSize.Level2)
+{
+    GTEST_LOG_(INFO) << "TraceCounterCoalescerTest001: start.";
+    constexpr uint64_t tag = 1ULL << 3;
+    constexpr uint64_t interval = 1000;
+    static TraceCounterCoalescer coalescer;
+    coalescer.Configure(true, 0);
+    EXPECT_TRUE(coalescer.IsEnabled());
+    EXPECT_TRUE(coalescer.Admit(tag, "fps", 60, 1, 0)); // 60 : first value
+    EXPECT_FALSE(coalescer.Admit(tag, "fps", 60, 1, 0)); // 60 : repeated value
+    std::string name = "fps";
+    EXPECT_FALSE(coalescer.Admit(tag, name.c_str(), 60, 1, 0)); // 60 : same name from another buffer
+    EXPECT_TRUE(coalescer.Admit(tag << 1, "fps", 60, 1, 0)); // 60 : same name of another tag
+    EXPECT_TRUE(coalescer.Admit(tag, "fps", 59, 1, 0)); // 59 : changed value
+    std::string longName(TraceCounterCoalescer::NAME_SIZE_MAX, 'a');
+    EXPECT_TRUE(coalescer.Admit(tag, longName.c_str(), 1, 1, 0));
+    EXPECT_TRUE(coalescer.Admit(tag, longName.c_str(), 1, 1, 0));
+    coalescer.Invalidate();
+    EXPECT_TRUE(coalescer.Admit(tag, "fps", 59, 1, 0)); // 59 : first value after the invalidation
+
+    coalescer.Configure(true, interval);
+    EXPECT_TRUE(coalescer.Admit(tag, "mem", 1, 1, 0));
+    EXPECT_FALSE(coalescer.Admit(tag, "mem", 2, 1, interval / 2)); // 2 : held back
+    EXPECT_FALSE(coalescer.Admit(tag, "mem", 3, 1, interval / 2)); // 3 : replaces the held value
+    EXPECT_TRUE(coalescer.Admit(tag, "mem", 4, 1, interval)); // 4 : the interval passed
+    EXPECT_FALSE(coalescer.Admit(tag, "mem", 5, 2, interval + 1)); // 5 : held back until the flush
+    coalescer.Configure(false, 0);
+    EXPECT_FALSE(coalescer.IsEnabled());
+    EXPECT_EQ(coalescer.Flush(CollectHeldCounter), 1);
+    ASSERT_EQ(g_heldCounters.size(), 1);
+    EXPECT_EQ(g_heldCounters[0].tag, tag);
+    EXPECT_EQ(g_heldCounters[0].level, 2);
+    EXPECT_EQ(g_heldCounters[0].value, 5);
+    EXPECT_EQ(g_heldNames[0], "mem");
+    EXPECT_EQ(coalescer.Flush(CollectHeldCounter), 0);
+    GTEST_LOG_(INFO) << "TraceCounterCoalescerTest001: end.";
+}
+
+/**
+ * @tc.name: TraceCounterCoalescerTest002
+ * @tc.desc: test TraceCounterCoalescer releases a quiet held value after the interval and writes an unchanged
+ *           value again after the maximum age.
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceUtilsTest, TraceCounterCoalescerTest002, TestSize.Level2)
+{
+    GTEST_LOG_(INFO) << "TraceCounterCoalescerTest002: start.";
+    constexpr uint64_t tag = 1ULL << 3;
+    constexpr uint64_t interval = 2000000; // 2 ms, above the minimum release period
+    constexpr uint64_t maxAge = interval * 10;
+    static TraceCounterCoalescer coalescer;
+    coalescer.Configure(true, interval, maxAge);
+    EXPECT_TRUE(coalescer.NeedsTime());
+    g_heldCounters.clear();
+    g_heldNames.clear();
+    EXPECT_TRUE(coalescer.Admit(tag, "cpu", 1, 1, 0));
+    EXPECT_FALSE(coalescer.Admit(tag, "cpu", 2, 1, interval / 2)); // 2 : held back
+    EXPECT_EQ(coalescer.ReleaseDue(interval / 2, CollectHeldCounter), 0); // the interval has not passed
+    EXPECT_EQ(coalescer.ReleaseDue(interval, CollectHeldCounter), 0); // the table was scanned a moment ago
+    EXPECT_EQ(coalescer.ReleaseDue(interval * 2, CollectHeldCounter), 1); // 2 : the next scan
+    ASSERT_EQ(g_heldCounters.size(), 1);
+    EXPECT_EQ(g_heldCounters[0].value, 2);
+    EXPECT_EQ(g_heldNames[0], "cpu");
+
+    EXPECT_FALSE(coalescer.Admit(tag, "cpu", 2, 1, interval * 2 + 1)); // 2 : the released value repeated
+    EXPECT_TRUE(coalescer.Admit(tag, "cpu", 2, 1, interval * 2 + maxAge)); // 2 : written again after the age
+    EXPECT_FALSE(coalescer.Admit(tag, "cpu", 2, 1, interval * 2 + maxAge + 1));
+    coalescer.Configure(true, 0);
+    EXPECT_FALSE(coalescer.NeedsTime());
+    EXPECT_EQ(coalescer.ReleaseDue(maxAge * 2, CollectHeldCounter), 0); // 2 : no interval, nothing is held
+    GTEST_LOG_(INFO) << "TraceCounterCoalescerTest002: end.";
+}
+
+/**
+ * @tc.name: TraceControlPageTest001
+ * @tc.desc: test a publish stamps the control page and moves the generation a mapped reader sees.
+ * @tc.type: FUNC
+*/
+HWTEST_F(HitraceUtilsTest, TraceControlPageTest001, TestSize.Level2)
+{
+    GTEST_LOG_(INFO) << "TraceControlPageTest001: start.";
+    PublishTraceControl();
+    const TraceControlPage* page = MapTraceControlPage();
+    ASSERT_NE(page, nullptr);
+    EXPECT_EQ(page->magic, TRACE_CONTROL_PAGE_MAGIC);
+    uint64_t generation = page->generation.load();
+    PublishTraceControl();
+    EXPECT_GT(page->generation.load(), generation);
+    generation = page->generation.load();
+    EXPECT_TRUE(SetPropertyInner(TRACE_LEVEL_THRESHOLD, GetPropertyInner(TRACE_LEVEL_THRESHOLD, "1")));
+    EXPECT_GT(page->generation.load(), generation);
+    munmap(const_cast<TraceControlPage*>(page), PAGE_SIZE);
+
+    EXPECT_TRUE(IsTraceControlProperty(TRACE_TAG_ENABLE_FLAGS));
+    EXPECT_TRUE(IsTraceControlProperty(TRACE_TAG_RATE_LIMIT));
+    EXPECT_FALSE(IsTraceControlProperty(TRACE_BOOT_ACTIVE_FLAG));
+    GTEST_LOG_(INFO) << "TraceControlPageTest001: end.";
+}
 } // namespace
 } // namespace Hitrace
 } // namespace HiviewDFX
@@ -15,8 +15,12 @@
 
 use std::io::{Error};
 use std::process::Command;
+use std::thread;
+use std::time::Duration;
 
 const TRACE_TAG_ENABLE_FLAGS: &str = "debug.hitrace.tags.enableflags";
+// a bare "param set" does not publish to the control page, the meter re-checks the parameters every 100 ms
+const PARAM_RECHECK_WAIT_MS: u64 = 200;
 
 extern "C" {
     // bool SetTraceEventPid();
@@ -36,6 +40,7 @@ fn set_params(key: &str, value: &str) -> Result<bool, Error> {
         Ok(out) => {
             let output_str = String::from_utf8_lossy(&out.stdout).into_owned();
             println!( "execute command result: {}", output_str);
+            thread::sleep(Duration::from_millis(PARAM_RECHECK_WAIT_MS));
             Ok(output_str.contains("success"))
         }
         Err(err) => {
@@ -14,7 +14,10 @@
  */
 
 #include <atomic>
+#include <cstring>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <map>
 #include <string>
 #include <sys/stat.h>
 #include <thread>
@@ -23,6 +26,7 @@
 #include "common_define.h"
 #include "common_utils.h"
 #include "hitrace_dump.h"
+#include "trace_file_merger.h"
 #include "trace_source_factory.h"
 
 using namespace testing::ext;
@@ -681,6 +685,185 @@ HWTEST_F(HitraceFactoryTest, TraceBufferManagerTest05, TestSize.Level2)
         TraceBufferManager::GetInstance().ReleaseTaskBlocks(i + 1);
     }
 }
+
+/**
+ * @tc.name: TraceBufferManagerTest06
+ * @tc.desc: Test TraceBufferManager spills the oldest block once the memory budget is exhausted.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceFactoryTest, TraceBufferManagerTest06, TestSize.Level2)
+{
+    const uint64_t taskId = 1;
+    const size_t maxBlocks = DEFAULT_MAX_TOTAL_SZ / DEFAULT_BLOCK_SZ;
+    const uint8_t pattern[] = { 0x5a, 0xa5, 0x5a, 0xa5 };
+    for (size_t i = 0; i < maxBlocks; i++) {
+        auto block = TraceBufferManager::GetInstance().AllocateBlockWithSpill(taskId, 0);
+        ASSERT_NE(block, nullptr);
+        ASSERT_TRUE(block->Append(pattern, sizeof(pattern)));
+    }
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetTaskSpilledBytes(taskId), 0);
+    EXPECT_EQ(TraceBufferManager::GetInstance().AllocateBlock(taskId, 0), nullptr);
+
+    auto block = TraceBufferManager::GetInstance().AllocateBlockWithSpill(taskId, 1);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(block->data.size(), DEFAULT_BLOCK_SZ);
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetCurrentTotalSize(), DEFAULT_MAX_TOTAL_SZ);
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetTaskSpilledBytes(taskId), sizeof(pattern));
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetTaskTotalUsedBytes(taskId), maxBlocks * sizeof(pattern));
+
+    auto buffers = TraceBufferManager::GetInstance().GetTaskBuffers(taskId);
+    ASSERT_TRUE(buffers.front()->IsSpilled());
+    uint8_t readBack[sizeof(pattern)] = {};
+    EXPECT_EQ(TraceBufferManager::GetInstance().ReadSpilledBlock(taskId, *buffers.front(), 0, readBack,
+        sizeof(readBack)), sizeof(pattern));
+    EXPECT_EQ(memcmp(readBack, pattern, sizeof(pattern)), 0);
+
+    TraceBufferManager::GetInstance().ReleaseTaskBlocks(taskId);
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetCurrentTotalSize(), 0);
+    EXPECT_EQ(TraceBufferManager::GetInstance().GetTaskSpilledBytes(taskId), 0);
+}
+
+using TestSections = std::vector<std::pair<uint8_t, std::string>>;
+
+static void WriteTestSlice(const std::string& file, const TestSections& sections)
+{
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    TraceFileHeader header;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& [type, data] : sections) {
+        TraceFileContentHeader contentHeader;
+        contentHeader.type = type;
+        contentHeader.length = static_cast<uint32_t>(data.size());
+        out.write(reinterpret_cast<const char*>(&contentHeader), sizeof(contentHeader));
+        out.write(data.data(), data.size());
+    }
+}
+
+static TestSections ReadTestSlice(const std::string& file)
+{
+    TestSections sections;
+    std::ifstream in(file, std::ios::binary);
+    TraceFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magicNumber != MAGIC_NUMBER) {
+        return sections;
+    }
+    TraceFileContentHeader contentHeader;
+    while (in.read(reinterpret_cast<char*>(&contentHeader), sizeof(contentHeader))) {
+        std::string data(contentHeader.length, '\0');
+        in.read(data.data(), data.size());
+        sections.emplace_back(contentHeader.type, data);
+    }
+    return sections;
+}
+
+/**
+ * @tc.name: TraceFileMergerTest001
+ * @tc.desc: Test TraceFileMerger concatenates cpu raw sections and keeps metadata once.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceFactoryTest, TraceFileMergerTest001, TestSize.Level2)
+{
+    const std::string slice1 = "/data/local/tmp/test_trace_slice1";
+    const std::string slice2 = "/data/local/tmp/test_trace_slice2";
+    const std::string merged = "/data/local/tmp/test_trace_merged";
+    WriteTestSlice(slice1, { {CONTENT_TYPE_BASE_INFO, "base1"}, {CONTENT_TYPE_EVENTS_FORMAT, "fmt"},
+        {CONTENT_TYPE_CPU_RAW, "c0a"}, {CONTENT_TYPE_CPU_RAW + 1, "c1a"},
+        {CONTENT_TYPE_CMDLINES, "1 init\n2 kthreadd\n"}, {CONTENT_TYPE_TGIDS, "1 1\n"},
+        {CONTENT_TYPE_HEADER_PAGE, "page"} });
+    WriteTestSlice(slice2, { {CONTENT_TYPE_BASE_INFO, "base2"}, {CONTENT_TYPE_EVENTS_FORMAT, "fmt"},
+        {CONTENT_TYPE_CPU_RAW, "c0b"}, {CONTENT_TYPE_CPU_RAW, "c0c"}, {CONTENT_TYPE_CPU_RAW + 1, "c1b"},
+        {CONTENT_TYPE_CMDLINES, "2 kthreadd\n3 hiview\n"}, {CONTENT_TYPE_TGIDS, "1 1\n3 3\n"},
+        {CONTENT_TYPE_HEADER_PAGE, "page"} });
+
+    TraceFileMerger merger({ slice1, slice2 });
+    ASSERT_TRUE(merger.MergeTo(merged));
+    TestSections expected = { {CONTENT_TYPE_BASE_INFO, "base1"}, {CONTENT_TYPE_EVENTS_FORMAT, "fmt"},
+        {CONTENT_TYPE_CPU_RAW, "c0ac0bc0c"}, {CONTENT_TYPE_CPU_RAW + 1, "c1ac1b"},
+        {CONTENT_TYPE_CMDLINES, "1 init\n2 kthreadd\n3 hiview\n"}, {CONTENT_TYPE_TGIDS, "1 1\n3 3\n"},
+        {CONTENT_TYPE_HEADER_PAGE, "page"} };
+    EXPECT_EQ(ReadTestSlice(merged), expected);
+    remove(slice1.c_str());
+    remove(slice2.c_str());
+    remove(merged.c_str());
+}
+
+/**
+ * @tc.name: TraceFileMergerTest002
+ * @tc.desc: Test TraceFileMerger rejects missing or non-trace input files.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceFactoryTest, TraceFileMergerTest002, TestSize.Level2)
+{
+    const std::string badSlice = "/data/local/tmp/test_trace_bad_slice";
+    const std::string merged = "/data/local/tmp/test_trace_merged";
+    {
+        std::ofstream out(badSlice);
+        out << "not a trace file";
+    }
+    EXPECT_FALSE(TraceFileMerger({}).MergeTo(merged));
+    EXPECT_FALSE(TraceFileMerger({ badSlice }).MergeTo(merged));
+    EXPECT_FALSE(TraceFileMerger({ "/data/local/tmp/test_trace_nonexist" }).MergeTo(merged));
+    EXPECT_NE(access(merged.c_str(), F_OK), 0);
+    remove(badSlice.c_str());
+}
+
+/**
+ * @tc.name: TraceFileMergerTest003
+ * @tc.desc: Test ExpandEventsFormatRef replaces the events format reference with the sidecar content.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceFactoryTest, TraceFileMergerTest003, TestSize.Level2)
+{
+    const std::string sidecarName = std::string(TRACE_EVENTS_FORMAT_SIDECAR_PREFIX) + "0123456789abcdef";
+    const std::string sidecar = std::string(TRACE_FILE_DEFAULT_DIR) + sidecarName;
+    const std::string slice = "/data/local/tmp/test_trace_ref_slice";
+    {
+        std::ofstream out(sidecar, std::ios::trunc);
+        out << "name: sched_switch\n";
+    }
+    // unknown sections, the section order and repeated cmdlines are kept, only the reference is replaced.
+    constexpr uint8_t unknownType = 99;
+    WriteTestSlice(slice, { {CONTENT_TYPE_BASE_INFO, "base"}, {CONTENT_TYPE_CPU_RAW, "c0"},
+        {CONTENT_TYPE_EVENTS_FORMAT_REF, sidecarName}, {CONTENT_TYPE_CMDLINES, "1 a\n1 a\n"}, {unknownType, "x"} });
+    ASSERT_TRUE(TraceFileMerger::ExpandEventsFormatRef(slice));
+    TestSections expected = { {CONTENT_TYPE_BASE_INFO, "base"}, {CONTENT_TYPE_CPU_RAW, "c0"},
+        {CONTENT_TYPE_EVENTS_FORMAT, "name: sched_switch\n"}, {CONTENT_TYPE_CMDLINES, "1 a\n1 a\n"},
+        {unknownType, "x"} };
+    EXPECT_EQ(ReadTestSlice(slice), expected);
+    EXPECT_NE(access("/data/local/tmp/.test_trace_ref_slice.expand", F_OK), 0);
+
+    WriteTestSlice(slice, { {CONTENT_TYPE_EVENTS_FORMAT_REF, "../../../etc/passwd"} });
+    EXPECT_FALSE(TraceFileMerger::ExpandEventsFormatRef(slice));
+    remove(slice.c_str());
+    remove(sidecar.c_str());
+}
+
+/**
+ * @tc.name: TraceFileMergerTest004
+ * @tc.desc: Test RemoveUnusedSidecars keeps only the sidecars referenced by the given trace files.
+ * @tc.type: FUNC
+ */
+HWTEST_F(HitraceFactoryTest, TraceFileMergerTest004, TestSize.Level2)
+{
+    const std::string usedName = std::string(TRACE_EVENTS_FORMAT_SIDECAR_PREFIX) + "00000000000000aa";
+    const std::string unusedName = std::string(TRACE_EVENTS_FORMAT_SIDECAR_PREFIX) + "00000000000000bb";
+    const std::string used = std::string(TRACE_FILE_DEFAULT_DIR) + usedName;
+    const std::string unused = std::string(TRACE_FILE_DEFAULT_DIR) + unusedName;
+    const std::string slice = "/data/local/tmp/test_trace_sidecar_slice";
+    std::ofstream(used, std::ios::trunc) << "fmt";
+    std::ofstream(unused, std::ios::trunc) << "fmt";
+    WriteTestSlice(slice, { {CONTENT_TYPE_EVENTS_FORMAT_REF, usedName}, {CONTENT_TYPE_CPU_RAW, "c0"} });
+
+    TraceFileMerger::RemoveUnusedSidecars({ slice, "/data/local/tmp/test_trace_sidecar_missing" });
+    EXPECT_EQ(access(used.c_str(), F_OK), 0);
+    EXPECT_EQ(access(unused.c_str(), F_OK), 0);
+
+    TraceFileMerger::RemoveUnusedSidecars({ slice });
+    EXPECT_EQ(access(used.c_str(), F_OK), 0);
+    EXPECT_NE(access(unused.c_str(), F_OK), 0);
+    remove(used.c_str());
+    remove(slice.c_str());
+}
 } // namespace
 } // namespace Hitrace
 } // namespace HiviewDFX
@@ -18,6 +18,9 @@
 from abc import ABCMeta, abstractmethod
 from enum import IntEnum, unique
 from typing import List, Any
+import ctypes
+import heapq
+import mmap
 import optparse
 import os
 import re
@@ -29,10 +32,12 @@ import parse_functions
 
 TRACE_REGEX_ASYNC = "\s*(\d+)\s+(.*?)\|\d+\|[SFC]\s+:(.*?)\s+:(.*?)\s+(.*?)\s+\]\d+\[\s+\)(\d+)\s*\(\s+(\d+?)-(.*?)\s+"
 TRACE_REGEX_SYNC = "\s*\|\d+\|E\s+:(.*?)\s+:(.*?)\s+(.*?)\s+\]\d+\[\s+\)(\d+)\s*\(\s+(\d+?)-(.*?)\s+"
+TRACE_REGEX_LINE = r"^\s*(.+)-(\d+)\s+(?:\(\s*([-\d]+)\)\s+)?\[(\d+)\]\s+\S{4}\s+(\d+)\.(\d+):\s+([\w.]+):\s?(.*)$"
 text_file = ""
 binary_file = ""
 out_file = ""
 file_dir = ""
+out_format = "systrace"
 
 TRACE_TXT_HEADER_FORMAT = """# tracer: nop
 #
@@ -53,6 +58,7 @@ def parse_options() -> None:
     global binary_file
     global out_file
     global file_dir
+    global out_format
 
     usage = "Usage: %prog -t text_file -o out_file or\n%prog -b binary_file -o out_file"
     desc = "Example: %prog -t my_trace_file.htrace -o my_trace_file.systrace"
@@ -66,8 +72,11 @@ def parse_options() -> None:
         help='File name after successful parsing.', metavar='FILE')
     parser.add_option('-d', '--file_dir', dest='file_dir',
         help='Folder to be parsed.', metavar='FILE')
+    parser.add_option('-f', '--out_format', dest='out_format', type='choice', choices=['systrace', 'perfetto'],
+        default='systrace', help='Output format, systrace text or perfetto protobuf, default systrace.')
 
     options, args = parser.parse_args()
+    out_format = options.out_format
 
     if options.file_dir is None:
         if options.out_file is not None:
@@ -95,6 +104,120 @@ def parse_options() -> None:
             file_dir = options.file_dir
 
 
+class HiTraceTextLine(ctypes.Structure):
+    # 与 trace_text_parser.h 中的 HiTraceTextLine 保持一致
+    _fields_ = [
+        ("line_offset", ctypes.c_uint64),
+        ("line_size", ctypes.c_uint32),
+        ("task_offset", ctypes.c_uint32),
+        ("task_size", ctypes.c_uint32),
+        ("pid", ctypes.c_int32),
+        ("tgid", ctypes.c_int32),
+        ("cpu", ctypes.c_uint32),
+        ("timestamp", ctypes.c_uint64),
+        ("event_offset", ctypes.c_uint32),
+        ("event_size", ctypes.c_uint32),
+        ("args_offset", ctypes.c_uint32),
+        ("args_size", ctypes.c_uint32),
+    ]
+
+
+class NativeTextParser:
+    """
+    ctypes binding of libhitrace_text_parser.so, found through HITRACE_TEXT_PARSER_LIB or next to this script,
+    the hitrace_host_tools build target places this script next to the host build of the library.
+    The native parser splits the lines, the strings are sliced out of an mmap of the same file.
+    """
+    LIB_NAMES = ["libhitrace_text_parser.so", "libhitrace_text_parser.z.so"]
+    BATCH_LINES = 4096
+
+    def __init__(self, lib: Any) -> None:
+        self.lib = lib
+        self.lib.HiTraceTextParserOpen.restype = ctypes.c_void_p
+        self.lib.HiTraceTextParserOpen.argtypes = [ctypes.c_char_p]
+        self.lib.HiTraceTextParserNext.restype = ctypes.c_size_t
+        self.lib.HiTraceTextParserNext.argtypes = [ctypes.c_void_p, ctypes.POINTER(HiTraceTextLine), ctypes.c_size_t]
+        self.lib.HiTraceTextParserSkippedLines.restype = ctypes.c_uint64
+        self.lib.HiTraceTextParserSkippedLines.argtypes = [ctypes.c_void_p]
+        self.lib.HiTraceTextParserClose.restype = None
+        self.lib.HiTraceTextParserClose.argtypes = [ctypes.c_void_p]
+
+    @staticmethod
+    def load() -> Any:
+        lib_paths = [os.path.join(os.path.dirname(os.path.abspath(__file__)), lib_name)
+            for lib_name in NativeTextParser.LIB_NAMES]
+        if "HITRACE_TEXT_PARSER_LIB" in os.environ:
+            lib_paths = [os.environ["HITRACE_TEXT_PARSER_LIB"]]
+        for lib_path in lib_paths:
+            if not os.path.exists(lib_path):
+                continue
+            try:
+                return NativeTextParser(ctypes.CDLL(lib_path))
+            except OSError:
+                continue
+        return None
+
+    def iter_lines(self, file_name: str) -> Any:
+        """
+        Yields (comm, pid, tgid, cpu, timestamp, name, args), tgid is -1 if absent.
+        """
+        if os.path.getsize(file_name) == 0:
+            return
+        handle = self.lib.HiTraceTextParserOpen(file_name.encode("utf-8"))
+        if not handle:
+            return
+        lines = (HiTraceTextLine * self.BATCH_LINES)()
+        try:
+            with open(file_name, "rb") as infile, mmap.mmap(infile.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+                while True:
+                    count = self.lib.HiTraceTextParserNext(handle, lines, self.BATCH_LINES)
+                    if count == 0:
+                        break
+                    for i in range(count):
+                        item = lines[i]
+                        raw = mm[item.line_offset:item.line_offset + item.line_size]
+                        yield (raw[item.task_offset:item.task_offset + item.task_size].decode("utf-8", "ignore"),
+                            item.pid, item.tgid, item.cpu, item.timestamp,
+                            raw[item.event_offset:item.event_offset + item.event_size].decode("utf-8", "ignore"),
+                            raw[item.args_offset:item.args_offset + item.args_size].decode("utf-8", "ignore"))
+            print("skipped malformed lines: ", self.lib.HiTraceTextParserSkippedLines(handle))
+        finally:
+            self.lib.HiTraceTextParserClose(handle)
+
+
+def iter_text_trace_lines(file_name: str) -> Any:
+    native_parser = NativeTextParser.load()
+    if native_parser is not None:
+        yield from native_parser.iter_lines(file_name)
+        return
+    pattern_line = re.compile(TRACE_REGEX_LINE)
+    infile = os.fdopen(os.open(file_name, os.O_RDONLY, stat.S_IRUSR), "r", encoding="utf-8", errors="ignore")
+    for line in infile:
+        trace_match = pattern_line.match(line.rstrip("\n"))
+        if trace_match is None:
+            continue
+        (comm, pid, tgid, cpu, ts_secs, ts_frac, name, args) = trace_match.groups()
+        tgid = int(tgid) if tgid is not None and tgid != "-----" else -1
+        timestamp = int(ts_secs) * 1000000000 + int(ts_frac.ljust(9, "0")[:9])
+        yield (comm.strip(), int(pid), tgid, int(cpu), timestamp, name, args)
+    infile.close()
+
+
+def parse_text_trace_file_to_perfetto() -> None:
+    print("start converting text trace file to perfetto")
+    cmd_lines = {}
+    tgids = {}
+    writer = PerfettoTraceWriter(out_file)
+    for (comm, pid, tgid, cpu, timestamp, name, args) in iter_text_trace_lines(text_file):
+        if pid != 0 and comm != "<...>":
+            cmd_lines[pid] = comm
+        if tgid >= 0:
+            tgids[pid] = tgid
+        writer.append_event(cpu, timestamp, pid, 0, name, args)
+    writer.write_process_tree(cmd_lines, tgids)
+    writer.close()
+
+
 def parse_text_trace_file() -> None:
     print("start processing text trace file")
     pattern_async = re.compile(TRACE_REGEX_ASYNC)
@@ -149,6 +272,7 @@ class FieldType(IntEnum):
     SEGMENT_HEADER_PAGE = 30
     SEGMENT_PRINTK_FORMATS = 31
     SEGMENT_KALLSYMS = 32
+    SEGMENT_EVENTS_FORMAT_REF = 34
     SEGMENT_UNSUPPORT = -1
     pass
 
@@ -212,7 +336,11 @@ class TraceViewerInterface(metaclass=ABCMeta):
         pass
 
     @abstractmethod
-    def calculate(self, context: TraceParseContext) -> None:
+    def pop_trace_events(self) -> List:
+        pass
+
+    @abstractmethod
+    def calculate(self, context: TraceParseContext, trace_events) -> None:
         pass
 
 
@@ -248,6 +376,10 @@ class TraceFileParserInterface(metaclass=ABCMeta):
     def get_segment_data(self, segment_size) -> List:
         return None
 
+    @abstractmethod
+    def get_segment_data_at(self, offset: int, segment_size: int) -> List:
+        return None
+
 
 class OperatorInterface(metaclass=ABCMeta):
     @abstractmethod
@@ -477,6 +609,17 @@ class PageWrapper(OperatorInterface):
     pass
 
 
+class RawSection:
+    """
+    功能描述: 记录trace_pipe_raw段在文件中的位置, 段内容在合并输出时才按页读取
+    """
+    def __init__(self, segment_type: int, offset: int, size: int) -> None:
+        self.segment_type = segment_type
+        self.offset = offset
+        self.size = size
+        pass
+
+
 class RawTraceSegment(SegmentOperator):
     """
     功能描述: 声明HiTrace文件trace_pipe_raw内容的段格式
@@ -499,11 +642,31 @@ class RawTraceSegment(SegmentOperator):
         )
         pass
 
+        # 同一CPU核的段按文件顺序归为一条事件流, 每条流内的事件已按时间排序
+        self.cpu_sections = {}
+        pass
+
     def accept(self, parser: TraceFileParserInterface, segment=None) -> bool:
-        segment = segment or []
-        self.field.accept(parser, segment)
+        if segment is None:
+            return True
+        self.cpu_sections.setdefault(segment.segment_type, []).append(segment)
         return True
 
+    def iter_cpu_events(self, parser: TraceFileParserInterface, sections: List):
+        for section in sections:
+            page_end = section.offset + section.size - PageWrapper.TRACE_PAGE_SIZE
+            for page_offset in range(section.offset, page_end + 1, PageWrapper.TRACE_PAGE_SIZE):
+                page = parser.get_segment_data_at(page_offset, PageWrapper.TRACE_PAGE_SIZE)
+                self.field.accept(parser, page)
+                yield from parser.get_viewer().pop_trace_events()
+
+    def iter_trace_events(self, parser: TraceFileParserInterface):
+        """
+        功能描述: 按时间戳对各CPU核的事件流做k路归并, 内存占用只与CPU核数相关
+        """
+        streams = [self.iter_cpu_events(parser, sections) for sections in self.cpu_sections.values()]
+        return heapq.merge(*streams, key=lambda trace_event: trace_event[0])
+
 
 class EventFormatSegment(SegmentOperator):
     """
@@ -521,6 +684,30 @@ class EventFormatSegment(SegmentOperator):
         return True
 
 
+class EventFormatRefSegment(SegmentOperator):
+    """
+    功能描述: 声明HiTrace文件event/format引用段格式, 段内容为同目录下event/format副本的文件名
+    """
+    SIDECAR_NAME_PATTERN = re.compile(r"^events_format_[0-9a-f]{16}$")
+
+    def __init__(self) -> None:
+        super().__init__(FieldType.SEGMENT_EVENTS_FORMAT_REF)
+        pass
+
+    def accept(self, parser: TraceFileParserInterface, segment=None) -> bool:
+        segment = segment or []
+        sidecar_name = bytes(segment).decode("utf-8", errors="ignore")
+        if not EventFormatRefSegment.SIDECAR_NAME_PATTERN.match(sidecar_name):
+            print(f"invalid events format reference: {sidecar_name}")
+            return False
+        sidecar_path = os.path.join(os.path.dirname(os.path.abspath(parser.trace_file.name)), sidecar_name)
+        if not os.path.exists(sidecar_path):
+            print(f"events format sidecar {sidecar_path} not found, please copy it next to the trace file.")
+            return False
+        with os.fdopen(os.open(sidecar_path, os.O_RDONLY | getattr(os, "O_BINARY", 0)), "rb") as sidecar:
+            return EventFormatSegment().accept(parser, sidecar.read())
+
+
 class CmdLinesSegment(SegmentOperator):
     """
     功能描述: 声明HiTrace文件/sys/kernel/tracing/saved_cmdlines内容的段格式
@@ -656,7 +843,12 @@ class SegmentWrapper(FieldOperator):
                 raise ValueError("Unsupported data file, please check the file content.")
             conext = parser.get_context()
             segment = self.get_segment(segment_type, conext.get_param(TraceParseContext.CONTEXT_CPU_NUM))
-            segment_data = parser.get_segment_data(segment_size)
+            if segment.field_type == FieldType.SEGMENT_RAW_TRACE:
+                segment_data = None
+                if parser.trace_file.skip_data(segment_size):
+                    segment_data = RawSection(segment_type, data_offset + self.field_size, segment_size)
+            else:
+                segment_data = parser.get_segment_data(segment_size)
             try:
                 if not segment.accept(parser, segment_data):
                     print(f"failed parse segment type={current_segment_info['type']:x}, "
@@ -709,12 +901,38 @@ class TraceFile:
         self.cur_post = self.cur_post + block_size
         return self.file.read(block_size)
 
+    def skip_data(self, block_size: int) -> bool:
+        """
+        功能描述: 跳过文件当前位置的blockSize字节
+        参数: 跳过字节数
+        返回值: 文件剩余内容不足时返回False
+        """
+        if (self.cur_post + block_size) > self.size:
+            return False
+        self.cur_post = self.cur_post + block_size
+        self.file.seek(self.cur_post)
+        return True
+
+    def read_data_at(self, offset: int, block_size: int) -> List:
+        """
+        功能描述: 读取文件offset位置blockSize字节的内容, 不改变当前位置
+        参数: 文件偏移, 读取字节数
+        返回值: 文件内容
+        """
+        if (offset + block_size) > self.size:
+            return None
+        self.file.seek(offset)
+        data = self.file.read(block_size)
+        self.file.seek(self.cur_post)
+        return data
+
 
 class TraceFileFormat(OperatorInterface):
     """
     功能描述: 声明整个HiTrace文件的二进制格式
     """
     def __init__(self) -> None:
+        self.raw_trace_segment = RawTraceSegment()
         self.fields = [
             FileHeader([
                 FileHeader.ITEM_MAGIC_NUMBER,
@@ -726,7 +944,8 @@ class TraceFileFormat(OperatorInterface):
                 CmdLinesSegment(),
                 TidGroupsSegment(),
                 EventFormatSegment(),
-                RawTraceSegment(),
+                EventFormatRefSegment(),
+                self.raw_trace_segment,
                 PrintkFormatSegment(),
                 KallSymsSegment(),
                 HeaderPageSegment(),
@@ -740,6 +959,9 @@ class TraceFileFormat(OperatorInterface):
                 return False
         return True
 
+    def iter_trace_events(self, parser: TraceFileParserInterface):
+        return self.raw_trace_segment.iter_trace_events(parser)
+
 
 class Viewer:
     @abstractmethod
@@ -773,12 +995,12 @@ class SysTraceViewer(Viewer):
 
     def __init__(self, output_file: str):
         self.out_file = output_file
+        self.outfile = None
         self.format_miss_cnt = 0
         self.format_miss_set = set()
         self.trace_event_count_dict = {} # trace event count dict
         self.trace_event_mem_dict = {} # trace event mem dict
         self.get_not_found_format = set()
-        self.systrace = []
         pass
 
     def set_context(self, context: TraceParseContext) -> None:
@@ -786,9 +1008,24 @@ class SysTraceViewer(Viewer):
         self.events_format = context.get_param(TraceParseContext.CONTEXT_EVENT_FORMAT)
         self.cmd_lines = context.get_param(TraceParseContext.CONTEXT_CMD_LINES)
         self.tgids = context.get_param(TraceParseContext.CONTEXT_TID_GROUPS)
+        self.open_output()
+        pass
+
+    def open_output(self) -> None:
+        # 事件按时间顺序到达, 逐行写出
+        outfile_flags = os.O_RDWR | os.O_CREAT
+        outfile_mode = stat.S_IRUSR | stat.S_IWUSR
+        self.outfile = os.fdopen(os.open(self.out_file, outfile_flags, outfile_mode), 'w', encoding="utf-8")
+        self.outfile.write(TRACE_TXT_HEADER_FORMAT)
         pass
 
     def calculate(self, timestamp: int, core_id: int, event_id: int, segment: List, context: TraceParseContext) -> None:
+        one_event = self.decode_one_event(core_id, event_id, segment)
+        if one_event is not None:
+            self.write_one_event(segment, core_id, timestamp, one_event)
+        pass
+
+    def decode_one_event(self, core_id: int, event_id: int, segment: List) -> dict:
         if event_id in self.trace_event_count_dict:
             self.trace_event_count_dict[event_id] += 1
         else:
@@ -804,7 +1041,7 @@ class SysTraceViewer(Viewer):
             # current event format is not found in trace file format data.
             self.format_miss_cnt = self.format_miss_cnt + 1
             self.format_miss_set.add(event_id)
-            return
+            return None
 
         fields = event_format["fields"]
         one_event = {}
@@ -817,9 +1054,11 @@ class SysTraceViewer(Viewer):
             offset = field["offset"]
             size = field["size"]
             one_event["fields"][field["name"]] = segment[offset:offset + size]
+        return one_event
 
-        systrace = self.generate_one_event_str(segment, core_id, timestamp, one_event)
-        self.systrace.append([timestamp, systrace])
+    def write_one_event(self, data: List, cpu_id: int, time_stamp: int, one_event: dict) -> None:
+        systrace = self.generate_one_event_str(data, cpu_id, time_stamp, one_event)
+        self.outfile.write("{}\n".format(systrace))
         pass
 
     def generate_one_event_str(self, data: List, cpu_id: int, time_stamp: int, one_event: dict) -> str:
@@ -865,6 +1104,9 @@ class SysTraceViewer(Viewer):
         parse_result = parse_functions.parse(one_event["print_fmt"], data, one_event)
         if parse_result is None:
             self.get_not_found_format.add(str(one_event["name"]))
+        elif one_event["name"] == "tracing_mark_write" and parse_result.startswith("M|"):
+            prefix = event_str + "tracing_mark_write: "
+            event_str = "\n".join(prefix + counter for counter in parse_functions.expand_counter_batch(parse_result))
         else:
             event_str += str(one_event["name"]) + ": " + parse_result
 
@@ -914,21 +1156,10 @@ class SysTraceViewer(Viewer):
         return result
 
     def show(self) -> None:
-        self.save_systrace()
+        self.outfile.close()
         self.show_stat()
         pass
 
-    def save_systrace(self) -> None:
-        outfile_flags = os.O_RDWR | os.O_CREAT
-        outfile_mode = stat.S_IRUSR | stat.S_IWUSR
-
-        result = sorted(self.systrace, key=lambda x: x[0])
-        outfile = os.fdopen(os.open(self.out_file, outfile_flags, outfile_mode), 'w', encoding="utf-8")
-        outfile.write(TRACE_TXT_HEADER_FORMAT)
-        for line in result:
-            outfile.write("{}\n".format(line[1]))
-        outfile.close()
-
     def show_stat(self) -> None:
         for name in self.get_not_found_format:
             print("Error: function parse_%s not found" % name)
@@ -946,6 +1177,201 @@ class SysTraceViewer(Viewer):
             print(f"ID {format_id}: count={count}, count percentage={count_percentage:.5f}%, mem={mem:.3f}KB, mem percentage={mem_percentage:.5f}%")
 
 
+class PerfettoTraceWriter:
+    """
+    功能描述: 将ftrace事件编码为Perfetto Trace protobuf, 事件按CPU核打包为ftrace_events
+    """
+    # 以下字段号来自perfetto/protos/perfetto/trace下的trace.proto, trace_packet.proto及ftrace/*.proto
+    TRACE_PACKET = 1
+    PACKET_FTRACE_EVENTS = 1
+    PACKET_PROCESS_TREE = 2
+    PACKET_TIMESTAMP = 8
+    PACKET_SEQUENCE_ID = 10
+    BUNDLE_CPU = 1
+    BUNDLE_EVENT = 2
+    EVENT_TIMESTAMP = 1
+    EVENT_PID = 2
+    EVENT_COMMON_FLAGS = 5
+    PROCESS_TREE_THREADS = 2
+    THREAD_TID = 1
+    THREAD_NAME = 2
+    THREAD_TGID = 5
+    WIRE_VARINT = 0
+    WIRE_LENGTH_DELIMITED = 2
+    SEQUENCE_ID = 1
+    MAX_BUNDLE_EVENTS = 1000
+
+    # 事件名: (FtraceEvent中的字段号, [(事件proto字段号, 参数名, 是否字符串)])
+    FTRACE_EVENTS = {
+        "print": (3, [(1, "ip", False), (2, "buf", True)]),
+        "sched_switch": (4, [(1, "prev_comm", True), (2, "prev_pid", False), (3, "prev_prio", False),
+            (4, "prev_state", False), (5, "next_comm", True), (6, "next_pid", False), (7, "next_prio", False)]),
+        "cpu_frequency": (11, [(1, "state", False), (2, "cpu_id", False)]),
+        "cpu_idle": (13, [(1, "state", False), (2, "cpu_id", False)]),
+        "sched_wakeup": (17, [(1, "comm", True), (2, "pid", False), (3, "prio", False), (5, "target_cpu", False)]),
+        "sched_waking": (20, [(1, "comm", True), (2, "pid", False), (3, "prio", False), (5, "target_cpu", False)]),
+        "softirq_entry": (24, [(1, "vec", False)]),
+        "softirq_exit": (25, [(1, "vec", False)]),
+        "softirq_raise": (26, [(1, "vec", False)]),
+        "irq_handler_entry": (36, [(1, "irq", False), (2, "name", True)]),
+        "irq_handler_exit": (37, [(1, "irq", False), (2, "ret", False)]),
+    }
+    TASK_STATE_BITS = {'R': 0x0, 'S': 0x1, 'D': 0x2, 'T': 0x4, 't': 0x8, 'X': 0x10, 'Z': 0x20, 'P': 0x40, 'I': 0x80}
+    TASK_STATE_PREEMPTED = 0x100
+    ARGS_PATTERN = re.compile(r"(\w+)=(.*?)(?= \w+=|$)")
+
+    def __init__(self, output_file: str) -> None:
+        outfile_flags = os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, "O_BINARY", 0)
+        outfile_mode = stat.S_IRUSR | stat.S_IWUSR
+        self.outfile = os.fdopen(os.open(output_file, outfile_flags, outfile_mode), 'wb')
+        self.cpu_events = {}
+        self.unsupported_events = {}
+        self.event_count = 0
+        pass
+
+    @staticmethod
+    def encode_varint(value: int) -> bytes:
+        value &= (1 << 64) - 1
+        result = bytearray()
+        while value > 0x7f:
+            result.append((value & 0x7f) | 0x80)
+            value >>= 7
+        result.append(value)
+        return bytes(result)
+
+    @staticmethod
+    def encode_int_field(field_id: int, value: int) -> bytes:
+        return PerfettoTraceWriter.encode_varint(field_id << 3 | PerfettoTraceWriter.WIRE_VARINT) + \
+            PerfettoTraceWriter.encode_varint(value)
+
+    @staticmethod
+    def encode_bytes_field(field_id: int, value: bytes) -> bytes:
+        return PerfettoTraceWriter.encode_varint(field_id << 3 | PerfettoTraceWriter.WIRE_LENGTH_DELIMITED) + \
+            PerfettoTraceWriter.encode_varint(len(value)) + value
+
+    @staticmethod
+    def parse_args(name: str, args: str) -> dict:
+        if name == "tracing_mark_write":
+            return {"ip": 0, "buf": args}
+        if name == "print":
+            pos = args.find(": ")
+            return {"ip": int(args[:pos], 16) if args.startswith("0x") and pos != -1 else 0, "buf": args[pos + 2:]}
+        return {key: value for key, value in PerfettoTraceWriter.ARGS_PATTERN.findall(args)}
+
+    @staticmethod
+    def parse_int(key: str, value: str) -> int:
+        if key == "prev_state":
+            state = PerfettoTraceWriter.TASK_STATE_BITS.get(value[:1], 0)
+            return state | (PerfettoTraceWriter.TASK_STATE_PREEMPTED if value.endswith('+') else 0)
+        if key == "ret":
+            return 1 if value == "handled" else 0
+        try:
+            return int(value, 0) if value.startswith("0x") else int(value)
+        except ValueError:
+            return 0
+
+    def write_packet(self, packet: bytes) -> None:
+        packet += self.encode_int_field(PerfettoTraceWriter.PACKET_SEQUENCE_ID, PerfettoTraceWriter.SEQUENCE_ID)
+        self.outfile.write(self.encode_bytes_field(PerfettoTraceWriter.TRACE_PACKET, packet))
+        pass
+
+    def write_process_tree(self, cmd_lines: dict, tgids: dict) -> None:
+        threads = b""
+        for tid, name in cmd_lines.items():
+            thread = self.encode_int_field(PerfettoTraceWriter.THREAD_TID, tid)
+            thread += self.encode_bytes_field(PerfettoTraceWriter.THREAD_NAME, name.encode("utf-8"))
+            if tid in tgids:
+                thread += self.encode_int_field(PerfettoTraceWriter.THREAD_TGID, tgids[tid])
+            threads += self.encode_bytes_field(PerfettoTraceWriter.PROCESS_TREE_THREADS, thread)
+        if threads != b"":
+            self.write_packet(self.encode_bytes_field(PerfettoTraceWriter.PACKET_PROCESS_TREE, threads))
+        pass
+
+    def append_event(self, cpu: int, timestamp: int, pid: int, flags: int, name: str, args: str) -> None:
+        ftrace_event = PerfettoTraceWriter.FTRACE_EVENTS.get(name)
+        if ftrace_event is None and name == "tracing_mark_write":
+            ftrace_event = PerfettoTraceWriter.FTRACE_EVENTS.get("print")
+        if ftrace_event is None:
+            self.unsupported_events[name] = self.unsupported_events.get(name, 0) + 1
+            return
+
+        if name == "tracing_mark_write" and args.startswith("M|"):
+            for counter in parse_functions.expand_counter_batch(args):
+                if not counter.startswith("M|"):
+                    self.append_event(cpu, timestamp, pid, flags, name, counter)
+            return
+
+        (event_field_id, fields) = ftrace_event
+        values = self.parse_args(name, args)
+        content = b""
+        for field_id, key, is_string in fields:
+            value = values.get(key)
+            if value is None:
+                continue
+            if is_string:
+                content += self.encode_bytes_field(field_id, value.encode("utf-8"))
+            else:
+                content += self.encode_int_field(field_id, value if isinstance(value, int) else
+                    self.parse_int(key, value))
+
+        event = self.encode_int_field(PerfettoTraceWriter.EVENT_TIMESTAMP, timestamp)
+        event += self.encode_int_field(PerfettoTraceWriter.EVENT_PID, pid)
+        if flags != 0:
+            event += self.encode_int_field(PerfettoTraceWriter.EVENT_COMMON_FLAGS, flags)
+        event += self.encode_bytes_field(event_field_id, content)
+
+        events = self.cpu_events.setdefault(cpu, [])
+        events.append(event)
+        self.event_count += 1
+        if len(events) >= PerfettoTraceWriter.MAX_BUNDLE_EVENTS:
+            self.flush_cpu(cpu)
+        pass
+
+    def flush_cpu(self, cpu: int) -> None:
+        events = self.cpu_events.pop(cpu, [])
+        if len(events) == 0:
+            return
+        bundle = self.encode_int_field(PerfettoTraceWriter.BUNDLE_CPU, cpu)
+        for event in events:
+            bundle += self.encode_bytes_field(PerfettoTraceWriter.BUNDLE_EVENT, event)
+        self.write_packet(self.encode_bytes_field(PerfettoTraceWriter.PACKET_FTRACE_EVENTS, bundle))
+        pass
+
+    def close(self) -> None:
+        for cpu in list(self.cpu_events.keys()):
+            self.flush_cpu(cpu)
+        self.outfile.close()
+        print("Perfetto ftrace events: %d" % self.event_count)
+        for name, count in self.unsupported_events.items():
+            print("Perfetto unsupported event %s: count=%d" % (name, count))
+        pass
+
+
+class PerfettoViewer(SysTraceViewer):
+    """
+    功能描述: 直接由raw事件生成Perfetto protobuf, 参数沿用systrace的解析结果
+    """
+    def open_output(self) -> None:
+        self.writer = PerfettoTraceWriter(self.out_file)
+        self.writer.write_process_tree(self.cmd_lines, self.tgids)
+        pass
+
+    def write_one_event(self, data: List, cpu_id: int, time_stamp: int, one_event: dict) -> None:
+        args = parse_functions.parse(one_event["print_fmt"], data, one_event)
+        if args is None:
+            self.get_not_found_format.add(str(one_event["name"]))
+            return
+        pid = int.from_bytes(one_event["fields"]["common_pid"], byteorder='little')
+        flags = int.from_bytes(one_event["fields"]["common_flags"], byteorder='little')
+        self.writer.append_event(cpu_id, time_stamp, pid, flags, one_event["name"], args)
+        pass
+
+    def show(self) -> None:
+        self.writer.close()
+        self.show_stat()
+        pass
+
+
 class TraceViewer(TraceViewerInterface):
     def __init__(self, viewers: List) -> None:
         self.trace_events = []
@@ -956,11 +1382,16 @@ class TraceViewer(TraceViewerInterface):
         self.trace_events.append(trace_event)
         pass
 
-    def calculate(self, context: TraceParseContext):
+    def pop_trace_events(self) -> List:
+        trace_events = self.trace_events
+        self.trace_events = []
+        return trace_events
+
+    def calculate(self, context: TraceParseContext, trace_events):
         for viewer in self.viewers:
             viewer.set_context(context)
 
-        for timestamp, core_id, event_id, segment in self.trace_events:
+        for timestamp, core_id, event_id, segment in trace_events:
             for viewer in self.viewers:
                 viewer.calculate(timestamp, core_id, event_id, segment, context)
 
@@ -1058,6 +1489,9 @@ class TraceFileParser(TraceFileParserInterface):
     def get_segment_data(self, segment_size) -> List:
         return self.trace_file.read_data(segment_size)
 
+    def get_segment_data_at(self, offset: int, segment_size: int) -> List:
+        return self.trace_file.read_data_at(offset, segment_size)
+
     def get_context(self) -> TraceParseContext:
         return self.context
 
@@ -1066,7 +1500,7 @@ class TraceFileParser(TraceFileParserInterface):
 
     def parse(self) -> None:
         self.trace_format.accept(self)
-        self.trace_viewer.calculate(self.context)
+        self.trace_viewer.calculate(self.context, self.trace_format.iter_trace_events(self))
         pass
 
 
@@ -1076,7 +1510,7 @@ def parse_binary_trace_file() -> None:
     file = TraceFile(binary_file)
     vformat = TraceFileFormat()
     viewer = TraceViewer([
-        SysTraceViewer(out_file)
+        PerfettoViewer(out_file) if out_format == "perfetto" else SysTraceViewer(out_file)
     ])
     context = TraceParseContext()
     parser = TraceFileParser(file, vformat, viewer, context)
@@ -1088,7 +1522,9 @@ def main() -> None:
     parse_options()
 
     if file_dir == '':
-        if text_file != '':
+        if text_file != '' and out_format == "perfetto":
+            parse_text_trace_file_to_perfetto()
+        elif text_file != '':
             parse_text_trace_file()
         else:
             parse_binary_trace_file()
@@ -1100,7 +1536,8 @@ def main() -> None:
                 global out_file
                 binary_file = os.path.join(file_dir, file)
                 out_file = os.path.join(os.path.split(binary_file)[0],
-                                        '%s%s' % (os.path.split(binary_file)[-1].split('.')[0], '.ftrace'))
+                                        '%s%s' % (os.path.split(binary_file)[-1].split('.')[0],
+                                        '.perfetto-trace' if out_format == "perfetto" else '.ftrace'))
                 parse_binary_trace_file()
 
 
@@ -910,6 +910,18 @@ def parse_tracing_mark_write(data, one_event):
     return result_str
 
 
+def expand_counter_batch(buf):
+    # M|pid|level|name|value|name|value... written by CountTraceBatch, one C marker per counter
+    if not buf.startswith("M|"):
+        return [buf]
+    fields = buf.rstrip("\n").split("|")
+    if len(fields) < 5:
+        return [buf]
+    pid = fields[1]
+    level = fields[2]
+    return ["C|%s|H:%s|%s|%s" % (pid, fields[i], fields[i + 1], level) for i in range(3, len(fields) - 1, 2)]
+
+
 def parse_xacct_tracing_mark_write(data, one_event):
     start = parse_int_field(one_event, "start", False)
     pid = parse_int_field(one_event, "pid", False)
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EVENT_FORMATTER_H
+#define EVENT_FORMATTER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "raw_trace_file.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct RawEvent {
+    const uint8_t* data = nullptr; // event payload, starting with common_type
+    size_t size = 0;
+    uint32_t cpu = 0;
+    uint64_t timestamp = 0; // in nanoseconds
+};
+
+/**
+ * @brief Turns raw events into systrace text lines.
+ * @note Every event format is compiled once into a printer that holds the field offsets it needs, so decoding an
+ *       event never looks a field up by name. Events with a dedicated printer are rendered like hitrace_converter.py,
+ *       the others through their print fmt like the kernel does. Only a print fmt whose arguments are plain field
+ *       reads can be compiled, events using kernel helpers such as __print_flags fall back to "field=value" pairs.
+ */
+class EventFormatter {
+public:
+    explicit EventFormatter(const RawTraceFile& traceFile);
+
+    /**
+     * @brief Append the systrace line of the event to out, without the trailing line feed.
+     *        A counter batch marker appends one line per counter, separated by line feeds.
+     * @return false if the event id has no format, nothing is appended then.
+     */
+    bool Format(const RawEvent& event, std::string& out) const;
+
+    using ArgsPrinter = std::function<void(const RawEvent&, std::string&)>;
+
+private:
+    struct CompiledFormat {
+        std::string name;
+        EventField commonPid;
+        EventField commonFlags;
+        EventField commonPreemptCount;
+        ArgsPrinter printArgs;
+        bool isMarker = false; // tracing_mark_write, a counter batch in it is expanded
+    };
+
+    void AppendTaskInfo(const RawEvent& event, const CompiledFormat& format, std::string& out) const;
+
+    const RawTraceFile& traceFile_;
+    std::unordered_map<uint16_t, CompiledFormat> formats_;
+};
+
+void AppendTraceFlags(uint32_t flags, uint32_t preemptCount, std::string& out);
+void AppendTimestamp(uint64_t timestamp, std::string& out);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // EVENT_FORMATTER_H
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RAW_TRACE_DECODER_H
+#define RAW_TRACE_DECODER_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+#include "event_formatter.h"
+#include "raw_trace_file.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct DecodeStats {
+    std::map<uint16_t, uint64_t> eventCount; // keyed by event id
+    std::map<uint16_t, uint64_t> eventBytes;
+    uint64_t formatMissCount = 0;
+    std::set<uint16_t> formatMissIds;
+    uint64_t outputBytes = 0; // text written to the output, which may be a pipe without a file offset
+};
+
+/**
+ * @brief Decodes the per-cpu raw sections of a trace file into systrace text.
+ * @note Every cpu is cut into page-aligned shards that one pool of threads decodes in start time order into
+ *       bounded chunks of formatted lines; the calling thread takes every cpu's chunks back in shard order,
+ *       k-way merges them by timestamp and streams them out, so memory stays flat whatever the file size.
+ */
+class RawTraceDecoder {
+public:
+    explicit RawTraceDecoder(const RawTraceFile& traceFile);
+
+    // Replaces the default text header, e.g. with one carrying the live ring buffer counters.
+    void SetTextHeader(const std::string& header) { textHeader_ = header; }
+    // Threads of the decode pool, 0 leaves one hardware thread to the merge on the calling thread.
+    void SetThreadCount(const size_t threadCount) { threadCount_ = threadCount; }
+    bool DecodeToSystrace(const int outFd, DecodeStats& stats);
+
+private:
+    const RawTraceFile& traceFile_;
+    EventFormatter formatter_;
+    std::string textHeader_;
+    size_t threadCount_ = 0;
+};
+
+/**
+ * @brief Build the text header the kernel prints on top of the trace node.
+ */
+std::string FormatTraceTextHeader(const uint64_t entries, const uint64_t written, const uint32_t cpuCount);
+
+/**
+ * @brief Walk the events of one 4096 byte page, page header {u64 timestamp, u64 length, u8 cpu} followed by
+ *        events {u32 timestamp delta, u16 size, payload aligned to 4 bytes}.
+ */
+void DecodePage(const uint8_t* page, const std::function<void(const RawEvent&)>& callback);
+
+/**
+ * @brief Walk the events of one linux ring buffer page, page header {u64 timestamp, long commit} followed by
+ *        events {u32 type_len:5 time_delta:27, payload}, time extend and padding records are consumed here.
+ */
+void DecodeLinuxPage(const uint8_t* page, const uint32_t cpu, const bool is32BitArch,
+    const std::function<void(const RawEvent&)>& callback);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // RAW_TRACE_DECODER_H
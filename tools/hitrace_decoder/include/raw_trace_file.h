@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RAW_TRACE_FILE_H
+#define RAW_TRACE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#include "smart_fd.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+// On-disk layout written by frameworks/trace_factory, kept here so the decoder also builds on a PC.
+constexpr uint16_t RAW_TRACE_MAGIC_NUMBER = 57161;
+constexpr uint8_t RAW_FILE_TYPE_LINUX = 0;
+constexpr uint8_t RAW_FILE_TYPE_HM = 1;
+constexpr uint8_t RAW_SECTION_EVENTS_FORMAT = 1;
+constexpr uint8_t RAW_SECTION_CMDLINES = 2;
+constexpr uint8_t RAW_SECTION_TGIDS = 3;
+constexpr uint8_t RAW_SECTION_CPU_RAW = 4;
+constexpr uint8_t RAW_SECTION_HEADER_PAGE = 30;
+constexpr uint8_t RAW_SECTION_EVENTS_FORMAT_REF = 34;
+constexpr size_t RAW_TRACE_PAGE_SIZE = 4096;
+
+// The library also runs inside the dump service, so it returns the failure and the caller decides how to log it.
+enum class RawTraceError : uint8_t {
+    NONE = 0,
+    OPEN_FAILED, // errno is kept
+    NOT_RAW_TRACE,
+    BAD_SECTION_TABLE,
+    READ_FAILED,
+    WRITE_FAILED, // errno is kept
+    BAD_EVENTS_FORMAT_REF,
+    SIDECAR_NOT_FOUND,
+};
+
+const char* GetRawTraceErrorMsg(const RawTraceError error);
+
+struct alignas(4) RawTraceFileHeader {
+    uint16_t magicNumber = 0;
+    uint8_t fileType = 0;
+    uint16_t versionNumber = 0;
+    uint32_t reserved = 0;
+};
+
+struct alignas(4) RawTraceSectionHeader {
+    uint8_t type = 0;
+    uint32_t length = 0;
+};
+
+struct EventField {
+    std::string type;
+    std::string name; // without the "[N]" suffix of array fields
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    bool isSigned = false;
+    bool isArray = false;
+    bool isDataLoc = false; // __data_loc, the value holds (length << 16 | offset) of the payload
+};
+
+/**
+ * @brief One entry of the events format section, the field list is the offset table used to decode the event.
+ */
+struct EventFormat {
+    uint16_t id = 0;
+    std::string name;
+    std::string printFmt;
+    std::vector<EventField> fields;
+
+    const EventField* FindField(const std::string& fieldName) const;
+};
+
+struct RawTraceSection {
+    uint8_t type = 0;
+    off_t offset = 0; // offset of the section payload
+    uint32_t length = 0;
+};
+
+/**
+ * @brief Read-only view of a raw trace file: the section table and the parsed metadata.
+ *        The per-cpu raw sections are only indexed here, their pages are read on demand by the decoder.
+ */
+class RawTraceFile {
+public:
+    RawTraceError Open(const std::string& path);
+
+    int GetFd() const { return fd_.GetFd(); }
+    uint32_t GetCpuCount() const { return cpuCount_; }
+    bool IsHmFormat() const { return isHmFormat_; }
+    bool Is32BitArch() const { return is32BitArch_; }
+    bool IsTruncated() const { return isTruncated_; } // the last section is shorter than its header says
+    const RawTraceFileHeader& GetHeader() const { return header_; }
+    const std::vector<RawTraceSection>& GetSections() const { return sections_; } // every section, in file order
+    const std::vector<RawTraceSection>& GetCpuSections() const { return cpuSections_; }
+    const std::unordered_map<uint16_t, EventFormat>& GetEventFormats() const { return eventFormats_; }
+    const std::unordered_map<int32_t, std::string>& GetCmdlines() const { return cmdlines_; }
+    const std::unordered_map<int32_t, int32_t>& GetTgids() const { return tgids_; }
+
+private:
+    bool ReadSection(const RawTraceSection& section, std::string& data) const;
+    RawTraceError LoadMetadata(const RawTraceSection& section);
+    RawTraceError LoadEventsFormatRef(const std::string& sidecarName);
+
+    std::string path_;
+    SmartFd fd_;
+    uint32_t cpuCount_ = 0;
+    bool isHmFormat_ = false;
+    bool is32BitArch_ = false;
+    bool isTruncated_ = false;
+    RawTraceFileHeader header_;
+    std::vector<RawTraceSection> sections_;
+    std::vector<RawTraceSection> cpuSections_;
+    std::unordered_map<uint16_t, EventFormat> eventFormats_;
+    std::unordered_map<int32_t, std::string> cmdlines_;
+    std::unordered_map<int32_t, int32_t> tgids_;
+};
+
+void ParseEventFormats(const std::string& text, std::unordered_map<uint16_t, EventFormat>& formats);
+void ParseCmdlines(const std::string& text, std::unordered_map<int32_t, std::string>& cmdlines);
+void ParseTgids(const std::string& text, std::unordered_map<int32_t, int32_t>& tgids);
+
+// events/header_page describes the page header of the running kernel, a 4 byte commit means a 32-bit layout.
+bool ParseHeaderPageArch(const std::string& text, bool& is32BitArch);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // RAW_TRACE_FILE_H
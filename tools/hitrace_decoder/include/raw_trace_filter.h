@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RAW_TRACE_FILTER_H
+#define RAW_TRACE_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "event_formatter.h"
+#include "hitrace_define.h"
+#include "raw_trace_file.h"
+#include "trace_marker.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct FilterStats {
+    uint64_t eventsIn = 0;
+    uint64_t eventsKept = 0;
+    uint64_t pagesIn = 0;
+    uint64_t pagesOut = 0;
+};
+
+/**
+ * @brief Writes a copy of a raw trace file holding only the events selected by a TraceMarkerFilter.
+ * @note The first pass walks the B and E markers in timestamp order to pair them per thread, so an E marker is
+ *       kept exactly when its B marker is. The second pass repacks the kept events into dense pages of the same
+ *       page format, all other sections are copied unchanged, the output decodes like any dump.
+ */
+class RawTraceFilter {
+public:
+    RawTraceFilter(const RawTraceFile& traceFile, const TraceMarkerFilter& filter);
+
+    RawTraceError FilterToFile(const int outFd, FilterStats& stats);
+
+private:
+    bool ForEachEvent(const size_t sectionIdx, const std::function<void(const RawEvent&, uint64_t)>& callback,
+        FilterStats* stats) const;
+    bool MatchMarker(const TraceMarkerInfo& info, const bool checkName) const;
+    bool KeepEvent(const RawEvent& event, const uint64_t eventKey) const;
+    bool PairSyncMarkers();
+    RawTraceError CopySection(const int outFd, const RawTraceSection& section) const;
+    RawTraceError RepackSection(const int outFd, const size_t sectionIdx, FilterStats& stats) const;
+
+    const RawTraceFile& traceFile_;
+    const TraceMarkerFilter& filter_;
+    std::unordered_set<int32_t> pids_;
+    TraceMarkerReader markerReader_;
+    std::unordered_set<uint64_t> keptSyncMarkers_; // keyed by section index and event index
+};
+
+bool IsMarkerFilterSet(const TraceMarkerFilter& filter);
+
+/**
+ * @brief Filter the raw trace file at inPath into outPath, which must be another path.
+ */
+RawTraceError FilterRawTraceFile(const std::string& inPath, const std::string& outPath,
+    const TraceMarkerFilter& filter, FilterStats& stats);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // RAW_TRACE_FILTER_H
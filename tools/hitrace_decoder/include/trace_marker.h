@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_MARKER_H
+#define TRACE_MARKER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "event_formatter.h"
+#include "raw_trace_file.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+/**
+ * @brief The fields of a hitrace marker, e.g. "B|pid|H:[chain,span,parent]#name|I13|args" or "E|pid|I13".
+ */
+struct TraceMarkerInfo {
+    char type = 0;
+    int32_t pid = 0;
+    std::string_view name; // without the "H:" and hitrace id prefixes, empty for E markers, "name|value..." for M
+    std::string_view value; // the task id of S and F markers, the value of C markers, empty otherwise
+    uint32_t level = 0; // HiTraceOutputLevel, debug if the marker has no level
+    uint64_t tags = 0; // 0 if the marker has no tag bits
+};
+
+bool ParseTraceMarker(std::string_view text, TraceMarkerInfo& info);
+
+/**
+ * @brief Splits a counter batch "M|pid|level|name|value|name|value..." written by CountTraceBatch into the
+ *        "C|pid|H:name|value|level" markers of its counters.
+ * @return false if the text is not a counter batch.
+ */
+bool ExpandCounterBatch(std::string_view text, std::vector<std::string>& counters);
+
+/**
+ * @brief Whether a counter name in the "name|value|name|value..." tail of a counter batch contains pattern,
+ *        the values never match.
+ */
+bool MatchCounterBatchName(std::string_view counters, std::string_view pattern);
+
+/**
+ * @brief Rewrites the text trace read from the kernel, a "tracing_mark_write: M|..." line becomes one line per
+ *        counter with the task, cpu and timestamp of the batch, like the dumps decoded from the raw trace.
+ * @note The text may be fed in chunks of any size, a line cut by a chunk is held back until its end arrives.
+ */
+class CounterBatchTextExpander {
+public:
+    void Feed(std::string_view chunk, std::string& out);
+    // appends the held back last line, for a trace not ending with a line feed
+    void Finish(std::string& out);
+
+private:
+    void AppendLines(std::string_view text, std::string& out);
+
+    std::string pending_;
+    std::vector<std::string> counters_;
+};
+
+/**
+ * @brief Reads the hitrace marker text out of the tracing_mark_write and print events of a raw trace file.
+ */
+class TraceMarkerReader {
+public:
+    explicit TraceMarkerReader(const RawTraceFile& traceFile);
+
+    bool HasMarkerEvents() const { return !markerFields_.empty(); }
+    bool GetText(const RawEvent& event, std::string_view& text) const;
+    bool GetMarker(const RawEvent& event, TraceMarkerInfo& info) const;
+
+private:
+    struct MarkerField {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        bool isDataLoc = false;
+    };
+
+    std::unordered_map<uint16_t, MarkerField> markerFields_;
+};
+
+/**
+ * @brief The common_pid of an event, i.e. the thread that wrote it.
+ */
+bool GetEventTid(const RawEvent& event, int32_t& tid);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // TRACE_MARKER_H
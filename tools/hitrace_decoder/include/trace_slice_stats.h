@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_SLICE_STATS_H
+#define TRACE_SLICE_STATS_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_marker.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+/**
+ * @brief Log-linear duration histogram in the HDR style: exact below 64 ns, then 32 buckets per power of two,
+ *        so a percentile is off by at most 1/32 of its value whatever the range, in at most 15 KB.
+ */
+class LatencyHistogram {
+public:
+    void Record(const uint64_t value);
+    uint64_t GetPercentile(const double percentile) const; // percentile in [0, 100]
+
+private:
+    std::vector<uint64_t> counts_; // grown up to the highest bucket used
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+struct SliceStats {
+    std::string name;
+    uint64_t tags = 0; // tag bits of the begin marker
+    bool isAsync = false; // S/F slices, paired by pid, name and task id instead of per thread
+    uint64_t count = 0;
+    uint64_t sum = 0; // ns
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    LatencyHistogram histogram;
+};
+
+struct SliceAggregateStats {
+    uint64_t markers = 0;
+    uint64_t unmatchedEnds = 0; // E or F markers whose begin is before the trace
+    uint64_t openSlices = 0; // B or S markers whose end is after the trace
+    uint64_t droppedSlices = 0; // beyond the name, nesting or open async slice limits
+};
+
+/**
+ * @brief Pairs B/E markers per thread and S/F markers by (pid, name, task id), and aggregates the durations per
+ *        name and tag. Markers must be added in timestamp order.
+ * @note Memory is bounded by the number of distinct names and open slices, both capped, not by the trace size.
+ */
+class SliceAggregator {
+public:
+    void AddMarker(const uint64_t timestamp, const int32_t tid, const TraceMarkerInfo& info);
+    // counts the slices still open, call once after the last marker
+    void Finish();
+
+    std::vector<const SliceStats*> GetSortedSlices() const; // by total duration, longest first
+    const SliceAggregateStats& GetStats() const { return stats_; }
+
+private:
+    struct OpenSlice {
+        uint64_t timestamp = 0;
+        SliceStats* slice = nullptr; // nullptr if the slice was dropped
+    };
+
+    struct ThreadStack {
+        std::vector<OpenSlice> slices;
+        uint64_t overflow = 0; // B markers beyond the nesting limit, their E markers are ignored
+    };
+
+    struct AsyncKey {
+        int32_t pid = 0;
+        std::string taskId;
+        std::string name;
+
+        bool operator==(const AsyncKey& other) const
+        {
+            return pid == other.pid && taskId == other.taskId && name == other.name;
+        }
+    };
+
+    struct AsyncKeyHash {
+        size_t operator()(const AsyncKey& key) const;
+    };
+
+    SliceStats* FindSlice(std::string_view name, const uint64_t tags, const bool isAsync);
+    void CloseSlice(const OpenSlice& open, const uint64_t timestamp);
+
+    std::deque<SliceStats> slices_; // stable addresses for the open slices and the index
+    std::unordered_map<std::string, SliceStats*> sliceIndex_; // keyed by type, tags and name
+    std::string keyBuffer_;
+    std::unordered_map<int32_t, ThreadStack> threadStacks_;
+    std::unordered_map<AsyncKey, OpenSlice, AsyncKeyHash> asyncSlices_;
+    AsyncKey asyncKey_;
+    SliceAggregateStats stats_;
+};
+
+/**
+ * @brief Feed the hitrace markers of a trace file to the aggregator, the file is either a raw trace file or a
+ *        systrace text file, told apart by the raw file magic number. Calls Finish() at the end.
+ */
+bool AggregateTraceSlices(const std::string& path, SliceAggregator& aggregator);
+
+/**
+ * @brief One line per name and tag: count, total, min, max, average and the p50/p90/p99/p99.9 durations in us.
+ */
+std::string FormatSliceStats(const SliceAggregator& aggregator);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // TRACE_SLICE_STATS_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_TEXT_PARSER_H
+#define TRACE_TEXT_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __cplusplus
+#include <string>
+#include <string_view>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+/**
+ * @brief One event line of a systrace text file:
+ *        "<task>-<pid> (<tgid>) [<cpu>] <flags> <secs>.<frac>: <event>: <args>", the tgid column is optional.
+ */
+struct TraceTextLine {
+    std::string_view line; // without the line feed
+    std::string_view task;
+    int32_t pid = 0;
+    int32_t tgid = -1; // -1 if the line has no tgid column or it is "-----"
+    uint32_t cpu = 0;
+    std::string_view flags;
+    uint64_t timestamp = 0; // ns
+    std::string_view event; // e.g. "tracing_mark_write"
+    std::string_view args; // e.g. the hitrace marker "B|pid|H:name|I13"
+};
+
+/**
+ * @brief Splits systrace text into event lines without copying, comment and malformed lines are skipped.
+ * @note Every delimiter is found with memchr, which the C library vectorizes (SSE2/AVX2 on x86, NEON on arm64),
+ *       so a line costs a handful of scans over its prefix plus one over its length.
+ */
+class TraceTextParser {
+public:
+    explicit TraceTextParser(std::string_view text) : text_(text) {}
+
+    // Returns false at the end of the text.
+    bool Next(TraceTextLine& line);
+    uint64_t GetSkippedLines() const { return skippedLines_; }
+    size_t GetOffset() const { return offset_; } // of the next line
+
+private:
+    std::string_view text_;
+    size_t offset_ = 0;
+    uint64_t skippedLines_ = 0;
+};
+
+bool ParseTraceTextLine(std::string_view text, TraceTextLine& line);
+
+/**
+ * @brief Read-only mapping of a whole text file, the string views handed out by the parser point into it.
+ */
+class TraceTextFile {
+public:
+    TraceTextFile() = default;
+    ~TraceTextFile();
+    TraceTextFile(const TraceTextFile&) = delete;
+    TraceTextFile& operator=(const TraceTextFile&) = delete;
+
+    bool Open(const std::string& path);
+    std::string_view GetText() const { return std::string_view(static_cast<const char*>(data_), size_); }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+
+extern "C" {
+#endif
+
+/**
+ * The C view of TraceTextLine for the ctypes binding of hitrace_converter.py: offsets instead of pointers, the
+ * line offset is from the start of the file, all other offsets are from the start of the line.
+ */
+typedef struct HiTraceTextLine {
+    uint64_t lineOffset;
+    uint32_t lineSize;
+    uint32_t taskOffset;
+    uint32_t taskSize;
+    int32_t pid;
+    int32_t tgid;
+    uint32_t cpu;
+    uint64_t timestamp;
+    uint32_t eventOffset;
+    uint32_t eventSize;
+    uint32_t argsOffset;
+    uint32_t argsSize;
+} HiTraceTextLine;
+
+void* HiTraceTextParserOpen(const char* path);
+// Fills up to maxLines lines and returns how many, 0 at the end of the file.
+size_t HiTraceTextParserNext(void* parser, HiTraceTextLine* lines, size_t maxLines);
+uint64_t HiTraceTextParserSkippedLines(void* parser);
+void HiTraceTextParserClose(void* parser);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TRACE_TEXT_PARSER_H
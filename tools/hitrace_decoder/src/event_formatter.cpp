@@ -0,0 +1,843 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_formatter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "trace_marker.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr int COMM_STR_MAX = 16;
+constexpr uint64_t NS_PER_US = 1000;
+constexpr uint64_t US_PER_S = 1000000;
+constexpr uint32_t DATA_LOC_OFFSET_MASK = 0xffff;
+constexpr uint32_t DATA_LOC_LENGTH_SHIFT = 16;
+constexpr uint32_t BITS_PER_BYTE = 8;
+constexpr uint32_t MAX_INT_FIELD_SIZE = 8;
+constexpr uint32_t BLOCKED_DELAY_SHIFT = 10;
+
+constexpr uint32_t TRACE_FLAG_IRQS_OFF = 0x01;
+constexpr uint32_t TRACE_FLAG_IRQS_NOSUPPORT = 0x02;
+constexpr uint32_t TRACE_FLAG_NEED_RESCHED = 0x04;
+constexpr uint32_t TRACE_FLAG_HARDIRQ = 0x08;
+constexpr uint32_t TRACE_FLAG_SOFTIRQ = 0x10;
+constexpr uint32_t TRACE_FLAG_PREEMPT_RESCHED = 0x20;
+constexpr uint32_t TRACE_FLAG_NMI = 0x40;
+
+using ArgsPrinter = EventFormatter::ArgsPrinter;
+using PrinterBuilder = std::function<ArgsPrinter(const EventFormat&, const RawTraceFile&)>;
+
+void AppendFormat(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+void AppendFormat(std::string& out, const char* fmt, ...)
+{
+    char buf[256]; // 256 : enough for the numeric parts of one line
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len > 0) {
+        out.append(buf, std::min(static_cast<size_t>(len), sizeof(buf) - 1));
+    }
+}
+
+bool IsFieldInEvent(const RawEvent& event, const EventField& field)
+{
+    return field.size > 0 && static_cast<size_t>(field.offset) + field.size <= event.size;
+}
+
+uint64_t ReadUnsigned(const RawEvent& event, const EventField& field)
+{
+    if (!IsFieldInEvent(event, field)) {
+        return 0;
+    }
+    uint64_t value = 0;
+    uint32_t size = std::min(field.size, MAX_INT_FIELD_SIZE);
+    for (uint32_t i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(event.data[field.offset + i]) << (i * BITS_PER_BYTE);
+    }
+    return value;
+}
+
+int64_t ReadSigned(const RawEvent& event, const EventField& field)
+{
+    uint64_t value = ReadUnsigned(event, field);
+    uint32_t bits = std::min(field.size, MAX_INT_FIELD_SIZE) * BITS_PER_BYTE;
+    if (bits > 0 && bits < MAX_INT_FIELD_SIZE * BITS_PER_BYTE && (value & (1ULL << (bits - 1))) != 0) {
+        value |= ~((1ULL << bits) - 1);
+    }
+    return static_cast<int64_t>(value);
+}
+
+void AppendCString(const uint8_t* data, size_t maxLen, std::string& out)
+{
+    const void* end = memchr(data, '\0', maxLen);
+    size_t len = (end == nullptr) ? maxLen : static_cast<size_t>(static_cast<const uint8_t*>(end) - data);
+    out.append(reinterpret_cast<const char*>(data), len);
+}
+
+void AppendArrayString(const RawEvent& event, const EventField& field, std::string& out)
+{
+    if (IsFieldInEvent(event, field)) {
+        AppendCString(event.data + field.offset, field.size, out);
+    }
+}
+
+void AppendDataLocString(const RawEvent& event, const EventField& field, std::string& out)
+{
+    uint32_t loc = static_cast<uint32_t>(ReadUnsigned(event, field));
+    size_t offset = loc & DATA_LOC_OFFSET_MASK;
+    if (offset >= event.size) {
+        return;
+    }
+    AppendCString(event.data + offset, event.size - offset, out);
+}
+
+void AppendCommByPid(const RawTraceFile& traceFile, int64_t pid, uint32_t cpu, std::string& out)
+{
+    if (pid == 0) {
+        AppendFormat(out, "tppmgr-idle-%u", cpu);
+        return;
+    }
+    auto it = traceFile.GetCmdlines().find(static_cast<int32_t>(pid));
+    if (it != traceFile.GetCmdlines().end()) {
+        out += it->second;
+    }
+}
+
+// Collect the named fields, fails if any of them is missing from the format.
+bool GetFields(const EventFormat& format, std::initializer_list<const char*> names, std::vector<EventField>& fields)
+{
+    for (const char* name : names) {
+        const EventField* field = format.FindField(name);
+        if (field == nullptr) {
+            return false;
+        }
+        fields.push_back(*field);
+    }
+    return true;
+}
+
+const char* GetHmTaskState(uint64_t state)
+{
+    switch (state) {
+        case 0x0: return "R";
+        case 0x1: return "S";
+        case 0x2: return "D";
+        case 0x10: return "X";
+        case 0x100: return "R+";
+        default: return "?";
+    }
+}
+
+void AppendLinuxTaskState(int64_t state, std::string& out)
+{
+    switch (state & 0xff) {
+        case 0x1: out += 'S'; break;
+        case 0x2: out += 'D'; break;
+        case 0x4: out += 'T'; break;
+        case 0x8: out += 't'; break;
+        case 0x10: out += 'X'; break;
+        case 0x20: out += 'Z'; break;
+        case 0x40: out += 'P'; break;
+        case 0x80: out += 'I'; break;
+        default: out += 'R'; break;
+    }
+    if ((state & 0x100) != 0) {
+        out += '+';
+    }
+}
+
+void AppendNextInfo(const RawEvent& event, const EventField& ninfo, bool withCgroup, std::string& out)
+{
+    constexpr uint32_t affinityBytes = 4;
+    EventField affinityField = ninfo;
+    affinityField.size = affinityBytes;
+    EventField remainField = ninfo;
+    remainField.offset += affinityBytes;
+    remainField.size = ninfo.size > affinityBytes ? ninfo.size - affinityBytes : 0;
+    uint64_t remaining = ReadUnsigned(event, remainField);
+    // the load is stored shifted right by one bit
+    AppendFormat(out, "%" PRIx64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64, ReadUnsigned(event, affinityField),
+        (remaining & 0x3ff) << 1, (remaining >> 10) & 0x3, (remaining >> 12) & 0x1, (remaining >> 13) & 0x7);
+    if (withCgroup) {
+        AppendFormat(out, ",%" PRIu64 ",%" PRIu64, (remaining >> 16) & 0x1f, (remaining >> 21) & 0x7f);
+    }
+}
+
+ArgsPrinter BuildSchedSwitchPrinter(const EventFormat& format, const RawTraceFile& traceFile)
+{
+    std::vector<EventField> f;
+    if (GetFields(format, {"prev_comm", "prev_pid", "prev_prio", "prev_state", "next_comm", "next_pid", "next_prio"},
+        f)) {
+        const EventField* expeller = format.FindField("expeller_type");
+        EventField expellerField = (expeller != nullptr) ? *expeller : EventField();
+        return [f, expellerField](const RawEvent& event, std::string& out) {
+            out += "prev_comm=";
+            AppendArrayString(event, f[0], out);
+            AppendFormat(out, " prev_pid=%" PRId64 " prev_prio=%" PRId64 " prev_state=", ReadSigned(event, f[1]),
+                ReadSigned(event, f[2]));
+            AppendLinuxTaskState(ReadSigned(event, f[3]), out);
+            out += " ==> next_comm=";
+            AppendArrayString(event, f[4], out);
+            AppendFormat(out, " next_pid=%" PRId64 " next_prio=%" PRId64, ReadSigned(event, f[5]),
+                ReadSigned(event, f[6]));
+            if (expellerField.size > 0) {
+                AppendFormat(out, " expeller_type=%" PRIu64, ReadUnsigned(event, expellerField));
+            }
+        };
+    }
+    f.clear();
+    if (!GetFields(format, {"prev_tid", "pprio", "pstate", "next_tid", "nprio"}, f)) {
+        return nullptr;
+    }
+    const EventField* pname = format.FindField("pname");
+    const EventField* nname = format.FindField("nname");
+    const EventField* ninfo = format.FindField("ninfo");
+    const EventField* cg = format.FindField("cg");
+    bool hasNames = pname != nullptr && nname != nullptr;
+    EventField pnameField = hasNames ? *pname : EventField();
+    EventField nnameField = hasNames ? *nname : EventField();
+    EventField ninfoField = (ninfo != nullptr) ? *ninfo : EventField();
+    EventField cgField = (cg != nullptr) ? *cg : EventField();
+    return [f, hasNames, pnameField, nnameField, ninfoField, cgField, &traceFile](const RawEvent& event,
+        std::string& out) {
+        int64_t prevTid = ReadSigned(event, f[0]);
+        int64_t nextTid = ReadSigned(event, f[3]);
+        out += "prev_comm=";
+        if (hasNames) {
+            AppendArrayString(event, pnameField, out);
+        } else {
+            AppendCommByPid(traceFile, prevTid, event.cpu, out);
+        }
+        AppendFormat(out, " prev_pid=%" PRId64 " prev_prio=%" PRId64 " prev_state=%s ==> next_comm=", prevTid,
+            ReadSigned(event, f[1]), GetHmTaskState(ReadUnsigned(event, f[2])));
+        if (hasNames) {
+            AppendArrayString(event, nnameField, out);
+        } else {
+            AppendCommByPid(traceFile, nextTid, event.cpu, out);
+        }
+        AppendFormat(out, " next_pid=%" PRId64 " next_prio=%" PRId64, nextTid, ReadSigned(event, f[4]));
+        if (ninfoField.size > 0) {
+            out += " next_info=";
+            AppendNextInfo(event, ninfoField, cgField.size == 0, out);
+        }
+        if (cgField.size > 0) {
+            out += " cg=";
+            AppendArrayString(event, cgField, out);
+        }
+    };
+}
+
+ArgsPrinter BuildSchedWakeupPrinter(const EventFormat& format, const RawTraceFile& traceFile)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"pid", "prio", "target_cpu"}, f)) {
+        return nullptr;
+    }
+    const EventField* comm = format.FindField("comm");
+    if (comm == nullptr) {
+        comm = format.FindField("pname");
+    }
+    bool hasComm = comm != nullptr;
+    EventField commField = hasComm ? *comm : EventField();
+    return [f, hasComm, commField, &traceFile](const RawEvent& event, std::string& out) {
+        int64_t pid = ReadSigned(event, f[0]);
+        out += "comm=";
+        if (hasComm) {
+            AppendArrayString(event, commField, out);
+        } else {
+            AppendCommByPid(traceFile, pid, event.cpu, out);
+        }
+        AppendFormat(out, " pid=%" PRId64 " prio=%" PRId64 " target_cpu=%03" PRId64, pid, ReadSigned(event, f[1]),
+            ReadSigned(event, f[2]));
+    };
+}
+
+ArgsPrinter BuildTracingMarkWritePrinter(const EventFormat& format, const RawTraceFile&)
+{
+    const EventField* buffer = format.FindField("buffer");
+    if (buffer != nullptr) {
+        EventField bufferField = *buffer;
+        return [bufferField](const RawEvent& event, std::string& out) {
+            size_t start = out.size();
+            AppendDataLocString(event, bufferField, out);
+            // drop the trailing separator of "E|pid|" end markers
+            if (out.size() - start > 1 && out.compare(start, 2, "E|") == 0 && out.back() == '|') {
+                out.pop_back();
+            }
+        };
+    }
+    std::vector<EventField> f;
+    if (!GetFields(format, {"start", "pid", "name"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        bool isBegin = ReadUnsigned(event, f[0]) == 1;
+        AppendFormat(out, "%c|%" PRIu64 "|", isBegin ? 'B' : 'E', ReadUnsigned(event, f[1]));
+        if (isBegin) {
+            AppendArrayString(event, f[2], out);
+        }
+    };
+}
+
+ArgsPrinter BuildPrintPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"ip", "buf"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "0x%" PRIx64 ": ", ReadUnsigned(event, f[0]));
+        if (f[1].offset < event.size) {
+            AppendCString(event.data + f[1].offset, event.size - f[1].offset, out);
+        }
+    };
+}
+
+ArgsPrinter BuildStateCpuPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"state", "cpu_id"}, f)) {
+        return nullptr;
+    }
+    const EventField* name = format.FindField("name");
+    bool hasName = name != nullptr && name->isDataLoc;
+    EventField nameField = hasName ? *name : EventField();
+    return [f, hasName, nameField](const RawEvent& event, std::string& out) {
+        if (hasName) {
+            AppendDataLocString(event, nameField, out);
+            out += ' ';
+        }
+        AppendFormat(out, "state=%" PRIu64 " cpu_id=%" PRIu64, ReadUnsigned(event, f[0]), ReadUnsigned(event, f[1]));
+    };
+}
+
+ArgsPrinter BuildCpuFrequencyLimitsPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"min_freq", "max_freq", "cpu_id"}, f) &&
+        !(f.clear(), GetFields(format, {"min", "max", "cpu_id"}, f))) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "min=%" PRIu64 " max=%" PRIu64 " cpu_id=%" PRIu64, ReadUnsigned(event, f[0]),
+            ReadUnsigned(event, f[1]), ReadUnsigned(event, f[2]));
+    };
+}
+
+ArgsPrinter BuildIrqEntryPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"irq", "name"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "irq=%" PRId64 " name=", ReadSigned(event, f[0]));
+        AppendDataLocString(event, f[1], out);
+    };
+}
+
+ArgsPrinter BuildIrqExitPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"irq", "ret"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "irq=%" PRId64 " ret=%s", ReadSigned(event, f[0]),
+            ReadSigned(event, f[1]) != 0 ? "handled" : "unhandled");
+    };
+}
+
+ArgsPrinter BuildSoftirqPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    static const char* const softirqNames[] = {
+        "HI", "TIMER", "NET_TX", "NET_RX", "BLOCK", "IRQ_POLL", "TASKLET", "SCHED", "HRTIMER", "RCU"
+    };
+    std::vector<EventField> f;
+    if (!GetFields(format, {"vec"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        uint64_t vec = ReadUnsigned(event, f[0]);
+        const char* action = vec < sizeof(softirqNames) / sizeof(softirqNames[0]) ? softirqNames[vec] : "";
+        AppendFormat(out, "vec=%" PRIu64 " [action=%s]", vec, action);
+    };
+}
+
+ArgsPrinter BuildSchedBlockedReasonPrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"pid", "iowait", "caller", "delay"}, f) || format.FindField("func_name") != nullptr ||
+        format.FindField("cnode_idx") != nullptr) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "pid=%" PRId64 " iowait=%" PRIu64 " caller=0x%" PRIx64 " delay=%" PRIu64,
+            ReadSigned(event, f[0]), ReadUnsigned(event, f[1]), ReadUnsigned(event, f[2]),
+            ReadUnsigned(event, f[3]) >> BLOCKED_DELAY_SHIFT);
+    };
+}
+
+ArgsPrinter BuildWorkqueuePrinter(const EventFormat& format, const RawTraceFile&)
+{
+    std::vector<EventField> f;
+    if (!GetFields(format, {"work", "function"}, f)) {
+        return nullptr;
+    }
+    return [f](const RawEvent& event, std::string& out) {
+        AppendFormat(out, "work struct 0x%" PRIx64 ": function 0x%" PRIx64, ReadUnsigned(event, f[0]),
+            ReadUnsigned(event, f[1]));
+    };
+}
+
+struct PrintFmtConversion {
+    std::string literal; // text printed before the conversion
+    std::string spec;    // the conversion with its length modifier replaced to take a 64 bit value or a string
+    char conv = 0;       // 0 for the text after the last conversion
+    uint32_t valueBits = 0;
+    EventField field;
+};
+
+std::string TrimSpaces(const std::string& text)
+{
+    size_t start = text.find_first_not_of(' ');
+    size_t end = text.find_last_not_of(' ');
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+// "fmt", REC->a, __get_str(b): the quoted format with its escapes resolved, and the arguments split on the top
+// level commas.
+bool SplitPrintFmt(const std::string& printFmt, std::string& fmt, std::vector<std::string>& args)
+{
+    if (printFmt.empty() || printFmt[0] != '"') {
+        return false;
+    }
+    size_t pos = 1;
+    for (; pos < printFmt.size() && printFmt[pos] != '"'; pos++) {
+        if (printFmt[pos] != '\\' || pos + 1 == printFmt.size()) {
+            fmt += printFmt[pos];
+            continue;
+        }
+        char escaped = printFmt[++pos];
+        fmt += (escaped == 'n') ? '\n' : ((escaped == 't') ? '\t' : escaped);
+    }
+    if (pos == printFmt.size()) {
+        return false;
+    }
+    int depth = 0;
+    std::string arg;
+    for (pos++; pos < printFmt.size(); pos++) {
+        char ch = printFmt[pos];
+        depth += (ch == '(') ? 1 : ((ch == ')') ? -1 : 0);
+        if (ch == ',' && depth == 0) {
+            args.push_back(TrimSpaces(arg));
+            arg.clear();
+        } else {
+            arg += ch;
+        }
+    }
+    args.push_back(TrimSpaces(arg));
+    if (args.front().empty()) {
+        args.erase(args.begin()); // the text before the first comma
+    }
+    return true;
+}
+
+// Only plain field reads are compiled, e.g. "REC->pid", "(unsigned long)REC->ip" or "__get_str(name)".
+const EventField* ResolvePrintFmtArg(const EventFormat& format, std::string arg, bool& isDataLocStr)
+{
+    while (!arg.empty() && arg.front() == '(') {
+        size_t close = arg.find(')');
+        if (close == std::string::npos) {
+            return nullptr;
+        }
+        // a cast is followed by more text, parentheses around the whole argument are dropped
+        arg = (close + 1 < arg.size()) ? TrimSpaces(arg.substr(close + 1)) : arg.substr(1, close - 1);
+    }
+    const std::string recPrefix = "REC->";
+    const std::string strPrefix = "__get_str(";
+    isDataLocStr = arg.compare(0, strPrefix.size(), strPrefix) == 0 && arg.back() == ')';
+    std::string name;
+    if (isDataLocStr) {
+        name = TrimSpaces(arg.substr(strPrefix.size(), arg.size() - strPrefix.size() - 1));
+    } else if (arg.compare(0, recPrefix.size(), recPrefix) == 0) {
+        name = arg.substr(recPrefix.size());
+    }
+    bool isName = !name.empty() && std::all_of(name.begin(), name.end(),
+        [](char ch) { return isalnum(static_cast<unsigned char>(ch)) != 0 || ch == '_'; });
+    return isName ? format.FindField(name) : nullptr;
+}
+
+uint32_t GetConversionBits(const std::string& length, char conv, bool is32BitArch)
+{
+    constexpr uint32_t charBits = 8;
+    constexpr uint32_t shortBits = 16;
+    constexpr uint32_t intBits = 32;
+    constexpr uint32_t longLongBits = 64;
+    const uint32_t longBits = is32BitArch ? intBits : longLongBits;
+    if (length == "hh" || conv == 'c') {
+        return charBits;
+    }
+    if (length == "h") {
+        return shortBits;
+    }
+    if (length == "l" || length == "z" || length == "t") {
+        return longBits;
+    }
+    return (length == "ll" || length == "j") ? longLongBits : intBits;
+}
+
+// Parses one conversion after its '%', false for what the kernel prints differently from libc: %p with its
+// extensions, '*' widths and floating point.
+bool ParseConversion(const std::string& fmt, size_t& pos, PrintFmtConversion& conversion, bool is32BitArch)
+{
+    size_t start = pos;
+    pos = fmt.find_first_not_of("-+ #0", pos);
+    pos = (pos == std::string::npos) ? fmt.size() : fmt.find_first_not_of("0123456789.", pos);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    std::string flags = fmt.substr(start, pos - start);
+    size_t lengthStart = pos;
+    pos = fmt.find_first_not_of("hlzjt", pos);
+    if (pos == std::string::npos || pos - lengthStart > 2) { // 2 : "hh" or "ll"
+        return false;
+    }
+    std::string length = fmt.substr(lengthStart, pos - lengthStart);
+    conversion.conv = fmt[pos++];
+    if (std::string("diuxXoc").find(conversion.conv) != std::string::npos) {
+        conversion.valueBits = GetConversionBits(length, conversion.conv, is32BitArch);
+        conversion.spec = "%" + flags + (conversion.conv == 'c' ? "" : "ll") + conversion.conv;
+        return true;
+    }
+    conversion.spec = "%" + flags + "s";
+    return conversion.conv == 's' && length.empty();
+}
+
+template <typename T>
+void AppendPrintf(std::string& out, const char* spec, T value)
+{
+    int len = snprintf(nullptr, 0, spec, value);
+    if (len <= 0) {
+        return;
+    }
+    size_t oldSize = out.size();
+    out.resize(oldSize + static_cast<size_t>(len) + 1);
+    snprintf(&out[oldSize], static_cast<size_t>(len) + 1, spec, value);
+    out.resize(oldSize + static_cast<size_t>(len));
+}
+
+void AppendConversion(const RawEvent& event, const PrintFmtConversion& conversion, std::string& out)
+{
+    if (conversion.conv == 's') {
+        std::string value;
+        if (conversion.field.isDataLoc) {
+            AppendDataLocString(event, conversion.field, value);
+        } else {
+            AppendArrayString(event, conversion.field, value);
+        }
+        AppendPrintf(out, conversion.spec.c_str(), value.c_str());
+        return;
+    }
+    uint64_t value = ReadUnsigned(event, conversion.field);
+    uint32_t bits = conversion.valueBits;
+    // the kernel passed the field converted to the type of the conversion, redo the truncation and extension
+    if (bits < MAX_INT_FIELD_SIZE * BITS_PER_BYTE) {
+        value &= (1ULL << bits) - 1;
+        if ((conversion.conv == 'd' || conversion.conv == 'i') && (value & (1ULL << (bits - 1))) != 0) {
+            value |= ~((1ULL << bits) - 1);
+        }
+    }
+    if (conversion.conv == 'c') {
+        AppendPrintf(out, conversion.spec.c_str(), static_cast<int>(value));
+    } else {
+        AppendPrintf(out, conversion.spec.c_str(), static_cast<unsigned long long>(value));
+    }
+}
+
+/**
+ * Renders the event through its own print fmt, as the kernel does, when every argument is a plain field read.
+ * Print fmts using kernel helpers (__print_flags, __print_symbolic, expressions) return nullptr.
+ */
+ArgsPrinter BuildPrintFmtPrinter(const EventFormat& format, bool is32BitArch)
+{
+    std::string fmt;
+    std::vector<std::string> args;
+    if (!SplitPrintFmt(format.printFmt, fmt, args)) {
+        return nullptr;
+    }
+    std::vector<PrintFmtConversion> conversions;
+    PrintFmtConversion current;
+    size_t argIndex = 0;
+    for (size_t pos = 0; pos < fmt.size();) {
+        if (fmt[pos] != '%') {
+            current.literal += fmt[pos++];
+            continue;
+        }
+        if (pos + 1 < fmt.size() && fmt[pos + 1] == '%') {
+            current.literal += '%';
+            pos += 2; // 2 : "%%"
+            continue;
+        }
+        pos++;
+        bool isDataLocStr = false;
+        if (!ParseConversion(fmt, pos, current, is32BitArch) || argIndex >= args.size()) {
+            return nullptr;
+        }
+        const EventField* field = ResolvePrintFmtArg(format, args[argIndex++], isDataLocStr);
+        bool isStrField = field != nullptr && (isDataLocStr || (field->isArray &&
+            field->type.find("char") != std::string::npos));
+        if (field == nullptr || isStrField != (current.conv == 's') || isDataLocStr != field->isDataLoc) {
+            return nullptr;
+        }
+        current.field = *field;
+        conversions.push_back(std::move(current));
+        current = PrintFmtConversion();
+    }
+    if (argIndex != args.size()) {
+        return nullptr;
+    }
+    conversions.push_back(std::move(current));
+    return [conversions](const RawEvent& event, std::string& out) {
+        for (const auto& conversion : conversions) {
+            out += conversion.literal;
+            if (conversion.conv != 0) {
+                AppendConversion(event, conversion, out);
+            }
+        }
+    };
+}
+
+ArgsPrinter BuildGenericPrinter(const EventFormat& format)
+{
+    std::vector<EventField> fields;
+    for (const auto& field : format.fields) {
+        if (field.name.compare(0, sizeof("common_") - 1, "common_") != 0) {
+            fields.push_back(field);
+        }
+    }
+    return [fields](const RawEvent& event, std::string& out) {
+        bool first = true;
+        for (const auto& field : fields) {
+            if (!first) {
+                out += ' ';
+            }
+            first = false;
+            out += field.name;
+            out += '=';
+            if (field.isDataLoc) {
+                AppendDataLocString(event, field, out);
+            } else if (field.isArray && field.type.find("char") != std::string::npos) {
+                AppendArrayString(event, field, out);
+            } else if (field.isArray || field.size > MAX_INT_FIELD_SIZE) {
+                for (uint32_t i = 0; IsFieldInEvent(event, field) && i < field.size; i++) {
+                    AppendFormat(out, "%02x", event.data[field.offset + i]);
+                }
+            } else if (field.type.find('*') != std::string::npos) {
+                AppendFormat(out, "0x%" PRIx64, ReadUnsigned(event, field));
+            } else if (field.isSigned) {
+                AppendFormat(out, "%" PRId64, ReadSigned(event, field));
+            } else {
+                AppendFormat(out, "%" PRIu64, ReadUnsigned(event, field));
+            }
+        }
+    };
+}
+
+const std::unordered_map<std::string, PrinterBuilder>& GetPrinterBuilders()
+{
+    static const std::unordered_map<std::string, PrinterBuilder> builders = {
+        {"sched_switch", BuildSchedSwitchPrinter},
+        {"sched_wakeup", BuildSchedWakeupPrinter},
+        {"sched_wakeup_new", BuildSchedWakeupPrinter},
+        {"sched_waking", BuildSchedWakeupPrinter},
+        {"sched_blocked_reason", BuildSchedBlockedReasonPrinter},
+        {"tracing_mark_write", BuildTracingMarkWritePrinter},
+        {"print", BuildPrintPrinter},
+        {"cpu_frequency", BuildStateCpuPrinter},
+        {"cpu_idle", BuildStateCpuPrinter},
+        {"clock_set_rate", BuildStateCpuPrinter},
+        {"clock_enable", BuildStateCpuPrinter},
+        {"clock_disable", BuildStateCpuPrinter},
+        {"cpu_frequency_limits", BuildCpuFrequencyLimitsPrinter},
+        {"irq_handler_entry", BuildIrqEntryPrinter},
+        {"irq_handler_exit", BuildIrqExitPrinter},
+        {"softirq_entry", BuildSoftirqPrinter},
+        {"softirq_exit", BuildSoftirqPrinter},
+        {"softirq_raise", BuildSoftirqPrinter},
+        {"workqueue_execute_start", BuildWorkqueuePrinter},
+        {"workqueue_execute_end", BuildWorkqueuePrinter},
+    };
+    return builders;
+}
+
+EventField GetFieldOrEmpty(const EventFormat& format, const char* name)
+{
+    const EventField* field = format.FindField(name);
+    return (field != nullptr) ? *field : EventField();
+}
+} // namespace
+
+void AppendTraceFlags(uint32_t flags, uint32_t preemptCount, std::string& out)
+{
+    if ((flags | preemptCount) == 0) {
+        out += "....";
+        return;
+    }
+    if ((flags & TRACE_FLAG_IRQS_OFF) != 0) {
+        out += 'd';
+    } else if ((flags & TRACE_FLAG_IRQS_NOSUPPORT) != 0) {
+        out += 'X';
+    } else {
+        out += '.';
+    }
+
+    bool needResched = (flags & TRACE_FLAG_NEED_RESCHED) != 0;
+    bool preemptResched = (flags & TRACE_FLAG_PREEMPT_RESCHED) != 0;
+    out += (needResched && preemptResched) ? 'N' : (needResched ? 'n' : (preemptResched ? 'p' : '.'));
+
+    bool nmi = (flags & TRACE_FLAG_NMI) != 0;
+    bool hardIrq = (flags & TRACE_FLAG_HARDIRQ) != 0;
+    bool softIrq = (flags & TRACE_FLAG_SOFTIRQ) != 0;
+    if (nmi) {
+        out += hardIrq ? 'Z' : 'z';
+    } else if (hardIrq) {
+        out += softIrq ? 'H' : 'h';
+    } else {
+        out += softIrq ? 's' : '.';
+    }
+
+    constexpr uint32_t preemptMask = 0x0f;
+    out += (preemptCount != 0) ? "0123456789abcdef"[preemptCount & preemptMask] : '.';
+}
+
+void AppendTimestamp(uint64_t timestamp, std::string& out)
+{
+    constexpr uint64_t halfUs = NS_PER_US / 2;
+    uint64_t us = timestamp / NS_PER_US + ((timestamp % NS_PER_US >= halfUs) ? 1 : 0);
+    if (us < US_PER_S) {
+        // the converter splits the decimal string, so a sub-second stamp has an empty seconds column
+        AppendFormat(out, "     .%" PRIu64 ": ", us);
+        return;
+    }
+    AppendFormat(out, "%5" PRIu64 ".%06" PRIu64 ": ", us / US_PER_S, us % US_PER_S);
+}
+
+EventFormatter::EventFormatter(const RawTraceFile& traceFile) : traceFile_(traceFile)
+{
+    const auto& builders = GetPrinterBuilders();
+    for (const auto& [id, format] : traceFile.GetEventFormats()) {
+        CompiledFormat compiled = {
+            .name = format.name,
+            .commonPid = GetFieldOrEmpty(format, "common_pid"),
+            .commonFlags = GetFieldOrEmpty(format, "common_flags"),
+            .commonPreemptCount = GetFieldOrEmpty(format, "common_preempt_count"),
+            .printArgs = nullptr,
+            .isMarker = format.name == "tracing_mark_write",
+        };
+        auto it = builders.find(format.name);
+        if (it != builders.end()) {
+            compiled.printArgs = it->second(format, traceFile);
+        }
+        if (compiled.printArgs == nullptr) {
+            compiled.printArgs = BuildPrintFmtPrinter(format, traceFile.Is32BitArch());
+        }
+        if (compiled.printArgs == nullptr) {
+            compiled.printArgs = BuildGenericPrinter(format);
+        }
+        formats_.emplace(id, std::move(compiled));
+    }
+}
+
+void EventFormatter::AppendTaskInfo(const RawEvent& event, const CompiledFormat& format, std::string& out) const
+{
+    int32_t pid = static_cast<int32_t>(ReadUnsigned(event, format.commonPid));
+    const char* comm = "<...>";
+    if (pid == 0) {
+        comm = "<idle>";
+    } else {
+        auto it = traceFile_.GetCmdlines().find(pid);
+        if (it != traceFile_.GetCmdlines().end()) {
+            comm = it->second.c_str();
+        }
+    }
+    size_t commLen = strlen(comm);
+    if (commLen < COMM_STR_MAX) {
+        out.append(COMM_STR_MAX - commLen, ' ');
+    }
+    out += comm;
+    AppendFormat(out, "-%-6d", pid);
+
+    auto tgid = traceFile_.GetTgids().find(pid);
+    if (tgid != traceFile_.GetTgids().end()) {
+        AppendFormat(out, "(%5d)", tgid->second);
+    } else {
+        out += "(-----)";
+    }
+    AppendFormat(out, " [%03u] ", event.cpu);
+}
+
+bool EventFormatter::Format(const RawEvent& event, std::string& out) const
+{
+    constexpr size_t eventIdSize = sizeof(uint16_t);
+    if (event.size < eventIdSize) {
+        return false;
+    }
+    uint16_t eventId = static_cast<uint16_t>(event.data[0] | (event.data[1] << BITS_PER_BYTE));
+    auto it = formats_.find(eventId);
+    if (it == formats_.end()) {
+        return false;
+    }
+    const CompiledFormat& format = it->second;
+    const size_t lineStart = out.size();
+    AppendTaskInfo(event, format, out);
+    AppendTraceFlags(static_cast<uint32_t>(ReadUnsigned(event, format.commonFlags)),
+        static_cast<uint32_t>(ReadUnsigned(event, format.commonPreemptCount)), out);
+    out += ' ';
+    AppendTimestamp(event.timestamp, out);
+    out += format.name;
+    out += ": ";
+    const size_t argsStart = out.size();
+    format.printArgs(event, out);
+    std::vector<std::string> counters;
+    if (format.isMarker && out.compare(argsStart, 2, "M|") == 0 && // 2 : "M|"
+        ExpandCounterBatch(std::string_view(out).substr(argsStart), counters)) {
+        // a counter batch becomes one line per counter, all with the task, cpu and timestamp of the batch
+        std::string prefix = out.substr(lineStart, argsStart - lineStart);
+        out.resize(lineStart);
+        for (size_t i = 0; i < counters.size(); i++) {
+            if (i > 0) {
+                out += '\n';
+            }
+            out += prefix;
+            out += counters[i];
+        }
+    }
+    return true;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
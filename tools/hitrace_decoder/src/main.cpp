@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <string>
+#include <unistd.h>
+
+#include "raw_trace_decoder.h"
+#include "raw_trace_filter.h"
+#include "smart_fd.h"
+#include "trace_slice_stats.h"
+
+using namespace OHOS::HiviewDFX;
+using namespace OHOS::HiviewDFX::Hitrace;
+
+namespace {
+constexpr double BYTES_PER_KB = 1024.0;
+constexpr double PERCENTAGE = 100.0;
+
+void PrintUsage(const char* name)
+{
+    printf("Usage: %s -b binary_file -o out_file\n"
+           "       %s -d file_dir\n"
+           "       %s -b binary_file -o out_file [-p pids] [-t tag_mask] [-l level] [-n names] [-k]\n"
+           "       %s -s trace_file [-o out_file]\n"
+           "Decode a hitrace raw trace file into systrace text, or filter it into a smaller raw trace file.\n"
+           "  -b, --binary_file        Name of the binary file to be parsed.\n"
+           "  -o, --out_file           File name after successful parsing.\n"
+           "  -d, --file_dir           Folder to be parsed, every *.sys file is decoded into <name>.ftrace.\n"
+           "  -p, --pid                Keep the hitrace markers of these processes, e.g. 1234,5678.\n"
+           "  -t, --tag_mask           Keep the hitrace markers carrying any of these tag bits, e.g. 0x2000.\n"
+           "  -l, --level              Keep the hitrace markers of this level or above: D, I, C or M.\n"
+           "  -n, --name               Keep the hitrace markers whose name contains one of these, e.g. draw,load.\n"
+           "  -k, --keep_kernel_events Keep the kernel events too, those of the filtered pids if -p is set.\n"
+           "                           With any of -p, -t, -l and -n, out_file is a raw trace file.\n"
+           "  -s, --slice_stats        Pair the B/E and S/F markers of a raw or text trace file and print the\n"
+           "                           slice durations per name and tag, to out_file if -o is set.\n"
+           "  -h, --help               Show this help.\n", name, name, name, name);
+}
+
+void PrintStats(const DecodeStats& stats)
+{
+    printf("Trace format miss count: %" PRIu64 "\n", stats.formatMissCount);
+    printf("Trace format id missed set:\n{");
+    const char* sep = "";
+    for (uint16_t id : stats.formatMissIds) {
+        printf("%s%u", sep, id);
+        sep = ", ";
+    }
+    printf("}\n");
+
+    uint64_t countTotal = 0;
+    uint64_t bytesTotal = 0;
+    for (const auto& [id, count] : stats.eventCount) {
+        countTotal += count;
+        bytesTotal += stats.eventBytes.at(id);
+    }
+    double memTotal = bytesTotal / BYTES_PER_KB;
+    printf("Trace counter: total count(%" PRIu64 "), total mem(%.3fKB)\n", countTotal, memTotal);
+    for (const auto& [id, count] : stats.eventCount) {
+        double mem = stats.eventBytes.at(id) / BYTES_PER_KB;
+        printf("ID %u: count=%" PRIu64 ", count percentage=%.5f%%, mem=%.3fKB, mem percentage=%.5f%%\n", id, count,
+            count * PERCENTAGE / countTotal, mem, mem * PERCENTAGE / memTotal);
+    }
+}
+
+bool DecodeFile(const std::string& binaryFile, const std::string& outFile)
+{
+    RawTraceFile traceFile;
+    RawTraceError openRet = traceFile.Open(binaryFile);
+    if (openRet != RawTraceError::NONE) {
+        fprintf(stderr, "error: %s: %s.\n", binaryFile.c_str(), GetRawTraceErrorMsg(openRet));
+        return false;
+    }
+    if (traceFile.IsTruncated()) {
+        fprintf(stderr, "warning: %s is truncated.\n", binaryFile.c_str());
+    }
+    SmartFd outFd(open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)); // 0600 : -rw-------
+    if (!outFd) {
+        fprintf(stderr, "error: open %s failed, errno(%d).\n", outFile.c_str(), errno);
+        return false;
+    }
+    RawTraceDecoder decoder(traceFile);
+    DecodeStats stats;
+    bool ret = decoder.DecodeToSystrace(outFd.GetFd(), stats);
+    PrintStats(stats);
+    return ret;
+}
+
+std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        end = (end == std::string::npos) ? list.size() : end;
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+bool ParseLevel(const std::string& level, uint32_t& minLevel)
+{
+    const std::string levels = "DICM"; // indexed by HiTraceOutputLevel
+    if (level.size() != 1 || levels.find(level[0]) == std::string::npos) {
+        fprintf(stderr, "error: level must be one of D, I, C and M.\n");
+        return false;
+    }
+    minLevel = static_cast<uint32_t>(levels.find(level[0]));
+    return true;
+}
+
+bool FilterFile(const std::string& binaryFile, const std::string& outFile, const TraceMarkerFilter& filter)
+{
+    FilterStats stats;
+    RawTraceError ret = FilterRawTraceFile(binaryFile, outFile, filter, stats);
+    if (ret != RawTraceError::NONE) {
+        fprintf(stderr, "error: filter %s into %s: %s, errno(%d).\n", binaryFile.c_str(), outFile.c_str(),
+            GetRawTraceErrorMsg(ret), errno);
+        return false;
+    }
+    printf("Trace filter: kept %" PRIu64 " of %" PRIu64 " events, %" PRIu64 " of %" PRIu64 " pages.\n",
+        stats.eventsKept, stats.eventsIn, stats.pagesOut, stats.pagesIn);
+    return true;
+}
+
+bool PrintSliceStats(const std::string& traceFile, const std::string& outFile)
+{
+    SliceAggregator aggregator;
+    if (!AggregateTraceSlices(traceFile, aggregator)) {
+        return false;
+    }
+    std::string text = FormatSliceStats(aggregator);
+    if (outFile.empty()) {
+        fwrite(text.data(), 1, text.size(), stdout);
+        return true;
+    }
+    SmartFd outFd(open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)); // 0644 : -rw-r--r--
+    if (!outFd || TEMP_FAILURE_RETRY(write(outFd.GetFd(), text.data(), text.size())) !=
+        static_cast<ssize_t>(text.size())) {
+        fprintf(stderr, "error: write %s failed, errno(%d).\n", outFile.c_str(), errno);
+        return false;
+    }
+    return true;
+}
+
+bool DecodeDir(const std::string& dir)
+{
+    DIR* dirp = opendir(dir.c_str());
+    if (dirp == nullptr) {
+        fprintf(stderr, "error: file_dir does not exist.\n");
+        return false;
+    }
+    bool ret = true;
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(dirp)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name.find(".sys") == std::string::npos) {
+            continue;
+        }
+        printf("%s\n", name.c_str());
+        std::string outFile = dir + "/" + name.substr(0, name.find('.')) + ".ftrace";
+        ret = DecodeFile(dir + "/" + name, outFile) && ret;
+    }
+    closedir(dirp);
+    return ret;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    static const struct option longOptions[] = {
+        {"binary_file", required_argument, nullptr, 'b'},
+        {"out_file", required_argument, nullptr, 'o'},
+        {"file_dir", required_argument, nullptr, 'd'},
+        {"pid", required_argument, nullptr, 'p'},
+        {"tag_mask", required_argument, nullptr, 't'},
+        {"level", required_argument, nullptr, 'l'},
+        {"name", required_argument, nullptr, 'n'},
+        {"keep_kernel_events", no_argument, nullptr, 'k'},
+        {"slice_stats", required_argument, nullptr, 's'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    std::string binaryFile;
+    std::string outFile;
+    std::string fileDir;
+    std::string sliceStatsFile;
+    TraceMarkerFilter filter;
+    int opt = 0;
+    while ((opt = getopt_long(argc, argv, "b:o:d:p:t:l:n:ks:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'b':
+                binaryFile = optarg;
+                break;
+            case 'o':
+                outFile = optarg;
+                break;
+            case 'd':
+                fileDir = optarg;
+                break;
+            case 'p':
+                for (const auto& pid : SplitList(optarg)) {
+                    filter.pids.push_back(static_cast<int32_t>(strtol(pid.c_str(), nullptr, 0)));
+                }
+                break;
+            case 't':
+                filter.tags = strtoull(optarg, nullptr, 0);
+                break;
+            case 'l':
+                if (!ParseLevel(optarg, filter.minLevel)) {
+                    return -1;
+                }
+                break;
+            case 'n':
+                filter.names = SplitList(optarg);
+                break;
+            case 'k':
+                filter.keepKernelEvents = true;
+                break;
+            case 's':
+                sliceStatsFile = optarg;
+                break;
+            default:
+                PrintUsage(argv[0]);
+                return (opt == 'h') ? 0 : -1;
+        }
+    }
+    if (!fileDir.empty()) {
+        return DecodeDir(fileDir) ? 0 : -1;
+    }
+    if (!sliceStatsFile.empty()) {
+        return PrintSliceStats(sliceStatsFile, outFile) ? 0 : -1;
+    }
+    if (binaryFile.empty() || outFile.empty()) {
+        fprintf(stderr, "error: binary_file and out_file must be specified.\n");
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    if (IsMarkerFilterSet(filter)) {
+        return FilterFile(binaryFile, outFile, filter) ? 0 : -1;
+    }
+    return DecodeFile(binaryFile, outFile) ? 0 : -1;
+}
@@ -0,0 +1,528 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raw_trace_decoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr size_t PAGE_HEADER_SIZE = 17; // u64 timestamp, u64 length, u8 cpu, packed
+constexpr size_t PAGE_CPU_OFFSET = 16;
+constexpr size_t EVENT_HEADER_SIZE = 6; // u32 timestamp delta, u16 size, packed
+constexpr size_t EVENT_SIZE_OFFSET = 4;
+constexpr size_t EVENT_ALIGN_MASK = 3;
+constexpr size_t MIN_EVENT_SIZE = 2; // the event id
+constexpr size_t LINUX_PAGE_COMMIT_OFFSET = 8;
+constexpr size_t LINUX_PAGE_HEADER_SIZE = 16; // u64 timestamp, long commit
+constexpr size_t LINUX_PAGE_HEADER_SIZE_32BIT = 12;
+constexpr uint64_t LINUX_PAGE_COMMIT_MASK = 0xfffff; // the high bits flag missed events
+constexpr uint32_t LINUX_TYPE_LEN_MASK = 0x1f;
+constexpr uint32_t LINUX_TIME_DELTA_SHIFT = 5;
+constexpr uint32_t LINUX_TYPE_DATA_MAX = 28;
+constexpr uint32_t LINUX_TYPE_PADDING = 29;
+constexpr uint32_t LINUX_TYPE_TIME_EXTEND = 30;
+constexpr uint32_t LINUX_TYPE_TIME_STAMP = 31;
+constexpr uint32_t LINUX_TIME_EXTEND_SHIFT = 27;
+constexpr uint64_t LINUX_TIME_STAMP_MSB_MASK = ~((1ULL << 59) - 1); // 59 : bits kept by an absolute timestamp
+constexpr size_t LINUX_EVENT_HEADER_SIZE = 4;
+constexpr size_t LINUX_EVENT_ALIGNMENT = 4;
+constexpr size_t PAGES_PER_READ = 64;
+constexpr size_t PAGES_PER_SHARD = 256; // 1 MB
+constexpr size_t LINES_PER_CHUNK = 4096;
+constexpr size_t MAX_QUEUED_CHUNKS = 4;
+constexpr size_t OUTPUT_BUFFER_SIZE = 1024 * 1024;
+
+constexpr char TRACE_TXT_HEADER_TITLE[] = "# tracer: nop\n#\n";
+// the converter keeps the kernel format string unexpanded, the default header does the same
+constexpr char TRACE_TXT_HEADER_ENTRIES[] = "# entries-in-buffer/entries-written: %lu/%lu   #P:%d\n";
+constexpr char TRACE_TXT_HEADER_COLUMNS[] = "#\n"
+    "#                                      _-----=> irqs-off\n"
+    "#                                     / _----=> need-resched\n"
+    "#                                    | / _---=> hardirq/softirq\n"
+    "#                                    || / _--=> preempt-depth\n"
+    "#                                    ||| /     delay\n"
+    "#           TASK-PID    TGID   CPU#  ||||    TIMESTAMP  FUNCTION\n"
+    "#              | |        |      |   ||||       |         |\n";
+
+template<typename T>
+T ReadLittleEndian(const uint8_t* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(data[i]) << (i * 8); // 8 : bits per byte
+    }
+    return value;
+}
+
+bool WriteFull(const int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t ret = TEMP_FAILURE_RETRY(write(fd, data, size));
+        if (ret <= 0) {
+            fprintf(stderr, "error: write output failed, errno(%d).\n", errno);
+            return false;
+        }
+        data += ret;
+        size -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+struct LineChunk {
+    std::string text;
+    std::vector<uint64_t> timestamps;
+    std::vector<size_t> ends; // end offset of every line in text
+};
+
+void MergeStats(const DecodeStats& from, DecodeStats& to)
+{
+    for (const auto& [id, count] : from.eventCount) {
+        to.eventCount[id] += count;
+    }
+    for (const auto& [id, bytes] : from.eventBytes) {
+        to.eventBytes[id] += bytes;
+    }
+    to.formatMissCount += from.formatMissCount;
+    to.formatMissIds.insert(from.formatMissIds.begin(), from.formatMissIds.end());
+}
+
+// A page-aligned run of pages of one cpu. Every page restarts from the absolute timestamp in its header and
+// time extend records never cross a page, so a shard decodes without any state from the one before it.
+struct PageShard {
+    off_t offset = 0;
+    size_t pageCount = 0;
+    uint32_t cpu = 0;
+    uint64_t startTime = 0; // of the first page, the pool hands the shards out in this order
+    std::atomic<bool> claimed {false};
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::unique_ptr<LineChunk>> chunks;
+    bool done = false;
+};
+
+/**
+ * @brief The shards of every cpu, decoded by a fixed set of threads that each take the next unclaimed shard in
+ *        start time order, so a thread done with a quiet cpu goes on with the pages of a busy one.
+ * @note A thread only waits on the bounded chunk queue of the shard it decodes, and the merger always drains the
+ *       current shard of the cpu it waits for, so the pool cannot stall. A shard the merger needs before any
+ *       thread claimed it is decoded by the merger itself, unbounded.
+ */
+class ShardPool {
+public:
+    ShardPool(const RawTraceFile& traceFile, const EventFormatter& formatter)
+        : traceFile_(traceFile), formatter_(formatter) {}
+
+    ~ShardPool()
+    {
+        Join();
+    }
+
+    size_t AddShard(const uint32_t cpu, const off_t offset, const size_t pageCount)
+    {
+        auto shard = std::make_unique<PageShard>();
+        shard->cpu = cpu;
+        shard->offset = offset;
+        shard->pageCount = pageCount;
+        uint8_t timestamp[sizeof(uint64_t)] = {0}; // both page formats start with the u64 timestamp
+        if (TEMP_FAILURE_RETRY(pread(traceFile_.GetFd(), timestamp, sizeof(timestamp), offset)) ==
+            static_cast<ssize_t>(sizeof(timestamp))) {
+            shard->startTime = ReadLittleEndian<uint64_t>(timestamp);
+        }
+        shards_.push_back(std::move(shard));
+        return shards_.size() - 1;
+    }
+
+    void Start(const size_t threadCount)
+    {
+        for (const auto& shard : shards_) {
+            claimOrder_.push_back(shard.get());
+        }
+        std::stable_sort(claimOrder_.begin(), claimOrder_.end(), [](const PageShard* lhs, const PageShard* rhs) {
+            return lhs->startTime < rhs->startTime;
+        });
+        size_t count = std::min(threadCount, shards_.size());
+        threadStats_.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            threads_.emplace_back([this, i] {
+                std::vector<uint8_t> pages(RAW_TRACE_PAGE_SIZE * PAGES_PER_READ);
+                for (PageShard* shard = ClaimNext(); shard != nullptr; shard = ClaimNext()) {
+                    DecodeShard(*shard, threadStats_[i], pages, true);
+                }
+            });
+        }
+    }
+
+    // Returns nullptr at the end of the shard.
+    std::unique_ptr<LineChunk> Pop(const size_t shardIdx)
+    {
+        PageShard& shard = *shards_[shardIdx];
+        if (!shard.claimed.exchange(true)) {
+            mergerPages_.resize(RAW_TRACE_PAGE_SIZE * PAGES_PER_READ);
+            DecodeShard(shard, mergerStats_, mergerPages_, false);
+        }
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.cond.wait(lock, [&shard] { return !shard.chunks.empty() || shard.done; });
+        if (shard.chunks.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<LineChunk> chunk = std::move(shard.chunks.front());
+        shard.chunks.pop_front();
+        shard.cond.notify_all();
+        return chunk;
+    }
+
+    void Join()
+    {
+        for (auto& thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    void MergeStatsTo(DecodeStats& stats) const
+    {
+        for (const auto& threadStats : threadStats_) {
+            MergeStats(threadStats, stats);
+        }
+        MergeStats(mergerStats_, stats);
+    }
+
+    bool HasReadError() const { return readError_.load(); }
+
+private:
+    PageShard* ClaimNext()
+    {
+        for (size_t idx = nextClaim_.fetch_add(1); idx < claimOrder_.size(); idx = nextClaim_.fetch_add(1)) {
+            if (!claimOrder_[idx]->claimed.exchange(true)) {
+                return claimOrder_[idx];
+            }
+        }
+        return nullptr;
+    }
+
+    void Push(PageShard& shard, std::unique_ptr<LineChunk> chunk, const bool bounded)
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if (bounded) {
+            shard.cond.wait(lock, [&shard] { return shard.chunks.size() < MAX_QUEUED_CHUNKS; });
+        }
+        if (chunk != nullptr) {
+            shard.chunks.push_back(std::move(chunk));
+        } else {
+            shard.done = true;
+        }
+        shard.cond.notify_all();
+    }
+
+    void DecodeShard(PageShard& shard, DecodeStats& stats, std::vector<uint8_t>& pages, const bool bounded)
+    {
+        auto chunk = std::make_unique<LineChunk>();
+        auto onEvent = [this, &shard, &chunk, &stats, bounded](const RawEvent& event) {
+            uint16_t eventId = ReadLittleEndian<uint16_t>(event.data);
+            stats.eventCount[eventId]++;
+            stats.eventBytes[eventId] += event.size;
+            if (!formatter_.Format(event, chunk->text)) {
+                stats.formatMissCount++;
+                stats.formatMissIds.insert(eventId);
+                return;
+            }
+            chunk->timestamps.push_back(event.timestamp);
+            chunk->ends.push_back(chunk->text.size());
+            if (chunk->ends.size() >= LINES_PER_CHUNK) {
+                Push(shard, std::move(chunk), bounded);
+                chunk = std::make_unique<LineChunk>();
+            }
+        };
+        // after a read error the shard is still closed, so the merger never waits on it
+        for (size_t page = 0; page < shard.pageCount && !readError_.load(); page += PAGES_PER_READ) {
+            size_t readPages = std::min(PAGES_PER_READ, shard.pageCount - page);
+            size_t readSize = readPages * RAW_TRACE_PAGE_SIZE;
+            off_t offset = shard.offset + static_cast<off_t>(page * RAW_TRACE_PAGE_SIZE);
+            if (TEMP_FAILURE_RETRY(pread(traceFile_.GetFd(), pages.data(), readSize, offset)) !=
+                static_cast<ssize_t>(readSize)) {
+                readError_.store(true);
+                break;
+            }
+            for (size_t i = 0; i < readPages; i++) {
+                DecodeOnePage(pages.data() + i * RAW_TRACE_PAGE_SIZE, shard.cpu, onEvent);
+            }
+        }
+        if (!chunk->ends.empty()) {
+            Push(shard, std::move(chunk), bounded);
+        }
+        Push(shard, nullptr, false);
+    }
+
+    void DecodeOnePage(const uint8_t* page, const uint32_t cpu,
+        const std::function<void(const RawEvent&)>& callback) const
+    {
+        // hm pages carry their cpu, linux pages take it from the section they were dumped into
+        if (traceFile_.IsHmFormat()) {
+            DecodePage(page, callback);
+        } else {
+            DecodeLinuxPage(page, cpu, traceFile_.Is32BitArch(), callback);
+        }
+    }
+
+    const RawTraceFile& traceFile_;
+    const EventFormatter& formatter_;
+    std::vector<std::unique_ptr<PageShard>> shards_;
+    std::vector<PageShard*> claimOrder_;
+    std::atomic<size_t> nextClaim_ {0};
+    std::vector<std::thread> threads_;
+    std::vector<DecodeStats> threadStats_;
+    DecodeStats mergerStats_;
+    std::vector<uint8_t> mergerPages_;
+    std::atomic<bool> readError_ {false};
+};
+
+/**
+ * @brief One cpu: its sections are cut into page-aligned shards of the shared pool, and the merger pops their
+ *        chunks back in shard order.
+ */
+class CpuStream {
+public:
+    CpuStream(ShardPool& pool, const uint8_t sectionType) : pool_(pool), cpu_(sectionType - RAW_SECTION_CPU_RAW) {}
+
+    void AddSection(const RawTraceSection& section)
+    {
+        size_t pageCount = section.length / RAW_TRACE_PAGE_SIZE;
+        for (size_t page = 0; page < pageCount; page += PAGES_PER_SHARD) {
+            off_t offset = section.offset + static_cast<off_t>(page * RAW_TRACE_PAGE_SIZE);
+            shards_.push_back(pool_.AddShard(cpu_, offset, std::min(PAGES_PER_SHARD, pageCount - page)));
+        }
+    }
+
+    // Returns nullptr once the stream is drained.
+    std::unique_ptr<LineChunk> Pop()
+    {
+        while (nextShard_ < shards_.size()) {
+            std::unique_ptr<LineChunk> chunk = pool_.Pop(shards_[nextShard_]);
+            if (chunk != nullptr) {
+                return chunk;
+            }
+            nextShard_++;
+        }
+        return nullptr;
+    }
+
+private:
+    ShardPool& pool_;
+    const uint32_t cpu_;
+    std::vector<size_t> shards_;
+    size_t nextShard_ = 0;
+};
+
+struct StreamCursor {
+    std::unique_ptr<LineChunk> chunk;
+    size_t line = 0;
+
+    uint64_t Timestamp() const { return chunk->timestamps[line]; }
+};
+
+// the calling thread merges and writes the text, the pool gets the other hardware threads
+size_t GetDefaultThreadCount()
+{
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    return (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+}
+} // namespace
+
+void DecodePage(const uint8_t* page, const std::function<void(const RawEvent&)>& callback)
+{
+    RawEvent event;
+    uint64_t pageTimestamp = ReadLittleEndian<uint64_t>(page);
+    event.cpu = page[PAGE_CPU_OFFSET];
+    size_t pos = PAGE_HEADER_SIZE;
+    while (pos + EVENT_HEADER_SIZE <= RAW_TRACE_PAGE_SIZE) {
+        uint32_t delta = ReadLittleEndian<uint32_t>(page + pos);
+        size_t eventSize = ReadLittleEndian<uint16_t>(page + pos + EVENT_SIZE_OFFSET);
+        pos += EVENT_HEADER_SIZE;
+        size_t available = RAW_TRACE_PAGE_SIZE - pos;
+        if (std::min(eventSize, available) < MIN_EVENT_SIZE) {
+            break;
+        }
+        event.data = page + pos;
+        event.size = std::min(eventSize, available);
+        event.timestamp = pageTimestamp + delta;
+        callback(event);
+        pos += (eventSize + EVENT_ALIGN_MASK) & ~EVENT_ALIGN_MASK;
+    }
+}
+
+void DecodeLinuxPage(const uint8_t* page, const uint32_t cpu, const bool is32BitArch,
+    const std::function<void(const RawEvent&)>& callback)
+{
+    RawEvent event;
+    event.cpu = cpu;
+    uint64_t timestamp = ReadLittleEndian<uint64_t>(page);
+    uint64_t commit = is32BitArch ? ReadLittleEndian<uint32_t>(page + LINUX_PAGE_COMMIT_OFFSET) :
+        ReadLittleEndian<uint64_t>(page + LINUX_PAGE_COMMIT_OFFSET);
+    const uint8_t* data = page + (is32BitArch ? LINUX_PAGE_HEADER_SIZE_32BIT : LINUX_PAGE_HEADER_SIZE);
+    size_t dataSize = std::min(static_cast<size_t>(commit & LINUX_PAGE_COMMIT_MASK),
+        static_cast<size_t>(page + RAW_TRACE_PAGE_SIZE - data));
+    size_t pos = 0;
+    while (pos + LINUX_EVENT_HEADER_SIZE <= dataSize) {
+        uint32_t header = ReadLittleEndian<uint32_t>(data + pos);
+        uint32_t typeLen = header & LINUX_TYPE_LEN_MASK;
+        uint64_t delta = header >> LINUX_TIME_DELTA_SHIFT;
+        // every record but the short data ones carries a 32 bit argument after the header
+        uint32_t array0 = 0;
+        if (typeLen == 0 || typeLen > LINUX_TYPE_DATA_MAX) {
+            if (pos + LINUX_EVENT_HEADER_SIZE * 2 > dataSize) { // 2 : header and array[0]
+                break;
+            }
+            array0 = ReadLittleEndian<uint32_t>(data + pos + LINUX_EVENT_HEADER_SIZE);
+        }
+        size_t length = 0;
+        if (typeLen == LINUX_TYPE_PADDING) {
+            if (delta == 0) {
+                break; // the rest of the page is padding
+            }
+            pos += LINUX_EVENT_HEADER_SIZE + array0;
+            continue;
+        } else if (typeLen == LINUX_TYPE_TIME_EXTEND) {
+            timestamp += (static_cast<uint64_t>(array0) << LINUX_TIME_EXTEND_SHIFT) + delta;
+            pos += LINUX_EVENT_HEADER_SIZE * 2; // 2 : header and array[0]
+            continue;
+        } else if (typeLen == LINUX_TYPE_TIME_STAMP) {
+            timestamp = (timestamp & LINUX_TIME_STAMP_MSB_MASK) |
+                (static_cast<uint64_t>(array0) << LINUX_TIME_EXTEND_SHIFT) | delta;
+            pos += LINUX_EVENT_HEADER_SIZE * 2; // 2 : header and array[0]
+            continue;
+        } else if (typeLen == 0) {
+            if (array0 < LINUX_EVENT_HEADER_SIZE) {
+                break;
+            }
+            length = array0 - LINUX_EVENT_HEADER_SIZE; // array[0] counts itself
+            pos += LINUX_EVENT_HEADER_SIZE * 2; // 2 : header and array[0]
+        } else {
+            length = typeLen * LINUX_EVENT_ALIGNMENT;
+            pos += LINUX_EVENT_HEADER_SIZE;
+        }
+        timestamp += delta;
+        if (pos + length > dataSize) {
+            break;
+        }
+        if (length >= MIN_EVENT_SIZE) {
+            event.data = data + pos;
+            event.size = length;
+            event.timestamp = timestamp;
+            callback(event);
+        }
+        pos += length;
+    }
+}
+
+std::string FormatTraceTextHeader(const uint64_t entries, const uint64_t written, const uint32_t cpuCount)
+{
+    std::string header(TRACE_TXT_HEADER_TITLE);
+    char line[128] = { 0 }; // 128 : longer than the entries line with two 20 digit counters
+    int len = snprintf(line, sizeof(line), "# entries-in-buffer/entries-written: %" PRIu64 "/%" PRIu64 "   #P:%u\n",
+        entries, written, cpuCount);
+    if (len > 0) {
+        header.append(line, std::min(static_cast<size_t>(len), sizeof(line) - 1));
+    }
+    header += TRACE_TXT_HEADER_COLUMNS;
+    return header;
+}
+
+RawTraceDecoder::RawTraceDecoder(const RawTraceFile& traceFile) : traceFile_(traceFile), formatter_(traceFile)
+{
+    textHeader_ = std::string(TRACE_TXT_HEADER_TITLE) + TRACE_TXT_HEADER_ENTRIES + TRACE_TXT_HEADER_COLUMNS;
+}
+
+bool RawTraceDecoder::DecodeToSystrace(const int outFd, DecodeStats& stats)
+{
+    // sections of the same cpu, e.g. from merged cache slices, are decoded in file order by one stream
+    ShardPool pool(traceFile_, formatter_);
+    std::vector<std::unique_ptr<CpuStream>> streams;
+    std::map<uint8_t, CpuStream*> streamByType;
+    for (const auto& section : traceFile_.GetCpuSections()) {
+        auto it = streamByType.find(section.type);
+        if (it == streamByType.end()) {
+            streams.push_back(std::make_unique<CpuStream>(pool, section.type));
+            it = streamByType.emplace(section.type, streams.back().get()).first;
+        }
+        it->second->AddSection(section);
+    }
+    pool.Start(threadCount_ == 0 ? GetDefaultThreadCount() : threadCount_);
+
+    std::vector<StreamCursor> cursors(streams.size());
+    using HeapItem = std::pair<uint64_t, size_t>; // timestamp, stream index
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    for (size_t i = 0; i < streams.size(); i++) {
+        cursors[i].chunk = streams[i]->Pop();
+        if (cursors[i].chunk != nullptr) {
+            heap.emplace(cursors[i].Timestamp(), i);
+        }
+    }
+
+    std::string output(textHeader_);
+    output.reserve(OUTPUT_BUFFER_SIZE + RAW_TRACE_PAGE_SIZE);
+    bool ret = true;
+    auto flushOutput = [&ret, &output, &stats, outFd]() {
+        ret = ret && WriteFull(outFd, output.data(), output.size());
+        stats.outputBytes += ret ? output.size() : 0;
+        output.clear();
+    };
+    while (!heap.empty()) {
+        size_t index = heap.top().second;
+        heap.pop();
+        StreamCursor& cursor = cursors[index];
+        size_t begin = (cursor.line == 0) ? 0 : cursor.chunk->ends[cursor.line - 1];
+        output.append(cursor.chunk->text, begin, cursor.chunk->ends[cursor.line] - begin);
+        output += '\n';
+        if (output.size() >= OUTPUT_BUFFER_SIZE) {
+            flushOutput();
+        }
+        if (++cursor.line == cursor.chunk->ends.size()) {
+            cursor.chunk = streams[index]->Pop();
+            cursor.line = 0;
+        }
+        if (cursor.chunk != nullptr) {
+            heap.emplace(cursor.Timestamp(), index);
+        }
+    }
+    flushOutput();
+
+    pool.Join();
+    pool.MergeStatsTo(stats);
+    if (pool.HasReadError()) {
+        fprintf(stderr, "error: read raw section failed.\n");
+        ret = false;
+    }
+    return ret;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
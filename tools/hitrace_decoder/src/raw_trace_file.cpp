@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raw_trace_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr uint32_t ARCH_32BIT_FLAG = 1;
+constexpr uint32_t CPU_COUNT_SHIFT = 1;
+constexpr uint32_t CPU_COUNT_MASK = 0x1f;
+constexpr size_t MAX_SECTION_COUNT = 256;
+constexpr char SIDECAR_PREFIX[] = "events_format_";
+constexpr size_t SIDECAR_HASH_LEN = 16;
+
+bool ReadFull(const int fd, void* buf, const size_t size, const off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = TEMP_FAILURE_RETRY(pread(fd, static_cast<uint8_t*>(buf) + done, size - done,
+            offset + static_cast<off_t>(done)));
+        if (ret <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool StartsWith(const std::string& str, const char* prefix)
+{
+    return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+std::string LeftTrim(const std::string& str)
+{
+    size_t pos = 0;
+    while (pos < str.size() && isspace(static_cast<unsigned char>(str[pos]))) {
+        pos++;
+    }
+    return str.substr(pos);
+}
+
+bool ParseEventField(const std::string& line, EventField& field)
+{
+    // field:unsigned short common_type;	offset:0;	size:2;	signed:0;
+    std::vector<std::string> items;
+    std::stringstream ss(line);
+    std::string item;
+    while (std::getline(ss, item, ';')) {
+        items.push_back(LeftTrim(item));
+    }
+    constexpr size_t minItems = 4;
+    if (items.size() < minItems) {
+        return false;
+    }
+    const std::string& decl = items[0];
+    size_t namePos = decl.rfind(' ');
+    constexpr size_t declPrefixLen = sizeof("field:") - 1;
+    if (namePos == std::string::npos || namePos < declPrefixLen) {
+        return false;
+    }
+    field.type = decl.substr(declPrefixLen, namePos - declPrefixLen);
+    field.name = decl.substr(namePos + 1);
+    size_t bracket = field.name.find('[');
+    if (bracket != std::string::npos) {
+        field.name.erase(bracket);
+        field.isArray = true;
+    }
+    field.isDataLoc = StartsWith(field.type, "__data_loc");
+    field.offset = static_cast<uint32_t>(strtoul(items[1].c_str() + sizeof("offset:") - 1, nullptr, 0));
+    field.size = static_cast<uint32_t>(strtoul(items[2].c_str() + sizeof("size:") - 1, nullptr, 0));
+    field.isSigned = strtol(items[3].c_str() + sizeof("signed:") - 1, nullptr, 0) != 0;
+    return true;
+}
+
+bool IsValidSidecarName(const std::string& name)
+{
+    if (name.size() != strlen(SIDECAR_PREFIX) + SIDECAR_HASH_LEN || !StartsWith(name, SIDECAR_PREFIX)) {
+        return false;
+    }
+    for (size_t i = strlen(SIDECAR_PREFIX); i < name.size(); i++) {
+        if (!isxdigit(static_cast<unsigned char>(name[i])) || isupper(static_cast<unsigned char>(name[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+const char* GetRawTraceErrorMsg(const RawTraceError error)
+{
+    switch (error) {
+        case RawTraceError::NONE:
+            return "success";
+        case RawTraceError::OPEN_FAILED:
+            return "open failed";
+        case RawTraceError::NOT_RAW_TRACE:
+            return "not a raw trace file";
+        case RawTraceError::BAD_SECTION_TABLE:
+            return "bad section table";
+        case RawTraceError::READ_FAILED:
+            return "read failed";
+        case RawTraceError::WRITE_FAILED:
+            return "write failed";
+        case RawTraceError::BAD_EVENTS_FORMAT_REF:
+            return "invalid events format reference";
+        case RawTraceError::SIDECAR_NOT_FOUND:
+            return "events format sidecar not found, please copy it next to the trace file";
+        default:
+            return "unknown error";
+    }
+}
+
+const EventField* EventFormat::FindField(const std::string& fieldName) const
+{
+    for (const auto& field : fields) {
+        if (field.name == fieldName) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+void ParseEventFormats(const std::string& text, std::unordered_map<uint16_t, EventFormat>& formats)
+{
+    std::stringstream ss(text);
+    std::string line;
+    EventFormat format;
+    bool hasId = false;
+    while (std::getline(ss, line)) {
+        line = LeftTrim(line);
+        if (StartsWith(line, "name: ")) {
+            format.name = line.substr(sizeof("name: ") - 1);
+        } else if (StartsWith(line, "ID: ")) {
+            format.id = static_cast<uint16_t>(strtoul(line.c_str() + sizeof("ID: ") - 1, nullptr, 0));
+            hasId = true;
+        } else if (StartsWith(line, "field:")) {
+            EventField field;
+            if (ParseEventField(line, field)) {
+                format.fields.push_back(std::move(field));
+            }
+        } else if (StartsWith(line, "print fmt: ")) {
+            format.printFmt = line.substr(sizeof("print fmt: ") - 1);
+            if (hasId) {
+                formats[format.id] = std::move(format);
+            }
+            format = EventFormat();
+            hasId = false;
+        }
+    }
+}
+
+void ParseCmdlines(const std::string& text, std::unordered_map<int32_t, std::string>& cmdlines)
+{
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        line.erase(std::remove(line.begin(), line.end(), '\t'), line.end());
+        size_t pos = line.find(' ');
+        if (pos == std::string::npos) {
+            continue;
+        }
+        cmdlines[static_cast<int32_t>(strtol(line.c_str(), nullptr, 0))] = line.substr(pos + 1);
+    }
+}
+
+void ParseTgids(const std::string& text, std::unordered_map<int32_t, int32_t>& tgids)
+{
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        size_t pos = line.find(' ');
+        if (pos == std::string::npos) {
+            continue;
+        }
+        tgids[static_cast<int32_t>(strtol(line.c_str(), nullptr, 0))] =
+            static_cast<int32_t>(strtol(line.c_str() + pos + 1, nullptr, 0));
+    }
+}
+
+bool ParseHeaderPageArch(const std::string& text, bool& is32BitArch)
+{
+    // field: local_t commit;	offset:8;	size:8;	signed:1;
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        line = LeftTrim(line);
+        EventField field;
+        if (StartsWith(line, "field:") && ParseEventField(line, field) && field.name == "commit") {
+            is32BitArch = field.size == sizeof(uint32_t);
+            return true;
+        }
+    }
+    return false;
+}
+
+RawTraceError RawTraceFile::Open(const std::string& path)
+{
+    path_ = path;
+    fd_ = SmartFd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat fileStat;
+    if (!fd_ || fstat(fd_.GetFd(), &fileStat) != 0) {
+        return RawTraceError::OPEN_FAILED;
+    }
+    RawTraceFileHeader& header = header_;
+    if (!ReadFull(fd_.GetFd(), &header, sizeof(header), 0) || header.magicNumber != RAW_TRACE_MAGIC_NUMBER) {
+        return RawTraceError::NOT_RAW_TRACE;
+    }
+    isHmFormat_ = header.fileType == RAW_FILE_TYPE_HM;
+    is32BitArch_ = (header.reserved & ARCH_32BIT_FLAG) != 0;
+    cpuCount_ = (header.reserved >> CPU_COUNT_SHIFT) & CPU_COUNT_MASK;
+
+    off_t offset = static_cast<off_t>(sizeof(header));
+    size_t sectionCount = 0;
+    while (offset + static_cast<off_t>(sizeof(RawTraceSectionHeader)) <= fileStat.st_size) {
+        RawTraceSectionHeader sectionHeader;
+        if (!ReadFull(fd_.GetFd(), &sectionHeader, sizeof(sectionHeader), offset) ||
+            ++sectionCount > MAX_SECTION_COUNT) {
+            return RawTraceError::BAD_SECTION_TABLE;
+        }
+        RawTraceSection section = {
+            .type = sectionHeader.type,
+            .offset = offset + static_cast<off_t>(sizeof(sectionHeader)),
+            .length = sectionHeader.length,
+        };
+        if (section.offset + static_cast<off_t>(section.length) > fileStat.st_size) {
+            isTruncated_ = true;
+            section.length = static_cast<uint32_t>(fileStat.st_size - section.offset);
+        }
+        sections_.push_back(section);
+        if (section.type >= RAW_SECTION_CPU_RAW && section.type < RAW_SECTION_HEADER_PAGE) {
+            cpuSections_.push_back(section);
+        } else {
+            RawTraceError ret = LoadMetadata(section);
+            if (ret != RawTraceError::NONE) {
+                return ret;
+            }
+        }
+        offset = section.offset + static_cast<off_t>(section.length);
+    }
+    return RawTraceError::NONE;
+}
+
+bool RawTraceFile::ReadSection(const RawTraceSection& section, std::string& data) const
+{
+    data.resize(section.length);
+    return ReadFull(fd_.GetFd(), &data[0], section.length, section.offset);
+}
+
+RawTraceError RawTraceFile::LoadMetadata(const RawTraceSection& section)
+{
+    if (section.type != RAW_SECTION_EVENTS_FORMAT && section.type != RAW_SECTION_EVENTS_FORMAT_REF &&
+        section.type != RAW_SECTION_CMDLINES && section.type != RAW_SECTION_TGIDS) {
+        return RawTraceError::NONE;
+    }
+    std::string data;
+    if (!ReadSection(section, data)) {
+        return RawTraceError::READ_FAILED;
+    }
+    switch (section.type) {
+        case RAW_SECTION_EVENTS_FORMAT:
+            ParseEventFormats(data, eventFormats_);
+            break;
+        case RAW_SECTION_EVENTS_FORMAT_REF:
+            return LoadEventsFormatRef(data);
+        case RAW_SECTION_CMDLINES:
+            ParseCmdlines(data, cmdlines_);
+            break;
+        default:
+            ParseTgids(data, tgids_);
+            break;
+    }
+    return RawTraceError::NONE;
+}
+
+RawTraceError RawTraceFile::LoadEventsFormatRef(const std::string& sidecarName)
+{
+    if (!IsValidSidecarName(sidecarName)) {
+        return RawTraceError::BAD_EVENTS_FORMAT_REF;
+    }
+    size_t dirPos = path_.rfind('/');
+    std::string sidecarPath = (dirPos == std::string::npos) ? sidecarName : path_.substr(0, dirPos + 1) + sidecarName;
+    SmartFd sidecarFd(open(sidecarPath.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat sidecarStat;
+    if (!sidecarFd || fstat(sidecarFd.GetFd(), &sidecarStat) != 0) {
+        return RawTraceError::SIDECAR_NOT_FOUND;
+    }
+    std::string text(static_cast<size_t>(sidecarStat.st_size), '\0');
+    if (!text.empty() && !ReadFull(sidecarFd.GetFd(), &text[0], text.size(), 0)) {
+        return RawTraceError::READ_FAILED;
+    }
+    ParseEventFormats(text, eventFormats_);
+    return RawTraceError::NONE;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
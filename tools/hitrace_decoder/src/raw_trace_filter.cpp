@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raw_trace_filter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "raw_trace_decoder.h"
+#include "smart_fd.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr size_t PAGES_PER_READ = 64;
+constexpr size_t COPY_BUFFER_SIZE = 256 * 1024;
+constexpr uint32_t EVENT_KEY_SECTION_SHIFT = 40;
+
+constexpr size_t HM_PAGE_HEADER_SIZE = 17; // u64 timestamp, u64 length, u8 cpu, packed
+constexpr size_t HM_PAGE_LENGTH_OFFSET = 8;
+constexpr size_t HM_PAGE_CPU_OFFSET = 16;
+constexpr size_t HM_EVENT_HEADER_SIZE = 6; // u32 timestamp delta, u16 size, packed
+constexpr size_t HM_EVENT_SIZE_OFFSET = 4;
+constexpr size_t LINUX_PAGE_COMMIT_OFFSET = 8;
+constexpr size_t LINUX_PAGE_HEADER_SIZE = 16; // u64 timestamp, long commit
+constexpr size_t LINUX_PAGE_HEADER_SIZE_32BIT = 12;
+constexpr uint32_t LINUX_TYPE_DATA_MAX = 28;
+constexpr uint32_t LINUX_TYPE_TIME_EXTEND = 30;
+constexpr uint32_t LINUX_TIME_DELTA_SHIFT = 5;
+constexpr uint32_t LINUX_TIME_EXTEND_SHIFT = 27;
+constexpr uint64_t LINUX_TIME_DELTA_MAX = (1ULL << LINUX_TIME_EXTEND_SHIFT) - 1;
+constexpr size_t EVENT_ALIGNMENT = 4;
+
+template<typename T>
+void WriteLittleEndian(uint8_t* data, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++) {
+        data[i] = static_cast<uint8_t>(value >> (i * 8)); // 8 : bits per byte
+    }
+}
+
+size_t AlignEventSize(const size_t size)
+{
+    return (size + EVENT_ALIGNMENT - 1) & ~(EVENT_ALIGNMENT - 1);
+}
+
+bool ReadFull(const int fd, void* buf, const size_t size, const off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = TEMP_FAILURE_RETRY(pread(fd, static_cast<uint8_t*>(buf) + done, size - done,
+            offset + static_cast<off_t>(done)));
+        if (ret <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool WriteFull(const int fd, const void* data, size_t size)
+{
+    const uint8_t* pos = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t ret = TEMP_FAILURE_RETRY(write(fd, pos, size));
+        if (ret <= 0) {
+            return false;
+        }
+        pos += ret;
+        size -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+/**
+ * @brief Packs events into pages of the format they were read from, one cpu per page.
+ */
+class PageWriter {
+public:
+    PageWriter(const int outFd, const bool isHm, const bool is32BitArch)
+        : outFd_(outFd), isHm_(isHm), page_(RAW_TRACE_PAGE_SIZE, 0)
+    {
+        headerSize_ = isHm ? HM_PAGE_HEADER_SIZE : (is32BitArch ? LINUX_PAGE_HEADER_SIZE_32BIT :
+            LINUX_PAGE_HEADER_SIZE);
+        is32BitArch_ = is32BitArch;
+    }
+
+    bool Add(const RawEvent& event)
+    {
+        return isHm_ ? AddHmEvent(event) : AddLinuxEvent(event);
+    }
+
+    bool Flush()
+    {
+        if (!pageOpen_) {
+            return true;
+        }
+        pageOpen_ = false;
+        size_t dataSize = pos_ - headerSize_;
+        WriteLittleEndian<uint64_t>(page_.data(), pageTimestamp_);
+        if (isHm_) {
+            WriteLittleEndian<uint64_t>(page_.data() + HM_PAGE_LENGTH_OFFSET, dataSize);
+            page_[HM_PAGE_CPU_OFFSET] = static_cast<uint8_t>(pageCpu_);
+        } else if (is32BitArch_) {
+            WriteLittleEndian<uint32_t>(page_.data() + LINUX_PAGE_COMMIT_OFFSET, static_cast<uint32_t>(dataSize));
+        } else {
+            WriteLittleEndian<uint64_t>(page_.data() + LINUX_PAGE_COMMIT_OFFSET, dataSize);
+        }
+        bool ret = WriteFull(outFd_, page_.data(), page_.size());
+        std::fill(page_.begin(), page_.end(), 0);
+        pageCount_++;
+        return ret;
+    }
+
+    uint64_t GetPageCount() const { return pageCount_; }
+
+private:
+    bool StartPage(const RawEvent& event)
+    {
+        if (!Flush()) {
+            return false;
+        }
+        pageOpen_ = true;
+        pageTimestamp_ = event.timestamp;
+        lastTimestamp_ = event.timestamp;
+        pageCpu_ = event.cpu;
+        pos_ = headerSize_;
+        return true;
+    }
+
+    bool AddHmEvent(const RawEvent& event)
+    {
+        size_t need = HM_EVENT_HEADER_SIZE + AlignEventSize(event.size);
+        if (!pageOpen_ || event.cpu != pageCpu_ || pos_ + need > RAW_TRACE_PAGE_SIZE ||
+            event.timestamp - pageTimestamp_ > UINT32_MAX) {
+            if (HM_PAGE_HEADER_SIZE + need > RAW_TRACE_PAGE_SIZE || !StartPage(event)) {
+                return false;
+            }
+        }
+        WriteLittleEndian<uint32_t>(page_.data() + pos_, static_cast<uint32_t>(event.timestamp - pageTimestamp_));
+        WriteLittleEndian<uint16_t>(page_.data() + pos_ + HM_EVENT_SIZE_OFFSET, static_cast<uint16_t>(event.size));
+        (void)memcpy(page_.data() + pos_ + HM_EVENT_HEADER_SIZE, event.data, event.size);
+        pos_ += need;
+        return true;
+    }
+
+    bool AddLinuxEvent(const RawEvent& event)
+    {
+        size_t length = AlignEventSize(event.size);
+        uint32_t typeLen = static_cast<uint32_t>(length / EVENT_ALIGNMENT);
+        bool isShort = typeLen > 0 && typeLen <= LINUX_TYPE_DATA_MAX;
+        size_t recordSize = (isShort ? EVENT_ALIGNMENT : EVENT_ALIGNMENT * 2) + length; // 2 : header and array[0]
+        uint64_t delta = pageOpen_ ? event.timestamp - lastTimestamp_ : 0;
+        size_t extendSize = delta > LINUX_TIME_DELTA_MAX ? EVENT_ALIGNMENT * 2 : 0; // 2 : header and array[0]
+        if (!pageOpen_ || pos_ + extendSize + recordSize > RAW_TRACE_PAGE_SIZE) {
+            if (headerSize_ + recordSize > RAW_TRACE_PAGE_SIZE || !StartPage(event)) {
+                return false;
+            }
+            delta = 0;
+            extendSize = 0;
+        }
+        uint8_t* record = page_.data() + pos_;
+        if (extendSize > 0) {
+            uint32_t extendDelta = static_cast<uint32_t>(delta & LINUX_TIME_DELTA_MAX);
+            WriteLittleEndian<uint32_t>(record, LINUX_TYPE_TIME_EXTEND | (extendDelta << LINUX_TIME_DELTA_SHIFT));
+            WriteLittleEndian<uint32_t>(record + EVENT_ALIGNMENT,
+                static_cast<uint32_t>(delta >> LINUX_TIME_EXTEND_SHIFT));
+            record += extendSize;
+            delta = 0;
+        }
+        if (isShort) {
+            WriteLittleEndian<uint32_t>(record, typeLen | static_cast<uint32_t>(delta << LINUX_TIME_DELTA_SHIFT));
+            record += EVENT_ALIGNMENT;
+        } else {
+            WriteLittleEndian<uint32_t>(record, static_cast<uint32_t>(delta << LINUX_TIME_DELTA_SHIFT));
+            WriteLittleEndian<uint32_t>(record + EVENT_ALIGNMENT, static_cast<uint32_t>(length + EVENT_ALIGNMENT));
+            record += EVENT_ALIGNMENT * 2; // 2 : header and array[0]
+        }
+        (void)memcpy(record, event.data, event.size);
+        pos_ += extendSize + recordSize;
+        lastTimestamp_ = event.timestamp;
+        return true;
+    }
+
+    const int outFd_;
+    const bool isHm_;
+    bool is32BitArch_ = false;
+    size_t headerSize_ = 0;
+    std::vector<uint8_t> page_;
+    bool pageOpen_ = false;
+    size_t pos_ = 0;
+    uint64_t pageTimestamp_ = 0;
+    uint64_t lastTimestamp_ = 0;
+    uint32_t pageCpu_ = 0;
+    uint64_t pageCount_ = 0;
+};
+
+struct SyncMarker {
+    uint64_t timestamp = 0;
+    uint64_t eventKey = 0;
+    int32_t tid = 0;
+    bool isBegin = false;
+    bool matched = false; // an E marker without a B marker in the file falls back to this
+};
+} // namespace
+
+bool IsMarkerFilterSet(const TraceMarkerFilter& filter)
+{
+    return filter.tags != 0 || filter.minLevel != 0 || !filter.pids.empty() || !filter.names.empty();
+}
+
+RawTraceFilter::RawTraceFilter(const RawTraceFile& traceFile, const TraceMarkerFilter& filter)
+    : traceFile_(traceFile), filter_(filter), pids_(filter.pids.begin(), filter.pids.end()), markerReader_(traceFile)
+{
+}
+
+bool RawTraceFilter::ForEachEvent(const size_t sectionIdx,
+    const std::function<void(const RawEvent&, uint64_t)>& callback, FilterStats* stats) const
+{
+    const RawTraceSection& section = traceFile_.GetSections()[sectionIdx];
+    uint32_t cpu = section.type - RAW_SECTION_CPU_RAW;
+    uint64_t eventKey = static_cast<uint64_t>(sectionIdx) << EVENT_KEY_SECTION_SHIFT;
+    auto onEvent = [&callback, &eventKey](const RawEvent& event) {
+        callback(event, eventKey++);
+    };
+    std::vector<uint8_t> pages(RAW_TRACE_PAGE_SIZE * PAGES_PER_READ);
+    size_t pageCount = section.length / RAW_TRACE_PAGE_SIZE;
+    for (size_t page = 0; page < pageCount; page += PAGES_PER_READ) {
+        size_t readPages = std::min(PAGES_PER_READ, pageCount - page);
+        off_t offset = section.offset + static_cast<off_t>(page * RAW_TRACE_PAGE_SIZE);
+        if (!ReadFull(traceFile_.GetFd(), pages.data(), readPages * RAW_TRACE_PAGE_SIZE, offset)) {
+            return false;
+        }
+        for (size_t i = 0; i < readPages; i++) {
+            if (traceFile_.IsHmFormat()) {
+                DecodePage(pages.data() + i * RAW_TRACE_PAGE_SIZE, onEvent);
+            } else {
+                DecodeLinuxPage(pages.data() + i * RAW_TRACE_PAGE_SIZE, cpu, traceFile_.Is32BitArch(), onEvent);
+            }
+        }
+        if (stats != nullptr) {
+            stats->pagesIn += readPages;
+        }
+    }
+    return true;
+}
+
+bool RawTraceFilter::MatchMarker(const TraceMarkerInfo& info, const bool checkName) const
+{
+    if (!pids_.empty() && pids_.count(info.pid) == 0) {
+        return false;
+    }
+    if (filter_.tags != 0 && (info.tags & filter_.tags) == 0) {
+        return false;
+    }
+    if (info.level < filter_.minLevel) {
+        return false;
+    }
+    if (!checkName || filter_.names.empty()) {
+        return true;
+    }
+    return std::any_of(filter_.names.begin(), filter_.names.end(), [&info](const std::string& name) {
+        return (info.type == 'M') ? MatchCounterBatchName(info.name, name) :
+            info.name.find(name) != std::string_view::npos;
+    });
+}
+
+bool RawTraceFilter::KeepEvent(const RawEvent& event, const uint64_t eventKey) const
+{
+    int32_t tid = 0;
+    if (!GetEventTid(event, tid)) {
+        return false;
+    }
+    TraceMarkerInfo info;
+    if (markerReader_.GetMarker(event, info)) {
+        if (info.type == 'B' || info.type == 'E') {
+            return keptSyncMarkers_.count(eventKey) != 0;
+        }
+        return MatchMarker(info, true);
+    }
+    if (!filter_.keepKernelEvents) {
+        return false;
+    }
+    if (pids_.empty()) {
+        return true;
+    }
+    const auto& tgids = traceFile_.GetTgids();
+    auto tgid = tgids.find(tid);
+    return pids_.count(tgid == tgids.end() ? tid : tgid->second) != 0;
+}
+
+bool RawTraceFilter::PairSyncMarkers()
+{
+    std::vector<SyncMarker> markers;
+    const auto& sections = traceFile_.GetSections();
+    for (size_t sectionIdx = 0; sectionIdx < sections.size(); sectionIdx++) {
+        if (sections[sectionIdx].type < RAW_SECTION_CPU_RAW || sections[sectionIdx].type >= RAW_SECTION_HEADER_PAGE) {
+            continue;
+        }
+        bool readOk = ForEachEvent(sectionIdx, [this, &markers](const RawEvent& event, uint64_t eventKey) {
+            TraceMarkerInfo info;
+            SyncMarker marker;
+            if (!GetEventTid(event, marker.tid) || !markerReader_.GetMarker(event, info) ||
+                (info.type != 'B' && info.type != 'E')) {
+                return;
+            }
+            marker.timestamp = event.timestamp;
+            marker.eventKey = eventKey;
+            marker.isBegin = info.type == 'B';
+            marker.matched = MatchMarker(info, info.type == 'B');
+            markers.push_back(marker);
+        }, nullptr);
+        if (!readOk) {
+            return false;
+        }
+    }
+    std::stable_sort(markers.begin(), markers.end(), [](const SyncMarker& lhs, const SyncMarker& rhs) {
+        return lhs.timestamp < rhs.timestamp;
+    });
+    std::unordered_map<int32_t, std::vector<bool>> stacks; // per thread, whether each open B marker is kept
+    for (const auto& marker : markers) {
+        std::vector<bool>& stack = stacks[marker.tid];
+        bool keep = marker.matched;
+        if (marker.isBegin) {
+            stack.push_back(keep);
+        } else if (!stack.empty()) {
+            keep = stack.back();
+            stack.pop_back();
+        } else {
+            keep = keep && filter_.names.empty(); // the B marker is before the capture, its name is unknown
+        }
+        if (keep) {
+            keptSyncMarkers_.insert(marker.eventKey);
+        }
+    }
+    return true;
+}
+
+RawTraceError RawTraceFilter::CopySection(const int outFd, const RawTraceSection& section) const
+{
+    RawTraceSectionHeader header;
+    header.type = section.type;
+    header.length = section.length;
+    if (!WriteFull(outFd, &header, sizeof(header))) {
+        return RawTraceError::WRITE_FAILED;
+    }
+    std::vector<uint8_t> buffer(std::min(COPY_BUFFER_SIZE, static_cast<size_t>(section.length)));
+    for (uint32_t done = 0; done < section.length;) {
+        size_t size = std::min(buffer.size(), static_cast<size_t>(section.length - done));
+        if (!ReadFull(traceFile_.GetFd(), buffer.data(), size, section.offset + static_cast<off_t>(done))) {
+            return RawTraceError::READ_FAILED;
+        }
+        if (!WriteFull(outFd, buffer.data(), size)) {
+            return RawTraceError::WRITE_FAILED;
+        }
+        done += static_cast<uint32_t>(size);
+    }
+    return RawTraceError::NONE;
+}
+
+RawTraceError RawTraceFilter::RepackSection(const int outFd, const size_t sectionIdx, FilterStats& stats) const
+{
+    off_t headerOffset = lseek(outFd, 0, SEEK_CUR);
+    RawTraceSectionHeader header;
+    header.type = traceFile_.GetSections()[sectionIdx].type;
+    if (headerOffset < 0 || !WriteFull(outFd, &header, sizeof(header))) {
+        return RawTraceError::WRITE_FAILED;
+    }
+    PageWriter writer(outFd, traceFile_.IsHmFormat(), traceFile_.Is32BitArch());
+    bool writeOk = true;
+    auto onEvent = [this, &writer, &writeOk, &stats](const RawEvent& event, uint64_t eventKey) {
+        stats.eventsIn++;
+        if (writeOk && KeepEvent(event, eventKey)) {
+            writeOk = writer.Add(event);
+            stats.eventsKept++;
+        }
+    };
+    if (!ForEachEvent(sectionIdx, onEvent, &stats)) {
+        return RawTraceError::READ_FAILED;
+    }
+    if (!writeOk || !writer.Flush()) {
+        return RawTraceError::WRITE_FAILED;
+    }
+    stats.pagesOut += writer.GetPageCount();
+    header.length = static_cast<uint32_t>(writer.GetPageCount() * RAW_TRACE_PAGE_SIZE);
+    if (TEMP_FAILURE_RETRY(pwrite(outFd, &header, sizeof(header), headerOffset)) !=
+        static_cast<ssize_t>(sizeof(header))) {
+        return RawTraceError::WRITE_FAILED;
+    }
+    return RawTraceError::NONE;
+}
+
+RawTraceError RawTraceFilter::FilterToFile(const int outFd, FilterStats& stats)
+{
+    if (!PairSyncMarkers()) {
+        return RawTraceError::READ_FAILED;
+    }
+    if (!WriteFull(outFd, &traceFile_.GetHeader(), sizeof(RawTraceFileHeader))) {
+        return RawTraceError::WRITE_FAILED;
+    }
+    const auto& sections = traceFile_.GetSections();
+    for (size_t sectionIdx = 0; sectionIdx < sections.size(); sectionIdx++) {
+        bool isCpuRaw = sections[sectionIdx].type >= RAW_SECTION_CPU_RAW &&
+            sections[sectionIdx].type < RAW_SECTION_HEADER_PAGE;
+        RawTraceError ret = isCpuRaw ? RepackSection(outFd, sectionIdx, stats) :
+            CopySection(outFd, sections[sectionIdx]);
+        if (ret != RawTraceError::NONE) {
+            return ret;
+        }
+    }
+    return RawTraceError::NONE;
+}
+
+RawTraceError FilterRawTraceFile(const std::string& inPath, const std::string& outPath,
+    const TraceMarkerFilter& filter, FilterStats& stats)
+{
+    RawTraceFile traceFile;
+    RawTraceError ret = traceFile.Open(inPath);
+    if (ret != RawTraceError::NONE) {
+        return ret;
+    }
+    struct stat inStat;
+    mode_t mode = (fstat(traceFile.GetFd(), &inStat) == 0) ? (inStat.st_mode & 0777) : 0600; // 0600 : -rw-------
+    SmartFd outFd(open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode));
+    if (!outFd) {
+        return RawTraceError::OPEN_FAILED;
+    }
+    RawTraceFilter rawTraceFilter(traceFile, filter);
+    return rawTraceFilter.FilterToFile(outFd.GetFd(), stats);
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
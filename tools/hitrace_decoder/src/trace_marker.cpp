@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_marker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr uint32_t COMMON_PID_OFFSET = 4; // common_type u16, common_flags u8, common_preempt_count u8
+constexpr uint32_t DATA_LOC_OFFSET_MASK = 0xffff;
+constexpr uint32_t DATA_LOC_SIZE_SHIFT = 16;
+constexpr size_t TAG_DIGITS = 2;
+constexpr int DECIMAL = 10;
+constexpr char TRACE_LEVELS[] = "DICM"; // indexed by HiTraceOutputLevel
+constexpr std::string_view MARKER_EVENT_PREFIX = "tracing_mark_write: ";
+constexpr std::string_view COUNTER_BATCH_LINE = "tracing_mark_write: M|";
+
+template<typename T>
+T ReadLittleEndian(const uint8_t* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(data[i]) << (i * 8); // 8 : bits per byte
+    }
+    return value;
+}
+
+bool ParseDecimal(std::string_view text, int32_t& value)
+{
+    if (text.empty()) {
+        return false;
+    }
+    int64_t result = 0;
+    for (char ch : text) {
+        if (ch < '0' || ch > '9' || result > INT32_MAX) {
+            return false;
+        }
+        result = result * DECIMAL + (ch - '0');
+    }
+    value = static_cast<int32_t>(result);
+    return result <= INT32_MAX;
+}
+
+// "I0513": the level letter, then two digits per tag bit, see ParseTagBits() of hitrace_meter
+bool ParseLevelAndTags(std::string_view text, TraceMarkerInfo& info)
+{
+    const char* level = text.empty() ? nullptr : strchr(TRACE_LEVELS, text[0]);
+    if (level == nullptr || *level == '\0' || (text.size() - 1) % TAG_DIGITS != 0) {
+        return false;
+    }
+    uint64_t tags = 0;
+    for (size_t pos = 1; pos < text.size(); pos += TAG_DIGITS) {
+        if (!isdigit(static_cast<unsigned char>(text[pos])) || !isdigit(static_cast<unsigned char>(text[pos + 1]))) {
+            return false;
+        }
+        uint32_t bit = static_cast<uint32_t>((text[pos] - '0') * DECIMAL + (text[pos + 1] - '0'));
+        if (bit >= sizeof(uint64_t) * 8) { // 8 : bits per byte
+            return false;
+        }
+        tags |= 1ULL << bit;
+    }
+    info.level = static_cast<uint32_t>(level - TRACE_LEVELS);
+    info.tags = tags;
+    return true;
+}
+
+std::string_view TrimMarkerName(std::string_view name)
+{
+    constexpr std::string_view hitracePrefix = "H:";
+    if (name.substr(0, hitracePrefix.size()) == hitracePrefix) {
+        name.remove_prefix(hitracePrefix.size());
+    }
+    // "[chainId,spanId,parentSpanId]#name"
+    if (!name.empty() && name[0] == '[') {
+        size_t end = name.find("]#");
+        if (end != std::string_view::npos) {
+            name.remove_prefix(end + 2); // 2 : "]#"
+        }
+    }
+    return name;
+}
+} // namespace
+
+bool ParseTraceMarker(std::string_view text, TraceMarkerInfo& info)
+{
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\0')) {
+        text.remove_suffix(1);
+    }
+    const std::string_view marker = text;
+    constexpr size_t maxFields = 5;
+    std::string_view fields[maxFields];
+    size_t fieldCount = 0;
+    while (fieldCount < maxFields) {
+        size_t end = text.find('|');
+        fields[fieldCount++] = text.substr(0, end);
+        if (end == std::string_view::npos) {
+            break;
+        }
+        text.remove_prefix(end + 1);
+    }
+    constexpr size_t minFields = 2;
+    if (fieldCount < minFields || fields[0].size() != 1 || !ParseDecimal(fields[1], info.pid)) {
+        return false;
+    }
+    info = { fields[0][0], info.pid, {}, {}, 0, 0 };
+    size_t levelField = 0;
+    if (info.type == 'E') {
+        levelField = 2; // 2 : E|pid|level
+    } else if (info.type == 'M') {
+        // M|pid|level|name|value...: a name filter keeps the batch if it matches the name of any of its counters
+        levelField = 2; // 2 : M|pid|level
+        if (fieldCount > levelField + 1) {
+            info.name = marker.substr(fields[0].size() + fields[1].size() + fields[levelField].size() + 3); // 3 : '|'
+        }
+    } else {
+        constexpr size_t nameField = 2;
+        constexpr size_t valueField = 3;
+        if (fieldCount <= nameField) {
+            return false;
+        }
+        info.name = TrimMarkerName(fields[nameField]);
+        if (info.type != 'B' && fieldCount > valueField) {
+            info.value = fields[valueField];
+        }
+        levelField = (info.type == 'B') ? 3 : 4; // 3 : B|pid|name|level, 4 : S|pid|name|value|level
+    }
+    // markers written without hitrace_meter have no level, they only pass the filters without level and tags
+    if (levelField < fieldCount) {
+        (void)ParseLevelAndTags(fields[levelField], info);
+    }
+    return true;
+}
+
+bool ExpandCounterBatch(std::string_view text, std::vector<std::string>& counters)
+{
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\0')) {
+        text.remove_suffix(1);
+    }
+    constexpr std::string_view batchPrefix = "M|";
+    if (text.substr(0, batchPrefix.size()) != batchPrefix) {
+        return false;
+    }
+    size_t pidEnd = text.find('|', batchPrefix.size());
+    size_t levelEnd = (pidEnd == std::string_view::npos) ? pidEnd : text.find('|', pidEnd + 1);
+    if (levelEnd == std::string_view::npos) {
+        return false;
+    }
+    std::string_view pid = text.substr(batchPrefix.size(), pidEnd - batchPrefix.size());
+    std::string_view level = text.substr(pidEnd + 1, levelEnd - pidEnd - 1);
+    counters.clear();
+    for (size_t pos = levelEnd + 1; pos < text.size();) {
+        size_t nameEnd = text.find('|', pos);
+        if (nameEnd == std::string_view::npos) {
+            break;
+        }
+        size_t valueEnd = std::min(text.find('|', nameEnd + 1), text.size());
+        std::string counter = "C|";
+        counter.append(pid).append("|H:").append(text.substr(pos, nameEnd - pos)).append(1, '|');
+        counter.append(text.substr(nameEnd + 1, valueEnd - nameEnd - 1)).append(1, '|').append(level);
+        counters.push_back(std::move(counter));
+        pos = valueEnd + 1;
+    }
+    return !counters.empty();
+}
+
+bool MatchCounterBatchName(std::string_view counters, std::string_view pattern)
+{
+    // "name|value|name|value...", every other field is a name
+    for (size_t pos = 0; pos < counters.size();) {
+        size_t nameEnd = counters.find('|', pos);
+        if (counters.substr(pos, nameEnd - pos).find(pattern) != std::string_view::npos) {
+            return true;
+        }
+        size_t valueEnd = (nameEnd == std::string_view::npos) ? nameEnd : counters.find('|', nameEnd + 1);
+        if (valueEnd == std::string_view::npos) {
+            break;
+        }
+        pos = valueEnd + 1;
+    }
+    return false;
+}
+
+void CounterBatchTextExpander::Feed(std::string_view chunk, std::string& out)
+{
+    size_t lastLineEnd = chunk.rfind('\n');
+    if (lastLineEnd == std::string_view::npos) {
+        pending_.append(chunk);
+        return;
+    }
+    std::string_view lines = chunk.substr(0, lastLineEnd + 1);
+    if (pending_.empty()) {
+        AppendLines(lines, out);
+    } else {
+        pending_.append(lines);
+        AppendLines(pending_, out);
+    }
+    pending_.assign(chunk.substr(lastLineEnd + 1));
+}
+
+void CounterBatchTextExpander::Finish(std::string& out)
+{
+    AppendLines(pending_, out);
+    pending_.clear();
+}
+
+void CounterBatchTextExpander::AppendLines(std::string_view text, std::string& out)
+{
+    // the common chunk has no batch and is copied as it is
+    if (text.find(COUNTER_BATCH_LINE) == std::string_view::npos) {
+        out.append(text);
+        return;
+    }
+    for (size_t pos = 0; pos < text.size();) {
+        size_t lineEnd = std::min(text.find('\n', pos), text.size());
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        size_t batch = line.find(COUNTER_BATCH_LINE);
+        if (batch == std::string_view::npos ||
+            !ExpandCounterBatch(line.substr(batch + MARKER_EVENT_PREFIX.size()), counters_)) {
+            out.append(line);
+            if (lineEnd < text.size()) {
+                out.append(1, '\n');
+            }
+        } else {
+            std::string_view prefix = line.substr(0, batch + MARKER_EVENT_PREFIX.size());
+            for (const auto& counter : counters_) {
+                out.append(prefix).append(counter).append(1, '\n');
+            }
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+TraceMarkerReader::TraceMarkerReader(const RawTraceFile& traceFile)
+{
+    for (const auto& [id, format] : traceFile.GetEventFormats()) {
+        if (format.name != "tracing_mark_write" && format.name != "print") {
+            continue;
+        }
+        const EventField* field = format.FindField("buffer");
+        if (field == nullptr) {
+            field = format.FindField("buf");
+        }
+        if (field != nullptr) {
+            markerFields_[id] = { field->offset, field->size, field->isDataLoc };
+        }
+    }
+}
+
+bool TraceMarkerReader::GetText(const RawEvent& event, std::string_view& text) const
+{
+    auto marker = markerFields_.find(ReadLittleEndian<uint16_t>(event.data));
+    if (marker == markerFields_.end()) {
+        return false;
+    }
+    uint32_t begin = marker->second.offset;
+    uint32_t end = begin + marker->second.size;
+    if (end > event.size) {
+        return false;
+    }
+    if (marker->second.isDataLoc) {
+        uint32_t dataLoc = ReadLittleEndian<uint32_t>(event.data + begin);
+        begin = dataLoc & DATA_LOC_OFFSET_MASK;
+        end = begin + (dataLoc >> DATA_LOC_SIZE_SHIFT);
+    } else {
+        end = static_cast<uint32_t>(event.size); // char buf[] takes up the rest of the record
+    }
+    if (begin >= end || end > event.size) {
+        return false;
+    }
+    text = std::string_view(reinterpret_cast<const char*>(event.data + begin), end - begin);
+    text = text.substr(0, text.find('\0'));
+    return true;
+}
+
+bool TraceMarkerReader::GetMarker(const RawEvent& event, TraceMarkerInfo& info) const
+{
+    std::string_view text;
+    return GetText(event, text) && ParseTraceMarker(text, info);
+}
+
+bool GetEventTid(const RawEvent& event, int32_t& tid)
+{
+    if (event.size < COMMON_PID_OFFSET + sizeof(int32_t)) {
+        return false;
+    }
+    tid = static_cast<int32_t>(ReadLittleEndian<uint32_t>(event.data + COMMON_PID_OFFSET));
+    return true;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
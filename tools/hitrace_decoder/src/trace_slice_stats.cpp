@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_slice_stats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unistd.h>
+
+#include "raw_trace_decoder.h"
+#include "smart_fd.h"
+#include "trace_text_parser.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr uint32_t HISTOGRAM_SUB_BUCKET_BITS = 6;
+constexpr uint64_t HISTOGRAM_SUB_BUCKETS = 1ULL << HISTOGRAM_SUB_BUCKET_BITS;
+constexpr uint64_t HISTOGRAM_HALF_BUCKETS = HISTOGRAM_SUB_BUCKETS / 2;
+constexpr uint32_t UINT64_BITS = 64;
+constexpr double PERCENT = 100.0;
+
+constexpr size_t MAX_SLICE_NAMES = 65536;
+constexpr size_t MAX_NESTING_DEPTH = 512;
+constexpr size_t MAX_OPEN_ASYNC_SLICES = 262144;
+
+constexpr size_t PAGES_PER_READ = 64;
+constexpr size_t MARKERS_PER_CHUNK = 4096;
+constexpr size_t MAX_QUEUED_CHUNKS = 4;
+constexpr double NS_PER_US = 1000.0;
+constexpr std::string_view TEXT_MARKER_EVENT = "tracing_mark_write";
+
+uint32_t HighestBit(const uint64_t value)
+{
+    return UINT64_BITS - 1 - static_cast<uint32_t>(__builtin_clzll(value));
+}
+
+// [0, 64) map to themselves, then every power of two is split into 32 buckets
+size_t BucketIndex(const uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    uint32_t shift = HighestBit(value) - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    return static_cast<size_t>(shift * HISTOGRAM_HALF_BUCKETS + (value >> shift));
+}
+
+uint64_t BucketHighestValue(const size_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    uint64_t shift = index / HISTOGRAM_HALF_BUCKETS - 1;
+    uint64_t top = index - shift * HISTOGRAM_HALF_BUCKETS;
+    return (top << shift) + ((1ULL << shift) - 1);
+}
+
+bool IsSyncMarker(const char type)
+{
+    return type == 'B' || type == 'E';
+}
+
+bool IsAsyncMarker(const char type)
+{
+    return type == 'S' || type == 'F';
+}
+
+struct MarkerChunk {
+    std::string text;
+    std::vector<uint64_t> timestamps;
+    std::vector<int32_t> tids;
+    std::vector<size_t> ends; // end offset of every marker in text
+};
+
+/**
+ * @brief One cpu: a producer thread pulls the hitrace markers out of its sections, the merger pops them in order.
+ */
+class MarkerStream {
+public:
+    MarkerStream(const RawTraceFile& traceFile, const TraceMarkerReader& reader, const uint8_t sectionType)
+        : traceFile_(traceFile), reader_(reader), cpu_(sectionType - RAW_SECTION_CPU_RAW) {}
+
+    ~MarkerStream()
+    {
+        Join();
+    }
+
+    void AddSection(const RawTraceSection& section) { sections_.push_back(section); }
+
+    void Start()
+    {
+        worker_ = std::thread([this] { Produce(); });
+    }
+
+    // Returns nullptr once the stream is drained.
+    std::unique_ptr<MarkerChunk> Pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !chunks_.empty() || finished_; });
+        if (chunks_.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<MarkerChunk> chunk = std::move(chunks_.front());
+        chunks_.pop_front();
+        cond_.notify_all();
+        return chunk;
+    }
+
+    void Join()
+    {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    bool HasReadError() const { return readError_; }
+
+private:
+    void Push(std::unique_ptr<MarkerChunk> chunk)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return chunks_.size() < MAX_QUEUED_CHUNKS; });
+        chunks_.push_back(std::move(chunk));
+        cond_.notify_all();
+    }
+
+    void Produce()
+    {
+        auto chunk = std::make_unique<MarkerChunk>();
+        std::vector<uint8_t> pages(RAW_TRACE_PAGE_SIZE * PAGES_PER_READ);
+        auto onEvent = [this, &chunk](const RawEvent& event) {
+            std::string_view text;
+            int32_t tid = 0;
+            if (!GetEventTid(event, tid) || !reader_.GetText(event, text) || text.size() < 2 || text[1] != '|' ||
+                !(IsSyncMarker(text[0]) || IsAsyncMarker(text[0]))) {
+                return;
+            }
+            chunk->text.append(text);
+            chunk->timestamps.push_back(event.timestamp);
+            chunk->tids.push_back(tid);
+            chunk->ends.push_back(chunk->text.size());
+            if (chunk->ends.size() >= MARKERS_PER_CHUNK) {
+                Push(std::move(chunk));
+                chunk = std::make_unique<MarkerChunk>();
+            }
+        };
+        for (const auto& section : sections_) {
+            size_t pageCount = section.length / RAW_TRACE_PAGE_SIZE;
+            for (size_t page = 0; page < pageCount && !readError_; page += PAGES_PER_READ) {
+                size_t readPages = std::min(PAGES_PER_READ, pageCount - page);
+                size_t readSize = readPages * RAW_TRACE_PAGE_SIZE;
+                off_t offset = section.offset + static_cast<off_t>(page * RAW_TRACE_PAGE_SIZE);
+                if (TEMP_FAILURE_RETRY(pread(traceFile_.GetFd(), pages.data(), readSize, offset)) !=
+                    static_cast<ssize_t>(readSize)) {
+                    readError_ = true;
+                    break;
+                }
+                for (size_t i = 0; i < readPages; i++) {
+                    DecodeOnePage(pages.data() + i * RAW_TRACE_PAGE_SIZE, onEvent);
+                }
+            }
+        }
+        if (!chunk->ends.empty()) {
+            Push(std::move(chunk));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        cond_.notify_all();
+    }
+
+    void DecodeOnePage(const uint8_t* page, const std::function<void(const RawEvent&)>& callback) const
+    {
+        if (traceFile_.IsHmFormat()) {
+            DecodePage(page, callback);
+        } else {
+            DecodeLinuxPage(page, cpu_, traceFile_.Is32BitArch(), callback);
+        }
+    }
+
+    const RawTraceFile& traceFile_;
+    const TraceMarkerReader& reader_;
+    const uint32_t cpu_;
+    std::vector<RawTraceSection> sections_;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::unique_ptr<MarkerChunk>> chunks_;
+    bool finished_ = false;
+    bool readError_ = false;
+};
+
+struct StreamCursor {
+    std::unique_ptr<MarkerChunk> chunk;
+    size_t index = 0;
+
+    uint64_t Timestamp() const { return chunk->timestamps[index]; }
+};
+
+bool AggregateRawFile(const std::string& path, SliceAggregator& aggregator)
+{
+    RawTraceFile traceFile;
+    RawTraceError openRet = traceFile.Open(path);
+    if (openRet != RawTraceError::NONE) {
+        fprintf(stderr, "error: %s: %s.\n", path.c_str(), GetRawTraceErrorMsg(openRet));
+        return false;
+    }
+    TraceMarkerReader reader(traceFile);
+    std::vector<std::unique_ptr<MarkerStream>> streams;
+    std::map<uint8_t, MarkerStream*> streamByType;
+    for (const auto& section : traceFile.GetCpuSections()) {
+        auto it = streamByType.find(section.type);
+        if (it == streamByType.end()) {
+            streams.push_back(std::make_unique<MarkerStream>(traceFile, reader, section.type));
+            it = streamByType.emplace(section.type, streams.back().get()).first;
+        }
+        it->second->AddSection(section);
+    }
+    for (auto& stream : streams) {
+        stream->Start();
+    }
+
+    // a thread migrates between cpus, its B and E markers only pair up in global timestamp order
+    std::vector<StreamCursor> cursors(streams.size());
+    using HeapItem = std::pair<uint64_t, size_t>; // timestamp, stream index
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    for (size_t i = 0; i < streams.size(); i++) {
+        cursors[i].chunk = streams[i]->Pop();
+        if (cursors[i].chunk != nullptr) {
+            heap.emplace(cursors[i].Timestamp(), i);
+        }
+    }
+    while (!heap.empty()) {
+        size_t streamIdx = heap.top().second;
+        heap.pop();
+        StreamCursor& cursor = cursors[streamIdx];
+        const MarkerChunk& chunk = *cursor.chunk;
+        size_t begin = (cursor.index == 0) ? 0 : chunk.ends[cursor.index - 1];
+        TraceMarkerInfo info;
+        if (ParseTraceMarker(std::string_view(chunk.text).substr(begin, chunk.ends[cursor.index] - begin), info)) {
+            aggregator.AddMarker(chunk.timestamps[cursor.index], chunk.tids[cursor.index], info);
+        }
+        if (++cursor.index == chunk.ends.size()) {
+            cursor.chunk = streams[streamIdx]->Pop();
+            cursor.index = 0;
+        }
+        if (cursor.chunk != nullptr) {
+            heap.emplace(cursor.Timestamp(), streamIdx);
+        }
+    }
+    aggregator.Finish();
+
+    bool ret = true;
+    for (auto& stream : streams) {
+        stream->Join();
+        if (stream->HasReadError()) {
+            fprintf(stderr, "error: read raw section failed.\n");
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+bool AggregateTextFile(const std::string& path, SliceAggregator& aggregator)
+{
+    TraceTextFile textFile;
+    if (!textFile.Open(path)) {
+        return false;
+    }
+    TraceTextParser parser(textFile.GetText());
+    TraceTextLine line;
+    TraceMarkerInfo info;
+    while (parser.Next(line)) {
+        if (line.event == TEXT_MARKER_EVENT && ParseTraceMarker(line.args, info)) {
+            aggregator.AddMarker(line.timestamp, line.pid, info);
+        }
+    }
+    aggregator.Finish();
+    return true;
+}
+} // namespace
+
+void LatencyHistogram::Record(const uint64_t value)
+{
+    size_t index = BucketIndex(value);
+    if (index >= counts_.size()) {
+        counts_.resize(index + 1, 0);
+    }
+    counts_[index]++;
+    count_++;
+    max_ = std::max(max_, value);
+}
+
+uint64_t LatencyHistogram::GetPercentile(const double percentile) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    double clamped = std::min(std::max(percentile, 0.0), PERCENT);
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / PERCENT * count_)));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < counts_.size(); index++) {
+        seen += counts_[index];
+        if (seen >= target) {
+            return std::min(BucketHighestValue(index), max_);
+        }
+    }
+    return max_;
+}
+
+size_t SliceAggregator::AsyncKeyHash::operator()(const AsyncKey& key) const
+{
+    size_t hash = std::hash<std::string>()(key.name);
+    hash = hash * 31 + std::hash<std::string>()(key.taskId); // 31 : hash multiplier
+    return hash * 31 + std::hash<int32_t>()(key.pid); // 31 : hash multiplier
+}
+
+SliceStats* SliceAggregator::FindSlice(std::string_view name, const uint64_t tags, const bool isAsync)
+{
+    keyBuffer_.assign(1, isAsync ? 'S' : 'B');
+    keyBuffer_.append(reinterpret_cast<const char*>(&tags), sizeof(tags));
+    keyBuffer_.append(name);
+    auto it = sliceIndex_.find(keyBuffer_);
+    if (it != sliceIndex_.end()) {
+        return it->second;
+    }
+    if (slices_.size() >= MAX_SLICE_NAMES) {
+        return nullptr;
+    }
+    SliceStats& slice = slices_.emplace_back();
+    slice.name = name;
+    slice.tags = tags;
+    slice.isAsync = isAsync;
+    sliceIndex_.emplace(keyBuffer_, &slice);
+    return &slice;
+}
+
+void SliceAggregator::CloseSlice(const OpenSlice& open, const uint64_t timestamp)
+{
+    if (open.slice == nullptr) {
+        stats_.droppedSlices++;
+        return;
+    }
+    uint64_t duration = timestamp >= open.timestamp ? timestamp - open.timestamp : 0;
+    SliceStats& slice = *open.slice;
+    slice.count++;
+    slice.sum += duration;
+    slice.min = std::min(slice.min, duration);
+    slice.max = std::max(slice.max, duration);
+    slice.histogram.Record(duration);
+}
+
+void SliceAggregator::AddMarker(const uint64_t timestamp, const int32_t tid, const TraceMarkerInfo& info)
+{
+    if (IsSyncMarker(info.type)) {
+        stats_.markers++;
+        ThreadStack& stack = threadStacks_[tid];
+        if (info.type == 'B') {
+            if (stack.slices.size() >= MAX_NESTING_DEPTH) {
+                stack.overflow++;
+                stats_.droppedSlices++;
+                return;
+            }
+            stack.slices.push_back({ timestamp, FindSlice(info.name, info.tags, false) });
+        } else if (stack.overflow > 0) {
+            stack.overflow--;
+        } else if (stack.slices.empty()) {
+            stats_.unmatchedEnds++;
+        } else {
+            CloseSlice(stack.slices.back(), timestamp);
+            stack.slices.pop_back();
+        }
+        return;
+    }
+    if (!IsAsyncMarker(info.type)) {
+        return;
+    }
+    stats_.markers++;
+    asyncKey_.pid = info.pid;
+    asyncKey_.taskId.assign(info.value);
+    asyncKey_.name.assign(info.name);
+    if (info.type == 'S') {
+        if (asyncSlices_.size() >= MAX_OPEN_ASYNC_SLICES) {
+            stats_.droppedSlices++;
+            return;
+        }
+        // a restarted task id without its F marker, the earlier begin is lost
+        OpenSlice& open = asyncSlices_[asyncKey_];
+        if (open.timestamp != 0 || open.slice != nullptr) {
+            stats_.openSlices++;
+        }
+        open = { timestamp, FindSlice(info.name, info.tags, true) };
+        return;
+    }
+    auto it = asyncSlices_.find(asyncKey_);
+    if (it == asyncSlices_.end()) {
+        stats_.unmatchedEnds++;
+        return;
+    }
+    CloseSlice(it->second, timestamp);
+    asyncSlices_.erase(it);
+}
+
+void SliceAggregator::Finish()
+{
+    for (auto& [tid, stack] : threadStacks_) {
+        stats_.openSlices += stack.slices.size();
+    }
+    stats_.openSlices += asyncSlices_.size();
+    threadStacks_.clear();
+    asyncSlices_.clear();
+}
+
+std::vector<const SliceStats*> SliceAggregator::GetSortedSlices() const
+{
+    std::vector<const SliceStats*> sorted;
+    sorted.reserve(slices_.size());
+    for (const auto& slice : slices_) {
+        if (slice.count > 0) {
+            sorted.push_back(&slice);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const SliceStats* lhs, const SliceStats* rhs) {
+        return lhs->sum != rhs->sum ? lhs->sum > rhs->sum : lhs->name < rhs->name;
+    });
+    return sorted;
+}
+
+bool AggregateTraceSlices(const std::string& path, SliceAggregator& aggregator)
+{
+    SmartFd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd) {
+        fprintf(stderr, "error: open %s failed, errno(%d).\n", path.c_str(), errno);
+        return false;
+    }
+    RawTraceFileHeader header;
+    ssize_t size = TEMP_FAILURE_RETRY(read(fd.GetFd(), &header, sizeof(header)));
+    if (size == static_cast<ssize_t>(sizeof(header)) && header.magicNumber == RAW_TRACE_MAGIC_NUMBER) {
+        return AggregateRawFile(path, aggregator);
+    }
+    return AggregateTextFile(path, aggregator);
+}
+
+std::string FormatSliceStats(const SliceAggregator& aggregator)
+{
+    std::string out;
+    char line[256] = { 0 }; // 256 : the numeric columns, the name is appended separately
+    auto append = [&out, &line](int len) {
+        if (len > 0) {
+            out.append(line, std::min(static_cast<size_t>(len), sizeof(line) - 1));
+        }
+    };
+    const SliceAggregateStats& stats = aggregator.GetStats();
+    append(snprintf(line, sizeof(line), "# markers: %" PRIu64 ", unmatched ends: %" PRIu64 ", open slices: %"
+        PRIu64 ", dropped slices: %" PRIu64 "\n", stats.markers, stats.unmatchedEnds, stats.openSlices,
+        stats.droppedSlices));
+    append(snprintf(line, sizeof(line), "# %-5s %-18s %10s %14s %12s %12s %12s %12s %12s %12s %12s  %s\n",
+        "type", "tags", "count", "total(us)", "min(us)", "max(us)", "avg(us)", "p50(us)", "p90(us)", "p99(us)",
+        "p99.9(us)", "name"));
+    constexpr double p50 = 50.0;
+    constexpr double p90 = 90.0;
+    constexpr double p99 = 99.0;
+    constexpr double p999 = 99.9;
+    for (const SliceStats* slice : aggregator.GetSortedSlices()) {
+        const LatencyHistogram& histogram = slice->histogram;
+        append(snprintf(line, sizeof(line),
+            "  %-5s 0x%016" PRIx64 " %10" PRIu64 " %14.3f %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f  ",
+            slice->isAsync ? "async" : "sync", slice->tags, slice->count, slice->sum / NS_PER_US,
+            slice->min / NS_PER_US, slice->max / NS_PER_US, slice->sum / NS_PER_US / slice->count,
+            histogram.GetPercentile(p50) / NS_PER_US, histogram.GetPercentile(p90) / NS_PER_US,
+            histogram.GetPercentile(p99) / NS_PER_US, histogram.GetPercentile(p999) / NS_PER_US));
+        out += slice->name;
+        out += '\n';
+    }
+    return out;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_text_parser.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "smart_fd.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr uint64_t NS_PER_SECOND = 1000000000;
+constexpr uint32_t MAX_FRACTION_DIGITS = 9;
+constexpr int DECIMAL = 10;
+constexpr std::string_view NO_TGID = "-----";
+
+bool IsDigit(const char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+bool IsSpace(const char ch)
+{
+    return ch == ' ' || ch == '\t';
+}
+
+std::string_view TrimSpaces(std::string_view text)
+{
+    while (!text.empty() && IsSpace(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && IsSpace(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// consumes the digits at pos, false if there are none
+bool ParseDigits(std::string_view text, size_t& pos, uint64_t& value)
+{
+    size_t start = pos;
+    value = 0;
+    while (pos < text.size() && IsDigit(text[pos])) {
+        value = value * DECIMAL + static_cast<uint64_t>(text[pos] - '0');
+        pos++;
+    }
+    return pos > start;
+}
+
+bool ParseInt32(std::string_view text, int32_t& value)
+{
+    size_t pos = 0;
+    uint64_t result = 0;
+    if (!ParseDigits(text, pos, result) || pos != text.size() || result > INT32_MAX) {
+        return false;
+    }
+    value = static_cast<int32_t>(result);
+    return true;
+}
+
+size_t FindChar(std::string_view text, const size_t from, const char ch)
+{
+    if (from >= text.size()) {
+        return std::string_view::npos;
+    }
+    const void* found = memchr(text.data() + from, ch, text.size() - from);
+    if (found == nullptr) {
+        return std::string_view::npos;
+    }
+    return static_cast<size_t>(static_cast<const char*>(found) - text.data());
+}
+
+// "[003] d..1 12345.678901: " at pos, fills cpu, flags and timestamp and returns the offset of the event name
+size_t ParseCpuToTimestamp(std::string_view text, size_t pos, TraceTextLine& line)
+{
+    uint64_t value = 0;
+    pos++; // '['
+    if (!ParseDigits(text, pos, value) || pos >= text.size() || text[pos] != ']') {
+        return std::string_view::npos;
+    }
+    line.cpu = static_cast<uint32_t>(value);
+    pos++;
+    while (pos < text.size() && IsSpace(text[pos])) {
+        pos++;
+    }
+    size_t flagsStart = pos;
+    while (pos < text.size() && !IsSpace(text[pos])) {
+        pos++;
+    }
+    line.flags = text.substr(flagsStart, pos - flagsStart);
+    while (pos < text.size() && IsSpace(text[pos])) {
+        pos++;
+    }
+    uint64_t seconds = 0;
+    if (line.flags.empty() || !ParseDigits(text, pos, seconds) || pos >= text.size() || text[pos] != '.') {
+        return std::string_view::npos;
+    }
+    size_t fractionStart = ++pos;
+    uint64_t fraction = 0;
+    if (!ParseDigits(text, pos, fraction) || pos >= text.size() || text[pos] != ':' ||
+        pos - fractionStart > MAX_FRACTION_DIGITS) {
+        return std::string_view::npos;
+    }
+    for (size_t digits = pos - fractionStart; digits < MAX_FRACTION_DIGITS; digits++) {
+        fraction *= DECIMAL;
+    }
+    line.timestamp = seconds * NS_PER_SECOND + fraction;
+    pos++; // ':'
+    while (pos < text.size() && IsSpace(text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+// "  <task>-<pid> (<tgid>) ", the task name itself may hold '-', ' ' and brackets
+bool ParseTask(std::string_view prefix, TraceTextLine& line)
+{
+    prefix = TrimSpaces(prefix);
+    line.tgid = -1;
+    if (!prefix.empty() && prefix.back() == ')') {
+        size_t open = prefix.rfind('(');
+        if (open == std::string_view::npos) {
+            return false;
+        }
+        std::string_view tgid = TrimSpaces(prefix.substr(open + 1, prefix.size() - open - 2)); // 2 : "()"
+        if (tgid != NO_TGID && !ParseInt32(tgid, line.tgid)) {
+            return false;
+        }
+        prefix = TrimSpaces(prefix.substr(0, open));
+    }
+    size_t dash = prefix.rfind('-');
+    if (dash == std::string_view::npos || !ParseInt32(prefix.substr(dash + 1), line.pid)) {
+        return false;
+    }
+    line.task = prefix.substr(0, dash);
+    return true;
+}
+} // namespace
+
+bool ParseTraceTextLine(std::string_view text, TraceTextLine& line)
+{
+    line.line = text;
+    size_t start = 0;
+    while (start < text.size() && IsSpace(text[start])) {
+        start++;
+    }
+    if (start == text.size() || text[start] == '#') {
+        return false;
+    }
+    // a '[' inside the task name fails the cpu column check, the scan goes on to the next one
+    for (size_t bracket = FindChar(text, start, '['); bracket != std::string_view::npos;
+        bracket = FindChar(text, bracket + 1, '[')) {
+        if (bracket + 1 >= text.size() || !IsDigit(text[bracket + 1])) {
+            continue;
+        }
+        size_t eventStart = ParseCpuToTimestamp(text, bracket, line);
+        if (eventStart == std::string_view::npos || !ParseTask(text.substr(start, bracket - start), line)) {
+            continue;
+        }
+        size_t colon = FindChar(text, eventStart, ':');
+        if (colon == std::string_view::npos || colon == eventStart) {
+            return false;
+        }
+        line.event = text.substr(eventStart, colon - eventStart);
+        size_t argsStart = colon + 1;
+        if (argsStart < text.size() && text[argsStart] == ' ') {
+            argsStart++;
+        }
+        line.args = text.substr(argsStart);
+        return true;
+    }
+    return false;
+}
+
+bool TraceTextParser::Next(TraceTextLine& line)
+{
+    while (offset_ < text_.size()) {
+        size_t end = FindChar(text_, offset_, '\n');
+        if (end == std::string_view::npos) {
+            end = text_.size();
+        }
+        std::string_view current = text_.substr(offset_, end - offset_);
+        offset_ = end + 1;
+        if (!current.empty() && current.back() == '\r') {
+            current.remove_suffix(1);
+        }
+        std::string_view trimmed = TrimSpaces(current);
+        if (trimmed.empty() || trimmed.front() == '#') {
+            continue;
+        }
+        if (ParseTraceTextLine(current, line)) {
+            return true;
+        }
+        skippedLines_++;
+    }
+    return false;
+}
+
+TraceTextFile::~TraceTextFile()
+{
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+}
+
+bool TraceTextFile::Open(const std::string& path)
+{
+    SmartFd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat fileStat;
+    if (!fd || fstat(fd.GetFd(), &fileStat) != 0) {
+        fprintf(stderr, "error: open %s failed, errno(%d).\n", path.c_str(), errno);
+        return false;
+    }
+    if (fileStat.st_size == 0) {
+        return true;
+    }
+    size_ = static_cast<size_t>(fileStat.st_size);
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd.GetFd(), 0);
+    if (data_ == MAP_FAILED) {
+        fprintf(stderr, "error: mmap %s failed, errno(%d).\n", path.c_str(), errno);
+        data_ = nullptr;
+        size_ = 0;
+        return false;
+    }
+    (void)madvise(data_, size_, MADV_SEQUENTIAL);
+    return true;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+
+using OHOS::HiviewDFX::Hitrace::TraceTextFile;
+using OHOS::HiviewDFX::Hitrace::TraceTextLine;
+using OHOS::HiviewDFX::Hitrace::TraceTextParser;
+
+namespace {
+struct TextParserHandle {
+    TraceTextFile file;
+    std::unique_ptr<TraceTextParser> parser;
+};
+
+uint32_t OffsetIn(std::string_view outer, std::string_view inner)
+{
+    return static_cast<uint32_t>(inner.data() - outer.data());
+}
+} // namespace
+
+void* HiTraceTextParserOpen(const char* path)
+{
+    if (path == nullptr) {
+        return nullptr;
+    }
+    auto handle = std::make_unique<TextParserHandle>();
+    if (!handle->file.Open(path)) {
+        return nullptr;
+    }
+    handle->parser = std::make_unique<TraceTextParser>(handle->file.GetText());
+    return handle.release();
+}
+
+size_t HiTraceTextParserNext(void* parser, HiTraceTextLine* lines, size_t maxLines)
+{
+    if (parser == nullptr || lines == nullptr) {
+        return 0;
+    }
+    auto handle = static_cast<TextParserHandle*>(parser);
+    std::string_view text = handle->file.GetText();
+    size_t count = 0;
+    TraceTextLine line;
+    while (count < maxLines && handle->parser->Next(line)) {
+        HiTraceTextLine& out = lines[count++];
+        out.lineOffset = static_cast<uint64_t>(line.line.data() - text.data());
+        out.lineSize = static_cast<uint32_t>(line.line.size());
+        out.taskOffset = OffsetIn(line.line, line.task);
+        out.taskSize = static_cast<uint32_t>(line.task.size());
+        out.pid = line.pid;
+        out.tgid = line.tgid;
+        out.cpu = line.cpu;
+        out.timestamp = line.timestamp;
+        out.eventOffset = OffsetIn(line.line, line.event);
+        out.eventSize = static_cast<uint32_t>(line.event.size());
+        out.argsOffset = OffsetIn(line.line, line.args);
+        out.argsSize = static_cast<uint32_t>(line.args.size());
+    }
+    return count;
+}
+
+uint64_t HiTraceTextParserSkippedLines(void* parser)
+{
+    return parser == nullptr ? 0 : static_cast<TextParserHandle*>(parser)->parser->GetSkippedLines();
+}
+
+void HiTraceTextParserClose(void* parser)
+{
+    delete static_cast<TextParserHandle*>(parser);
+}
@@ -31,6 +31,7 @@
 #include "parameters.h"
 #include "securec.h"
 #include "smart_fd.h"
+#include "trace_control_page.h"
 
 namespace OHOS {
 namespace HiviewDFX {
@@ -185,6 +186,8 @@ bool SetPropertyInner(const std::string& property, const std::string& value)
     bool result = OHOS::system::SetParameter(property, value);
     if (!result) {
         HILOG_ERROR(LOG_CORE, "Error: Failed to set %{public}s property.", property.c_str());
+    } else if (IsTraceControlProperty(property)) {
+        PublishTraceControl();
     }
     return result;
 }
@@ -43,6 +43,8 @@ using namespace OHOS::HiviewDFX::Hitrace;
 class FileAgeingChecker {
 public:
     virtual bool ShouldAgeing(const TraceFileInfo& traceFileInfo) = 0;
+    // Reads the ledger totals, no file of the type needs ageing while they are under the limit.
+    virtual bool IsUnderLimit(const TraceDumpType traceType) = 0;
     virtual ~FileAgeingChecker() = default;
 
     static std::shared_ptr<FileAgeingChecker> CreateFileChecker(const TraceDumpType traceType,
@@ -61,6 +63,11 @@ public:
         currentCount_++;
         return false;
     }
+
+    bool IsUnderLimit(const TraceDumpType traceType) override
+    {
+        return static_cast<int64_t>(TraceFileLedger::GetInstance().GetFileCount(traceType)) <= maxCount_;
+    }
 private:
     int64_t currentCount_ = 0;
     const int64_t maxCount_;
@@ -85,6 +92,11 @@ public:
         return false;
     }
 
+    bool IsUnderLimit(const TraceDumpType traceType) override
+    {
+        return TraceFileLedger::GetInstance().GetTotalSize(traceType) / BYTE_PER_KB < maxSizeKb_;
+    }
+
 private:
     int64_t currentSizeKb_ = 0;
     const int64_t maxSizeKb_;
@@ -118,7 +130,12 @@ std::shared_ptr<FileAgeingChecker> FileAgeingChecker::CreateFileChecker(const Tr
 
 void HandleFileNotInVec(std::vector<TraceFileInfo>& fileList, const TraceDumpType traceType, int32_t& deleteCount)
 {
-    // handle files that are not saved in vector
+    // handle files that are not saved in vector, the ledger count spares the listing when there are none
+    if (!TraceFileLedger::GetInstance().HasFilesBesides(fileList, traceType)) {
+        HILOG_INFO(LOG_CORE, "HandleAgeing: deleteCount:%{public}d type:%{public}d",
+                   deleteCount, static_cast<int32_t>(traceType));
+        return;
+    }
     std::set<std::string> traceFiles = {};
     GetTraceFileNamesInDir(traceFiles, traceType);
     for (const auto& traceFileInfo : fileList) {
@@ -171,6 +188,10 @@ void HandleFileNeedAgeing(const int64_t& needDelete, const CheckType checkType,
 void HandleAgeingImpl(std::vector<TraceFileInfo>& fileList, const TraceDumpType traceType, FileAgeingChecker& helper)
 {
     int32_t deleteCount = 0;
+    if (helper.IsUnderLimit(traceType)) {
+        HandleFileNotInVec(fileList, traceType, deleteCount);
+        return;
+    }
     // handle the files saved in vector
     std::vector<TraceFileInfo> result = {};
     for (auto it = fileList.rbegin(); it != fileList.rend(); it++) {
@@ -208,6 +229,14 @@ void HandleAgeingSnapShort(std::vector<TraceFileInfo>& fileList, const TraceDump
     int32_t deleteCount = 0;
     std::set<std::string> needRemoveFiles = {};
     std::queue<TraceFileInfo> linkFiles= {};
+    // the ledger totals cover every file of the type, the list walk is only needed once they are over the limit
+    auto& ledger = TraceFileLedger::GetInstance();
+    if ((checkType == CheckType::FILESIZE && ledger.GetTotalSize(traceType) <= param.fileSizeKbLimit * BYTE_PER_KB) ||
+        (checkType == CheckType::FILENUMBER &&
+        static_cast<int64_t>(ledger.GetFileCount(traceType)) <= param.fileNumberLimit)) {
+        HandleFileNotInVec(fileList, traceType, deleteCount);
+        return;
+    }
     if (checkType == CheckType::FILESIZE) {
         int64_t countSize = 0;
         CalculateFilesize(fileList, countSize);
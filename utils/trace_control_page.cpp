@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_control_page.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common_define.h"
+#include "hilog/log.h"
+#include "smart_fd.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+#ifdef LOG_DOMAIN
+#undef LOG_DOMAIN
+#define LOG_DOMAIN 0xD002D33
+#endif
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "HitraceUtils"
+#endif
+namespace {
+// the page is shared between processes, a lock based atomic would lock a process-local mutex
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the generation must be lock free");
+static_assert(sizeof(TraceControlPage) <= PAGE_SIZE, "the control page must fit in one page");
+
+// The init cfg creates the file holding the single byte "0", writable by hiview and root only: other publishers
+// fail to open it and their parameter changes are picked up by the periodic re-check of the readers instead.
+// The first publisher sizes the file to a page and stamps the magic, readers map it read only.
+bool PrepareControlFile(const int fd)
+{
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        return false;
+    }
+    if (fileStat.st_size >= static_cast<off_t>(PAGE_SIZE)) {
+        return true;
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+        return false;
+    }
+    bool ret = fstat(fd, &fileStat) == 0 &&
+        (fileStat.st_size >= static_cast<off_t>(PAGE_SIZE) || ftruncate(fd, PAGE_SIZE) == 0);
+    (void)flock(fd, LOCK_UN);
+    return ret;
+}
+} // namespace
+
+const TraceControlPage* MapTraceControlPage()
+{
+    SmartFd fd(open(TRACE_CONTROL_PAGE_PATH, O_RDONLY | O_CLOEXEC));
+    struct stat fileStat;
+    if (!fd || fstat(fd.GetFd(), &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(PAGE_SIZE)) {
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, PAGE_SIZE, PROT_READ, MAP_SHARED, fd.GetFd(), 0);
+    if (addr == MAP_FAILED) {
+        HILOG_WARN(LOG_CORE, "MapTraceControlPage: mmap failed, errno(%{public}d).", errno);
+        return nullptr;
+    }
+    auto page = static_cast<const TraceControlPage*>(addr);
+    if (page->magic != TRACE_CONTROL_PAGE_MAGIC) {
+        munmap(addr, PAGE_SIZE);
+        return nullptr;
+    }
+    return page;
+}
+
+void PublishTraceControl()
+{
+    SmartFd fd(open(TRACE_CONTROL_PAGE_PATH, O_RDWR | O_CLOEXEC));
+    if (!fd || !PrepareControlFile(fd.GetFd())) {
+        return;
+    }
+    void* addr = mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd.GetFd(), 0);
+    if (addr == MAP_FAILED) {
+        HILOG_WARN(LOG_CORE, "PublishTraceControl: mmap failed, errno(%{public}d).", errno);
+        return;
+    }
+    auto page = static_cast<TraceControlPage*>(addr);
+    // the generation moves after the parameter is set, a reader seeing it reads the new value
+    page->generation.fetch_add(1, std::memory_order_release);
+    page->magic = TRACE_CONTROL_PAGE_MAGIC;
+    munmap(addr, PAGE_SIZE);
+}
+
+bool IsTraceControlProperty(const std::string& property)
+{
+    return property == TRACE_TAG_ENABLE_FLAGS || property == TRACE_KEY_APP_PID || property == TRACE_LEVEL_THRESHOLD ||
+        property == TRACE_TAG_RATE_LIMIT;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HITRACE_TRACE_CONTROL_PAGE_H
+#define HITRACE_TRACE_CONTROL_PAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+static const char* const TRACE_CONTROL_PAGE_PATH = "/dev/hitrace_control";
+constexpr uint32_t TRACE_CONTROL_PAGE_MAGIC = 0x48544350; // "HTCP"
+
+/**
+ * @brief Shared page that tells every process the trace parameters moved.
+ * @note Only the generation lives here, the values stay in the system parameters: a stray bump costs a parameter
+ *       refresh and never a wrong tag. A parameter set without a publish, such as a bare "param set", is seen by
+ *       the readers within their periodic re-check.
+ */
+struct TraceControlPage {
+    uint32_t magic;
+    uint32_t reserved;
+    std::atomic<uint64_t> generation;
+};
+
+// Returns nullptr if the page is missing or unreadable, the caller then checks the parameters every time.
+const TraceControlPage* MapTraceControlPage();
+
+// Bumps the generation, called after the tag, app pid or level parameter is set.
+void PublishTraceControl();
+
+bool IsTraceControlProperty(const std::string& property);
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // HITRACE_TRACE_CONTROL_PAGE_H
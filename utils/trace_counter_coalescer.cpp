@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_counter_coalescer.h"
+
+#include <cstring>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr size_t MAX_PROBES = 8;
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr uint64_t FNV_PRIME = 0x100000001b3;
+constexpr uint64_t GOLDEN_RATIO = 0x9e3779b97f4a7c15;
+constexpr uint64_t MIN_RELEASE_PERIOD_NS = 1000000; // 1 ms : a tiny interval does not scan the table every update
+
+// the name is hashed by content, the std::string overloads hand in buffers that are reused for other names
+uint64_t CounterKey(const uint64_t tag, const char* name, size_t& nameSize)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    const char* ch = name;
+    for (; *ch != '\0'; ch++) {
+        hash = (hash ^ static_cast<uint8_t>(*ch)) * FNV_PRIME;
+    }
+    nameSize = static_cast<size_t>(ch - name);
+    hash ^= tag * GOLDEN_RATIO;
+    return hash == 0 ? 1 : hash; // 0 marks an empty entry
+}
+} // namespace
+
+void TraceCounterCoalescer::Configure(const bool enable, const uint64_t minIntervalNs, const uint64_t maxAgeNs)
+{
+    if (enable) {
+        Invalidate();
+    }
+    minIntervalNs_.store(minIntervalNs, std::memory_order_relaxed);
+    maxAgeNs_.store(maxAgeNs, std::memory_order_relaxed);
+    nextReleaseTime_.store(0, std::memory_order_relaxed);
+    enabled_.store(enable, std::memory_order_relaxed);
+}
+
+bool TraceCounterCoalescer::Admit(const uint64_t tag, const char* name, const int64_t value, const int level,
+    const uint64_t now)
+{
+    if (name == nullptr) {
+        return true;
+    }
+    size_t nameSize = 0;
+    uint64_t key = CounterKey(tag, name, nameSize);
+    if (nameSize >= NAME_SIZE_MAX) {
+        return true;
+    }
+    Entry* entry = FindEntry(key);
+    if (entry == nullptr || entry->busy.exchange(true, std::memory_order_acquire)) {
+        return true;
+    }
+    bool admit = Decide(*entry, tag, name, nameSize, value, level, now);
+    entry->busy.store(false, std::memory_order_release);
+    return admit;
+}
+
+TraceCounterCoalescer::Entry* TraceCounterCoalescer::FindEntry(const uint64_t key)
+{
+    for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+        Entry& entry = entries_[(key + probe) % ENTRY_COUNT];
+        uint64_t expected = entry.key.load(std::memory_order_relaxed);
+        if (expected == key) {
+            return &entry;
+        }
+        if (expected == 0 && (entry.key.compare_exchange_strong(expected, key, std::memory_order_relaxed) ||
+            expected == key)) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool TraceCounterCoalescer::Decide(Entry& entry, const uint64_t tag, const char* name, const size_t nameSize,
+    const int64_t value, const int level, const uint64_t now)
+{
+    uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+    if (entry.epoch != epoch) {
+        // the first value of the counter in this trace is always written
+        entry.epoch = epoch;
+        entry.tag = tag;
+        entry.level = level;
+        entry.held = false;
+        entry.lastValue = value;
+        entry.lastWriteTime = now;
+        (void)memcpy(entry.name, name, nameSize + 1);
+        return true;
+    }
+    if (entry.tag != tag || memcmp(entry.name, name, nameSize + 1) != 0) {
+        return true; // another counter with the same hash, it is not coalesced
+    }
+    if (value == entry.lastValue) {
+        // a value held back and changed back in time never reaches the trace
+        entry.held = false;
+        uint64_t maxAge = maxAgeNs_.load(std::memory_order_relaxed);
+        if (maxAge == 0 || now - entry.lastWriteTime < maxAge) {
+            return false;
+        }
+        entry.level = level;
+        entry.lastWriteTime = now;
+        return true;
+    }
+    uint64_t minInterval = minIntervalNs_.load(std::memory_order_relaxed);
+    if (minInterval != 0 && now - entry.lastWriteTime < minInterval) {
+        entry.held = true;
+        entry.heldValue = value;
+        entry.level = level;
+        return false;
+    }
+    entry.held = false;
+    entry.level = level;
+    entry.lastValue = value;
+    entry.lastWriteTime = now;
+    return true;
+}
+
+size_t TraceCounterCoalescer::ReleaseDue(const uint64_t now, void (*write)(const HeldCounter& counter))
+{
+    uint64_t minInterval = minIntervalNs_.load(std::memory_order_relaxed);
+    uint64_t next = nextReleaseTime_.load(std::memory_order_relaxed);
+    if (minInterval == 0 || now < next) {
+        return 0;
+    }
+    uint64_t period = (minInterval < MIN_RELEASE_PERIOD_NS) ? MIN_RELEASE_PERIOD_NS : minInterval;
+    if (!nextReleaseTime_.compare_exchange_strong(next, now + period, std::memory_order_relaxed)) {
+        return 0; // another thread scans the table
+    }
+    return Release(write, now, minInterval);
+}
+
+size_t TraceCounterCoalescer::Flush(void (*write)(const HeldCounter& counter))
+{
+    return Release(write, 0, 0);
+}
+
+size_t TraceCounterCoalescer::Release(void (*write)(const HeldCounter& counter), const uint64_t now,
+    const uint64_t minAgeNs)
+{
+    size_t count = 0;
+    for (Entry& entry : entries_) {
+        if (entry.key.load(std::memory_order_relaxed) == 0 || entry.busy.exchange(true, std::memory_order_acquire)) {
+            continue;
+        }
+        if (!entry.held || (minAgeNs != 0 && now - entry.lastWriteTime < minAgeNs)) {
+            entry.busy.store(false, std::memory_order_release);
+            continue;
+        }
+        char name[NAME_SIZE_MAX];
+        (void)memcpy(name, entry.name, sizeof(name));
+        HeldCounter counter = {entry.tag, entry.level, entry.heldValue, name};
+        entry.held = false;
+        entry.lastValue = entry.heldValue;
+        if (minAgeNs != 0) {
+            entry.lastWriteTime = now;
+        }
+        entry.busy.store(false, std::memory_order_release);
+        write(counter);
+        count++;
+    }
+    return count;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HITRACE_TRACE_COUNTER_COALESCER_H
+#define HITRACE_TRACE_COUNTER_COALESCER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct HeldCounter {
+    uint64_t tag = 0;
+    int level = 0;
+    int64_t value = 0;
+    const char* name = nullptr; // valid during the flush callback only
+};
+
+/**
+ * @brief Last written value of the counters of one process, per tag and name.
+ * @note A counter repeating its last value is dropped until the maximum age passes, and with a minimum interval a
+ *       changed value arriving too soon is held back until the next write, ReleaseDue or Flush. Lock free: a thread
+ *       finding the entry busy, a full table or a long name writes the counter as it is, so the cost is a hash of
+ *       the name and one uncontended exchange. Trivially destructible, it can still be flushed at process exit.
+ */
+class TraceCounterCoalescer {
+public:
+    static constexpr size_t NAME_SIZE_MAX = 64;
+
+    // Every enable starts from an empty cache, a disable keeps the held values for Flush. An unchanged value is
+    // written again once maxAgeNs passed since its last write, so a trace that lost it to the ring buffer gets it
+    // back; 0 drops it for good.
+    void Configure(const bool enable, const uint64_t minIntervalNs, const uint64_t maxAgeNs = 0);
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // whether Admit and ReleaseDue read now
+    bool NeedsTime() const
+    {
+        return minIntervalNs_.load(std::memory_order_relaxed) != 0 || maxAgeNs_.load(std::memory_order_relaxed) != 0;
+    }
+
+    // forgets the last values, called when a new trace may have started and has not seen them
+    void Invalidate() { epoch_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Returns true to write the value now, now is only read when NeedsTime.
+    bool Admit(const uint64_t tag, const char* name, const int64_t value, const int level, const uint64_t now);
+
+    // Hands the held back values whose interval passed to write, at most once per interval, so a counter that went
+    // quiet after a change still reaches the trace on the next update of any counter. Returns the count.
+    size_t ReleaseDue(const uint64_t now, void (*write)(const HeldCounter& counter));
+
+    // Hands the held back values to write and forgets them, returns the count.
+    size_t Flush(void (*write)(const HeldCounter& counter));
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> key {0};
+        std::atomic<bool> busy {false};
+        uint32_t epoch = 0;
+        bool held = false;
+        int level = 0;
+        uint64_t tag = 0;
+        int64_t lastValue = 0;
+        int64_t heldValue = 0;
+        uint64_t lastWriteTime = 0;
+        char name[NAME_SIZE_MAX] = {0};
+    };
+
+    static constexpr size_t ENTRY_COUNT = 256;
+
+    Entry* FindEntry(const uint64_t key);
+    bool Decide(Entry& entry, const uint64_t tag, const char* name, const size_t nameSize, const int64_t value,
+        const int level, const uint64_t now);
+    // releases the held values written at least minAgeNs before now, all of them with 0
+    size_t Release(void (*write)(const HeldCounter& counter), const uint64_t now, const uint64_t minAgeNs);
+
+    Entry entries_[ENTRY_COUNT];
+    std::atomic<bool> enabled_ {false};
+    std::atomic<uint64_t> minIntervalNs_ {0};
+    std::atomic<uint64_t> maxAgeNs_ {0};
+    std::atomic<uint64_t> nextReleaseTime_ {0};
+    std::atomic<uint32_t> epoch_ {1}; // entries start at epoch 0, so an unused entry is never current
+};
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // HITRACE_TRACE_COUNTER_COALESCER_H
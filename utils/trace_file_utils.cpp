@@ -22,6 +22,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <sys/sysinfo.h>
 #include <sys/types.h>
@@ -52,6 +53,10 @@ constexpr char TRACE_SNAPSHOT_PREFIX[] = "trace_";
 constexpr char TRACE_RECORDING_PREFIX[] = "record_trace_";
 constexpr char TRACE_CACHE_PREFIX[] = "cache_trace_";
 constexpr char TRACE_WRITABLE_PATH[] = "/data/local/tmp";
+// IN_MODIFY and IN_ATTRIB keep the size and ctime of a file being written or touched in step
+constexpr uint32_t LEDGER_WATCH_MASK = IN_CREATE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_TO |
+    IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+constexpr size_t LEDGER_EVENT_BUF_SIZE = 4096;
 
 std::map<TraceDumpType, std::string> tracePrefixMap = {
     {TraceDumpType::TRACE_SNAPSHOT, TRACE_SNAPSHOT_PREFIX},
@@ -173,6 +178,16 @@ std::string TrimTrailingSlashes(const std::string& path)
     return path.substr(0, lastValidPos + 1);
 }
 
+std::string GetLedgerPrefix(const char* fileName)
+{
+    for (const char* prefix : { TRACE_SNAPSHOT_PREFIX, TRACE_RECORDING_PREFIX, TRACE_CACHE_PREFIX }) {
+        if (strncmp(fileName, prefix, strlen(prefix)) == 0) {
+            return prefix;
+        }
+    }
+    return "";
+}
+
 bool TraverseFilesInner(const char* dirPath, bool recursion,
     const std::function<void(const char*, const dirent*)>& handler)
 {
@@ -216,23 +231,178 @@ TraceFileInfo::TraceFileInfo(const std::string& name, time_t time, int64_t sizek
     isNewFile = newFile;
 }
 
-void GetTraceFilesInDir(std::vector<TraceFileInfo>& fileList, TraceDumpType traceType)
+TraceFileLedger& TraceFileLedger::GetInstance()
+{
+    static TraceFileLedger instance;
+    return instance;
+}
+
+void TraceFileLedger::GetTraceFiles(std::vector<TraceFileInfo>& fileList, TraceDumpType traceType)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLocked();
+    for (const auto& [filePath, entry] : entries_[tracePrefixMap[traceType]]) {
+        fileList.emplace_back(filePath, entry.ctime, entry.fileSize, false);
+    }
+}
+
+void TraceFileLedger::GetTraceFileNames(std::set<std::string>& fileSet, TraceDumpType traceType)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLocked();
+    for (const auto& item : entries_[tracePrefixMap[traceType]]) {
+        fileSet.emplace(item.first);
+    }
+}
+
+size_t TraceFileLedger::GetFileCount(TraceDumpType traceType)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLocked();
+    return totals_[tracePrefixMap[traceType]].fileCount;
+}
+
+int64_t TraceFileLedger::GetTotalSize(TraceDumpType traceType)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLocked();
+    return totals_[tracePrefixMap[traceType]].fileSize;
+}
+
+bool TraceFileLedger::HasFilesBesides(const std::vector<TraceFileInfo>& fileList, TraceDumpType traceType)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLocked();
+    const auto& files = entries_[tracePrefixMap[traceType]];
+    size_t listed = 0;
+    for (const auto& fileInfo : fileList) {
+        listed += files.count(fileInfo.filename);
+    }
+    return files.size() > listed;
+}
+
+void TraceFileLedger::SyncLocked()
+{
+    if (synced_ && DrainEventsLocked()) {
+        return;
+    }
+    // the watch is installed before scanning, so nothing that happens during the scan is lost.
+    synced_ = AddWatchLocked();
+    RescanLocked();
+}
+
+bool TraceFileLedger::AddWatchLocked()
+{
+    RemoveWatchLocked();
+    if (!inotifyFd_) {
+        inotifyFd_ = SmartFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+        if (!inotifyFd_) {
+            HILOG_WARN(LOG_CORE, "TraceFileLedger: inotify_init1 failed, errno: %{public}d.", errno);
+            return false;
+        }
+    }
+    watchFd_ = inotify_add_watch(inotifyFd_.GetFd(), TRACE_FILE_DEFAULT_DIR, LEDGER_WATCH_MASK);
+    if (watchFd_ < 0) {
+        HILOG_WARN(LOG_CORE, "TraceFileLedger: watch %{public}s failed, errno: %{public}d.",
+            TRACE_FILE_DEFAULT_DIR, errno);
+        return false;
+    }
+    return true;
+}
+
+void TraceFileLedger::RemoveWatchLocked()
+{
+    if (inotifyFd_ && watchFd_ >= 0) {
+        inotify_rm_watch(inotifyFd_.GetFd(), watchFd_);
+    }
+    watchFd_ = -1;
+}
+
+void TraceFileLedger::RescanLocked()
+{
+    entries_.clear();
+    totals_.clear();
+    TraverseFiles(TRACE_FILE_DEFAULT_DIR, false, [this] (const char* dirPath, const dirent* item) {
+        if (item->d_type == DT_REG && !GetLedgerPrefix(item->d_name).empty()) {
+            UpdateEntryLocked(std::string(dirPath) + "/" + item->d_name);
+        }
+    });
+    HILOG_INFO(LOG_CORE, "TraceFileLedger: rescan done, watched: %{public}d.", synced_);
+}
+
+bool TraceFileLedger::DrainEventsLocked()
 {
-    auto target = tracePrefixMap[traceType];
-    TraverseFiles(TRACE_FILE_DEFAULT_DIR, false,
-        [&fileList, &target] (const char* dirPath, const dirent* item) {
-            if (item->d_type != DT_REG) {
-                return;
+    alignas(struct inotify_event) char buffer[LEDGER_EVENT_BUF_SIZE];
+    const std::string dirPath = TRACE_FILE_DEFAULT_DIR;
+    // a file being written raises an IN_MODIFY per write, it is stat once when the queue is drained
+    std::set<std::string> changedFiles;
+    while (true) {
+        ssize_t len = TEMP_FAILURE_RETRY(read(inotifyFd_.GetFd(), buffer, sizeof(buffer)));
+        if (len <= 0) {
+            if (len < 0 && errno != EAGAIN) {
+                return false;
             }
-            if (strncmp(item->d_name, target.c_str(), target.size()) != 0) {
-                return;
+            for (const auto& fileName : changedFiles) {
+                UpdateEntryLocked(fileName);
             }
-            std::string filePath = std::string(dirPath) + "/" + item->d_name;
-            struct stat fileStat{};
-            if (stat(filePath.c_str(), &fileStat) == 0) {
-                fileList.emplace_back(filePath, fileStat.st_ctime, static_cast<int64_t>(fileStat.st_size), false);
+            return true;
+        }
+        for (ssize_t offset = 0; offset < len;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+            if ((event->mask & IN_Q_OVERFLOW) != 0 || (event->wd == watchFd_ &&
+                (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) != 0)) {
+                HILOG_WARN(LOG_CORE, "TraceFileLedger: lost track of directory, mask: %{public}u.", event->mask);
+                return false;
             }
-    });
+            // events of a watch that has been replaced are stale, the rescan already covered them.
+            if (event->wd != watchFd_ || event->len == 0 || (event->mask & IN_ISDIR) != 0 ||
+                GetLedgerPrefix(event->name).empty()) {
+                continue;
+            }
+            if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+                changedFiles.erase(dirPath + event->name);
+                EraseEntryLocked(dirPath + event->name);
+            } else {
+                changedFiles.insert(dirPath + event->name);
+            }
+        }
+    }
+}
+
+void TraceFileLedger::UpdateEntryLocked(const std::string& fileName)
+{
+    struct stat fileStat{};
+    if (stat(fileName.c_str(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+        EraseEntryLocked(fileName);
+        return;
+    }
+    const std::string prefix = GetLedgerPrefix(fileName.c_str() + fileName.find_last_of('/') + 1);
+    auto [it, isNew] = entries_[prefix].try_emplace(fileName);
+    LedgerTotal& total = totals_[prefix];
+    total.fileCount += isNew ? 1 : 0;
+    total.fileSize += static_cast<int64_t>(fileStat.st_size) - it->second.fileSize;
+    it->second.ctime = fileStat.st_ctime;
+    it->second.fileSize = static_cast<int64_t>(fileStat.st_size);
+}
+
+void TraceFileLedger::EraseEntryLocked(const std::string& fileName)
+{
+    const std::string prefix = GetLedgerPrefix(fileName.c_str() + fileName.find_last_of('/') + 1);
+    auto& files = entries_[prefix];
+    auto it = files.find(fileName);
+    if (it == files.end()) {
+        return;
+    }
+    LedgerTotal& total = totals_[prefix];
+    total.fileCount--;
+    total.fileSize -= it->second.fileSize;
+    files.erase(it);
+}
+
+void GetTraceFilesInDir(std::vector<TraceFileInfo>& fileList, TraceDumpType traceType)
+{
+    TraceFileLedger::GetInstance().GetTraceFiles(fileList, traceType);
     HILOG_INFO(LOG_CORE, "GetTraceFilesInDir fileList size: %{public}d.", static_cast<int>(fileList.size()));
     std::sort(fileList.begin(), fileList.end(), [](const TraceFileInfo& a, const TraceFileInfo& b) {
         return a.ctime < b.ctime;
@@ -241,14 +411,7 @@ void GetTraceFilesInDir(std::vector<TraceFileInfo>& fileList, TraceDumpType trac
 
 void GetTraceFileNamesInDir(std::set<std::string>& fileSet, TraceDumpType traceType)
 {
-    auto target = tracePrefixMap[traceType];
-    TraverseFiles(TRACE_FILE_DEFAULT_DIR, false,
-        [&fileSet, &target] (const char* dirPath, const dirent* item) {
-            if (item->d_type == DT_REG &&
-                strncmp(item->d_name, target.c_str(), target.size()) == 0) {
-                fileSet.emplace(std::string(dirPath) + "/" + item->d_name);
-            }
-    });
+    TraceFileLedger::GetInstance().GetTraceFileNames(fileSet, traceType);
     HILOG_INFO(LOG_CORE, "GetTraceFileNamesInDir fileSet size: %{public}d.", static_cast<int>(fileSet.size()));
 }
 
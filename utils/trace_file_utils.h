@@ -19,11 +19,13 @@
 #include <dirent.h>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "hitrace_define.h"
+#include "smart_fd.h"
 
 namespace OHOS {
 namespace HiviewDFX {
@@ -46,6 +48,58 @@ struct TimestampRange {
     uint64_t lastPageTimestamp;
 };
 
+/**
+ * In-memory index of the trace files under TRACE_FILE_DEFAULT_DIR with their size and ctime, per file type.
+ * The directory is scanned once, afterwards creations, writes, renames and deletions are applied from an inotify
+ * watch, so ageing between record slices no longer has to readdir and stat every file.
+ * When the watch cannot be installed, every query falls back to a full directory scan.
+ */
+class TraceFileLedger {
+public:
+    static TraceFileLedger& GetInstance();
+
+    void GetTraceFiles(std::vector<TraceFileInfo>& fileList, TraceDumpType traceType);
+    void GetTraceFileNames(std::set<std::string>& fileSet, TraceDumpType traceType);
+    size_t GetFileCount(TraceDumpType traceType);
+    // Bytes of all the files of the type, kept as a running total so the ageing does not sum the list.
+    int64_t GetTotalSize(TraceDumpType traceType);
+    // Whether the directory holds files of the type that are not in fileList, without listing them.
+    bool HasFilesBesides(const std::vector<TraceFileInfo>& fileList, TraceDumpType traceType);
+
+private:
+    struct LedgerEntry {
+        time_t ctime = 0;
+        int64_t fileSize = 0;
+    };
+
+    struct LedgerTotal {
+        size_t fileCount = 0;
+        int64_t fileSize = 0;
+    };
+
+    TraceFileLedger() = default;
+    ~TraceFileLedger() = default;
+    TraceFileLedger(const TraceFileLedger&) = delete;
+    TraceFileLedger& operator=(const TraceFileLedger&) = delete;
+
+    void SyncLocked();
+    bool AddWatchLocked();
+    void RemoveWatchLocked();
+    void RescanLocked();
+    bool DrainEventsLocked();
+    void UpdateEntryLocked(const std::string& fileName);
+    void EraseEntryLocked(const std::string& fileName);
+
+    std::mutex mutex_;
+    SmartFd inotifyFd_;
+    int watchFd_ = -1;
+    bool synced_ = false;
+    // file prefix -> full path -> entry
+    std::map<std::string, std::map<std::string, LedgerEntry>> entries_;
+    // file prefix -> totals of the entries above
+    std::map<std::string, LedgerTotal> totals_;
+};
+
 void GetTraceFilesInDir(std::vector<TraceFileInfo>& fileList, TraceDumpType traceType);
 void GetTraceFileNamesInDir(std::set<std::string>& fileSet, TraceDumpType traceType);
 bool RemoveFile(const std::string& fileName);
@@ -150,6 +150,40 @@ bool ParseTagCategory(cJSON* jsonNode, std::map<std::string, TraceTag>& tagInfos
     return true;
 }
 
+// "tag_rate_limit": {"<tag name>": {"events_per_second": N, "burst": M}}, only user tags can be limited
+void ParseTagRateLimits(cJSON* jsonNode, const std::map<std::string, TraceTag>& tagInfos,
+    std::vector<TagRateLimit>& rateLimits)
+{
+    cJSON* rateLimitNode = cJSON_GetObjectItem(jsonNode, "tag_rate_limit");
+    if (rateLimitNode == nullptr) {
+        return;
+    }
+    cJSON* tagNode = nullptr;
+    cJSON_ArrayForEach(tagNode, rateLimitNode) {
+        if (tagNode == nullptr || tagNode->string == nullptr) {
+            continue;
+        }
+        auto iter = tagInfos.find(tagNode->string);
+        if (iter == tagInfos.end() || iter->second.type != USER) {
+            HILOG_ERROR(LOG_CORE, "ParseTagRateLimits: tag[%{public}s] is invalid.", tagNode->string);
+            continue;
+        }
+        int eventsPerSecond = 0;
+        int burst = 0;
+        if (!GetIntFromJson(tagNode, "events_per_second", eventsPerSecond) || eventsPerSecond <= 0) {
+            continue;
+        }
+        if (!GetIntFromJson(tagNode, "burst", burst) || burst <= 0) {
+            burst = eventsPerSecond;
+        }
+        TagRateLimit rateLimit;
+        rateLimit.tag = iter->second.tag;
+        rateLimit.eventsPerSecond = static_cast<uint32_t>(eventsPerSecond);
+        rateLimit.burst = static_cast<uint32_t>(burst);
+        rateLimits.push_back(rateLimit);
+    }
+}
+
 bool ParseTagGroups(cJSON* jsonNode, std::map<std::string, std::vector<std::string>>& tagGroups)
 {
     cJSON* tagGroupsNode = cJSON_GetObjectItem(jsonNode, "tag_groups");
@@ -202,6 +236,7 @@ void TraceJsonParser::ParseHitraceUtilsJson(const std::string& hitraceUtilsJson)
         ParseTagCategory(hitraceUtilsJsonRoot, traceTagInfos_);
         GetStringFromJsonVector(hitraceUtilsJsonRoot, "base_format_path", baseTraceFormats_);
         ParseTagGroups(hitraceUtilsJsonRoot, tagGroups_);
+        ParseTagRateLimits(hitraceUtilsJsonRoot, traceTagInfos_, tagRateLimits_);
 
         int value = 0;
         if (GetIntFromJson(hitraceUtilsJsonRoot, "snapshot_file_aging", value)) {
@@ -213,6 +248,9 @@ void TraceJsonParser::ParseHitraceUtilsJson(const std::string& hitraceUtilsJson)
         if (GetIntFromJson(hitraceUtilsJsonRoot, "snapshot_buffer_kb", value) && value != 0) {
             snapshotBufSzKb_ = value;
         }
+        if (GetIntFromJson(hitraceUtilsJsonRoot, "cache_event_format_ref", value)) {
+            cacheEventFmtRef_ = (value != 0);
+        }
     }
     cJSON_Delete(hitraceUtilsJsonRoot);
 }
@@ -251,6 +289,19 @@ const AgeingParam& TraceJsonParser::GetAgeingParam(TraceDumpType type) const
     return defaultParam;
 }
 
+std::string TraceJsonParser::GetTagRateLimitParam() const
+{
+    std::string param;
+    for (const auto& rateLimit : tagRateLimits_) {
+        if (!param.empty()) {
+            param += ",";
+        }
+        param += std::to_string(__builtin_ctzll(rateLimit.tag)) + ":" + std::to_string(rateLimit.eventsPerSecond) +
+            ":" + std::to_string(rateLimit.burst);
+    }
+    return param;
+}
+
 void TraceJsonParser::InitSnapshotDefaultBufferSize()
 {
     snapshotBufSzKb_ = DEFAULT_SNAPSHOT_BUFFER_SIZE_KB;
@@ -39,6 +39,12 @@ struct TraceTag {
     std::vector<std::string> formatPath;
 };
 
+struct TagRateLimit {
+    uint64_t tag = 0;
+    uint32_t eventsPerSecond = 0;
+    uint32_t burst = 0;
+};
+
 class TraceJsonParser {
 public:
     static TraceJsonParser& Instance();
@@ -50,12 +56,18 @@ public:
     const AgeingParam& GetAgeingParam(TraceDumpType type) const;
 
     int GetSnapshotDefaultBufferSizeKb() const { return snapshotBufSzKb_; }
+    bool IsCacheEventFormatRefEnabled() const { return cacheEventFmtRef_; }
+    const std::vector<TagRateLimit>& GetTagRateLimits() const { return tagRateLimits_; }
+    // value of TRACE_TAG_RATE_LIMIT for the configured limits, empty if there are none
+    std::string GetTagRateLimitParam() const;
 private:
     std::map<std::string, TraceTag> traceTagInfos_ = {};
     std::map<std::string, std::vector<std::string>> tagGroups_ = {};
     std::vector<std::string> baseTraceFormats_ = {};
 
     int snapshotBufSzKb_ = 0;
+    bool cacheEventFmtRef_ = false;
+    std::vector<TagRateLimit> tagRateLimits_ = {};
 
     AgeingParam snapShotAgeingParam_ = {};
     AgeingParam recordAgeingParam_ = {};
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_rate_limiter.h"
+
+#include <cstdlib>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+namespace {
+constexpr uint64_t NS_PER_SECOND = 1000000000;
+constexpr uint64_t MAX_EVENTS_PER_SECOND = 1000000;
+constexpr uint64_t MAX_REFILL_NS = 10 * NS_PER_SECOND; // 10 : keeps elapsed * rate far from overflow
+constexpr uint64_t REPORT_INTERVAL_NS = NS_PER_SECOND;
+constexpr int TAG_OFFSET_MAX = 63;
+constexpr int DECIMAL = 10;
+constexpr int64_t PAIR_COST = 2;
+constexpr int64_t COUNTER_COST = 1;
+constexpr int MAX_TRACKED_DEPTH = 64;
+constexpr size_t MAX_PROBES = 8;
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr uint64_t FNV_PRIME = 0x100000001b3;
+constexpr uint64_t GOLDEN_RATIO = 0x9e3779b97f4a7c15;
+
+// the B markers of every limited tag nest on the thread, bit n tells whether the B at depth n was dropped
+struct ThreadDropStack {
+    uint32_t epoch = 0;
+    uint32_t depth[TraceRateLimiter::MAX_LIMITED_TAGS] = {};
+    uint64_t dropped[TraceRateLimiter::MAX_LIMITED_TAGS] = {};
+};
+thread_local ThreadDropStack t_dropStack;
+
+bool ParseNumber(const char*& cur, uint64_t& value)
+{
+    char* end = nullptr;
+    value = strtoull(cur, &end, DECIMAL);
+    if (end == cur) {
+        return false;
+    }
+    cur = end;
+    return true;
+}
+
+bool SkipChar(const char*& cur, const char ch)
+{
+    if (*cur != ch) {
+        return false;
+    }
+    cur++;
+    return true;
+}
+
+uint64_t AsyncKey(const char* name, const int64_t taskId, const int slot)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const char* ch = name; ch != nullptr && *ch != '\0'; ch++) {
+        hash = (hash ^ static_cast<uint8_t>(*ch)) * FNV_PRIME;
+    }
+    hash ^= (static_cast<uint64_t>(taskId) + static_cast<uint64_t>(slot)) * GOLDEN_RATIO;
+    return hash == 0 ? 1 : hash; // 0 marks an empty slot
+}
+} // namespace
+
+void TraceRateLimiter::Configure(const char* value, const uint64_t now,
+    void (*report)(const SuppressedReport& report))
+{
+    std::lock_guard<std::mutex> lock(configureMutex_);
+    // markers racing with the update see no limit, never a half written bucket
+    limitedTags_.store(0, std::memory_order_relaxed);
+    for (int slot = 0; report != nullptr && slot < MAX_LIMITED_TAGS; slot++) {
+        Bucket& bucket = buckets_[slot];
+        uint64_t suppressed = bucket.suppressed.load(std::memory_order_relaxed);
+        uint64_t tag = bucket.tag.load(std::memory_order_relaxed);
+        if (tag != 0 && bucket.reportedSuppressed.exchange(suppressed, std::memory_order_relaxed) != suppressed) {
+            report({tag, suppressed});
+        }
+    }
+    uint64_t limitedTags = 0;
+    int count = 0;
+    for (const char* cur = value; cur != nullptr && *cur != '\0' && count < MAX_LIMITED_TAGS;) {
+        uint64_t offset = 0;
+        uint64_t rate = 0;
+        uint64_t burst = 0;
+        bool valid = ParseNumber(cur, offset) && SkipChar(cur, ':') && ParseNumber(cur, rate);
+        if (valid && SkipChar(cur, ':')) {
+            valid = ParseNumber(cur, burst);
+        }
+        while (*cur != '\0' && *cur != ',') {
+            valid = false;
+            cur++;
+        }
+        (void)SkipChar(cur, ',');
+        if (!valid || offset > TAG_OFFSET_MAX || rate == 0) {
+            continue;
+        }
+        rate = rate > MAX_EVENTS_PER_SECOND ? MAX_EVENTS_PER_SECOND : rate;
+        burst = burst < rate ? rate : (burst > MAX_EVENTS_PER_SECOND ? MAX_EVENTS_PER_SECOND : burst);
+        Bucket& bucket = buckets_[count++];
+        bucket.tag.store(1ULL << offset, std::memory_order_relaxed);
+        bucket.eventsPerSecond.store(rate, std::memory_order_relaxed);
+        bucket.burst.store(static_cast<int64_t>(burst), std::memory_order_relaxed);
+        bucket.tokens.store(static_cast<int64_t>(burst), std::memory_order_relaxed);
+        bucket.refillTime.store(now, std::memory_order_relaxed);
+        bucket.suppressed.store(0, std::memory_order_relaxed);
+        bucket.reportTime.store(now, std::memory_order_relaxed);
+        bucket.reportedSuppressed.store(0, std::memory_order_relaxed);
+        limitedTags |= 1ULL << offset;
+    }
+    for (int slot = count; slot < MAX_LIMITED_TAGS; slot++) {
+        buckets_[slot].tag.store(0, std::memory_order_relaxed);
+    }
+    for (auto& key : droppedAsync_) {
+        key.store(0, std::memory_order_relaxed);
+    }
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+    limitedTags_.store(limitedTags, std::memory_order_release);
+}
+
+bool TraceRateLimiter::Admit(const char type, const uint64_t tag, const char* name, const int64_t taskId,
+    const uint64_t now, SuppressedReport& report)
+{
+    int slot = 0;
+    while (slot < MAX_LIMITED_TAGS && (buckets_[slot].tag.load(std::memory_order_relaxed) & tag) == 0) {
+        slot++;
+    }
+    if (slot == MAX_LIMITED_TAGS) {
+        return true;
+    }
+    Bucket& bucket = buckets_[slot];
+    uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+    if (t_dropStack.epoch != epoch) {
+        t_dropStack = ThreadDropStack();
+        t_dropStack.epoch = epoch;
+    }
+    uint32_t& depth = t_dropStack.depth[slot];
+    bool admit = true;
+    switch (type) {
+        case 'B':
+            // beyond the tracked depth the slices are kept, their E markers cannot be told apart
+            if (depth < MAX_TRACKED_DEPTH) {
+                admit = TakeTokens(bucket, PAIR_COST, now);
+                uint64_t bit = 1ULL << depth;
+                t_dropStack.dropped[slot] = admit ? (t_dropStack.dropped[slot] & ~bit) :
+                    (t_dropStack.dropped[slot] | bit);
+            }
+            depth++;
+            break;
+        case 'E':
+            // an E without a B on this thread began before the limits were set, it is kept
+            if (depth > 0) {
+                depth--;
+                admit = depth >= MAX_TRACKED_DEPTH || (t_dropStack.dropped[slot] & (1ULL << depth)) == 0;
+            }
+            break;
+        case 'S':
+            // a dropped S the set has no room for is written anyway, an F must never be left alone
+            admit = TakeTokens(bucket, PAIR_COST, now) || !RememberDroppedAsync(AsyncKey(name, taskId, slot));
+            break;
+        case 'F':
+            admit = !ForgetDroppedAsync(AsyncKey(name, taskId, slot));
+            break;
+        default:
+            admit = TakeTokens(bucket, COUNTER_COST, now);
+            break;
+    }
+    if (!admit) {
+        bucket.suppressed.fetch_add(1, std::memory_order_relaxed);
+    }
+    CheckReport(bucket, now, report);
+    return admit;
+}
+
+bool TraceRateLimiter::TakeTokens(Bucket& bucket, const int64_t cost, const uint64_t now)
+{
+    uint64_t last = bucket.refillTime.load(std::memory_order_relaxed);
+    if (now > last) {
+        uint64_t rate = bucket.eventsPerSecond.load(std::memory_order_relaxed);
+        uint64_t elapsed = now - last;
+        bool capped = elapsed > MAX_REFILL_NS;
+        uint64_t refill = (capped ? MAX_REFILL_NS : elapsed) * rate / NS_PER_SECOND;
+        // the thread winning the refill time adds the tokens, the fraction of a token stays for the next one
+        uint64_t next = capped ? now : last + refill * NS_PER_SECOND / rate;
+        if (refill > 0 && bucket.refillTime.compare_exchange_strong(last, next, std::memory_order_relaxed)) {
+            int64_t burst = bucket.burst.load(std::memory_order_relaxed);
+            int64_t tokens = bucket.tokens.fetch_add(static_cast<int64_t>(refill), std::memory_order_relaxed) +
+                static_cast<int64_t>(refill);
+            while (tokens > burst &&
+                !bucket.tokens.compare_exchange_weak(tokens, burst, std::memory_order_relaxed)) {}
+        }
+    }
+    if (bucket.tokens.fetch_sub(cost, std::memory_order_relaxed) >= cost) {
+        return true;
+    }
+    bucket.tokens.fetch_add(cost, std::memory_order_relaxed);
+    return false;
+}
+
+bool TraceRateLimiter::RememberDroppedAsync(const uint64_t key)
+{
+    for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+        auto& slot = droppedAsync_[(key + probe) % DROPPED_ASYNC_SLOTS];
+        uint64_t expected = 0;
+        if (slot.compare_exchange_strong(expected, key, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceRateLimiter::ForgetDroppedAsync(const uint64_t key)
+{
+    for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+        auto& slot = droppedAsync_[(key + probe) % DROPPED_ASYNC_SLOTS];
+        uint64_t expected = key;
+        if (slot.compare_exchange_strong(expected, 0, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// runs on every marker of a limited tag, so the common case of nothing new to report is two relaxed loads
+void TraceRateLimiter::CheckReport(Bucket& bucket, const uint64_t now, SuppressedReport& report)
+{
+    uint64_t suppressed = bucket.suppressed.load(std::memory_order_relaxed);
+    if (suppressed == bucket.reportedSuppressed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t last = bucket.reportTime.load(std::memory_order_relaxed);
+    if (now < last + REPORT_INTERVAL_NS ||
+        !bucket.reportTime.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return;
+    }
+    if (bucket.reportedSuppressed.exchange(suppressed, std::memory_order_relaxed) == suppressed) {
+        return;
+    }
+    report.tag = bucket.tag.load(std::memory_order_relaxed);
+    report.suppressed = suppressed;
+}
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
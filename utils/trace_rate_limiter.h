@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HITRACE_TRACE_RATE_LIMITER_H
+#define HITRACE_TRACE_RATE_LIMITER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace Hitrace {
+struct SuppressedReport {
+    uint64_t tag = 0;
+    uint64_t suppressed = 0; // markers dropped for the tag since the limits were set
+};
+
+/**
+ * @brief Per tag token buckets of one process, set from TRACE_TAG_RATE_LIMIT.
+ * @note A B marker takes the tokens of its pair and the matching E marker follows its decision on the same thread,
+ *       S/F pairs are matched by name and task id, so a storming tag loses whole slices and never leaves a half.
+ *       Admit is lock free, the caller only pays for a clock read on the limited tags.
+ */
+class TraceRateLimiter {
+public:
+    static constexpr int MAX_LIMITED_TAGS = 8;
+
+    // value is "<tag offset>:<events per second>[:<burst>],...", empty clears the limits.
+    // The drops of the old limits not yet reported are handed to report first, when it is set. Any tracing thread
+    // may see the parameter change, concurrent calls are serialized.
+    void Configure(const char* value, const uint64_t now, void (*report)(const SuppressedReport& report) = nullptr);
+    uint64_t GetLimitedTags() const { return limitedTags_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Decide whether a marker of a limited tag is written, type is one of 'B', 'E', 'S', 'F' and 'C'.
+     * @return false to drop it. report.tag is set when a suppressed counter for the tag is due, which a later
+     *         admitted marker of the tag also checks, so the last drops of a burst are not left unreported.
+     */
+    bool Admit(const char type, const uint64_t tag, const char* name, const int64_t taskId, const uint64_t now,
+        SuppressedReport& report);
+
+private:
+    struct Bucket {
+        std::atomic<uint64_t> tag {0};
+        std::atomic<uint64_t> eventsPerSecond {0};
+        std::atomic<int64_t> burst {0};
+        std::atomic<int64_t> tokens {0};
+        std::atomic<uint64_t> refillTime {0};
+        std::atomic<uint64_t> suppressed {0};
+        std::atomic<uint64_t> reportTime {0};
+        std::atomic<uint64_t> reportedSuppressed {0};
+    };
+
+    static constexpr size_t DROPPED_ASYNC_SLOTS = 256;
+
+    bool TakeTokens(Bucket& bucket, const int64_t cost, const uint64_t now);
+    bool RememberDroppedAsync(const uint64_t key);
+    bool ForgetDroppedAsync(const uint64_t key);
+    void CheckReport(Bucket& bucket, const uint64_t now, SuppressedReport& report);
+
+    Bucket buckets_[MAX_LIMITED_TAGS];
+    std::mutex configureMutex_;
+    std::atomic<uint64_t> limitedTags_ {0};
+    std::atomic<uint32_t> epoch_ {0}; // moves on every Configure, resets the per thread B/E decisions
+    std::atomic<uint64_t> droppedAsync_[DROPPED_ASYNC_SLOTS] = {};
+};
+} // namespace Hitrace
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif // HITRACE_TRACE_RATE_LIMITER_H